@@ -0,0 +1,489 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <regex>
+#include <thread>
+
+#include <cJSON.h>
+
+#include "version.h"
+
+namespace bench
+{
+
+static std::vector<Benchmark *> &registry()
+{
+    static std::vector<Benchmark *> benchmarks;
+    return benchmarks;
+}
+
+Benchmark *register_benchmark(const char *name, Function fn)
+{
+    Benchmark *b = new Benchmark(name, fn);
+    registry().push_back(b);
+    return b;
+}
+
+static double real_now_ns()
+{
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double cpu_now_ns()
+{
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+    return (double)clock() * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+void State::_start_timer()
+{
+    if (_running)
+        return;
+    _running = true;
+    _real_start = real_now_ns();
+    _cpu_start = cpu_now_ns();
+}
+
+void State::_stop_timer()
+{
+    if (!_running)
+        return;
+    _running = false;
+    _real_ns += real_now_ns() - _real_start;
+    _cpu_ns += cpu_now_ns() - _cpu_start;
+}
+
+void State::pause_timing()
+{
+    _stop_timer();
+}
+
+void State::resume_timing()
+{
+    _start_timer();
+}
+
+struct Options
+{
+    std::string filter = ".";
+    double min_time = 0.5;      // seconds per measurement
+    int repetitions = 3;        // median is reported
+    std::string out;
+    std::string baseline;
+    double max_regression = 10; // percent of baseline cpu_time
+    bool list = false;
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double real_ns = 0;         // per iteration
+    double cpu_ns = 0;          // per iteration
+    double bytes_per_second = 0;
+    double items_per_second = 0;
+    std::string label;
+    std::string error;
+};
+
+class Runner
+{
+public:
+    explicit Runner(const Options &opts) : _opts(opts) {}
+
+    int run();
+
+private:
+    bool _run_once(Benchmark *b, const std::vector<int64_t> &args, uint64_t iterations, Result &r);
+    Result _measure(Benchmark *b, const std::vector<int64_t> &args, const std::string &name);
+    void _print(const Result &r);
+    bool _write_json();
+    int _compare_baseline();
+
+    const Options &_opts;
+    std::vector<Result> _results;
+};
+
+static std::string run_name(const std::string &base, const std::vector<int64_t> &args)
+{
+    std::string name = base;
+    for (int64_t a : args)
+        name += "/" + std::to_string(a);
+    return name;
+}
+
+bool Runner::_run_once(Benchmark *b, const std::vector<int64_t> &args, uint64_t iterations, Result &r)
+{
+    State state(iterations, args);
+    b->_fn(state);
+    state._stop_timer();
+
+    r.iterations = iterations;
+    r.label = state._label;
+    r.error = state._error;
+    if (!r.error.empty())
+        return false;
+
+    r.real_ns = state._real_ns / iterations;
+    r.cpu_ns = state._cpu_ns / iterations;
+    double seconds = state._real_ns / 1e9;
+    r.bytes_per_second = (state._bytes > 0 && seconds > 0) ? state._bytes / seconds : 0;
+    r.items_per_second = (state._items > 0 && seconds > 0) ? state._items / seconds : 0;
+    return true;
+}
+
+/* Grow the iteration count until one run lasts at least min_time, then take the
+   median of the requested repetitions at that count. Same approach as Google Benchmark,
+   minus the statistics we don't use.
+*/
+Result Runner::_measure(Benchmark *b, const std::vector<int64_t> &args, const std::string &name)
+{
+    Result r;
+    r.name = name;
+
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        if (!_run_once(b, args, iterations, r))
+            return r;
+
+        double seconds = r.real_ns * iterations / 1e9;
+        if (seconds >= _opts.min_time || iterations >= 1000000000)
+            break;
+
+        // aim 40% over the target, never more than 10x at once
+        double multiplier = seconds > 0 ? _opts.min_time * 1.4 / seconds : 10;
+        multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+        iterations = (uint64_t)(iterations * multiplier);
+    }
+
+    std::vector<Result> reps;
+    reps.push_back(r);
+    for (int i = 1; i < _opts.repetitions; i++)
+    {
+        Result rep;
+        rep.name = name;
+        if (!_run_once(b, args, iterations, rep))
+            return rep;
+        reps.push_back(rep);
+    }
+
+    std::sort(reps.begin(), reps.end(),
+              [](const Result &a, const Result &b) { return a.cpu_ns < b.cpu_ns; });
+    return reps[reps.size() / 2];
+}
+
+static std::string format_time(double ns)
+{
+    char buf[32];
+    if (ns < 10000)
+        snprintf(buf, sizeof(buf), "%.1f ns", ns);
+    else if (ns < 10000000)
+        snprintf(buf, sizeof(buf), "%.1f us", ns / 1e3);
+    else
+        snprintf(buf, sizeof(buf), "%.1f ms", ns / 1e6);
+    return buf;
+}
+
+static std::string format_rate(double per_second, const char *unit)
+{
+    char buf[32];
+    if (per_second >= 1e9)
+        snprintf(buf, sizeof(buf), "%.2fG%s/s", per_second / 1e9, unit);
+    else if (per_second >= 1e6)
+        snprintf(buf, sizeof(buf), "%.2fM%s/s", per_second / 1e6, unit);
+    else if (per_second >= 1e3)
+        snprintf(buf, sizeof(buf), "%.2fk%s/s", per_second / 1e3, unit);
+    else
+        snprintf(buf, sizeof(buf), "%.2f%s/s", per_second, unit);
+    return buf;
+}
+
+void Runner::_print(const Result &r)
+{
+    if (!r.error.empty())
+    {
+        printf("%-48s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+        return;
+    }
+
+    std::string extra;
+    if (r.bytes_per_second > 0)
+        extra += " " + format_rate(r.bytes_per_second, "B");
+    if (r.items_per_second > 0)
+        extra += " " + format_rate(r.items_per_second, "");
+    if (!r.label.empty())
+        extra += " " + r.label;
+
+    printf("%-48s %13s %13s %12llu%s\n", r.name.c_str(), format_time(r.real_ns).c_str(),
+           format_time(r.cpu_ns).c_str(), (unsigned long long)r.iterations, extra.c_str());
+    fflush(stdout);
+}
+
+// Same layout as Google Benchmark's JSON reporter, so its compare.py can be used as well
+bool Runner::_write_json()
+{
+    cJSON *root = cJSON_CreateObject();
+
+    cJSON *context = cJSON_AddObjectToObject(root, "context");
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    cJSON_AddStringToObject(context, "date", date);
+    cJSON_AddStringToObject(context, "executable", "fujinet_bench");
+    cJSON_AddNumberToObject(context, "num_cpus", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+    cJSON_AddStringToObject(context, "library_build_type", "release");
+#else
+    cJSON_AddStringToObject(context, "library_build_type", "debug");
+#endif
+    cJSON_AddStringToObject(context, "fujinet_version", FN_VERSION_FULL);
+#if defined(BUILD_ATARI)
+    cJSON_AddStringToObject(context, "fujinet_target", "ATARI");
+#elif defined(BUILD_APPLE)
+    cJSON_AddStringToObject(context, "fujinet_target", "APPLE");
+#elif defined(BUILD_COCO)
+    cJSON_AddStringToObject(context, "fujinet_target", "COCO");
+#endif
+
+    cJSON *list = cJSON_AddArrayToObject(root, "benchmarks");
+    for (const Result &r : _results)
+    {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", r.name.c_str());
+        cJSON_AddStringToObject(item, "run_name", r.name.c_str());
+        cJSON_AddStringToObject(item, "run_type", "iteration");
+        cJSON_AddNumberToObject(item, "repetitions", _opts.repetitions);
+        if (!r.error.empty())
+        {
+            cJSON_AddTrueToObject(item, "error_occurred");
+            cJSON_AddStringToObject(item, "error_message", r.error.c_str());
+        }
+        else
+        {
+            cJSON_AddNumberToObject(item, "iterations", (double)r.iterations);
+            cJSON_AddNumberToObject(item, "real_time", r.real_ns);
+            cJSON_AddNumberToObject(item, "cpu_time", r.cpu_ns);
+            cJSON_AddStringToObject(item, "time_unit", "ns");
+            if (r.bytes_per_second > 0)
+                cJSON_AddNumberToObject(item, "bytes_per_second", r.bytes_per_second);
+            if (r.items_per_second > 0)
+                cJSON_AddNumberToObject(item, "items_per_second", r.items_per_second);
+            if (!r.label.empty())
+                cJSON_AddStringToObject(item, "label", r.label.c_str());
+        }
+        cJSON_AddItemToArray(list, item);
+    }
+
+    char *text = cJSON_Print(root);
+    cJSON_Delete(root);
+    if (text == nullptr)
+        return false;
+
+    FILE *f = fopen(_opts.out.c_str(), "w");
+    bool ok = false;
+    if (f != nullptr)
+    {
+        ok = fputs(text, f) >= 0;
+        ok = (fclose(f) == 0) && ok;
+    }
+    cJSON_free(text);
+
+    if (!ok)
+        fprintf(stderr, "Failed to write %s\n", _opts.out.c_str());
+    return ok;
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::string data;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return data;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.append(buf, n);
+    fclose(f);
+    return data;
+}
+
+/* Compare cpu_time with a previous --benchmark_out file.
+   Returns 1 if any benchmark got slower by more than max_regression percent.
+*/
+int Runner::_compare_baseline()
+{
+    std::string text = read_file(_opts.baseline);
+    cJSON *root = cJSON_Parse(text.c_str());
+    cJSON *list = cJSON_GetObjectItem(root, "benchmarks");
+    if (!cJSON_IsArray(list))
+    {
+        fprintf(stderr, "Can't read baseline %s\n", _opts.baseline.c_str());
+        cJSON_Delete(root);
+        return 1;
+    }
+
+    printf("\nComparison with %s (limit +%.1f%% cpu_time)\n", _opts.baseline.c_str(), _opts.max_regression);
+
+    int regressions = 0;
+    for (const Result &r : _results)
+    {
+        if (!r.error.empty())
+            continue;
+
+        cJSON *item;
+        cJSON_ArrayForEach(item, list)
+        {
+            cJSON *name = cJSON_GetObjectItem(item, "name");
+            cJSON *cpu = cJSON_GetObjectItem(item, "cpu_time");
+            if (!cJSON_IsString(name) || !cJSON_IsNumber(cpu) || r.name != name->valuestring)
+                continue;
+
+            double change = cpu->valuedouble > 0 ? (r.cpu_ns - cpu->valuedouble) * 100 / cpu->valuedouble : 0;
+            bool regressed = change > _opts.max_regression;
+            if (regressed)
+                regressions++;
+            printf("%-48s %13s -> %13s %+7.1f%%%s\n", r.name.c_str(), format_time(cpu->valuedouble).c_str(),
+                   format_time(r.cpu_ns).c_str(), change, regressed ? "  REGRESSION" : "");
+            break;
+        }
+    }
+    cJSON_Delete(root);
+
+    if (regressions)
+    {
+        printf("%d benchmark(s) regressed\n", regressions);
+        return 1;
+    }
+    return 0;
+}
+
+int Runner::run()
+{
+    std::regex filter;
+    try
+    {
+        filter = std::regex(_opts.filter);
+    }
+    catch (const std::regex_error &)
+    {
+        fprintf(stderr, "Invalid --benchmark_filter: %s\n", _opts.filter.c_str());
+        return 1;
+    }
+
+    if (!_opts.list)
+        printf("%-48s %13s %13s %12s\n%s\n", "Benchmark", "Time", "CPU", "Iterations",
+               std::string(90, '-').c_str());
+
+    bool failed = false;
+    for (Benchmark *b : registry())
+    {
+        std::vector<std::vector<int64_t>> arg_sets = b->_args;
+        if (arg_sets.empty())
+            arg_sets.push_back({});
+
+        for (const auto &args : arg_sets)
+        {
+            std::string name = run_name(b->_name, args);
+            if (!std::regex_search(name, filter))
+                continue;
+            if (_opts.list)
+            {
+                printf("%s\n", name.c_str());
+                continue;
+            }
+
+            Result r = _measure(b, args, name);
+            if (!r.error.empty())
+                failed = true;
+            _print(r);
+            _results.push_back(r);
+        }
+    }
+
+    if (_opts.list)
+        return 0;
+
+    if (!_opts.out.empty() && !_write_json())
+        failed = true;
+
+    if (!_opts.baseline.empty() && _compare_baseline() != 0)
+        failed = true;
+
+    return failed ? 1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --benchmark_filter=<regex>         run only matching benchmarks\n"
+           "  --benchmark_list_tests             list benchmarks and exit\n"
+           "  --benchmark_min_time=<seconds>     minimum time per measurement (default 0.5)\n"
+           "  --benchmark_repetitions=<n>        measurements per benchmark, median is reported (default 3)\n"
+           "  --benchmark_out=<file>             write results as JSON\n"
+           "  --benchmark_baseline=<file>        compare with an earlier --benchmark_out file\n"
+           "  --benchmark_max_regression=<pct>   allowed cpu_time increase over baseline (default 10)\n",
+           prog);
+}
+
+static bool match_arg(const char *arg, const char *name, const char **value)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0)
+        return false;
+    if (arg[len] == '\0')
+    {
+        *value = nullptr;
+        return true;
+    }
+    if (arg[len] != '=')
+        return false;
+    *value = arg + len + 1;
+    return true;
+}
+
+int run(int argc, char *argv[])
+{
+    Options opts;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *v;
+        if (match_arg(argv[i], "--benchmark_filter", &v) && v)
+            opts.filter = v;
+        else if (match_arg(argv[i], "--benchmark_list_tests", &v))
+            opts.list = v == nullptr || strcmp(v, "true") == 0;
+        else if (match_arg(argv[i], "--benchmark_min_time", &v) && v)
+            opts.min_time = atof(v); // "0.5s" works too, atof stops at the suffix
+        else if (match_arg(argv[i], "--benchmark_repetitions", &v) && v)
+            opts.repetitions = std::max(1, atoi(v));
+        else if (match_arg(argv[i], "--benchmark_out", &v) && v)
+            opts.out = v;
+        else if (match_arg(argv[i], "--benchmark_baseline", &v) && v)
+            opts.baseline = v;
+        else if (match_arg(argv[i], "--benchmark_max_regression", &v) && v)
+            opts.max_regression = atof(v);
+        else
+        {
+            usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    Runner runner(opts);
+    return runner.run();
+}
+
+} // namespace bench
@@ -0,0 +1,166 @@
+/**
+ * Host-side micro benchmark harness for FujiNet-PC
+ *
+ * Small stand-in for Google Benchmark (which isn't available to every FujiNet-PC
+ * build environment) using the same registration style and JSON output format,
+ * so results can be fed to Google Benchmark's tools/compare.py as well as to our
+ * own --benchmark_baseline check.
+ *
+ *   static void BM_something(bench::State &state)
+ *   {
+ *       setup();
+ *       for (auto _ : state)
+ *           bench::do_not_optimize(work(state.arg(0)));
+ *       state.set_bytes_processed(state.iterations() * size);
+ *   }
+ *   BENCHMARK(BM_something)->arg(128)->arg(256);
+ */
+
+#ifndef FN_BENCH_H
+#define FN_BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_UNUSED __attribute__((unused))
+#else
+#define BENCH_UNUSED
+#endif
+
+class State
+{
+public:
+    // What `for (auto _ : state)` binds to. Non-trivial (and marked unused
+    // where the compiler supports it) so -Wall doesn't flag the loop variable.
+    struct BENCH_UNUSED Value
+    {
+        Value() {}
+    };
+
+    struct Iterator
+    {
+        State *state;
+        uint64_t remaining;
+
+        bool operator!=(const Iterator &) const
+        {
+            if (remaining != 0)
+                return true;
+            state->_stop_timer();
+            return false;
+        }
+        void operator++() { --remaining; }
+        Value operator*() const { return Value(); }
+    };
+
+    State(uint64_t iterations, const std::vector<int64_t> &args)
+        : _iterations(iterations), _args(args) {}
+
+    Iterator begin()
+    {
+        _start_timer();
+        return Iterator{this, _iterations};
+    }
+    Iterator end() { return Iterator{this, 0}; }
+
+    int64_t arg(size_t i) const { return i < _args.size() ? _args[i] : 0; }
+    uint64_t iterations() const { return _iterations; }
+
+    // Exclude per-iteration setup from the measurement
+    void pause_timing();
+    void resume_timing();
+
+    void set_bytes_processed(int64_t bytes) { _bytes = bytes; }
+    void set_items_processed(int64_t items) { _items = items; }
+    void set_label(const std::string &label) { _label = label; }
+    // Mark the benchmark as failed (e.g. fixture couldn't be created)
+    void skip_with_error(const std::string &msg) { _error = msg; }
+
+private:
+    friend class Runner;
+
+    void _start_timer();
+    void _stop_timer();
+
+    uint64_t _iterations;
+    std::vector<int64_t> _args;
+
+    bool _running = false;
+    double _real_start = 0;
+    double _cpu_start = 0;
+    double _real_ns = 0;
+    double _cpu_ns = 0;
+
+    int64_t _bytes = 0;
+    int64_t _items = 0;
+    std::string _label;
+    std::string _error;
+};
+
+typedef void (*Function)(State &);
+
+class Benchmark
+{
+public:
+    Benchmark(const char *name, Function fn) : _name(name), _fn(fn) {}
+
+    // Run the benchmark once for each arg() value
+    Benchmark *arg(int64_t a)
+    {
+        _args.push_back({a});
+        return this;
+    }
+    // Run the benchmark once for each args() set
+    Benchmark *args(const std::vector<int64_t> &a)
+    {
+        _args.push_back(a);
+        return this;
+    }
+
+private:
+    friend class Runner;
+
+    std::string _name;
+    Function _fn;
+    std::vector<std::vector<int64_t>> _args;
+};
+
+Benchmark *register_benchmark(const char *name, Function fn);
+
+// Run registered benchmarks according to command line, returns process exit code
+int run(int argc, char *argv[]);
+
+// Keep the compiler from optimizing away a computed value
+template <class T>
+inline void do_not_optimize(T const &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+inline void clobber_memory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+} // namespace bench
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+
+#define BENCHMARK(fn)                                                    \
+    static bench::Benchmark *BENCH_CONCAT(_bench_reg_, __LINE__) =       \
+        bench::register_benchmark(#fn, fn)
+
+#endif // FN_BENCH_H
@@ -0,0 +1,67 @@
+/* Bus hot paths: frame checksums and the per command metrics bookkeeping */
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include "busMetrics.h"
+
+#ifdef BUILD_ATARI
+
+#include "sio/sio.h"
+
+// Command frame (4 bytes) and sector payloads, checksummed on every SIO transfer
+static void BM_sio_checksum(bench::State &state)
+{
+    std::vector<uint8_t> buf(state.arg(0));
+    fixtures::Random rnd;
+    for (uint8_t &b : buf)
+        b = (uint8_t)rnd.next();
+
+    for (auto _ : state)
+    {
+        bench::do_not_optimize(sio_checksum(buf.data(), buf.size()));
+        bench::clobber_memory();
+    }
+    state.set_bytes_processed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_sio_checksum)->arg(4)->arg(128)->arg(256)->arg(512);
+
+#endif // BUILD_ATARI
+
+// Hooks a bus runs for one sector read, spread over a realistic mix of devices/commands
+static void BM_bus_metrics_command(bench::State &state)
+{
+    static const uint8_t devices[] = {0x31, 0x32, 0x70, 0x71};
+    static const uint8_t commands[] = {'R', 'S', 'W', 'P', 'O', 'C'};
+
+    uint32_t n = 0;
+    for (auto _ : state)
+    {
+        uint8_t device = devices[n & 3];
+        uint8_t command = commands[n % 6];
+        fnBusMetrics.command_start(device, command);
+        fnBusMetrics.ack();
+        fnBusMetrics.complete(false);
+        fnBusMetrics.data_out(128);
+        fnBusMetrics.command_end();
+        n++;
+    }
+    state.set_items_processed(state.iterations());
+}
+BENCHMARK(BM_bus_metrics_command);
+
+static void BM_bus_metrics_to_json(bench::State &state)
+{
+    for (uint8_t d = 0x31; d < 0x39; d++)
+        for (uint8_t c : {'R', 'S', 'W', 'P'})
+        {
+            fnBusMetrics.command_start(d, c);
+            fnBusMetrics.ack();
+            fnBusMetrics.complete(false);
+            fnBusMetrics.command_end();
+        }
+
+    for (auto _ : state)
+        bench::do_not_optimize(fnBusMetrics.to_json());
+}
+BENCHMARK(BM_bus_metrics_to_json);
@@ -0,0 +1,59 @@
+/* Directory listing: DirCache filtering and sorting as done for every OPEN DIRECTORY */
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include "fnDirCache.h"
+
+// args: number of entries, DIR_OPTION_* sort options
+static void BM_dircache_sort(bench::State &state)
+{
+    DirCache cache;
+    fixtures::dir_entries(cache, state.arg(0));
+    uint16_t diropts = state.arg(1);
+
+    for (auto _ : state)
+    {
+        cache.apply_filter(nullptr, diropts);
+        bench::do_not_optimize(cache.read());
+    }
+    state.set_items_processed(state.iterations() * state.arg(0));
+}
+BENCHMARK(BM_dircache_sort)
+    ->args({100, 0})
+    ->args({1000, 0})
+    ->args({1000, DIR_OPTION_DESCENDING})
+    ->args({1000, DIR_OPTION_FILEDATE})
+    ->args({5000, 0});
+
+// Wildcard filter, as used by the CONFIG file browser search
+static void BM_dircache_filter(bench::State &state)
+{
+    DirCache cache;
+    fixtures::dir_entries(cache, state.arg(0));
+
+    for (auto _ : state)
+    {
+        cache.apply_filter("*.ATR", 0);
+        bench::do_not_optimize(cache.read());
+    }
+    state.set_items_processed(state.iterations() * state.arg(0));
+}
+BENCHMARK(BM_dircache_filter)->arg(1000);
+
+// Reading the sorted listing back, entry by entry
+static void BM_dircache_read(bench::State &state)
+{
+    DirCache cache;
+    fixtures::dir_entries(cache, state.arg(0));
+    cache.apply_filter(nullptr, 0);
+
+    for (auto _ : state)
+    {
+        cache.seek(0);
+        while (fsdir_entry *e = cache.read())
+            bench::do_not_optimize(e);
+    }
+    state.set_items_processed(state.iterations() * state.arg(0));
+}
+BENCHMARK(BM_dircache_read)->arg(1000);
@@ -0,0 +1,11 @@
+#include "bench.h"
+
+#include "utils.h"
+
+int main(int argc, char *argv[])
+{
+    // Debug_printf is compiled into the firmware objects shared with fujinet,
+    // mute it here, the hot paths are full of it
+    util_debug_enable(false);
+    return bench::run(argc, argv);
+}
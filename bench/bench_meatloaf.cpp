@@ -0,0 +1,148 @@
+/* Meatloaf media containers: header and directory parsing on top of the container stream */
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <string.h>
+
+#include "meat_media.h"
+
+/* Container stream over an in-memory image that counts the calls made to it,
+   each of which is a separate client read or range request over HTTP/TNFS.
+*/
+class CountingStream : public MStream
+{
+public:
+    CountingStream(const std::string &data) : _data(data) { _size = data.size(); }
+
+    bool isOpen() override { return true; }
+    bool open() override { return true; }
+    void close() override {}
+
+    uint32_t write(const uint8_t *buf, uint32_t size) override { return 0; }
+    uint32_t read(uint8_t *buf, uint32_t size) override
+    {
+        calls++;
+        if (_position >= _size)
+            return 0;
+        size = std::min(size, _size - _position);
+        memcpy(buf, _data.data() + _position, size);
+        _position += size;
+        return size;
+    }
+    bool seek(uint32_t pos) override
+    {
+        calls++;
+        _position = pos;
+        return pos <= _size;
+    }
+
+    size_t calls = 0;
+
+private:
+    const std::string &_data;
+};
+
+// Walks a T64 directory the way T64MStream does, one seek and 32 byte read per entry
+class BenchT64Stream : public MMediaStream
+{
+public:
+    BenchT64Stream(std::shared_ptr<MStream> is) : MMediaStream(is) {}
+
+    void seekHeader() override
+    {
+        seekContainer(0x28);
+        readContainer(header, sizeof(header));
+    }
+    bool seekNextImageEntry() override
+    {
+        seekContainer(0x40 + entry_index * sizeof(entry));
+        readContainer(entry, sizeof(entry));
+        entry_index++;
+        return entry[0] != 0x00;
+    }
+    uint16_t readFile(uint8_t *buf, uint16_t size) override { return readContainer(buf, size); }
+
+    size_t list(size_t max_entries)
+    {
+        resetEntryCounter();
+        seekHeader();
+        size_t count = 0;
+        while (count < max_entries && seekNextImageEntry())
+            count++;
+        return count;
+    }
+
+    uint8_t header[24];
+    uint8_t entry[32];
+};
+
+// Lynx directory, CR terminated text fields read with readUntil()
+class BenchLNXStream : public MMediaStream
+{
+public:
+    BenchLNXStream(std::shared_ptr<MStream> is) : MMediaStream(is) {}
+
+    void seekHeader() override
+    {
+        seekContainer(0);
+        readUntil(0x0D); // BASIC stub
+        readUntil(0x0D); // signature
+        entries = atoi(readUntil(0x0D).c_str());
+    }
+    bool seekNextImageEntry() override
+    {
+        name = readUntil(0x0D);
+        blocks = atoi(readUntil(0x0D).c_str());
+        type = readUntil(0x0D);
+        readUntil(0x0D); // last byte
+        return !name.empty();
+    }
+    uint16_t readFile(uint8_t *buf, uint16_t size) override { return readContainer(buf, size); }
+
+    size_t list(size_t max_entries)
+    {
+        seekHeader();
+        size_t count = 0;
+        while (count < entries && count < max_entries && seekNextImageEntry())
+            count++;
+        return count;
+    }
+
+    size_t entries = 0;
+    std::string name, type;
+    int blocks = 0;
+};
+
+template <class T>
+static void list_image(bench::State &state, const std::string &image)
+{
+    auto container = std::make_shared<CountingStream>(image);
+    size_t calls = 0, listings = 0;
+
+    for (auto _ : state)
+    {
+        T stream(container);
+        size_t before = container->calls;
+        if (stream.list(state.arg(0)) != (size_t)state.arg(0))
+            state.skip_with_error("wrong number of entries");
+        calls += container->calls - before;
+        listings++;
+    }
+    state.set_items_processed(state.iterations() * state.arg(0));
+    if (listings)
+        state.set_label("container calls/listing: " + std::to_string(calls / listings));
+}
+
+// arg: number of directory entries
+static void BM_meatloaf_t64_listing(bench::State &state)
+{
+    list_image<BenchT64Stream>(state, fixtures::t64_image(state.arg(0)));
+}
+BENCHMARK(BM_meatloaf_t64_listing)->arg(8)->arg(30);
+
+static void BM_meatloaf_lnx_listing(bench::State &state)
+{
+    list_image<BenchLNXStream>(state, fixtures::lnx_image(state.arg(0)));
+}
+BENCHMARK(BM_meatloaf_lnx_listing)->arg(8)->arg(30);
@@ -0,0 +1,188 @@
+/* Disk image hot paths: sector reads and image conversion on mount
+   (ATX isn't part of the FujiNet-PC build, so it isn't covered here)
+*/
+
+#include "bench.h"
+#include "fixtures.h"
+
+#ifdef BUILD_ATARI
+
+#include "atari/diskTypeAtr.h"
+
+static MediaTypeATR *mount_atr(bench::State &state, uint16_t sector_size)
+{
+    uint16_t num_sectors = sector_size == 128 ? 1040 : 720;
+    std::vector<uint8_t> image = fixtures::atr_image(num_sectors, sector_size);
+    fnFile *f = fixtures::temp_file(image);
+    if (f == nullptr)
+    {
+        state.skip_with_error("can't create temporary file");
+        return nullptr;
+    }
+
+    MediaTypeATR *disk = new MediaTypeATR();
+    if (disk->mount(f, image.size()) != MEDIATYPE_ATR)
+    {
+        state.skip_with_error("ATR mount failed");
+        fnio::fclose(f);
+        delete disk;
+        return nullptr;
+    }
+    return disk;
+}
+
+// Sector after sector, the common case the skipped fseek() is meant for
+static void BM_atr_read_sequential(bench::State &state)
+{
+    uint16_t sector_size = state.arg(0);
+    MediaTypeATR *disk = mount_atr(state, sector_size);
+    if (disk == nullptr)
+        return;
+
+    uint16_t sector = 1;
+    uint16_t readcount;
+    int64_t bytes = 0;
+    for (auto _ : state)
+    {
+        bench::do_not_optimize(disk->read(sector, &readcount));
+        bytes += readcount;
+        if (++sector > disk->_disk_num_sectors)
+            sector = 1;
+    }
+    state.set_bytes_processed(bytes);
+    state.set_items_processed(state.iterations());
+    delete disk;
+}
+BENCHMARK(BM_atr_read_sequential)->arg(128)->arg(256);
+
+// Replay of the sectors read while booting DOS and loading a file
+static void BM_atr_read_trace(bench::State &state)
+{
+    MediaTypeATR *disk = mount_atr(state, 128);
+    if (disk == nullptr)
+        return;
+
+    const std::vector<uint16_t> &trace = fixtures::dos_boot_trace();
+    size_t i = 0;
+    uint16_t readcount;
+    int64_t bytes = 0;
+    for (auto _ : state)
+    {
+        bench::do_not_optimize(disk->read(trace[i], &readcount));
+        bytes += readcount;
+        if (++i == trace.size())
+            i = 0;
+    }
+    state.set_bytes_processed(bytes);
+    state.set_items_processed(state.iterations());
+    delete disk;
+}
+BENCHMARK(BM_atr_read_trace);
+
+// Every read seeks
+static void BM_atr_read_random(bench::State &state)
+{
+    MediaTypeATR *disk = mount_atr(state, 256);
+    if (disk == nullptr)
+        return;
+
+    fixtures::Random rnd;
+    std::vector<uint16_t> sectors(4096);
+    for (uint16_t &s : sectors)
+        s = 1 + rnd.below(disk->_disk_num_sectors);
+
+    size_t i = 0;
+    uint16_t readcount;
+    int64_t bytes = 0;
+    for (auto _ : state)
+    {
+        bench::do_not_optimize(disk->read(sectors[i], &readcount));
+        bytes += readcount;
+        i = (i + 1) % sectors.size();
+    }
+    state.set_bytes_processed(bytes);
+    state.set_items_processed(state.iterations());
+    delete disk;
+}
+BENCHMARK(BM_atr_read_random);
+
+#endif // BUILD_ATARI
+
+#ifdef BUILD_APPLE
+
+#include "apple/mediaTypeDSK.h"
+
+// DSK is nibblized into WOZ tracks on mount
+static void BM_dsk_mount(bench::State &state)
+{
+    int tracks = state.arg(0);
+    std::vector<uint8_t> image = fixtures::dsk_image(tracks);
+
+    for (auto _ : state)
+    {
+        state.pause_timing();
+        fnFile *f = fixtures::mem_file(image);
+        MediaTypeDSK *disk = new MediaTypeDSK();
+        state.resume_timing();
+
+        if (disk->mount(f, image.size()) != MEDIATYPE_WOZ)
+            state.skip_with_error("DSK mount failed");
+
+        state.pause_timing();
+        disk->unmount();
+        delete disk;
+        state.resume_timing();
+    }
+    state.set_bytes_processed(state.iterations() * image.size());
+}
+BENCHMARK(BM_dsk_mount)->arg(35)->arg(40);
+
+#include "apple/dsk2woz.h"
+
+/* FNV-1a over the WOZ1 records of all tracks of fixtures::dsk_image(35) as the
+   original dsk2woz port wrote them. The encoder must keep producing exactly these.
+*/
+static const uint32_t dsk2woz_golden[2] = {0xf48e94c2, 0x6d2bac55}; // DOS 3.3, ProDOS order
+
+static uint32_t fnv1a(const uint8_t *p, size_t n, uint32_t h)
+{
+    while (n--)
+    {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Single track encoding, the unit of work when tracks are built as they're needed
+// arg: 0 DOS 3.3 order, 1 ProDOS order
+static void BM_dsk2woz_track(bench::State &state)
+{
+    bool prodos = state.arg(0) != 0;
+    std::vector<uint8_t> image = fixtures::dsk_image(35);
+    std::vector<uint8_t> track(WOZ1_TRACK_RECORD);
+
+    uint32_t h = 2166136261u;
+    for (int t = 0; t < 35; t++)
+    {
+        dsk2woz_track(track.data(), &image[t * DSK_BYTES_PER_TRACK], t, prodos);
+        h = fnv1a(track.data(), track.size(), h);
+    }
+    if (h != dsk2woz_golden[prodos])
+    {
+        state.skip_with_error("WOZ tracks differ from golden output");
+        return;
+    }
+
+    int t = 0;
+    for (auto _ : state)
+    {
+        dsk2woz_track(track.data(), &image[t * DSK_BYTES_PER_TRACK], t, prodos);
+        bench::do_not_optimize(track);
+        t = (t + 1) % 35;
+    }
+    state.set_bytes_processed(state.iterations() * DSK_BYTES_PER_TRACK);
+}
+BENCHMARK(BM_dsk2woz_track)->arg(0)->arg(1);
+
+#endif // BUILD_APPLE
@@ -0,0 +1,145 @@
+/* N: device data paths: JSON channel mode and end of line translation */
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <algorithm>
+
+#include "Protocol.h"
+#include "fnjson.h"
+
+// NetworkProtocol's dtor clears the buffers, so they have to outlive it
+struct BenchBuffers
+{
+    std::string rx, tx, sp;
+};
+
+/* Protocol serving a canned payload, in chunks like a socket would, and making
+   the translation routines reachable for the benchmarks.
+*/
+class BenchProtocol : public BenchBuffers, public NetworkProtocol
+{
+public:
+    BenchProtocol() : NetworkProtocol(&rx, &tx, &sp) {}
+
+    using NetworkProtocol::translate_receive_buffer;
+    using NetworkProtocol::translate_transmit_buffer;
+
+    void feed(const std::string &data)
+    {
+        _payload = &data;
+        _pos = 0;
+    }
+
+    bool read(unsigned short len) override
+    {
+        receiveBuffer->append(*_payload, _pos, len);
+        _pos += len;
+        return false;
+    }
+
+    bool status(NetworkStatus *status) override
+    {
+        status->rxBytesWaiting = std::min<size_t>(_payload->size() - _pos, 8192);
+        status->connected = 0;
+        status->error = 0;
+        return false;
+    }
+
+private:
+    const std::string *_payload = nullptr;
+    size_t _pos = 0;
+};
+
+// arg: number of items in the document
+static void BM_fnjson_parse(bench::State &state)
+{
+    std::string payload = fixtures::json_payload(state.arg(0));
+    BenchProtocol protocol;
+    FNJSON json;
+    json.setProtocol(&protocol);
+
+    for (auto _ : state)
+    {
+        protocol.feed(payload);
+        if (!json.parse())
+            state.skip_with_error("JSON parse failed");
+    }
+    state.set_bytes_processed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_fnjson_parse)->arg(10)->arg(100);
+
+// JSON pointer lookup and value formatting, one per item like a program walking a list
+static void BM_fnjson_query(bench::State &state)
+{
+    std::string payload = fixtures::json_payload(100);
+    BenchProtocol protocol;
+    FNJSON json;
+    json.setProtocol(&protocol);
+    protocol.feed(payload);
+    if (!json.parse())
+    {
+        state.skip_with_error("JSON parse failed");
+        return;
+    }
+
+    static const char *fields[] = {"/title", "/score", "/author/name", "/tags", "/text"};
+    std::vector<std::string> queries;
+    for (int i = 0; i < 100; i++)
+        queries.push_back("/items/" + std::to_string(i) + fields[i % 5]);
+
+    uint8_t buf[512];
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        json.setReadQuery(queries[i], 0);
+        int len = std::min<int>(json.readValueLen(), sizeof(buf));
+        json.readValue(buf, len);
+        bench::do_not_optimize(buf);
+        i = (i + 1) % queries.size();
+    }
+    state.set_items_processed(state.iterations());
+}
+BENCHMARK(BM_fnjson_query);
+
+// arg: translation mode (1 CR, 2 LF, 3 CR/LF, 4 PETSCII)
+static void BM_translate_receive(bench::State &state)
+{
+    static const char *eols[] = {"", "\r", "\n", "\r\n", "\r"};
+    int mode = state.arg(0);
+    std::string text = fixtures::text(16384, eols[mode]);
+    BenchProtocol protocol;
+    protocol.translation_mode = mode;
+
+    for (auto _ : state)
+    {
+        state.pause_timing();
+        protocol.rx = text;
+        state.resume_timing();
+        protocol.translate_receive_buffer();
+    }
+    state.set_bytes_processed(state.iterations() * text.size());
+}
+BENCHMARK(BM_translate_receive)->arg(1)->arg(2)->arg(3)->arg(4);
+
+static void BM_translate_transmit(bench::State &state)
+{
+    int mode = state.arg(0);
+#ifdef BUILD_APPLE
+    std::string text = fixtures::text(16384, "\x0d");
+#else
+    std::string text = fixtures::text(16384, "\x9b");
+#endif
+    BenchProtocol protocol;
+    protocol.translation_mode = mode;
+
+    for (auto _ : state)
+    {
+        state.pause_timing();
+        protocol.tx = text;
+        state.resume_timing();
+        bench::do_not_optimize(protocol.translate_transmit_buffer());
+    }
+    state.set_bytes_processed(state.iterations() * text.size());
+}
+BENCHMARK(BM_translate_transmit)->arg(1)->arg(2)->arg(3)->arg(4);
@@ -0,0 +1,212 @@
+#include "fixtures.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "compat_string.h"
+#include "fnDirCache.h"
+#include "fnFileLocal.h"
+#include "fnFileMem.h"
+
+namespace fixtures
+{
+
+std::vector<uint8_t> atr_image(uint16_t num_sectors, uint16_t sector_size)
+{
+    uint32_t data_size = (sector_size == 256 && num_sectors > 3)
+                             ? 3 * 128 + (num_sectors - 3) * 256
+                             : (uint32_t)num_sectors * sector_size;
+    uint32_t paragraphs = data_size / 16;
+
+    std::vector<uint8_t> image(16 + data_size);
+    image[0] = 0x96; // 'NICKATARI'
+    image[1] = 0x02;
+    image[2] = paragraphs & 0xFF;
+    image[3] = (paragraphs >> 8) & 0xFF;
+    image[4] = sector_size & 0xFF;
+    image[5] = sector_size >> 8;
+    image[6] = (paragraphs >> 16) & 0xFF;
+
+    Random rnd;
+    for (size_t i = 16; i < image.size(); i++)
+        image[i] = (uint8_t)rnd.next();
+    return image;
+}
+
+fnFile *temp_file(const std::vector<uint8_t> &data)
+{
+    FILE *fh = tmpfile();
+    if (fh == nullptr)
+        return nullptr;
+    if (fwrite(data.data(), 1, data.size(), fh) != data.size() || fseek(fh, 0, SEEK_SET) != 0)
+    {
+        fclose(fh);
+        return nullptr;
+    }
+    return new FileHandlerLocal(fh);
+}
+
+fnFile *mem_file(const std::vector<uint8_t> &data)
+{
+    FileHandlerMem *f = new FileHandlerMem();
+    if (f->write(data.data(), 1, data.size()) != data.size() || f->seek(0, SEEK_SET) != 0)
+    {
+        f->close();
+        return nullptr;
+    }
+    return f;
+}
+
+const std::vector<uint16_t> &dos_boot_trace()
+{
+    static std::vector<uint16_t> trace;
+    if (!trace.empty())
+        return trace;
+
+    // boot sectors and DOS.SYS
+    for (uint16_t s = 1; s <= 39; s++)
+        trace.push_back(s);
+    // VTOC and directory scan
+    trace.push_back(360);
+    for (uint16_t s = 361; s <= 368; s++)
+        trace.push_back(s);
+    // AUTORUN.SYS, sector chain of a file written to a fragmented disk
+    static const uint16_t runs[][2] = {{40, 71}, {369, 402}, {120, 151}, {500, 539}, {72, 90}};
+    for (const auto &run : runs)
+        for (uint16_t s = run[0]; s <= run[1]; s++)
+            trace.push_back(s);
+    // program loads an overlay, VTOC and directory again
+    trace.push_back(360);
+    for (uint16_t s = 361; s <= 363; s++)
+        trace.push_back(s);
+    for (uint16_t s = 600; s <= 680; s++)
+        trace.push_back(s);
+
+    return trace;
+}
+
+std::vector<uint8_t> dsk_image(int tracks)
+{
+    std::vector<uint8_t> image(tracks * 4096);
+    Random rnd(0x0DD5CA7);
+    for (uint8_t &b : image)
+        b = (uint8_t)rnd.next();
+    return image;
+}
+
+void dir_entries(DirCache &cache, int count, uint32_t seed)
+{
+    static const char *extensions[] = {".ATR", ".XEX", ".COM", ".CAS", ".ATX", ".BAS", ".DSK", ".WOZ"};
+    static const char letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_";
+
+    Random rnd(seed);
+    for (int i = 0; i < count; i++)
+    {
+        fsdir_entry &e = cache.new_entry();
+        int len = 3 + rnd.below(24);
+        for (int c = 0; c < len; c++)
+            e.filename[c] = letters[rnd.below(sizeof(letters) - 1)];
+        e.filename[len] = '\0';
+        e.isDir = rnd.below(10) == 0;
+        if (!e.isDir)
+            strlcat(e.filename, extensions[rnd.below(8)], sizeof(e.filename));
+        e.size = e.isDir ? 0 : rnd.below(1 << 20);
+        e.modified_time = 946684800 + rnd.below(24 * 365 * 86400); // 2000..2024
+    }
+}
+
+std::string json_payload(int items)
+{
+    Random rnd(7);
+    char buf[320];
+    std::string json = "{\"status\":\"ok\",\"count\":" + std::to_string(items) + ",\"items\":[";
+    for (int i = 0; i < items; i++)
+    {
+        // draw in a fixed order, argument evaluation order is unspecified
+        uint32_t v[7];
+        for (uint32_t &x : v)
+            x = rnd.below(100000);
+        snprintf(buf, sizeof(buf),
+                 "%s{\"id\":%d,\"title\":\"Item number %u\",\"score\":%u.%02u,\"active\":%s,"
+                 "\"author\":{\"name\":\"user%u\",\"karma\":%u},\"tags\":[\"atari\",\"retro\",\"t%u\"],"
+                 "\"text\":\"<p>Some <b>markup</b> to strip &amp; text to return</p>\"}",
+                 i ? "," : "", i, v[0], v[1] % 100, v[2] % 100, (v[3] & 1) ? "true" : "false",
+                 v[4] % 5000, v[5], v[6] % 50);
+        json += buf;
+    }
+    json += "]}";
+    return json;
+}
+
+std::string text(size_t bytes, const char *eol)
+{
+    static const char *words[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+                                  "FujiNet", "READY", "LOAD", "RUN", "10", "PRINT", "GOTO"};
+    Random rnd(3);
+    std::string out;
+    out.reserve(bytes + 80);
+    while (out.size() < bytes)
+    {
+        int n = 3 + rnd.below(10);
+        for (int w = 0; w < n; w++)
+        {
+            if (w)
+                out += rnd.below(20) == 0 ? '\t' : ' ';
+            out += words[rnd.below(15)];
+        }
+        out += eol;
+    }
+    return out;
+}
+
+std::string t64_image(int entries)
+{
+    Random rnd(4);
+    std::string image(0x40 + entries * 32, '\0');
+    memcpy(&image[0], "C64S tape image file", 20);
+    image[0x20] = 0x01;
+    image[0x22] = image[0x24] = entries & 0xFF;
+    image[0x23] = image[0x25] = entries >> 8;
+    memcpy(&image[0x28], "FUJINET BENCH           ", 24);
+
+    for (int i = 0; i < entries; i++)
+    {
+        uint8_t *e = (uint8_t *)&image[0x40 + i * 32];
+        uint32_t len = 200 + rnd.below(800);
+        uint32_t offset = image.size();
+        e[0] = 0x01; // normal tape file
+        e[1] = 0x82; // PRG
+        e[2] = 0x01;
+        e[3] = 0x08; // $0801
+        e[4] = (0x0801 + len) & 0xFF;
+        e[5] = (0x0801 + len) >> 8;
+        memcpy(e + 8, &offset, 4);
+        char name[17];
+        snprintf(name, sizeof(name), "FILE%-12d", i);
+        memcpy(e + 16, name, 16);
+
+        for (uint32_t b = 0; b < len; b++)
+            image += (char)rnd.next();
+    }
+    return image;
+}
+
+std::string lnx_image(int entries)
+{
+    Random rnd(5);
+    // BASIC stub (10 SYS ...) up to the first CR, then the directory
+    static const char stub[] = "\x01\x08\x5B\x08\x0A\x00\x9E\x32\x30\x36\x31\x00\x00\x00\r";
+    std::string image(stub, sizeof(stub) - 1);
+    image += " 1  *LYNX XV  BY WILL CORLEY\r";
+    image += " " + std::to_string(entries) + " \r";
+    for (int i = 0; i < entries; i++)
+    {
+        char name[17];
+        snprintf(name, sizeof(name), "FILE%-12d", i);
+        image += name;
+        image += "\r " + std::to_string(1 + rnd.below(40)) + "\rP\r " + std::to_string(2 + rnd.below(253)) + "\r";
+    }
+    return image;
+}
+
+} // namespace fixtures
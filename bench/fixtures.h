@@ -0,0 +1,69 @@
+#ifndef FN_BENCH_FIXTURES_H
+#define FN_BENCH_FIXTURES_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "fnio.h"
+
+class DirCache;
+
+/*
+ Canned inputs for the benchmarks. Everything is generated from a fixed seed so
+ results are comparable between runs and machines without shipping binary images.
+*/
+
+namespace fixtures
+{
+
+// Small deterministic PRNG (xorshift32), std:: engines differ between libraries
+class Random
+{
+public:
+    explicit Random(uint32_t seed = 0x46754E74) : _state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+
+private:
+    uint32_t _state;
+};
+
+// ATR image with header, 128 byte boot sectors and sector_size bytes for the rest
+std::vector<uint8_t> atr_image(uint16_t num_sectors, uint16_t sector_size);
+
+// Temporary local file (deleted on close) holding the given bytes, positioned at start
+fnFile *temp_file(const std::vector<uint8_t> &data);
+// Memory file holding the given bytes, positioned at start
+fnFile *mem_file(const std::vector<uint8_t> &data);
+
+// Sectors read by the OS when booting a DOS 2.x disk and loading a file from it
+const std::vector<uint16_t> &dos_boot_trace();
+
+// Apple II DOS ordered disk image, 4096 bytes per track
+std::vector<uint8_t> dsk_image(int tracks);
+
+// Fill the cache with count entries with random names, sizes and dates
+void dir_entries(DirCache &cache, int count, uint32_t seed = 1);
+
+// JSON document shaped like a typical web API response with `items` array entries
+std::string json_payload(int items);
+
+// Printable text with eol after every line, total length about `bytes`
+std::string text(size_t bytes, const char *eol);
+
+// C64 T64 tape image with `entries` PRG files of a few hundred bytes each
+std::string t64_image(int entries);
+// Lynx (LNX) archive directory: name, blocks, type and last byte, each terminated by CR
+std::string lnx_image(int entries);
+
+} // namespace fixtures
+
+#endif // FN_BENCH_FIXTURES_H
@@ -87,7 +87,7 @@
 #endif
 
 #if defined(ESP_PLATFORM)
-#define DEFAULT_OUTPUT_BUFFER_LENGTH 512
+#define DEFAULT_OUTPUT_BUFFER_LENGTH 4096
 #elif defined(PS2_EE_PLATFORM) || defined(PS2_IOP_PLATFORM)
 #define DEFAULT_OUTPUT_BUFFER_LENGTH 4096
 #else
@@ -120,7 +120,7 @@ endif()
 set(INCLUDE_DIRS include
     lib/compat lib/config lib/utils lib/hardware
     lib/FileSystem
-    lib/tcpip lib/ftp lib/TNFSlib lib/telnet lib/fnjson
+    lib/tcpip lib/ftp lib/smb lib/TNFSlib lib/telnet lib/fnjson
     lib/webdav lib/http lib/sam lib/task
     lib/modem-sniffer lib/printer-emulator
     lib/network-protocol 
@@ -134,7 +134,7 @@ set(INCLUDE_DIRS include
     components_pc/libssh/include ${CMAKE_CURRENT_BINARY_DIR}/components_pc/libssh/include
 )
 
-set(SOURCES src/main.cpp
+set(SOURCES
     lib/config/fnConfig.h lib/config/fnConfig.cpp
     lib/config/fnc_bt.cpp
     lib/config/fnc_cassette.cpp
@@ -156,6 +156,7 @@ set(SOURCES src/main.cpp
     lib/utils/utils.h lib/utils/utils.cpp
     lib/utils/cbuf.h lib/utils/cbuf.cpp
     lib/utils/string_utils.h lib/utils/string_utils.cpp
+    lib/utils/byte_translator.h lib/utils/byte_translator.cpp
     lib/utils/peoples_url_parser.h lib/utils/peoples_url_parser.cpp
     lib/utils/punycode.h lib/utils/punycode.cpp
     lib/utils/U8Char.h lib/utils/U8Char.cpp
@@ -176,14 +177,17 @@ set(SOURCES src/main.cpp
     lib/FileSystem/fnFileTNFS.h lib/FileSystem/fnFileTNFS.cpp
     lib/FileSystem/fnFileSMB.h lib/FileSystem/fnFileSMB.cpp
     lib/FileSystem/fnFileMem.h lib/FileSystem/fnFileMem.cpp
+    lib/FileSystem/fnFileGzip.h lib/FileSystem/fnFileGzip.cpp
     lib/FileSystem/fnio.h lib/FileSystem/fnio.cpp
     lib/tcpip/fnDNS.h lib/tcpip/fnDNS.cpp
     lib/tcpip/fnUDP.h lib/tcpip/fnUDP.cpp
     lib/tcpip/fnTcpClient.h lib/tcpip/fnTcpClient.cpp
     lib/tcpip/fnTcpServer.h lib/tcpip/fnTcpServer.cpp
     lib/ftp/fnFTP.h lib/ftp/fnFTP.cpp
+    lib/smb/fnSmbPool.h lib/smb/fnSmbPool.cpp
     lib/TNFSlib/tnfslibMountInfo.h lib/TNFSlib/tnfslibMountInfo.cpp
     lib/TNFSlib/tnfslib.h lib/TNFSlib/tnfslib.cpp
+    lib/TNFSlib/tnfslibDirCache.h lib/TNFSlib/tnfslibDirCache.cpp
     lib/TNFSlib/tnfslib_udp.h lib/TNFSlib/tnfslib_udp_testing.cpp
     lib/telnet/libtelnet.h lib/telnet/libtelnet.c
     lib/fnjson/fnjson.h lib/fnjson/fnjson.cpp
@@ -224,6 +228,7 @@ set(SOURCES src/main.cpp
     lib/network-protocol/UDP.h lib/network-protocol/UDP.cpp
     lib/network-protocol/Telnet.h lib/network-protocol/Telnet.cpp
     lib/network-protocol/FS.h lib/network-protocol/FS.cpp
+    lib/network-protocol/DirListing.h lib/network-protocol/DirListing.cpp
     lib/network-protocol/FTP.h lib/network-protocol/FTP.cpp
     lib/network-protocol/TNFS.h lib/network-protocol/TNFS.cpp
     lib/network-protocol/HTTP.h lib/network-protocol/HTTP.cpp
@@ -233,7 +238,8 @@ set(SOURCES src/main.cpp
     lib/fuji/fujiCmd.h
     lib/fuji/fujiHost.h lib/fuji/fujiHost.cpp
     lib/fuji/fujiDisk.h lib/fuji/fujiDisk.cpp
-    lib/bus/bus.h
+    lib/fuji/fujiImageIndex.h lib/fuji/fujiImageIndex.cpp
+    lib/bus/bus.h lib/bus/busMetrics.h lib/bus/busMetrics.cpp
     lib/device/device.h
     lib/device/disk.h
     lib/device/printer.h
@@ -262,6 +268,7 @@ if(FUJINET_TARGET STREQUAL "ATARI")
     lib/bus/sio/siocom/fnSioCom.h lib/bus/sio/siocom/fnSioCom.cpp
     lib/media/atari/diskType.h lib/media/atari/diskType.cpp
     lib/media/atari/diskTypeAtr.h lib/media/atari/diskTypeAtr.cpp
+    lib/media/atari/diskOverlay.h lib/media/atari/diskOverlay.cpp
     lib/media/atari/diskTypeAtx.h 
     lib/media/atari/diskTypeXex.h lib/media/atari/diskTypeXex.cpp
 
@@ -310,6 +317,7 @@ if(FUJINET_TARGET STREQUAL "APPLE")
     lib/media/apple/mediaType.h lib/media/apple/mediaType.cpp
     lib/media/apple/mediaTypeDO.h lib/media/apple/mediaTypeDO.cpp
     lib/media/apple/mediaTypeDSK.h lib/media/apple/mediaTypeDSK.cpp
+    lib/media/apple/dsk2woz.h lib/media/apple/dsk2woz.cpp
     lib/media/apple/mediaTypePO.h lib/media/apple/mediaTypePO.cpp
     lib/media/apple/mediaTypeWOZ.h lib/media/apple/mediaTypeWOZ.cpp
 
@@ -373,7 +381,10 @@ else()
     set(SOURCES ${SOURCES} lib/compat/strlcat.c lib/compat/strlcpy.c)
 endif()
 
-add_executable(fujinet ${SOURCES})
+# Everything but main() is compiled once, into fujinet_objs, and linked into
+# both the fujinet executable and fujinet_bench
+add_library(fujinet_objs OBJECT ${SOURCES})
+add_executable(fujinet src/main.cpp $<TARGET_OBJECTS:fujinet_objs>)
 
 # Libraries
 # build and link static libs
@@ -418,11 +429,14 @@ if(CMAKE_SYSTEM_NAME STREQUAL "Windows")
 endif()
 
 
+target_include_directories(fujinet_objs PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
 target_include_directories(fujinet PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
 target_link_libraries(fujinet ${CRYPTO_LIBS})
 
 if(DEFINED USE_LIBSERIAL)
     pkg_search_module(LIBSERIALPORT REQUIRED libserialport)
+    target_include_directories(fujinet_objs PRIVATE ${LIBSERIALPORT_INCLUDE_DIRS})
+    target_compile_options(fujinet_objs PRIVATE ${LIBSERIALPORT_CFLAGS_OTHER})
     target_include_directories(fujinet PRIVATE ${LIBSERIALPORT_INCLUDE_DIRS})
     target_link_libraries(fujinet ${LIBSERIALPORT_LIBRARIES})
     target_compile_options(fujinet PRIVATE ${LIBSERIALPORT_CFLAGS_OTHER})
@@ -453,6 +467,8 @@ add_subdirectory(components_pc/libsmb2)
 add_subdirectory(components_pc/libssh)
 
 target_link_libraries(fujinet pthread expat cjson cjson_utils smb2 ssh)
+# for their include directories and compile definitions (e.g. LIBSSH_STATIC)
+target_link_libraries(fujinet_objs cjson cjson_utils smb2 ssh)
 
 if(CMAKE_SYSTEM_NAME STREQUAL "Windows")
     target_link_libraries(fujinet ws2_32 bcrypt)
@@ -470,9 +486,48 @@ add_custom_command(
   VERBATIM
 )
 add_custom_target(build_version DEPENDS "${CMAKE_BINARY_DIR}/include/build_version.h")
+add_dependencies(fujinet_objs build_version)
+target_include_directories(fujinet_objs PRIVATE "${CMAKE_BINARY_DIR}/include")
 add_dependencies(fujinet build_version)
 target_include_directories(fujinet PRIVATE "${CMAKE_BINARY_DIR}/include")
 
+# Benchmarks
+# "fujinet_bench" executable and "bench" target (runs it, results in bench_results.json)
+# not built by default, e.g.
+#   cmake --build . --target bench
+#   ./fujinet_bench --benchmark_filter=atr --benchmark_baseline=old_results.json
+set(BENCH_SOURCES
+    bench/bench.h bench/bench.cpp bench/bench_main.cpp
+    bench/fixtures.h bench/fixtures.cpp
+    bench/bench_media.cpp
+    bench/bench_bus.cpp
+    bench/bench_fs.cpp
+    bench/bench_network.cpp
+    bench/bench_meatloaf.cpp
+    # Meatloaf isn't part of FujiNet-PC, only its container stream base is benchmarked
+    lib/meatloaf/meat_media.h lib/meatloaf/meat_media.cpp
+)
+add_executable(fujinet_bench EXCLUDE_FROM_ALL ${BENCH_SOURCES} $<TARGET_OBJECTS:fujinet_objs>)
+target_include_directories(fujinet_bench PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR} bench lib/meatloaf "${CMAKE_BINARY_DIR}/include")
+target_link_libraries(fujinet_bench ${CRYPTO_LIBS} pthread expat cjson cjson_utils smb2 ssh)
+if(DEFINED USE_LIBSERIAL)
+    target_include_directories(fujinet_bench PRIVATE ${LIBSERIALPORT_INCLUDE_DIRS})
+    target_link_libraries(fujinet_bench ${LIBSERIALPORT_LIBRARIES})
+    target_compile_options(fujinet_bench PRIVATE ${LIBSERIALPORT_CFLAGS_OTHER})
+endif()
+if(CMAKE_SYSTEM_NAME STREQUAL "Windows")
+    target_link_libraries(fujinet_bench crypt32 ws2_32 bcrypt)
+endif()
+add_dependencies(fujinet_bench build_version)
+
+add_custom_target(bench
+    COMMENT "Running benchmarks"
+    COMMAND $<TARGET_FILE:fujinet_bench> --benchmark_out=bench_results.json
+    WORKING_DIRECTORY ${CMAKE_BINARY_DIR}
+    USES_TERMINAL
+)
+add_dependencies(bench fujinet_bench)
+
 # WebUI
 # "build_webui" target
 add_custom_command(
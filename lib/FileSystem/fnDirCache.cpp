@@ -100,6 +100,14 @@ void DirCache::apply_filter(const char *pattern, uint16_t diropts)
     _current = 0;
 }
 
+fsdir_entry *DirCache::find(const char *filename)
+{
+    for (fsdir_entry &entry : _entries)
+        if (strcmp(entry.filename, filename) == 0)
+            return &entry;
+    return nullptr;
+}
+
 fsdir_entry *DirCache::read()
 {
     if(_current < _entries_filtered.size())
@@ -21,6 +21,8 @@ public:
     void apply_filter(const char *pattern, uint16_t diropts);
 
     bool empty() {return _entries.empty();}
+    // Entry by name, ignoring the filter, or null
+    fsdir_entry *find(const char *filename);
 
     fsdir_entry *read();
     uint16_t tell();
@@ -0,0 +1,625 @@
+
+#include "fnFileGzip.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+#ifdef ESP_PLATFORM
+#include "esp_heap_caps.h"
+#endif
+
+#include "../../include/debug.h"
+
+#define GZ_HEADER_SIZE 18  // gzip header with the 6 byte "BC" extra field
+#define GZ_TRAILER_SIZE 8  // CRC32 and uncompressed size
+#define GZ_MAX_FRAME 65536
+
+/*
+ * Raw deflate (RFC 1951) decoder for one member. Huffman codes up to
+ * FAST_BITS long are decoded with a single table lookup, longer ones bit
+ * by bit.
+ */
+
+#define FAST_BITS 9
+
+struct huffman
+{
+    uint16_t fast[1 << FAST_BITS]; // (code length << 9) | symbol, 0 if the code is longer
+    uint16_t count[16];            // number of codes of each length
+    uint16_t symbol[288];          // symbols in code order
+};
+
+struct gz_inflater
+{
+    huffman lit;
+    huffman dist;
+};
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+struct bit_reader
+{
+    const uint8_t *in;
+    const uint8_t *end;
+    uint32_t bitbuf = 0;
+    int bitcnt = 0;
+    int overrun = 0; // zero bytes fed in past the end of the input
+
+    bit_reader(const uint8_t *src, size_t len) : in(src), end(src + len) {}
+
+    inline void fill()
+    {
+        while (bitcnt <= 24)
+        {
+            uint32_t b = 0;
+            if (in < end)
+                b = *in++;
+            else
+                overrun++;
+            bitbuf |= b << bitcnt;
+            bitcnt += 8;
+        }
+    }
+
+    inline uint32_t bits(int n)
+    {
+        fill();
+        uint32_t v = bitbuf & ((1u << n) - 1);
+        bitbuf >>= n;
+        bitcnt -= n;
+        return v;
+    }
+
+    // True once bits that weren't in the input have been used
+    bool exhausted() { return overrun * 8 > bitcnt; }
+};
+
+// Returns TRUE if the lengths don't make a usable code
+static bool build_huffman(huffman *h, const uint8_t *lengths, int n)
+{
+    memset(h->count, 0, sizeof(h->count));
+    memset(h->fast, 0, sizeof(h->fast));
+
+    for (int i = 0; i < n; i++)
+        h->count[lengths[i]]++;
+    h->count[0] = 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++)
+    {
+        left = (left << 1) - h->count[len];
+        if (left < 0)
+            return true; // over-subscribed
+    }
+
+    uint16_t offs[16];
+    uint16_t next_code[16];
+    uint32_t code = 0;
+    offs[1] = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        code = (code + h->count[len - 1]) << 1;
+        next_code[len] = code;
+        if (len < 15)
+            offs[len + 1] = offs[len] + h->count[len];
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        int len = lengths[i];
+        if (len == 0)
+            continue;
+        h->symbol[offs[len]++] = i;
+
+        uint32_t c = next_code[len]++;
+        if (len <= FAST_BITS)
+        {
+            // Codes are sent starting with their top bit, the bit reader is LSB first
+            uint32_t r = 0;
+            for (int b = 0; b < len; b++)
+                r |= ((c >> b) & 1) << (len - 1 - b);
+            for (uint32_t j = r; j < (1u << FAST_BITS); j += 1u << len)
+                h->fast[j] = (len << 9) | i;
+        }
+    }
+    return false;
+}
+
+// Returns the next symbol, -1 if the bits aren't a code
+static inline int decode(bit_reader &br, const huffman *h)
+{
+    br.fill();
+    uint16_t e = h->fast[br.bitbuf & ((1 << FAST_BITS) - 1)];
+    if (e != 0)
+    {
+        int len = e >> 9;
+        br.bitbuf >>= len;
+        br.bitcnt -= len;
+        return e & 0x1ff;
+    }
+
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        code |= br.bits(1);
+        int count = h->count[len];
+        if (code - count < first)
+            return h->symbol[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void build_fixed(gz_inflater *z)
+{
+    uint8_t lengths[288];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    build_huffman(&z->lit, lengths, 288);
+
+    memset(lengths, 5, 30);
+    build_huffman(&z->dist, lengths, 30);
+}
+
+// Returns TRUE if the code length tables are corrupt
+static bool build_dynamic(gz_inflater *z, bit_reader &br)
+{
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    uint8_t lengths[286 + 30];
+
+    int nlen = br.bits(5) + 257;
+    int ndist = br.bits(5) + 1;
+    int ncode = br.bits(4) + 4;
+    if (nlen > 286 || ndist > 30)
+        return true;
+
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++)
+        lengths[order[i]] = br.bits(3);
+    // The code length code goes in the literal table for now
+    if (build_huffman(&z->lit, lengths, 19))
+        return true;
+
+    int i = 0;
+    while (i < nlen + ndist)
+    {
+        int sym = decode(br, &z->lit);
+        if (sym < 0)
+            return true;
+        if (sym < 16)
+        {
+            lengths[i++] = sym;
+            continue;
+        }
+
+        uint8_t len = 0;
+        int repeat;
+        if (sym == 16)
+        {
+            if (i == 0)
+                return true;
+            len = lengths[i - 1];
+            repeat = 3 + br.bits(2);
+        }
+        else if (sym == 17)
+            repeat = 3 + br.bits(3);
+        else
+            repeat = 11 + br.bits(7);
+
+        if (i + repeat > nlen + ndist)
+            return true;
+        memset(lengths + i, len, repeat);
+        i += repeat;
+    }
+
+    if (lengths[256] == 0)
+        return true; // no end of block code
+
+    return build_huffman(&z->lit, lengths, nlen) || build_huffman(&z->dist, lengths + nlen, ndist);
+}
+
+// Returns the number of bytes written to dst, -1 if the data is corrupt or doesn't fit
+static long inflate_raw(gz_inflater *z, const uint8_t *src, size_t srclen, uint8_t *dst, size_t dstlen)
+{
+    bit_reader br(src, srclen);
+    uint8_t *out = dst;
+    uint8_t *out_end = dst + dstlen;
+
+    int final;
+    do
+    {
+        final = br.bits(1);
+        int type = br.bits(2);
+
+        if (type == 0)
+        {
+            // Stored: byte aligned LEN, NLEN and LEN bytes as is
+            br.bits(br.bitcnt & 7);
+            int buffered = br.bitcnt / 8 - br.overrun;
+            if (buffered < 0)
+                return -1;
+            br.in -= buffered;
+            br.bitbuf = 0;
+            br.bitcnt = 0;
+            br.overrun = 0;
+            if (br.end - br.in < 4)
+                return -1;
+            uint16_t len = br.in[0] | (br.in[1] << 8);
+            uint16_t nlen = br.in[2] | (br.in[3] << 8);
+            br.in += 4;
+            if (len != (uint16_t)~nlen || len > br.end - br.in || len > out_end - out)
+                return -1;
+            memcpy(out, br.in, len);
+            br.in += len;
+            out += len;
+            continue;
+        }
+        else if (type == 1)
+            build_fixed(z);
+        else if (type == 2)
+        {
+            if (build_dynamic(z, br))
+                return -1;
+        }
+        else
+            return -1;
+
+        for (;;)
+        {
+            int sym = decode(br, &z->lit);
+            if (sym < 0)
+                return -1;
+            if (sym < 256)
+            {
+                if (out == out_end)
+                    return -1;
+                *out++ = sym;
+                continue;
+            }
+            if (sym == 256)
+                break;
+
+            sym -= 257;
+            if (sym >= 29)
+                return -1;
+            uint32_t len = len_base[sym] + br.bits(len_extra[sym]);
+
+            int dsym = decode(br, &z->dist);
+            if (dsym < 0 || dsym >= 30)
+                return -1;
+            uint32_t dist = dist_base[dsym] + br.bits(dist_extra[dsym]);
+
+            if (dist > (uint32_t)(out - dst) || len > (uint32_t)(out_end - out))
+                return -1;
+
+            const uint8_t *from = out - dist;
+            if (dist >= len)
+                memcpy(out, from, len);
+            else
+                for (uint32_t i = 0; i < len; i++)
+                    out[i] = from[i];
+            out += len;
+        }
+
+        if (br.exhausted())
+            return -1;
+    } while (!final);
+
+    return out - dst;
+}
+
+static uint32_t crc32(const uint8_t *buf, size_t len)
+{
+    static uint32_t table[256];
+    if (table[1] == 0)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--)
+        crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Size of the member starting with this header, 0 if it isn't a BGZF member
+static uint32_t bgzf_member_size(const uint8_t *h)
+{
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || h[3] != 4 || // deflate, FEXTRA only
+        h[10] != 6 || h[11] != 0 || h[12] != 'B' || h[13] != 'C' || h[14] != 2 || h[15] != 0)
+        return 0;
+
+    uint32_t size = (h[16] | (h[17] << 8)) + 1;
+    return size >= GZ_HEADER_SIZE + GZ_TRAILER_SIZE ? size : 0;
+}
+
+static uint8_t *gz_alloc(size_t size)
+{
+#ifdef ESP_PLATFORM
+    return (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+#else
+    return (uint8_t *)malloc(size);
+#endif
+}
+
+
+FileHandlerGzip::FileHandlerGzip(FileHandler *fh) : _fh(fh)
+{
+    Debug_println("new FileHandlerGzip");
+}
+
+
+FileHandlerGzip::~FileHandlerGzip()
+{
+    Debug_println("delete FileHandlerGzip");
+    if (_fh != nullptr) close(false);
+}
+
+
+FileHandlerGzip *FileHandlerGzip::open(FileHandler *fh)
+{
+    if (fh == nullptr)
+        return nullptr;
+
+    FileHandlerGzip *gz = new FileHandlerGzip(fh);
+    if (gz->_index())
+    {
+        Debug_println("FileHandlerGzip: not a blocked gzip (bgzip) image");
+        gz->close();
+        return nullptr;
+    }
+
+    Debug_printf("FileHandlerGzip: %u bytes in %u frames\r\n", (unsigned)gz->_filesize, (unsigned)gz->_frames.size());
+    return gz;
+}
+
+
+bool FileHandlerGzip::is_compressed_name(const char *path)
+{
+    size_t l = strlen(path);
+    return l > 3 && strcasecmp(path + l - 3, ".gz") == 0;
+}
+
+
+/*
+ Walk the members, one read per member: the uncompressed size at the end of
+ a member and the header of the next one sit next to each other.
+*/
+bool FileHandlerGzip::_index()
+{
+    uint8_t buf[4 + GZ_HEADER_SIZE];
+    uint8_t *header = buf + 4;
+
+    if (_fh->seek(0, SEEK_SET) != 0 || _fh->read(header, 1, GZ_HEADER_SIZE) != GZ_HEADER_SIZE)
+        return true;
+
+    uint32_t offset = 0;
+    uint32_t start = 0;
+    for (;;)
+    {
+        uint32_t size = bgzf_member_size(header);
+        if (size == 0)
+            return true;
+
+        if (_fh->seek(offset + size - 4, SEEK_SET) != 0)
+            return true;
+        size_t n = _fh->read(buf, 1, sizeof(buf));
+        if (n != 4 && n != sizeof(buf))
+            return true;
+
+        uint32_t isize = get_le32(buf);
+        if (isize > GZ_MAX_FRAME)
+            return true;
+        // Skip empty members, like the BGZF end of file marker
+        if (isize > 0)
+        {
+            _frames.push_back({offset, size, start});
+            _max_member = std::max(_max_member, size);
+            _max_frame = std::max(_max_frame, isize);
+            start += isize;
+        }
+        offset += size;
+
+        if (n == 4)
+            break;
+    }
+
+    _filesize = start;
+    if (_frames.empty())
+        return true;
+
+    _member = gz_alloc(_max_member);
+    _inflater = (gz_inflater *)malloc(sizeof(gz_inflater));
+    return _member == nullptr || _inflater == nullptr;
+}
+
+
+int FileHandlerGzip::_find_frame(uint32_t pos)
+{
+    auto it = std::upper_bound(_frames.begin(), _frames.end(), pos,
+                               [](uint32_t p, const gz_frame &f) { return p < f.start; });
+    return (it - _frames.begin()) - 1;
+}
+
+
+// Returns the decompressed frame, nullptr if it couldn't be read or is corrupt
+const uint8_t *FileHandlerGzip::_load_frame(int frame)
+{
+    gz_cache_slot *slot = &_cache[0];
+    for (int i = 0; i < GZIP_CACHE_FRAMES; i++)
+    {
+        if (_cache[i].frame == frame)
+        {
+            _cache[i].last_used = ++_cache_clock;
+            return _cache[i].data;
+        }
+        if (_cache[i].last_used < slot->last_used)
+            slot = &_cache[i];
+    }
+
+    if (slot->data == nullptr && (slot->data = gz_alloc(_max_frame)) == nullptr)
+        return nullptr;
+    slot->frame = -1;
+
+    const gz_frame &f = _frames[frame];
+    uint32_t isize = (frame + 1 < (int)_frames.size() ? _frames[frame + 1].start : _filesize) - f.start;
+
+    if (_fh->seek(f.offset, SEEK_SET) != 0 || _fh->read(_member, 1, f.size) != f.size)
+    {
+        Debug_printf("FileHandlerGzip: failed reading frame %d\r\n", frame);
+        return nullptr;
+    }
+
+    long n = inflate_raw(_inflater, _member + GZ_HEADER_SIZE, f.size - GZ_HEADER_SIZE - GZ_TRAILER_SIZE,
+                         slot->data, isize);
+    if (n != (long)isize || crc32(slot->data, isize) != get_le32(_member + f.size - GZ_TRAILER_SIZE))
+    {
+        Debug_printf("FileHandlerGzip: frame %d is corrupt\r\n", frame);
+        return nullptr;
+    }
+
+    slot->frame = frame;
+    slot->last_used = ++_cache_clock;
+    return slot->data;
+}
+
+
+int FileHandlerGzip::close(bool destroy)
+{
+    Debug_println("FileHandlerGzip::close");
+    int result = 0;
+    if (_fh != nullptr)
+    {
+        result = _fh->close();
+        _fh = nullptr;
+    }
+    for (int i = 0; i < GZIP_CACHE_FRAMES; i++)
+    {
+        free(_cache[i].data);
+        _cache[i].data = nullptr;
+        _cache[i].frame = -1;
+    }
+    free(_member);
+    _member = nullptr;
+    free(_inflater);
+    _inflater = nullptr;
+    if (destroy) delete this;
+    return result;
+}
+
+
+int FileHandlerGzip::seek(long int off, int whence)
+{
+    long int new_pos;
+    switch (whence)
+    {
+        case SEEK_SET:
+            new_pos = off;
+            break;
+        case SEEK_END:
+            new_pos = _filesize + off;
+            break;
+        case SEEK_CUR:
+            new_pos = _position + off;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    if (new_pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    _position = new_pos;
+    return 0;
+}
+
+
+long int FileHandlerGzip::tell()
+{
+    return _position;
+}
+
+
+size_t FileHandlerGzip::read(void *ptr, size_t size, size_t count)
+{
+    if (size == 0 || _position >= (long int)_filesize)
+        return 0;
+
+    size_t want = std::min(size * count, (size_t)(_filesize - _position));
+    uint8_t *dst = (uint8_t *)ptr;
+    size_t done = 0;
+
+    while (done < want)
+    {
+        int frame = _find_frame(_position);
+        const uint8_t *data = _load_frame(frame);
+        if (data == nullptr)
+        {
+            errno = EIO;
+            break;
+        }
+
+        uint32_t frame_end = frame + 1 < (int)_frames.size() ? _frames[frame + 1].start : _filesize;
+        size_t n = std::min(want - done, (size_t)(frame_end - _position));
+        memcpy(dst + done, data + (_position - _frames[frame].start), n);
+        done += n;
+        _position += n;
+    }
+
+    return done / size;
+}
+
+
+// Compressed images are read-only
+size_t FileHandlerGzip::write(const void *ptr, size_t size, size_t count)
+{
+    Debug_println("FileHandlerGzip::write - image is read-only");
+    errno = EROFS;
+    return 0;
+}
+
+
+int FileHandlerGzip::flush()
+{
+    return 0;
+}
+
+
+int FileHandlerGzip::eof()
+{
+    return _position >= (long int)_filesize;
+}
@@ -0,0 +1,77 @@
+#ifndef FN_FILEGZIP_H
+#define FN_FILEGZIP_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+#include "fnFile.h"
+
+/*
+ * FileHandlerGzip - read-only, seekable view of a compressed disk image
+ *
+ * The image has to be a blocked gzip file as written by "bgzip" (BGZF): a
+ * series of gzip members, each holding up to 64 KB of the image and recording
+ * its own compressed size in a "BC" extra field. Any gzip tool can still
+ * decompress it, but the frames can be found without inflating anything, so a
+ * sector read only inflates the frame holding it. The last few frames are kept
+ * decompressed.
+ */
+
+#define GZIP_CACHE_FRAMES 2
+
+struct gz_inflater;
+
+class FileHandlerGzip : public FileHandler
+{
+protected:
+    struct gz_frame
+    {
+        uint32_t offset; // in the compressed file
+        uint32_t size;   // compressed member size, header and trailer included
+        uint32_t start;  // first uncompressed byte
+    };
+
+    struct gz_cache_slot
+    {
+        int frame = -1;
+        uint32_t last_used = 0;
+        uint8_t *data = nullptr;
+    };
+
+    FileHandler *_fh;
+    std::vector<gz_frame> _frames;
+    uint32_t _filesize = 0;
+    long int _position = 0;
+
+    gz_cache_slot _cache[GZIP_CACHE_FRAMES];
+    uint32_t _cache_clock = 0;
+    uint8_t *_member = nullptr; // one compressed member
+    gz_inflater *_inflater = nullptr;
+    uint32_t _max_member = 0;
+    uint32_t _max_frame = 0;
+
+    FileHandlerGzip(FileHandler *fh);
+
+    bool _index();
+    int _find_frame(uint32_t pos);
+    const uint8_t *_load_frame(int frame);
+
+public:
+    virtual ~FileHandlerGzip() override;
+
+    // Takes over fh. Returns nullptr, and closes fh, if it isn't a blocked gzip file
+    static FileHandlerGzip *open(FileHandler *fh);
+    // True for names of compressed images, "GAME.ATR.gz"
+    static bool is_compressed_name(const char *path);
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+    virtual int eof() override;
+};
+
+#endif // FN_FILEGZIP_H
@@ -4,6 +4,8 @@
 #include "fnFileSMB.h"
 #include "../../include/debug.h"
 
+#include "fnSmbPool.h"
+
 
 FileHandlerSMB::FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle)
 {
@@ -27,6 +29,7 @@ int FileHandlerSMB::close(bool destroy)
     if (_handle != nullptr) 
     {
         result = smb2_close(_smb, _handle);
+        smbPool.release(_smb);
         _handle = nullptr;
         _smb = nullptr;
     }
@@ -14,6 +14,7 @@ protected:
     struct smb2_context *_smb;
     struct smb2fh *_handle;
 public:
+    // Takes over smb, a session leased from smbPool, and releases it on close
     FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle);
     virtual ~FileHandlerSMB() override;
 
@@ -27,8 +27,6 @@ FileSystemFTP::FileSystemFTP()
     Debug_printf("FileSystemFTP::ctor\n");
     _ftp = nullptr;
     _url = nullptr;
-    // invalidate _last_dir
-    _last_dir[0] = '\0';
 }
 
 FileSystemFTP::~FileSystemFTP()
@@ -92,8 +90,12 @@ bool FileSystemFTP::start(const char *url, const char *user, const char *passwor
 
 bool FileSystemFTP::exists(const char *path)
 {
-    // TODO
-    return false;
+    if (!_started)
+        return false;
+
+    long filesize;
+    time_t modified;
+    return !_ftp->file_size(path, filesize) || !_ftp->file_modified(path, modified);
 }
 
 bool FileSystemFTP::remove(const char *path)
@@ -119,10 +121,41 @@ FileHandler *FileSystemFTP::filehandler_open(const char *path, const char *mode)
     return fh;
 }
 
+// open SD card file to cache FTP file which is too big for memory
+// return FileHandler* on success, nullptr on error
+FileHandler *FileSystemFTP::open_sd_cache(const char *path)
+{
+    if (!fnSDFAT.running())
+    {
+        Debug_println("FileSystemFTP::cache_file - SD Filesystem is not running");
+        return nullptr;
+    }
+
+    // SD file path, use MD5 of host url and MD5 of file path
+    char cache_path[] = "/FujiNet/cache/........-................................";
+    get_md5_string((const unsigned char *)(_url->mRawUrl.c_str()), _url->mRawUrl.length(), cache_path + 15);
+    get_md5_string((const unsigned char *)path, strlen(path), cache_path + 15 + 9);
+    cache_path[15 + 8] = '-';
+    Debug_printf("SD cache file: %s\n", cache_path);
+
+    // ensure cache directory exists
+    fnSDFAT.create_path("/FujiNet/cache");
+
+    // open SD file
+    FileHandler *fh_sd = fnSDFAT.filehandler_open(cache_path, "wb+");
+    if (fh_sd == nullptr)
+        Debug_println("FileSystemFTP::cache_file - failed to open SD file");
+    return fh_sd;
+}
+
 // read file from FTP path and write it to cache file
 // return FileHandler* on success (memory or SD file), nullptr on error
 FileHandler *FileSystemFTP::cache_file(const char *path)
 {
+    // files known to be large go to SD card right away
+    long filesize;
+    bool use_memfile = _ftp->file_size(path, filesize) || filesize <= MAX_CACHE_MEMFILE_SIZE;
+
     // open FTP file
     if (_ftp->open_file(path, false))
     {
@@ -131,19 +164,18 @@ FileHandler *FileSystemFTP::cache_file(const char *path)
     }
 
     // open cache memory file
-    FileHandler *fh = new FileHandlerMem;
+    FileHandler *fh = use_memfile ? new FileHandlerMem : open_sd_cache(path);
     if (fh == nullptr)
     {
-        Debug_println("FileSystemFTP::cache_file - failed to open memory file");
+        Debug_println("FileSystemFTP::cache_file - failed to open cache file");
+        _ftp->close();
         return nullptr;
     }
 
     // copy FTP to file
 
     uint8_t buf[1024];
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
     size_t bytes_read = 0;
-    bool use_memfile = true;
     bool cancel = false;
 
     do
@@ -151,14 +183,14 @@ FileHandler *FileSystemFTP::cache_file(const char *path)
         int available = _ftp->data_available();
         if (available == 0)
         {
-            if (--tmout_counter == 0)
+            // wait for more data or control message
+            if (_ftp->wait_data() && _ftp->data_connected())
             {
                 // no data & no control message
                 Debug_printf("FileSystemFTP::cache_file - Timeout\n");
                 cancel = true;
                 break;
             }
-            fnSystem.delay(50); // wait for more data or control message
             available = _ftp->data_available();
         }
         
@@ -188,28 +220,9 @@ FileHandler *FileSystemFTP::cache_file(const char *path)
                 if (use_memfile && bytes_read > MAX_CACHE_MEMFILE_SIZE)
                 {
                     // for large files switch from memory to SD card
-                    if (!fnSDFAT.running())
-                    {
-                        Debug_println("FileSystemFTP::cache_file - SD Filesystem is not running");
-                        cancel = true;
-                        break;
-                    }
-
-                    // SD file path, use MD5 of host url and MD5 of file path
-                    char cache_path[] = "/FujiNet/cache/........-................................";
-                    get_md5_string((const unsigned char *)(_url->mRawUrl.c_str()), _url->mRawUrl.length(), cache_path + 15);
-                    get_md5_string((const unsigned char *)path, strlen(path), cache_path + 15 + 9);
-                    cache_path[15 + 8] = '-';
-                    Debug_printf("SD cache file: %s\n", cache_path);
-
-                    // ensure cache directory exists
-                    fnSDFAT.create_path("/FujiNet/cache");
-
-                    // open SD file
-                    FileHandler *fh_sd = fnSDFAT.filehandler_open(cache_path, "wb+");
+                    FileHandler *fh_sd = open_sd_cache(path);
                     if (fh_sd == nullptr)
                     {
-                        Debug_println("FileSystemFTP::cache_file - failed to open SD file");
                         cancel = true;
                         break;
                     }
@@ -230,7 +243,6 @@ FileHandler *FileSystemFTP::cache_file(const char *path)
                 // next batch
                 available = _ftp->data_available();
             }
-            tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
         }
     } while (!cancel && _ftp->data_connected());
     _ftp->close();
@@ -264,57 +276,37 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
     if (path == nullptr)
         return false;
 
-    if (strcmp(_last_dir, path) == 0 && !_dircache.empty())
+    // fnFTP keeps recent listings, no need to remember the last directory here
+    _dircache.clear();
+
+    // List FTP directory
+    if (_ftp->open_directory(path, ""))
     {
-        Debug_printf("Use directory cache\n");
+        Debug_printf("Failed to open directory\n");
+        return false;
     }
-    else
-    {
-        Debug_printf("Fill directory cache\n");
-
-        _dircache.clear();
-        // invalidate _last_dir
-        _last_dir[0] = '\0';
-
-        // List FTP directory
-        bool res;
-        res = _ftp->open_directory(path, "");
-
-        if (res)
-        {
-            Debug_printf("Failed to open directory\n");
-            return false;
-        }
-
-        // Remember last visited directory
-        strlcpy(_last_dir, path, MAX_PATHLEN);
 
-        // Populate directory cache with entries
-        string filename;
-        long filesz;
-        bool is_dir;
-        fsdir_entry *fs_de;
-
-        // get first directory entry
-        res = _ftp->read_directory(filename, filesz, is_dir);
-        while(res == false)
-        {
-            // skip hidden
-            if (filename[0] == '.')
-                continue;
+    // Populate directory cache with entries
+    string filename;
+    long filesz;
+    bool is_dir;
+    time_t modified;
+    fsdir_entry *fs_de;
 
-            // new dir entry
-            fs_de = &_dircache.new_entry();
-
-            // set entry members
-            strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
-            fs_de->isDir = is_dir;
-            fs_de->size = (uint32_t)filesz;
-            fs_de->modified_time = 0; // TODO
-
-            // get next
-            res = _ftp->read_directory(filename, filesz, is_dir);
-        }
+    while (_ftp->read_directory(filename, filesz, is_dir, modified) == false)
+    {
+        // skip hidden
+        if (filename[0] == '.')
+            continue;
+
+        // new dir entry
+        fs_de = &_dircache.new_entry();
+
+        // set entry members
+        strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
+        fs_de->isDir = is_dir;
+        fs_de->size = (uint32_t)filesz;
+        fs_de->modified_time = modified;
     }
 
     // Apply pattern matching filter and sort entries
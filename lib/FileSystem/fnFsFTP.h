@@ -21,7 +21,6 @@ private:
     fnFTP *_ftp;
 
     // directory cache
-    char _last_dir[MAX_PATHLEN];
     DirCache _dircache;
 
 public:
@@ -57,6 +56,7 @@ public:
 
 #ifndef FNIO_IS_STDIO
     FileHandler *cache_file(const char *path);
+    FileHandler *open_sd_cache(const char *path);
 #endif
 
 };
@@ -48,13 +48,6 @@
 // Our global SD interface
 FileSystemSDFAT fnSDFAT;
 
-/*
- We maintain directory information cached to allow
- for sorting and to provide telldir/seekdir
-*/
-std::vector<fsdir_entry> _dir_entries;
-uint16_t _dir_entry_current = 0;
-
 bool _fssd_fsdir_sort_name_ascend(fsdir_entry &left, fsdir_entry &right)
 {
     return strcasecmp(left.filename, right.filename) < 0;
@@ -231,6 +224,7 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
         // Ignore some special files we create on SD
         if(strcmp(finfo.fname, "paper") == 0 
         || strcmp(finfo.fname, "fnconfig.ini") == 0
+        || strcmp(finfo.fname, "fnconfig.ini.tmp") == 0
         || strcmp(finfo.fname, "rs232dump") == 0)
             continue;
 
@@ -275,6 +269,7 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
         // Ignore some special files we create on SD
         if(strcmp(d->d_name, "paper") == 0 
         || strcmp(d->d_name, "fnconfig.ini") == 0
+        || strcmp(d->d_name, "fnconfig.ini.tmp") == 0
         || strcmp(d->d_name, "rs232dump") == 0)
             continue;
         // Debug_printf("Entry %s (%d)\n", d->d_name, d->d_type);
@@ -6,6 +6,7 @@
 #endif
 
 #include <stdio.h>
+#include <vector>
 
 #include "fnFS.h"
 
@@ -18,6 +19,12 @@ private:
     DIR * _dir;
 #endif
     uint64_t _card_capacity = 0;
+    /*
+     We maintain directory information cached to allow
+     for sorting and to provide telldir/seekdir
+    */
+    std::vector<fsdir_entry> _dir_entries;
+    uint16_t _dir_entry_current = 0;
 public:
 #ifdef ESP_PLATFORM
     bool start();
@@ -9,6 +9,11 @@
 
 #include "smb2/smb2.h"
 #include "fnFileSMB.h"
+#include "fnFileMem.h"
+#include "fnSmbPool.h"
+
+// read only files up to this size are fetched in one go
+#define SMB_FETCH_MEMFILE_SIZE SMB_FETCH_MAX
 
 FileSystemSMB::FileSystemSMB()
 {
@@ -26,26 +31,27 @@ FileSystemSMB::~FileSystemSMB()
     if (_started)
     {
         _dircache.clear();
-        smb2_disconnect_share(_smb);
         smb2_destroy_url(_url);
-        smb2_destroy_context(_smb);
+        smbPool.release(_smb);
     }
 }
 
 bool FileSystemSMB::start(const char *url, const char *user, const char *password)
 {
-    int smb_error;
-
     if (_started)
         return false;
 
     if(url == nullptr || url[0] == '\0')
         return false;
 
-    _smb = smb2_init_context();
-    if (_smb == nullptr) 
+    // credentials are only used as a pair
+    if (user == nullptr || password == nullptr)
+        user = password = nullptr;
+
+    _smb = smbPool.acquire(url, user, password);
+    if (_smb == nullptr)
     {
-        Debug_printf("FileSystemSMB::start() - failed to init SMB2 context\n");
+        Debug_printf("FileSystemSMB::start() - failed to connect \"%s\"\n", url);
         return false;
     }
 
@@ -53,27 +59,18 @@ bool FileSystemSMB::start(const char *url, const char *user, const char *passwor
     if (_url == nullptr) 
     {
         Debug_printf("FileSystemSMB::start() - failed to parse URL \"%s\", SMB2 error: %s\n", url, smb2_get_error(_smb));
+        smbPool.release(_smb);
+        _smb = nullptr;
         return false;
     }
 
-    smb2_set_security_mode(_smb, SMB2_NEGOTIATE_SIGNING_ENABLED);
-
-    if (user != nullptr && password != nullptr)
-    {
-        smb2_set_user(_smb, user);
-        smb2_set_password(_smb, password);
-        smb_error = smb2_connect_share(_smb, _url->server, _url->share, user);
-    }
-    else
-    {
-        smb_error = smb2_connect_share(_smb, _url->server, _url->share, _url->user);
-    }
-
-	if (smb_error != 0) 
-    {
-        Debug_printf("FileSystemSMB::start() - failed to connect share \"//%s/%s\", SMB2 error: %s\n", _url->server, _url->share, smb2_get_error(_smb));
-        return false;
-	}
+    _share_url = url;
+    _have_user = user != nullptr;
+    _have_password = password != nullptr;
+    if (_have_user)
+        _user = user;
+    if (_have_password)
+        _password = password;
 
     Debug_printf("SMB share connected: //%s/%s\n", _url->server, _url->share);
 
@@ -164,12 +161,53 @@ FileHandler *FileSystemSMB::filehandler_open(const char *path, const char *mode)
         }
     }
 
-    if ((fh = smb2_open(_smb, smb_path, O_RDONLY)) == nullptr) // TODO use open_flags
+    // Small read only files, whose size is known from the listing they were
+    // picked from, come in one round trip. Anything else is opened as usual.
+    fsdir_entry *entry = nullptr;
+    if (open_flags == O_RDONLY)
+    {
+        const char *name = strrchr(smb_path, '/');
+        std::string dir = name == nullptr ? std::string() : std::string(smb_path, name - smb_path);
+        name = name == nullptr ? smb_path : name + 1;
+        std::string last_dir = _last_dir;
+        if (!last_dir.empty() && last_dir.back() == '/')
+            last_dir.pop_back();
+        if (dir == last_dir)
+            entry = _dircache.find(name);
+    }
+
+    if (entry != nullptr && !entry->isDir && entry->size <= SMB_FETCH_MEMFILE_SIZE)
+    {
+        std::vector<uint8_t> data;
+        uint64_t file_size = 0;
+        if (!smbPool.fetch(_smb, smb_path, data, entry->size > 0 ? entry->size : 1, &file_size))
+        {
+            Debug_printf("FileSystemSMB::filehandler_open - fetched \"%s\", %u bytes\n", smb_path, (unsigned)data.size());
+            FileHandler *fhm = new FileHandlerMem;
+            if (!data.empty() && fhm->write(data.data(), 1, data.size()) != data.size())
+            {
+                fhm->close();
+                return nullptr;
+            }
+            fhm->seek(0, SEEK_SET);
+            return fhm;
+        }
+    }
+
+    // Opened files get a session of their own, so they don't wait on each other
+    struct smb2_context *smb = smbPool.acquire(_share_url.c_str(),
+                                               _have_user ? _user.c_str() : nullptr,
+                                               _have_password ? _password.c_str() : nullptr);
+    if (smb == nullptr)
+        return nullptr;
+
+    if ((fh = smb2_open(smb, smb_path, O_RDONLY)) == nullptr) // TODO use open_flags
     {
+        smbPool.release(smb);
         return nullptr;
     }
 
-    return new FileHandlerSMB(_smb, fh);
+    return new FileHandlerSMB(smb, fh);
 }
 #endif
 
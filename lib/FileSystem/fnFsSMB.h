@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <string>
 #include <smb2/libsmb2.h>
 
 #include "fnFS.h"
@@ -15,6 +16,13 @@ private:
     struct smb2_context *_smb;
     struct smb2_url *_url;
 
+    // to lease more sessions from smbPool for opened files
+    std::string _share_url;
+    std::string _user;
+    std::string _password;
+    bool _have_user = false;
+    bool _have_password = false;
+
     // directory cache
     char _last_dir[MAX_PATHLEN];
     DirCache _dircache;
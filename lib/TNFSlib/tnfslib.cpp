@@ -14,6 +14,10 @@
 #include "fnUDP.h"
 #include "fnTcpClient.h"
 #include "tnfslib_udp.h"
+#include "tnfslibDirCache.h"
+#ifndef ESP_PLATFORM
+#include "fnTaskManager.h"
+#endif
 
 #include "utils.h"
 
@@ -56,6 +60,8 @@ uint8_t _tnfs_session_recovery(tnfsMountInfo *m_info, uint8_t command);
 
 int _tnfs_adjust_with_full_path(tnfsMountInfo *m_info, char *buffer, const char *source, int bufflen);
 
+void _tnfs_dircache_invalidate(tnfsMountInfo *m_info);
+
 void _tnfs_debug_packet(const tnfsPacket &pkt, unsigned short len, bool isResponse = false);
 
 const char *_tnfs_command_string(int command);
@@ -235,6 +241,10 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
                     pFileInf->file_size = 0;
             }
             Debug_printf("File opened, handle ID: %hd, size: %u, pos: %u\r\n", *file_handle, pFileInf->file_size, pFileInf->file_position);
+
+            // The file may be created or truncated
+            if (open_mode & TNFS_OPENMODE_WRITE)
+                _tnfs_dircache_invalidate(m_info);
         }
         result = packet.payload[0];
     }
@@ -568,6 +578,8 @@ int tnfs_write(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint
             uint32_t new_pos = pFileInf->file_position + *resultlen;
             // Debug_printf("tnfs_write prev_pos: %u, read: %u, new_pos: %u\r\n", pFileInf->file_position, *resultlen, new_pos);
             pFileInf->file_position = pFileInf->cached_pos = new_pos;
+            // File size and time may have changed
+            _tnfs_dircache_invalidate(m_info);
         }
         return packet.payload[0];
     }
@@ -684,8 +696,227 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
     return -1;
 }
 
+// Identifies the server and how we see it (mount path and user) in the directory cache
+std::string _tnfs_dircache_server(tnfsMountInfo *m_info)
+{
+    std::string key;
+    if (m_info->hostname[0] != '\0')
+        key = m_info->hostname;
+    else
+        key = std::to_string(m_info->host_ip);
+    key += ':' + std::to_string(m_info->port) + '\n' + m_info->mountpath + '\n' + m_info->user;
+    return key;
+}
+
+// Drops cached listings after we changed something on the server
+void _tnfs_dircache_invalidate(tnfsMountInfo *m_info)
+{
+    tnfsDirectoryCache.invalidate(_tnfs_dircache_server(m_info));
+}
+
+/*
+ The directory is all read: close it on the server and share the listing.
+ Called holding the listing's fetch_mutex.
+*/
+void _tnfs_dirfill_done(tnfsDirListing *listing)
+{
+    listing->completed_ms = fnSystem.millis();
+    listing->complete = true;
+
+    tnfsPacket packet;
+    packet.command = TNFS_CMD_CLOSEDIR;
+    packet.payload[0] = listing->handle;
+    _tnfs_transaction(listing->owner, packet, 1);
+    listing->handle = TNFS_INVALID_HANDLE;
+
+    Debug_printf("TNFS directory listing complete, %u entries\r\n", listing->count());
+    tnfsDirectoryCache.put(listing->shared_from_this());
+}
+
+/*
+ Stops filling the listing this mount has open on the server, if any
+*/
+void _tnfs_dirfill_stop(tnfsMountInfo *m_info)
+{
+    if (m_info->dir_filling == nullptr)
+        return;
+
+    tnfsDirListing *listing = m_info->dir_filling.get();
+    {
+        std::lock_guard<std::mutex> lock(listing->fetch_mutex);
+        if (!listing->complete && !listing->failed && listing->owner == m_info)
+        {
+            if (listing->session == m_info->session)
+            {
+                tnfsPacket packet;
+                packet.command = TNFS_CMD_CLOSEDIR;
+                packet.payload[0] = listing->handle;
+                _tnfs_transaction(m_info, packet, 1);
+            }
+            listing->error = TNFS_RESULT_BAD_FILENUM;
+            listing->failed = true;
+        }
+        listing->owner = nullptr;
+    }
+    m_info->dir_filling.reset();
+}
+
+#define OFFSET_READDIRX_FLAGS 0
+#define OFFSET_READDIRX_SIZE 1
+#define OFFSET_READDIRX_MTIME 5
+#define OFFSET_READDIRX_CTIME 9
+#define OFFSET_READDIRX_PATH 13
+
 /*
-    Opens directory and stores directory handle in tnfsMountInfo.dir_handle
+ Adds the next TNFS_READDIRX batch to the listing, unless it already holds
+ more than need_pos entries. Called from the bus and from worker threads.
+ Returns: 0: success (or listing complete), -1: failed to send/receive packet, other: TNFS error result code
+*/
+int _tnfs_dirfill_batch(tnfsDirListing *listing, uint32_t need_pos)
+{
+    std::lock_guard<std::mutex> lock(listing->fetch_mutex);
+
+    // Somebody else may have done it while we waited
+    if (listing->complete || listing->count() > need_pos)
+        return TNFS_RESULT_SUCCESS;
+    if (listing->failed)
+        return listing->error;
+
+    tnfsMountInfo *m_info = listing->owner;
+    if (m_info == nullptr)
+    {
+        listing->error = TNFS_RESULT_BAD_FILENUM;
+        listing->failed = true;
+        return listing->error;
+    }
+
+    // Keep the session from changing under us
+    std::lock_guard<std::recursive_mutex> tlock(m_info->transaction_mutex);
+
+    // The directory handle is gone with the session that opened it
+    if (listing->session != m_info->session)
+    {
+        Debug_print("tnfs_readdirx session changed, directory handle lost\r\n");
+        listing->error = TNFS_RESULT_BAD_FILENUM;
+        listing->failed = true;
+        return listing->error;
+    }
+
+    tnfsPacket packet;
+    packet.command = TNFS_CMD_READDIRX;
+    packet.payload[0] = listing->handle;
+    // Number of responses to read
+    packet.payload[1] = TNFS_DIRCACHE_BATCH;
+
+    if (!_tnfs_transaction(m_info, packet, 2))
+    {
+        listing->error = -1;
+        listing->failed = true;
+        return listing->error;
+    }
+
+    if (packet.payload[0] == TNFS_RESULT_END_OF_FILE)
+    {
+        _tnfs_dirfill_done(listing);
+        return TNFS_RESULT_SUCCESS;
+    }
+    if (packet.payload[0] != TNFS_RESULT_SUCCESS)
+    {
+        listing->error = packet.payload[0];
+        listing->failed = true;
+        return listing->error;
+    }
+
+    uint8_t response_count = packet.payload[1];
+    uint8_t response_status = packet.payload[2];
+    uint16_t dirpos = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 3);
+
+    Debug_printf("tnfs_readdirx resp_count=%hu, dirpos=%hu, status=%hu\r\n", response_count, dirpos, response_status);
+    // Entry indexes double as directory positions
+    if (dirpos != listing->count())
+        Debug_printf("tnfs_readdirx expected dirpos=%u\r\n", listing->count());
+
+    // Add the returned entries to the listing
+    int current_offset = 5;
+    for (int i = 0; i < response_count; i++)
+    {
+        if (current_offset + OFFSET_READDIRX_PATH >= TNFS_PAYLOAD_SIZE)
+            break;
+
+        const char *name = (const char *)packet.payload + current_offset + OFFSET_READDIRX_PATH;
+        size_t name_len = strnlen(name, TNFS_PAYLOAD_SIZE - current_offset - OFFSET_READDIRX_PATH);
+
+        listing->add(packet.payload[current_offset + OFFSET_READDIRX_FLAGS],
+            TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_SIZE),
+            TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_MTIME),
+            TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_CTIME),
+            name, name_len);
+
+        /*
+         Adjust our offset to point to the next entry within the packet
+         flags (1) + size (4) + mtime (4) + ctime (4) + null (1) = 14
+        */
+        current_offset += 14 + name_len;
+    }
+
+    // The server tells us there's no more after this
+    if ((response_status & TNFS_READDIRX_STATUS_EOF) || response_count == 0)
+        _tnfs_dirfill_done(listing);
+
+    return TNFS_RESULT_SUCCESS;
+}
+
+#ifndef ESP_PLATFORM
+/*
+ Fetches the next batch of a listing on a worker thread, while the computer
+ is still busy with the entries it got
+*/
+class tnfsDirPrefetchTask : public fnTask
+{
+private:
+    std::shared_ptr<tnfsDirListing> _listing;
+    uint32_t _need_pos;
+
+public:
+    tnfsDirPrefetchTask(std::shared_ptr<tnfsDirListing> listing, uint32_t need_pos)
+        : _listing(listing), _need_pos(need_pos)
+    {
+        set_blocking(true);
+        set_priority(PRIORITY_LOW);
+    };
+    ~tnfsDirPrefetchTask() { _listing->prefetching = false; };
+
+protected:
+    int start() override { return 0; };
+    int work() override { _tnfs_dirfill_batch(_listing.get(), _need_pos); return 0; };
+    int step() override { return 1; };
+};
+
+// Queues a background fetch when the reader gets close to the end of what we have
+void _tnfs_dirfill_prefetch(tnfsMountInfo *m_info)
+{
+    std::shared_ptr<tnfsDirListing> &listing = m_info->dir_listing;
+    if (listing->complete || listing->failed)
+        return;
+
+    uint32_t count = listing->count();
+    if (count - m_info->dir_pos >= TNFS_DIRCACHE_PREFETCH)
+        return;
+
+    bool idle = false;
+    if (!listing->prefetching.compare_exchange_strong(idle, true))
+        return;
+
+    tnfsDirPrefetchTask *task = new tnfsDirPrefetchTask(listing, count);
+    if (taskMgr.submit_task(task) <= 0)
+        delete task;
+}
+#endif
+
+/*
+    Opens directory for reading with tnfs_readdirx.
+    The listing comes from our directory cache if it was read recently (through
+    any mount of the same server), else it's fetched from the server as it's read.
     sortopts = zero or more TNFS_DIRSORT flags
     diropts = zero or more TNFS_DIROPT flags
     pattern = zero-terminated wildcard pattern string
@@ -705,8 +936,9 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
 // Number of bytes before the two null-terminated strings start
 #define OPENDIRX_HEADERBYTES 4
 
-    // Throw out any existing cached directory entries
-    m_info->empty_dircache();
+    // Forget whatever we were reading
+    m_info->dir_listing.reset();
+    m_info->dir_pos = 0;
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_OPENDIRX;
@@ -732,28 +964,78 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
     Debug_printf("TNFS open directory: sortopts=0x%02x diropts=0x%02x maxresults=0x%04x pattern=\"%s\" path=\"%s\"\r\n",
      sortopts, diropts, maxresults, (char *)(packet.payload + OFFSET_OPENDIRX_PATTERN), (char *)(packet.payload + pathoffset));
 
+    // The packet up to the path is our cache key
+    std::string server = _tnfs_dircache_server(m_info);
+    std::string key = server + '\n' + std::string((char *)packet.payload, pathoffset + pathlen);
+
+    // Same directory we opened last time, maybe still being read
+    if (m_info->dir_filling != nullptr && m_info->dir_filling->key == key &&
+        tnfsDirectoryCache.is_current(m_info->dir_filling.get()))
+    {
+        Debug_print("TNFS directory reused\r\n");
+        m_info->dir_listing = m_info->dir_filling;
+        return TNFS_RESULT_SUCCESS;
+    }
+
+    // Read recently through some mount
+    std::shared_ptr<tnfsDirListing> cached = tnfsDirectoryCache.find(key);
+    if (cached != nullptr)
+    {
+        Debug_printf("TNFS directory from cache, %u entries\r\n", cached->count());
+        m_info->dir_listing = cached;
+        return TNFS_RESULT_SUCCESS;
+    }
+
+    // Only one directory open on the server at a time
+    _tnfs_dirfill_stop(m_info);
+
+    std::shared_ptr<tnfsDirListing> listing =
+        std::make_shared<tnfsDirListing>(key, server, tnfsDirectoryCache.generation());
+
+    std::lock_guard<std::recursive_mutex> tlock(m_info->transaction_mutex);
     if (_tnfs_transaction(m_info, packet, pathoffset + pathlen + 1))
     {
         if (packet.payload[0] == TNFS_RESULT_SUCCESS)
         {
-            m_info->dir_handle = packet.payload[1];
+            listing->handle = packet.payload[1];
+            listing->session = m_info->session;
+            listing->owner = m_info;
             m_info->dir_entries = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 2);
-            Debug_printf("Directory opened, handle ID: %hd, entries: %u\r\n", m_info->dir_handle, m_info->dir_entries);
+            m_info->dir_listing = listing;
+            m_info->dir_filling = listing;
+            Debug_printf("Directory opened, handle ID: %hd, entries: %u\r\n", listing->handle, m_info->dir_entries);
         }
         return packet.payload[0];
     }
     return -1;
 }
 
-void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+/*
+    Reads next entry from the directory opened by tnfs_opendirx,
+    fetching more from the server when needed.
+    dir_entry filled with filename up to dir_entry_len
+ returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
 {
-    filestat->isDir = pCached->flags & TNFS_READDIRX_DIR ? true : false;
-    filestat->filesize = pCached->filesize;
-    filestat->m_time = pCached->m_time;
-    filestat->c_time = pCached->c_time;
-    filestat->a_time = 0;
+    // Check for an open directory
+    if (m_info == nullptr || m_info->dir_listing == nullptr)
+        return -1;
 
-    strlcpy(dir_entry, pCached->entryname, dir_entry_len);
+    tnfsDirListing *listing = m_info->dir_listing.get();
+
+    while (!listing->get(m_info->dir_pos, filestat, dir_entry, dir_entry_len))
+    {
+        if (listing->complete)
+        {
+            Debug_print("tnfs_readdirx returning EOF\r\n");
+            return TNFS_RESULT_END_OF_FILE;
+        }
+        int result = _tnfs_dirfill_batch(listing, m_info->dir_pos);
+        if (result != TNFS_RESULT_SUCCESS)
+            return result;
+    }
+    m_info->dir_pos++;
 
 #ifdef DEBUG
     {
@@ -764,197 +1046,61 @@ void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, cha
         strftime(t_m, sizeof(t_m), tfmt, localtime(&tt));
         tt = filestat->c_time;
         strftime(t_c, sizeof(t_c), tfmt, localtime(&tt));
-        Debug_printf("\t_readdirx_fill_response: dir: %s, size: %u, mtime: %s, ctime: %s \"%s\"\r\n",
+        Debug_printf("\ttnfs_readdirx: dir: %s, size: %u, mtime: %s, ctime: %s \"%s\"\r\n",
             filestat->isDir ? "Yes" : "no",
             filestat->filesize, t_m, t_c, dir_entry );
     }
 #endif
-}
-
-/*
-    Reads next available file using open directory handle specified in
-    tnfsMountInfo.dir_handle
-    dir_entry filled with filename up to dir_entry_len
- returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
-*/
-int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
-{
-    // Check for a valid open handle ID
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
-        return -1;
-
-    // See if we have an entry in our directory cache to return first
-    tnfsDirCacheEntry *pCached = m_info->next_dircache_entry();
-    if(pCached != nullptr)
-    {
-        Debug_print("tnfs_readdirx responding from cached entry\r\n");
-        _readdirx_fill_response(pCached, filestat, dir_entry, dir_entry_len);
-        return 0;
-    }
 
-    // If the cache was empty and the EOF flag was set, just respond with an EOF error
-    if(m_info->get_dircache_eof() == true)
-    {
-        Debug_print("tnfs_readdirx returning EOF based on cached value\r\n");
-        return TNFS_RESULT_END_OF_FILE;
-    }
-
-    // Invalidate the cache before loading more
-    m_info->empty_dircache();
-
-#define OFFSET_READDIRX_FLAGS 0
-#define OFFSET_READDIRX_SIZE 1
-#define OFFSET_READDIRX_MTIME 5
-#define OFFSET_READDIRX_CTIME 9
-#define OFFSET_READDIRX_PATH 13
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_READDIRX;
-    packet.payload[0] = m_info->dir_handle;
-    // Number of responses to read
-    packet.payload[1] = TNFS_MAX_DIRCACHE_ENTRIES;
-
-    if (_tnfs_transaction(m_info, packet, 2))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            uint8_t response_count = packet.payload[1];
-            uint8_t response_status = packet.payload[2];
-            uint16_t dirpos = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 3);
-
-            // Set our EOF flag if the server tells us there's no more after this
-            if(response_status & TNFS_READDIRX_STATUS_EOF)
-                m_info->set_dircache_eof();
-
-            Debug_printf("tnfs_readdirx resp_count=%hu, dirpos=%hu, status=%hu\r\n", response_count, dirpos, response_status);
-
-            // Fill our directory cache using the returned values
-            int current_offset = 5;
-            for(int i = 0; i < response_count; i++)
-            {
-                tnfsDirCacheEntry *pEntry = m_info->new_dircache_entry();
-                if(pEntry != nullptr)
-                {
-                    pEntry->dirpos = dirpos + i;
-                    pEntry->flags =
-                        packet.payload[current_offset + OFFSET_READDIRX_FLAGS];
-                    pEntry->filesize =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_SIZE);
-                    pEntry->m_time =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_MTIME);
-                    pEntry->c_time =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_CTIME);
-
-                    int name_len = strlcpy(pEntry->entryname,
-                        (char *)packet.payload + current_offset + OFFSET_READDIRX_PATH, sizeof(pEntry->entryname));
-
-                    /*
-                     Adjust our offset to point to the next entry within the packet
-                     flags (1) + size (4) + mtime (4) + ctime (4) + null (1) = 14
-                    */
-                    current_offset += 14 + name_len;
-                }
-                else
-                {
-                    Debug_print("tnfs_readdirx Failed to allocate new dircache entry!\r\n");
-                    break;
-                }
-            }
-
-            int loaded = m_info->count_dircache();
-            Debug_printf("tnfs_readdirx cached %d entries\r\n", loaded);
-            // Now that we've cached our entries, return the first one
-            if(loaded > 0)
-                _readdirx_fill_response(m_info->next_dircache_entry(), filestat, dir_entry, dir_entry_len);
+#ifndef ESP_PLATFORM
+    _tnfs_dirfill_prefetch(m_info);
+#endif
 
-        }
-        return packet.payload[0];
-    }
-    return -1;
+    return 0;
 }
 
 /*
-    TELLDIR
+    TELLDIR, answered from the listing
 */
 int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || m_info->dir_listing == nullptr)
         return -1;
 
     if(position == nullptr)
         return -1;
 
-    // First see if we're pointing at a currently-cached directory entry and return that
-    int cached = m_info->tell_dircache_entry();
-    if (cached > -1)
-    {
-        *position = cached;
-        return 0;
-    }
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_TELLDIR;
-    packet.payload[0] = m_info->dir_handle;
-
-    if (_tnfs_transaction(m_info, packet, 1))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            *position = TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + 1);
-        }
-        return packet.payload[0];
-    }
-    return -1;
+    *position = m_info->dir_pos;
+    return 0;
 }
 
 /*
-    SEEKDIR
+    SEEKDIR, entries past what we have are fetched by the next tnfs_readdirx
 */
 int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || m_info->dir_listing == nullptr)
         return -1;
 
-    // A SEEKDIR will always invalidate our directory cache
-    m_info->empty_dircache();
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_SEEKDIR;
-    packet.payload[0] = m_info->dir_handle;
-    uint32_t pos = position;
-    TNFS_UINT32_TO_LOHI_BYTEPTR(pos, packet.payload + 1);
-
-    if (_tnfs_transaction(m_info, packet, 5))
-        return packet.payload[0];
-
-    return -1;
+    m_info->dir_pos = position;
+    return 0;
 }
 
 /*
-    Closes current directory handle specificed in tnfsMountInfo
-    Returns: 0: success, -1: failed to send/receive packet, other: TNFS server response
+    Closes the directory opened by tnfs_opendirx.
+    A directory that wasn't read to the end stays open on the server, opening it
+    again continues where we left off. It's closed once read to the end or when
+    another directory is opened.
+    Returns: 0: success, -1: no open directory
 */
 int tnfs_closedir(tnfsMountInfo *m_info)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || m_info->dir_listing == nullptr)
         return -1;
 
-    // Throw out any existing cached directory entries
-    m_info->empty_dircache();
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_CLOSEDIR;
-    packet.payload[0] = m_info->dir_handle;
-
-    if (_tnfs_transaction(m_info, packet, 1))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            m_info->dir_handle = TNFS_INVALID_HANDLE;
-        }
-        return packet.payload[0];
-    }
-    return -1;
+    m_info->dir_listing.reset();
+    m_info->dir_pos = 0;
+    return 0;
 }
 
 /*
@@ -975,6 +1121,8 @@ int tnfs_mkdir(tnfsMountInfo *m_info, const char *directory)
 
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            _tnfs_dircache_invalidate(m_info);
         return packet.payload[0];
     }
     return -1;
@@ -998,6 +1146,8 @@ int tnfs_rmdir(tnfsMountInfo *m_info, const char *directory)
 
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            _tnfs_dircache_invalidate(m_info);
         return packet.payload[0];
     }
     return -1;
@@ -1075,6 +1225,8 @@ int tnfs_unlink(tnfsMountInfo *m_info, const char *filepath)
 
     if (_tnfs_transaction(m_info, packet, len + 1))
     {
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            _tnfs_dircache_invalidate(m_info);
         return packet.payload[0];
     }
     return -1;
@@ -1100,6 +1252,8 @@ int tnfs_rename(tnfsMountInfo *m_info, const char *old_filepath, const char *new
 
     if (_tnfs_transaction(m_info, packet, l1 + l2))
     {
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            _tnfs_dircache_invalidate(m_info);
         return packet.payload[0];
     }
     return -1;
@@ -1127,6 +1281,8 @@ int tnfs_chmod(tnfsMountInfo *m_info, const char *filepath, uint16_t mode)
 
     if (_tnfs_transaction(m_info, packet, len + 3))
     {
+        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+            _tnfs_dircache_invalidate(m_info);
         return packet.payload[0];
     }
     return -1;
@@ -1568,6 +1724,9 @@ uint8_t _tnfs_session_recovery(tnfsMountInfo *m_info, uint8_t command)
         Debug_printf("_tnfs_session_recovery - remount failed\n");
         return TNFS_RESULT_INVALID_HANDLE;
     }
+    // Directory handles are lost and the server may have restarted with different contents
+    _tnfs_dircache_invalidate(m_info);
+
     // re-mount succeeded, check the command
     switch (command)
     {
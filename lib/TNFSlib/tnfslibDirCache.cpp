@@ -0,0 +1,138 @@
+
+#include "tnfslibDirCache.h"
+
+#include "compat_string.h"
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+
+tnfsDirCache tnfsDirectoryCache;
+
+void tnfsDirListing::add(uint8_t flags, uint32_t filesize, uint32_t m_time, uint32_t c_time, const char *name, size_t name_len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    entry e;
+    e.name = _names.size();
+    e.filesize = filesize;
+    e.m_time = m_time;
+    e.c_time = c_time;
+    e.flags = flags;
+    _entries.push_back(e);
+
+    _names.append(name, name_len);
+    _names.push_back('\0');
+}
+
+uint32_t tnfsDirListing::count()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+size_t tnfsDirListing::size_bytes()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size() * sizeof(entry) + _names.size();
+}
+
+/*
+ Fills filestat and dir_entry from the entry at index
+ Returns false if there's no such entry (yet)
+*/
+bool tnfsDirListing::get(uint32_t index, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (index >= _entries.size())
+        return false;
+
+    const entry &e = _entries[index];
+    filestat->isDir = e.flags & TNFS_READDIRX_DIR ? true : false;
+    filestat->filesize = e.filesize;
+    filestat->m_time = e.m_time;
+    filestat->c_time = e.c_time;
+    filestat->a_time = 0;
+
+    strlcpy(dir_entry, _names.c_str() + e.name, dir_entry_len);
+    return true;
+}
+
+/*
+ Returns a complete listing that isn't older than TNFS_DIRCACHE_TTL_MS,
+ or null if there's none
+*/
+std::shared_ptr<tnfsDirListing> tnfsDirCache::find(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint64_t now = fnSystem.millis();
+
+    for (auto it = _listings.begin(); it != _listings.end(); ++it)
+    {
+        if ((*it)->key != key)
+            continue;
+        if (now - (*it)->completed_ms > TNFS_DIRCACHE_TTL_MS)
+        {
+            _listings.erase(it);
+            return nullptr;
+        }
+        // Move to front
+        _listings.splice(_listings.begin(), _listings, it);
+        return _listings.front();
+    }
+    return nullptr;
+}
+
+/*
+ Keeps a just completed listing, unless something changed on the server since
+ its directory was opened or it's too big to keep around
+*/
+void tnfsDirCache::put(std::shared_ptr<tnfsDirListing> listing)
+{
+    size_t bytes = listing->size_bytes();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (listing->generation != _generation || bytes > TNFS_DIRCACHE_MAX_BYTES)
+        return;
+
+    _listings.remove_if([&listing](const std::shared_ptr<tnfsDirListing> &l) { return l->key == listing->key; });
+    _listings.push_front(listing);
+
+    // Drop least recently used listings over the count or memory limit
+    size_t total = 0;
+    int kept = 0;
+    for (auto it = _listings.begin(); it != _listings.end();)
+    {
+        total += (*it)->size_bytes();
+        if (++kept > TNFS_DIRCACHE_LISTINGS || total > TNFS_DIRCACHE_MAX_BYTES)
+            it = _listings.erase(it);
+        else
+            ++it;
+    }
+}
+
+/*
+ Drops the listings of a server after a change made through any of its mounts.
+ Listings still being read (from any server) won't be kept either, their
+ directory may have been opened before the change.
+*/
+void tnfsDirCache::invalidate(const std::string &server)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _generation++;
+    _listings.remove_if([&server](const std::shared_ptr<tnfsDirListing> &l) { return l->server == server; });
+}
+
+uint32_t tnfsDirCache::generation()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _generation;
+}
+
+bool tnfsDirCache::is_current(tnfsDirListing *listing)
+{
+    if (listing->failed || listing->generation != generation())
+        return false;
+    return !listing->complete || fnSystem.millis() - listing->completed_ms <= TNFS_DIRCACHE_TTL_MS;
+}
@@ -0,0 +1,100 @@
+#ifndef _TNFSLIB_DIRCACHE_H
+#define _TNFSLIB_DIRCACHE_H
+
+#include <cstdint>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tnfslib.h"
+
+
+#define TNFS_DIRCACHE_BATCH 0 // Entries asked for with each TNFS_READDIRX, 0 is as many as fit in a response
+#define TNFS_DIRCACHE_PREFETCH 16 // Fetch the next batch once fewer entries than this are left to read
+#define TNFS_DIRCACHE_TTL_MS 10000 // How long a complete listing is reused
+#define TNFS_DIRCACHE_LISTINGS 4 // Max number of complete listings shared between mounts
+#ifdef ESP_PLATFORM
+#define TNFS_DIRCACHE_MAX_BYTES 32768 // Bigger listings are only reused by the mount that read them
+#else
+#define TNFS_DIRCACHE_MAX_BYTES 1048576
+#endif
+
+/*
+ All entries of one directory as returned by TNFS_READDIRX, for one pattern and
+ set of options. Entries are kept in two arenas: fixed size records and the
+ names, each followed by '\0'. An entry's index is its TELLDIR position.
+
+ Until the server reports the end of the directory, the listing keeps the
+ directory open on the server and is filled a batch at a time through the
+ mount (and session) that opened it.
+*/
+class tnfsDirListing : public std::enable_shared_from_this<tnfsDirListing>
+{
+public:
+    struct entry
+    {
+        uint32_t name; // Offset in _names
+        uint32_t filesize;
+        uint32_t m_time;
+        uint32_t c_time;
+        uint8_t flags;
+    };
+
+    tnfsDirListing(const std::string &listing_key, const std::string &server_key, uint32_t cache_generation)
+        : key(listing_key), server(server_key), generation(cache_generation) {};
+
+    const std::string key; // Server, path, pattern and options
+    const std::string server; // Server, mount path and user
+    const uint32_t generation; // Of tnfsDirCache when the directory was opened
+
+    // Filling state, only used while holding fetch_mutex
+    std::mutex fetch_mutex;
+    tnfsMountInfo *owner = nullptr; // Set to null when the mount goes away
+    uint16_t session = TNFS_INVALID_SESSION; // Owner's session the directory handle belongs to
+    int16_t handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIRX
+    int error = 0; // Result that stopped the filling
+
+    std::atomic<bool> complete{false}; // Server returned every entry
+    std::atomic<bool> failed{false}; // Filling stopped before the end
+    std::atomic<bool> prefetching{false}; // A background fetch is queued
+    std::atomic<uint64_t> completed_ms{0};
+
+    void add(uint8_t flags, uint32_t filesize, uint32_t m_time, uint32_t c_time, const char *name, size_t name_len);
+    uint32_t count();
+    size_t size_bytes();
+    bool get(uint32_t index, tnfsStat *filestat, char *dir_entry, int dir_entry_len);
+
+private:
+    std::mutex _mutex; // Guards the arenas, entries may be added by a worker thread
+    std::vector<entry> _entries;
+    std::string _names;
+};
+
+/*
+ Complete listings kept for a short while so opening the same directory again,
+ from any drive or host slot, needs no round trips. Any change made through a
+ mount drops the listings of that server.
+*/
+class tnfsDirCache
+{
+private:
+    std::list<std::shared_ptr<tnfsDirListing>> _listings; // Most recently used first
+    uint32_t _generation = 0;
+    std::mutex _mutex;
+
+public:
+    std::shared_ptr<tnfsDirListing> find(const std::string &key);
+    void put(std::shared_ptr<tnfsDirListing> listing);
+    void invalidate(const std::string &server);
+    uint32_t generation();
+
+    // True if the listing can still be used to answer a new TNFS_OPENDIRX
+    bool is_current(tnfsDirListing *listing);
+};
+
+extern tnfsDirCache tnfsDirectoryCache;
+
+#endif // _TNFSLIB_DIRCACHE_H
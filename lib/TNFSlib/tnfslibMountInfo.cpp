@@ -1,5 +1,6 @@
 
 #include "tnfslibMountInfo.h"
+#include "tnfslibDirCache.h"
 
 #include "compat_string.h"
 
@@ -28,63 +29,13 @@ tnfsMountInfo::~tnfsMountInfo()
             _file_handles[i] = nullptr;
         }
     }
-    // Delete any remaining directory cache entries
-    empty_dircache();
-}
-
-// Empty the current contents of the directory cache
-void tnfsMountInfo::empty_dircache()
-{
-    for (int i = 0; i < TNFS_MAX_DIRCACHE_ENTRIES; i++)
+    // A listing still being filled (maybe by a worker thread) mustn't use us anymore
+    if (dir_filling != nullptr)
     {
-        if (_dir_cache[i] != nullptr)
-        {
-            delete _dir_cache[i];
-            _dir_cache[i] = nullptr;
-        }
+        std::lock_guard<std::mutex> lock(dir_filling->fetch_mutex);
+        if (dir_filling->owner == this)
+            dir_filling->owner = nullptr;
     }
-    _dir_cache_current = 0;
-    _dir_cache_count = 0;
-    _dir_cache_eof = false;
-}
-
-/*
- Add a new entry to the directory cache and return a pointer to it
- Null is returned if we've reached TNFS_MAX_DIRCACHE_ENTRIES
-*/
-tnfsDirCacheEntry * tnfsMountInfo::new_dircache_entry()
-{
-    if(_dir_cache_count >= TNFS_MAX_DIRCACHE_ENTRIES)
-        return nullptr;
-
-    _dir_cache[_dir_cache_count] = new tnfsDirCacheEntry();
-    _dir_cache_count ++;
-    return _dir_cache[_dir_cache_count - 1];
-}
-
-/*
- Return a pointer to the next unread directory cache entry
- Returns null if there are no cache entries left to read
-*/
-tnfsDirCacheEntry * tnfsMountInfo::next_dircache_entry()
-{
-    if(_dir_cache_current >= _dir_cache_count)
-        return nullptr;
-
-    _dir_cache_current++;
-    return _dir_cache[_dir_cache_current - 1];
-}
-
-/*
- Returns the directory position of the currently cached directory
- entry as provided by the server.
- Returns -1 if there is no currently cached entry.
-*/
-int tnfsMountInfo::tell_dircache_entry()
-{
-    if(_dir_cache_current >= _dir_cache_count)
-        return -1;
-    return _dir_cache[_dir_cache_current]->dirpos;
 }
 
 /*
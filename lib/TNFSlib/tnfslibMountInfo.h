@@ -2,6 +2,7 @@
 #define _TNFSLIB_MOUNTINFO_H
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 
 #include "fnDNS.h"
@@ -21,8 +22,6 @@
 #define TNFS_INVALID_HANDLE -1
 #define TNFS_INVALID_SESSION 0 // We're assuming a '0' is never a valid session ID
 
-#define TNFS_MAX_DIRCACHE_ENTRIES 32 // Max number of directory cache entries we'll store
-
 #define TNFS_PROTOCOL_UNKNOWN 0
 #define TNFS_PROTOCOL_TCP 1
 #define TNFS_PROTOCOL_UDP 2
@@ -56,26 +55,14 @@ struct tnfsFileHandleInfo
     char filename[TNFS_MAX_FILELEN];
 };
 
-// A place to store each directory entry we cache from a response to TNFS_READDIRX
-struct tnfsDirCacheEntry
-{
-    uint16_t dirpos;
-    uint8_t flags;
-    uint32_t filesize;
-    uint32_t m_time;
-    uint32_t c_time;
-    char entryname[TNFS_MAX_FILELEN];
-};
+// Entries cached from responses to TNFS_READDIRX, see tnfslibDirCache.h
+class tnfsDirListing;
 
 // Everything we need to know about and keep track of for the server we're talking to
 class tnfsMountInfo
 {
 private:
     tnfsFileHandleInfo * _file_handles[TNFS_MAX_FILE_HANDLES] = { nullptr }; // Stored from server's responses to TNFS_OPEN
-    tnfsDirCacheEntry * _dir_cache[TNFS_MAX_DIRCACHE_ENTRIES] = { nullptr };
-    uint16_t _dir_cache_current = 0;
-    uint16_t _dir_cache_count = 0;
-    bool _dir_cache_eof = false;
 
 public:
     ~tnfsMountInfo();
@@ -89,15 +76,6 @@ public:
     void delete_filehandleinfo(uint8_t filehandle);
     void delete_filehandleinfo(tnfsFileHandleInfo * pFilehandle);
 
-    tnfsDirCacheEntry * new_dircache_entry();
-    tnfsDirCacheEntry * next_dircache_entry();
-
-    int tell_dircache_entry();
-    void empty_dircache();
-    uint16_t count_dircache() { return _dir_cache_count; };
-    void set_dircache_eof() { _dir_cache_eof = true; };
-    bool get_dircache_eof() { return _dir_cache_eof; };
-
     uint8_t protocol = TNFS_PROTOCOL_UNKNOWN;
     fnTcpClient tcp_client;
 
@@ -116,8 +94,10 @@ public:
     int timeout_ms = TNFS_TIMEOUT;
     uint8_t current_sequence_num = 0; // Updated with each transaction to the server
 
-    int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
     uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
+    std::shared_ptr<tnfsDirListing> dir_listing; // Directory being read, set by tnfs_opendirx
+    uint32_t dir_pos = 0; // Next entry of dir_listing to read
+    std::shared_ptr<tnfsDirListing> dir_filling; // Last directory opened on the server, may outlive tnfs_closedir
     std::recursive_mutex transaction_mutex;
 
 #ifdef TNFS_UDP_SIMULATE_RECV_TWICE
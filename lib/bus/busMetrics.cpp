@@ -0,0 +1,294 @@
+#include "busMetrics.h"
+
+#include <stdio.h>
+
+#include "fnSystem.h"
+
+// global bus metrics object
+busMetrics fnBusMetrics;
+
+const uint32_t busMetrics::bucket_bounds_us[BUS_METRICS_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000};
+
+static const char *phase_names[BUS_PHASE_COUNT] = {"ack", "complete", "data"};
+
+uint32_t busMetrics::_elapsed()
+{
+    // 32 bit difference is wrap-safe and fnSystem.micros() is only 32 bit on ESP
+    return (uint32_t)fnSystem.micros() - _start_us;
+}
+
+void busMetrics::command_start(uint8_t device, uint8_t command)
+{
+    // previous command returned early without saying so
+    if (_active)
+        command_end();
+
+    _active = true;
+    _device = device;
+    _command = command;
+    _start_us = (uint32_t)fnSystem.micros();
+    _phases = 0;
+    _error = false;
+    _naks = 0;
+    _bytes_in = 0;
+    _bytes_out = 0;
+}
+
+// For buses where the device number only shows up after the command byte
+void busMetrics::set_device(uint8_t device)
+{
+    _device = device;
+}
+
+void busMetrics::ack()
+{
+    if (!_active || (_phases & (1 << BUS_PHASE_ACK)))
+        return;
+    _phase_us[BUS_PHASE_ACK] = _elapsed();
+    _phases |= 1 << BUS_PHASE_ACK;
+}
+
+void busMetrics::nak()
+{
+    if (_active)
+        _naks++;
+}
+
+void busMetrics::complete(bool error)
+{
+    if (!_active)
+        return;
+    if (error)
+        _error = true;
+    if (_phases & (1 << BUS_PHASE_COMPLETE))
+        return;
+    _phase_us[BUS_PHASE_COMPLETE] = _elapsed();
+    _phases |= 1 << BUS_PHASE_COMPLETE;
+}
+
+void busMetrics::data_in(size_t len)
+{
+    if (!_active)
+        return;
+    _bytes_in += len;
+    _phase_us[BUS_PHASE_DATA] = _elapsed();
+    _phases |= 1 << BUS_PHASE_DATA;
+}
+
+void busMetrics::data_out(size_t len)
+{
+    if (!_active)
+        return;
+    _bytes_out += len;
+    _phase_us[BUS_PHASE_DATA] = _elapsed();
+    _phases |= 1 << BUS_PHASE_DATA;
+}
+
+void busMetrics::command_end()
+{
+    if (!_active)
+        return;
+    _active = false;
+
+    busCommandMetrics *m = _find(_device, _command);
+    if (m == nullptr)
+    {
+        _untracked++;
+        return;
+    }
+
+    m->count++;
+    if (_error)
+        m->errors++;
+    m->naks += _naks;
+    m->bytes_in += _bytes_in;
+    m->bytes_out += _bytes_out;
+
+    for (int p = 0; p < BUS_PHASE_COUNT; p++)
+        if (_phases & (1 << p))
+            _record(m->latency[p], _phase_us[p]);
+}
+
+// Open addressing on (device, command), the table never shrinks so no tombstones needed
+busCommandMetrics *busMetrics::_find(uint8_t device, uint8_t command)
+{
+    unsigned start = ((device * 31u) + command) % BUS_METRICS_MAX_ENTRIES;
+    for (unsigned n = 0; n < BUS_METRICS_MAX_ENTRIES; n++)
+    {
+        busCommandMetrics *m = &_entries[(start + n) % BUS_METRICS_MAX_ENTRIES];
+        if (!m->used)
+        {
+            m->used = true;
+            m->device = device;
+            m->command = command;
+            return m;
+        }
+        if (m->device == device && m->command == command)
+            return m;
+    }
+    return nullptr;
+}
+
+void busMetrics::_record(busLatency &lat, uint32_t elapsed_us)
+{
+    int b = 0;
+    while (b < BUS_METRICS_BUCKETS - 1 && elapsed_us > bucket_bounds_us[b])
+        b++;
+    lat.buckets[b]++;
+    lat.count++;
+    lat.sum_us += elapsed_us;
+    if (elapsed_us > lat.max_us)
+        lat.max_us = elapsed_us;
+}
+
+std::string busMetrics::to_json()
+{
+    char buf[160];
+    std::string out;
+
+    snprintf(buf, sizeof(buf), "{\"untracked\":%u,\"bad_frames\":%u,\"buckets_us\":[",
+             (unsigned)_untracked, (unsigned)_bad_frames);
+    out += buf;
+    for (int b = 0; b < BUS_METRICS_BUCKETS - 1; b++)
+    {
+        snprintf(buf, sizeof(buf), "%s%u", b ? "," : "", (unsigned)bucket_bounds_us[b]);
+        out += buf;
+    }
+    out += "],\"commands\":[";
+
+    bool first = true;
+    for (int i = 0; i < BUS_METRICS_MAX_ENTRIES; i++)
+    {
+        const busCommandMetrics &m = _entries[i];
+        if (!m.used)
+            continue;
+
+        snprintf(buf, sizeof(buf),
+                 "%s{\"device\":%u,\"command\":%u,\"count\":%u,\"errors\":%u,\"naks\":%u,"
+                 "\"bytes_in\":%llu,\"bytes_out\":%llu",
+                 first ? "" : ",", m.device, m.command, (unsigned)m.count, (unsigned)m.errors,
+                 (unsigned)m.naks, (unsigned long long)m.bytes_in, (unsigned long long)m.bytes_out);
+        out += buf;
+        first = false;
+
+        for (int p = 0; p < BUS_PHASE_COUNT; p++)
+        {
+            const busLatency &lat = m.latency[p];
+            snprintf(buf, sizeof(buf), ",\"%s\":{\"count\":%u,\"sum_us\":%llu,\"max_us\":%u,\"hist\":[",
+                     phase_names[p], (unsigned)lat.count, (unsigned long long)lat.sum_us, (unsigned)lat.max_us);
+            out += buf;
+            for (int b = 0; b < BUS_METRICS_BUCKETS; b++)
+            {
+                snprintf(buf, sizeof(buf), "%s%u", b ? "," : "", (unsigned)lat.buckets[b]);
+                out += buf;
+            }
+            out += "]}";
+        }
+        out += "}";
+    }
+    out += "]}\n";
+
+    return out;
+}
+
+// Prometheus text exposition format
+std::string busMetrics::to_prometheus()
+{
+    char buf[200];
+    std::string out;
+
+    out += "# HELP fujinet_bus_commands_total Bus commands handled.\n"
+           "# TYPE fujinet_bus_commands_total counter\n";
+    for (const busCommandMetrics &m : _entries)
+    {
+        if (!m.used)
+            continue;
+        snprintf(buf, sizeof(buf), "fujinet_bus_commands_total{device=\"0x%02x\",command=\"0x%02x\"} %u\n",
+                 m.device, m.command, (unsigned)m.count);
+        out += buf;
+    }
+
+    out += "# HELP fujinet_bus_command_errors_total Bus commands answered with an error.\n"
+           "# TYPE fujinet_bus_command_errors_total counter\n";
+    for (const busCommandMetrics &m : _entries)
+    {
+        if (!m.used)
+            continue;
+        snprintf(buf, sizeof(buf), "fujinet_bus_command_errors_total{device=\"0x%02x\",command=\"0x%02x\"} %u\n",
+                 m.device, m.command, (unsigned)m.errors);
+        out += buf;
+    }
+
+    out += "# HELP fujinet_bus_command_naks_total NAKs and checksum retries.\n"
+           "# TYPE fujinet_bus_command_naks_total counter\n";
+    for (const busCommandMetrics &m : _entries)
+    {
+        if (!m.used)
+            continue;
+        snprintf(buf, sizeof(buf), "fujinet_bus_command_naks_total{device=\"0x%02x\",command=\"0x%02x\"} %u\n",
+                 m.device, m.command, (unsigned)m.naks);
+        out += buf;
+    }
+
+    out += "# HELP fujinet_bus_bytes_total Data bytes moved over the bus.\n"
+           "# TYPE fujinet_bus_bytes_total counter\n";
+    for (const busCommandMetrics &m : _entries)
+    {
+        if (!m.used)
+            continue;
+        snprintf(buf, sizeof(buf),
+                 "fujinet_bus_bytes_total{device=\"0x%02x\",command=\"0x%02x\",direction=\"in\"} %llu\n"
+                 "fujinet_bus_bytes_total{device=\"0x%02x\",command=\"0x%02x\",direction=\"out\"} %llu\n",
+                 m.device, m.command, (unsigned long long)m.bytes_in,
+                 m.device, m.command, (unsigned long long)m.bytes_out);
+        out += buf;
+    }
+
+    out += "# HELP fujinet_bus_latency_seconds Time from command frame to ACK, COMPLETE and last data byte.\n"
+           "# TYPE fujinet_bus_latency_seconds histogram\n";
+    for (const busCommandMetrics &m : _entries)
+    {
+        if (!m.used)
+            continue;
+        for (int p = 0; p < BUS_PHASE_COUNT; p++)
+        {
+            const busLatency &lat = m.latency[p];
+            if (lat.count == 0)
+                continue;
+
+            uint32_t cumulative = 0;
+            for (int b = 0; b < BUS_METRICS_BUCKETS; b++)
+            {
+                cumulative += lat.buckets[b];
+                char le[16];
+                if (b < BUS_METRICS_BUCKETS - 1)
+                    snprintf(le, sizeof(le), "%g", bucket_bounds_us[b] / 1e6);
+                else
+                    snprintf(le, sizeof(le), "+Inf");
+                snprintf(buf, sizeof(buf),
+                         "fujinet_bus_latency_seconds_bucket{device=\"0x%02x\",command=\"0x%02x\",phase=\"%s\",le=\"%s\"} %u\n",
+                         m.device, m.command, phase_names[p], le, (unsigned)cumulative);
+                out += buf;
+            }
+            snprintf(buf, sizeof(buf),
+                     "fujinet_bus_latency_seconds_sum{device=\"0x%02x\",command=\"0x%02x\",phase=\"%s\"} %g\n"
+                     "fujinet_bus_latency_seconds_count{device=\"0x%02x\",command=\"0x%02x\",phase=\"%s\"} %u\n",
+                     m.device, m.command, phase_names[p], lat.sum_us / 1e6,
+                     m.device, m.command, phase_names[p], (unsigned)lat.count);
+            out += buf;
+        }
+    }
+
+    out += "# HELP fujinet_bus_untracked_commands_total Commands not tracked because the metrics table is full.\n"
+           "# TYPE fujinet_bus_untracked_commands_total counter\n";
+    snprintf(buf, sizeof(buf), "fujinet_bus_untracked_commands_total %u\n", (unsigned)_untracked);
+    out += buf;
+
+    out += "# HELP fujinet_bus_bad_frames_total Command frames dropped for a bad checksum.\n"
+           "# TYPE fujinet_bus_bad_frames_total counter\n";
+    snprintf(buf, sizeof(buf), "fujinet_bus_bad_frames_total %u\n", (unsigned)_bad_frames);
+    out += buf;
+
+    return out;
+}
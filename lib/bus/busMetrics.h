@@ -0,0 +1,113 @@
+#ifndef BUS_METRICS_H
+#define BUS_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/*
+ Per device, per command timing and traffic counters shared by the bus implementations.
+
+ A bus calls command_start() when it has a complete command from the host and
+ command_end() when it's done with it. In between, ack(), nak(), complete(),
+ data_in() and data_out() are called as the bus talks to the host. Latency of
+ each phase is measured from command_start():
+    ACK      - command acknowledged
+    COMPLETE - COMPLETE/ERROR (or the bus equivalent) sent
+    DATA     - last data byte moved
+ and kept in fixed-bucket histograms, so the cost per command is a few additions.
+
+ Counters are updated from the bus task only and read without locking by the
+ web server; a snapshot may be slightly inconsistent, which is fine for metrics.
+*/
+
+// (device, command) pairs tracked, anything beyond that only counts as untracked
+#ifdef ESP_PLATFORM
+#define BUS_METRICS_MAX_ENTRIES 24
+#else
+#define BUS_METRICS_MAX_ENTRIES 64
+#endif
+
+// Latency histogram buckets, last one is +Inf
+#define BUS_METRICS_BUCKETS 12
+
+// Device number for commands that aren't addressed to a device (e.g. DriveWire time/init)
+#define BUS_METRICS_NO_DEVICE 0xFF
+
+enum busMetricsPhase
+{
+    BUS_PHASE_ACK = 0,
+    BUS_PHASE_COMPLETE,
+    BUS_PHASE_DATA,
+    BUS_PHASE_COUNT
+};
+
+struct busLatency
+{
+    uint32_t count = 0;
+    uint32_t max_us = 0;
+    uint64_t sum_us = 0;
+    uint32_t buckets[BUS_METRICS_BUCKETS] = {};
+};
+
+struct busCommandMetrics
+{
+    bool used = false;
+    uint8_t device = 0;
+    uint8_t command = 0;
+
+    uint32_t count = 0;         // commands finished
+    uint32_t errors = 0;        // ERROR or error status sent to the host
+    uint32_t naks = 0;          // NAKs or checksum retries
+    uint64_t bytes_in = 0;      // host -> FujiNet
+    uint64_t bytes_out = 0;     // FujiNet -> host
+
+    busLatency latency[BUS_PHASE_COUNT];
+};
+
+class busMetrics
+{
+public:
+    // upper bounds of the histogram buckets in microseconds
+    static const uint32_t bucket_bounds_us[BUS_METRICS_BUCKETS - 1];
+
+    void command_start(uint8_t device, uint8_t command);
+    void set_device(uint8_t device);
+    void ack();
+    void nak();
+    void complete(bool error);
+    void data_in(size_t len);
+    void data_out(size_t len);
+    void command_end();
+
+    // command frame that couldn't be parsed or failed its checksum
+    void bad_frame() { _bad_frames++; }
+
+    std::string to_json();
+    std::string to_prometheus();
+
+private:
+    busCommandMetrics *_find(uint8_t device, uint8_t command);
+    static void _record(busLatency &lat, uint32_t elapsed_us);
+    uint32_t _elapsed();
+
+    busCommandMetrics _entries[BUS_METRICS_MAX_ENTRIES];
+    uint32_t _untracked = 0;
+    uint32_t _bad_frames = 0;
+
+    // command in progress
+    bool _active = false;
+    uint8_t _device = 0;
+    uint8_t _command = 0;
+    uint32_t _start_us = 0;
+    uint8_t _phases = 0;        // bit per busMetricsPhase seen
+    uint32_t _phase_us[BUS_PHASE_COUNT] = {};
+    bool _error = false;
+    uint32_t _naks = 0;
+    uint32_t _bytes_in = 0;
+    uint32_t _bytes_out = 0;
+};
+
+extern busMetrics fnBusMetrics;
+
+#endif // BUS_METRICS_H
@@ -4,6 +4,8 @@
 
 #include "../../include/debug.h"
 
+#include "busMetrics.h"
+
 #include "fuji.h"
 #include "udpstream.h"
 #include "modem.h"
@@ -123,6 +125,7 @@ void systemBus::op_readex()
     lsn |= fnDwCom.read();
 
     Debug_printf("OP_READ: DRIVE %3u - SECTOR %8lu\n", drive_num, lsn);
+    fnBusMetrics.set_device(drive_num);
 
     if (theFuji.boot_config)
         d = theFuji.bootdisk();
@@ -174,6 +177,7 @@ void systemBus::op_readex()
 
     // send sector data
     fnDwCom.write(blk_buffer, blk_size);
+    fnBusMetrics.data_out(blk_size);
 
     // receive checksum
     c1 = (fnDwCom.read()) << 8;
@@ -187,6 +191,7 @@ void systemBus::op_readex()
         if (c1 != c2)
         {
             Debug_printf("Checksum error: expected %d, got %d\n", c2, c1);
+            fnBusMetrics.nak();
             rc = 243;
         }
     }
@@ -194,6 +199,7 @@ void systemBus::op_readex()
     // finally, send the transaction status
     fnDwCom.write(rc);
     fnDwCom.flush();
+    fnBusMetrics.complete(rc != DISK_CTRL_STATUS_CLEAR);
 }
 
 void systemBus::op_write()
@@ -207,7 +213,10 @@ void systemBus::op_write()
     lsn |= fnDwCom.read() << 8;
     lsn |= fnDwCom.read();
 
+    fnBusMetrics.set_device(drive_num);
+
     size_t s = fnDwCom.readBytes(sector_data, MEDIA_BLOCK_SIZE);
+    fnBusMetrics.data_in(s);
 
     if (s != MEDIA_BLOCK_SIZE)
     {
@@ -237,6 +246,7 @@ void systemBus::op_write()
     {
         Debug_printv("Invalid drive #%3u", drive_num);
         fnDwCom.write(0xF6);
+        fnBusMetrics.complete(true);
         return;
     }
 
@@ -244,6 +254,7 @@ void systemBus::op_write()
     {
         Debug_printv("Device not active.");
         fnDwCom.write(0xF6);
+        fnBusMetrics.complete(true);
         return;
     }
 
@@ -251,10 +262,12 @@ void systemBus::op_write()
     {
         Debug_print("Write error\n");
         fnDwCom.write(0xF5);
+        fnBusMetrics.complete(true);
         return;
     }
 
     fnDwCom.write(0x00); // success
+    fnBusMetrics.complete(false);
 }
 
 void systemBus::op_fuji()
@@ -358,6 +371,9 @@ void systemBus::_drivewire_process_cmd()
 
     fnLedManager.set(eLed::LED_BUS, true);
 
+    // the drive number, if any, comes after the opcode
+    fnBusMetrics.command_start(BUS_METRICS_NO_DEVICE, c);
+
     switch (c)
     {
     case OP_JEFF:
@@ -416,6 +432,7 @@ void systemBus::_drivewire_process_cmd()
         break;
     }
 
+    fnBusMetrics.command_end();
     fnLedManager.set(eLed::LED_BUS, false);
 }
 
@@ -7,6 +7,7 @@
 
 #include "iwm.h"
 #include "fnSystem.h"
+#include "busMetrics.h"
 
 #ifdef ESP_PLATFORM
 #include "fnHardwareTimer.h"
@@ -207,15 +208,23 @@ int iwmBus::iwm_send_packet(uint8_t source, iwm_packet_type_t packet_type, uint8
   do
   {
     r = smartport.iwm_send_packet_spi();
+    if (r)
+      fnBusMetrics.nak();
     retry--;
   } while (r && retry); // retry if we get an error and haven't tried too many times
 
+  if (num > 0)
+    fnBusMetrics.data_out(num);
+  fnBusMetrics.complete(status != 0 || r != 0);
+
   return r;
 }
 
 bool iwmBus::iwm_decode_data_packet(uint8_t *data, int &n)
 {
   n = smartport.decode_data_packet(data);
+  if (n > 0)
+    fnBusMetrics.data_in(n);
   return false;
 }
 
@@ -498,7 +507,10 @@ void IRAM_ATTR iwmBus::service()
       print_packet(command_packet.data);
       Debug_printf("\r\nhandling init command");
 #endif
+      fnBusMetrics.command_start(BUS_METRICS_NO_DEVICE, 0x05);
+      fnBusMetrics.ack();
       handle_init();
+      fnBusMetrics.command_end();
     }
     else
     {
@@ -526,7 +538,11 @@ void IRAM_ATTR iwmBus::service()
           memset(command.decoded, 0, sizeof(command.decoded));
           smartport.decode_data_packet(command_packet.data, command.decoded);
           print_packet(command.decoded, 9);
+          // REQ handshake is done, the command has been acknowledged
+          fnBusMetrics.command_start(devicep->_devnum, command.command);
+          fnBusMetrics.ack();
           _activeDev->process(command);
+          fnBusMetrics.command_end();
           break; // we don't need to needlessly keep looping once we find it
         }
       }
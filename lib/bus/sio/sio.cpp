@@ -4,6 +4,8 @@
 
 #include "../../include/debug.h"
 
+#include "busMetrics.h"
+
 #include "fuji.h"
 #include "udpstream.h"
 #include "modem.h"
@@ -15,6 +17,11 @@
 #include "led.h"
 #include "utils.h"
 
+#ifndef ESP_PLATFORM
+#include <vector>
+#include "fnTaskManager.h"
+#endif
+
 // Helper functions outside the class defintions
 
 // Get requested buffer length from command frame
@@ -72,6 +79,7 @@ void virtualDevice::bus_to_computer(uint8_t *buf, uint16_t len, bool err)
 
     fnSioCom.flush();
 #endif
+    fnBusMetrics.data_out(len);
 }
 
 // TODO apc: change return type to indicate valid/invalid checksum
@@ -111,6 +119,8 @@ uint8_t virtualDevice::bus_to_peripheral(uint8_t *buf, unsigned short len)
     uint8_t ck_rcv = fnSioCom.read();
 #endif
 
+    fnBusMetrics.data_in(l);
+
     uint8_t ck_tst = sio_checksum(buf, len);
 
 #ifdef VERBOSE_SIO
@@ -146,6 +156,7 @@ void virtualDevice::sio_nak()
     fnSioCom.flush();
     SIO.set_command_processed(true);
 #endif
+    fnBusMetrics.nak();
     Debug_println("NAK!");
 }
 
@@ -163,6 +174,7 @@ void virtualDevice::sio_ack()
     fnSioCom.flush();
     SIO.set_command_processed(true);
 #endif
+    fnBusMetrics.ack();
     Debug_println("ACK!");
 }
 
@@ -174,6 +186,7 @@ void virtualDevice::sio_late_ack()
     {
         fnSioCom.netsio_late_sync('A');
         SIO.set_command_processed(true);
+        fnBusMetrics.ack();
         Debug_println("ACK+!");
     }
     else
@@ -192,6 +205,7 @@ void virtualDevice::sio_complete()
 #else
     fnSioCom.write('C');
 #endif
+    fnBusMetrics.complete(false);
     Debug_println("COMPLETE!");
 }
 
@@ -204,9 +218,83 @@ void virtualDevice::sio_error()
 #else
     fnSioCom.write('E');
 #endif
+    fnBusMetrics.complete(true);
     Debug_println("ERROR!");
 }
 
+#ifndef ESP_PLATFORM
+// Hand the slow part of the command over to a worker thread, see sioDeferredCommand
+void virtualDevice::sio_defer(uint16_t len, std::function<bool()> work, std::function<void(bool err)> done)
+{
+    sioDeferredCommand *cmd = new sioDeferredCommand(this, len, work, done);
+    if (SIO.set_deferred(cmd))
+    {
+        cmd->set_blocking(true);
+        cmd->set_priority(fnTask::PRIORITY_HIGH);
+        if (taskMgr.submit_task(cmd) > 0)
+            return;
+    }
+    delete cmd;
+
+    // Nowhere to run it, finish the command here
+    done(work());
+}
+
+sioDeferredCommand::sioDeferredCommand(virtualDevice *dev, uint16_t len, std::function<bool()> work, std::function<void(bool err)> done)
+    : _dev(dev), _len(len), _work_fn(work), _done_fn(done)
+{
+    _start_ms = fnSystem.millis();
+}
+
+sioDeferredCommand::~sioDeferredCommand()
+{
+    SIO.clear_deferred(this);
+}
+
+// Runs on a worker thread
+int sioDeferredCommand::work()
+{
+    _err = _work_fn();
+    return 0;
+}
+
+// Runs from the main loop once work() is done
+int sioDeferredCommand::step()
+{
+    if (_answered)
+    {
+        Debug_printf("Dropping late result for device %02x\n", _dev->_devnum);
+    }
+    else
+    {
+        _answered = true;
+        _done_fn(_err);
+        fnBusMetrics.command_end();
+        Debug_printf("Deferred command done in %lu ms\n", (long unsigned)(fnSystem.millis() - _start_ms));
+    }
+    return 1; // task completed
+}
+
+void sioDeferredCommand::expire()
+{
+    Debug_printf("Deferred command for device %02x is over budget\n", _dev->_devnum);
+    _answered = true;
+    std::vector<uint8_t> zeros(_len, 0);
+    _dev->bus_to_computer(zeros.data(), _len, true);
+    fnBusMetrics.command_end();
+}
+
+void sioDeferredCommand::abandon()
+{
+    if (!_answered)
+    {
+        Debug_printf("Abandoning deferred command for device %02x\n", _dev->_devnum);
+        _answered = true;
+        fnBusMetrics.command_end();
+    }
+}
+#endif
+
 // SIO HIGH SPEED REQUEST
 void virtualDevice::sio_high_speed()
 {
@@ -296,7 +384,10 @@ void systemBus::_sio_process_cmd()
 #ifndef ESP_PLATFORM
         // reset counter if checksum was correct
         _command_frame_counter = 0;
+        _sio_wait_deferred();
 #endif
+        fnBusMetrics.command_start(tempFrame.device, tempFrame.comnd);
+
         if (tempFrame.device == SIO_DEVICEID_DISK && _fujiDev != nullptr && _fujiDev->boot_config)
         {
             _activeDev = _fujiDev->bootdisk();
@@ -345,10 +436,16 @@ void systemBus::_sio_process_cmd()
                 }
             }
         }
+#ifndef ESP_PLATFORM
+        // a deferred command ends when its result is sent
+        if (_deferred == nullptr)
+#endif
+        fnBusMetrics.command_end();
     } // valid checksum
     else
     {
         Debug_print("CHECKSUM_ERROR\n");
+        fnBusMetrics.bad_frame();
         // Switch to/from hispeed SIO if we get enough failed frame checksums
         _command_frame_counter++;
         if (COMMAND_FRAME_SPEED_CHANGE_THRESHOLD == _command_frame_counter)
@@ -410,6 +507,10 @@ void systemBus::service()
     // modes disrupt normal SIO handling - should probably make a separate task for this)
     _sio_process_queue();
 
+#ifndef ESP_PLATFORM
+    _sio_check_deferred();
+#endif
+
     if (_udpDev != nullptr && _udpDev->udpstreamActive)
     {
 #ifdef ESP_PLATFORM
@@ -518,6 +619,11 @@ void systemBus::service()
     // Handle interrupts from network protocols
     for (int i = 0; i < 8; i++)
     {
+#ifndef ESP_PLATFORM
+        // protocol is busy on the worker thread
+        if (_deferred != nullptr && _deferred->device() == _netDev[i])
+            continue;
+#endif
         if (_netDev[i] != nullptr)
             _netDev[i]->sio_poll_interrupt();
     }
@@ -791,6 +897,49 @@ void systemBus::sio_empty_ack()
         fnSioCom.netsio_empty_sync();
     }
 }
+
+bool systemBus::set_deferred(sioDeferredCommand *cmd)
+{
+    if (_deferred != nullptr)
+        return false;
+    _deferred = cmd;
+    return true;
+}
+
+void systemBus::clear_deferred(sioDeferredCommand *cmd)
+{
+    if (_deferred == cmd)
+        _deferred = nullptr;
+}
+
+// Answer the deferred command with ERROR if its worker is taking too long, before the Atari times out
+void systemBus::_sio_check_deferred()
+{
+    if (_deferred != nullptr && _deferred->overdue(fnSystem.millis()))
+        _deferred->expire();
+}
+
+// A new command frame came in, let the deferred command finish first as it may be using
+// the same device, media or host
+void systemBus::_sio_wait_deferred()
+{
+    if (_deferred == nullptr)
+        return;
+
+    _deferred->abandon();
+    wait_deferred(nullptr);
+}
+
+// Wait for the worker of the deferred command for dev (or for any device), e.g. before the media goes away
+void systemBus::wait_deferred(virtualDevice *dev)
+{
+    while (_deferred != nullptr && (dev == nullptr || _deferred->device() == dev))
+    {
+        taskMgr.service();
+        if (_deferred != nullptr)
+            fnSystem.delay(1);
+    }
+}
 #endif
 
 void systemBus::setUDPHost(const char *hostname, int port)
@@ -7,7 +7,9 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #else
+#include <functional>
 #include "sio/siocom/fnSioCom.h"
+#include "fnTask.h"
 #endif
 
 #ifdef ESP_PLATFORM
@@ -63,6 +65,10 @@ FN_HISPEED_INDEX=40 //  18,806 (18,806) baud
 #define COMMAND_FRAME_SPEED_CHANGE_THRESHOLD 2
 #define SERIAL_TIMEOUT 300
 
+// Time a deferred command may take before the Atari gets an ERROR instead of
+// the data, well inside the 7 second OS timeout for disk I/O (FujiNet-PC)
+#define SIO_DEFER_BUDGET_MS 5000
+
 #define SIO_DEVICEID_DISK 0x31
 #define SIO_DEVICEID_DISK_LAST 0x3F
 
@@ -119,16 +125,52 @@ uint8_t sio_checksum(uint8_t *buf, unsigned short len);
 class modem;          // declare here so can reference it, but define in modem.h
 class sioFuji;        // declare here so can reference it, but define in fuji.h
 class systemBus;      // declare early so can be friend
+class virtualDevice;
 class sioNetwork;     // declare here so can reference it, but define in network.h
 class sioUDPStream;   // declare here so can reference it, but define in udpstream.h
 class sioCassette;    // Cassette forward-declaration.
 class sioCPM;         // CPM device.
 class sioPrinter;     // Printer device
 
+#ifndef ESP_PLATFORM
+// Second half of a command that was deferred with virtualDevice::sio_defer()
+class sioDeferredCommand : public fnTask
+{
+public:
+    sioDeferredCommand(virtualDevice *dev, uint16_t len, std::function<bool()> work, std::function<void(bool err)> done);
+    virtual ~sioDeferredCommand() override;
+
+    virtualDevice *device() { return _dev; };
+    // Atari gets ERROR and len zero bytes, the result is dropped once work() is done
+    void expire();
+    // Atari moved on to another command, nothing is sent
+    void abandon();
+    bool answered() { return _answered; };
+    bool overdue(unsigned long ms) { return !_answered && ms - _start_ms >= SIO_DEFER_BUDGET_MS; };
+
+protected:
+    virtual int start() override { return 0; };
+    virtual int work() override;
+    virtual int step() override;
+
+private:
+    virtualDevice *_dev;
+    uint16_t _len;
+    std::function<bool()> _work_fn;
+    std::function<void(bool err)> _done_fn;
+    bool _err = false;
+    bool _answered = false;
+    unsigned long _start_ms;
+};
+#endif
+
 class virtualDevice
 {
 protected:
     friend systemBus;
+#ifndef ESP_PLATFORM
+    friend sioDeferredCommand;
+#endif
 
     int _devnum;
 
@@ -193,6 +235,18 @@ protected:
      */
     void sio_error();
 
+#ifndef ESP_PLATFORM
+    /**
+     * @brief Finish the command in the background (FujiNet-PC only), call it after sio_ack().
+     * work() runs on a task manager worker thread and returns TRUE on error. done(err) is then called
+     * from the main loop to send the result with bus_to_computer(). Meanwhile the bus keeps polling
+     * and servicing network interrupts. If work() takes longer than SIO_DEFER_BUDGET_MS, the Atari gets
+     * ERROR with len zero bytes instead and done() is never called. Without a free worker, both run
+     * right away.
+     */
+    void sio_defer(uint16_t len, std::function<bool()> work, std::function<void(bool err)> done);
+#endif
+
     /**
      * @brief Return the two aux bytes in cmdFrame as a single 16-bit value, commonly used, for example to retrieve
      * a sector number, for disk, or a number of bytes waiting for the sioNetwork device.
@@ -289,10 +343,15 @@ private:
 
 #ifndef ESP_PLATFORM
     bool _command_processed = false;
+    sioDeferredCommand *_deferred = nullptr; // command waiting for its worker thread
 #endif
 
     void _sio_process_cmd();
     void _sio_process_queue();
+#ifndef ESP_PLATFORM
+    void _sio_check_deferred();
+    void _sio_wait_deferred();
+#endif
 
 public:
     void setup();
@@ -324,6 +383,9 @@ public:
 #ifndef ESP_PLATFORM
     void set_command_processed(bool processed);
     void sio_empty_ack();                                       // for NetSIO, notify hub we are not interested to handle the command
+    bool set_deferred(sioDeferredCommand *cmd);                 // FALSE if another command is still deferred
+    void clear_deferred(sioDeferredCommand *cmd);
+    void wait_deferred(virtualDevice *dev);
 #endif
 
     sioCassette *getCassette() { return _cassetteDev; }
@@ -42,6 +42,13 @@
 
 #define CONFIG_FILEBUFFSIZE 2048
 
+// save() only schedules a write; it happens once changes have been quiet
+// for CONFIG_SAVE_DEBOUNCE_MS, but never later than CONFIG_SAVE_MAX_DELAY_MS
+#define CONFIG_SAVE_DEBOUNCE_MS 2000
+#define CONFIG_SAVE_MAX_DELAY_MS 10000
+// New contents are written here first, then renamed over the config file
+#define CONFIG_TEMP_SUFFIX ".tmp"
+
 #define CONFIG_DEFAULT_SNTPSERVER "pool.ntp.org"
 
 #define PHONEBOOK_CHAR_WIDTH 12
@@ -63,6 +70,7 @@ public:
     {
         MOUNTMODE_READ = 0,
         MOUNTMODE_WRITE,
+        MOUNTMODE_OVERLAY, // read-only image, writes kept in a delta file on the SD card
         MOUNTMODE_INVALID
     };
     typedef mount_modes mount_mode_t;
@@ -295,6 +303,8 @@ public:
 
     void load();
     void save();
+    void flush();
+    void service();
 
     void mark_dirty() { _dirty = true; };
 
@@ -303,6 +313,13 @@ public:
 private:
     bool _dirty = false;
 
+    bool _save_pending = false;
+    uint64_t _save_first_ms = 0;
+    uint64_t _save_due_ms = 0;
+
+    std::string _serialize();
+    void _recover_interrupted_save();
+
     int _read_line(std::stringstream &ss, std::string &line, char abort_if_starts_with = '\0');
 
     void _read_section_general(std::stringstream &ss);
@@ -359,7 +376,8 @@ private:
     };
     const char * _mount_mode_names[MOUNTMODE_INVALID] = {
         "r",
-        "w"
+        "w",
+        "o"
     };
 
 #ifndef ESP_PLATFORM
@@ -67,6 +67,8 @@ Original behavior: read from FLASH first and only read from SD if nothing found
         }
     }
 */
+    _recover_interrupted_save();
+
     /*
 New behavior: copy from SD first if available, then read FLASH.
 */
@@ -92,7 +94,9 @@ New behavior: copy from SD first if available, then read FLASH.
  #else
 // !ESP_PLATFORM
     Debug_printf("fnConfig::load \"%s\"\n", _general.config_file_path.c_str());
-        
+
+    _recover_interrupted_save();
+
     struct stat st;
     if (stat(_general.config_file_path.c_str(), &st) < 0)
     {
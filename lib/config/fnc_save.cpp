@@ -5,28 +5,218 @@
 
 #include <cstring>
 #include <sstream>
+#include <stdio.h>
+#ifndef ESP_PLATFORM
+#include <unistd.h>
+#endif
 
 #include "../../include/debug.h"
 
-/* Save configuration data to FLASH. If SD is mounted, save a backup copy there.
+/* Write data to a temporary file next to path, then rename it over path,
+   so an interrupted write never leaves a truncated config behind.
+*/
+#ifdef ESP_PLATFORM
+static bool _write_atomic(FileSystem *fs, const char *path, const std::string &data)
+{
+    std::string tmp = std::string(path) + CONFIG_TEMP_SUFFIX;
+
+    FILE *fout = fs->file_open(tmp.c_str(), FILE_WRITE);
+    if (fout == nullptr)
+    {
+        Debug_printf("Failed to open \"%s\"\r\n", tmp.c_str());
+        return false;
+    }
+
+    size_t z = fwrite(data.c_str(), 1, data.length(), fout);
+    if (fclose(fout) != 0 || z != data.length())
+    {
+        Debug_printf("Failed to write \"%s\"\r\n", tmp.c_str());
+        fs->remove(tmp.c_str());
+        return false;
+    }
+
+    // SPIFFS and FAT can't rename over an existing file. If we lose power
+    // between these two steps, load() picks up the complete temporary file.
+    if (fs->exists(path))
+        fs->remove(path);
+
+    if (!fs->rename(tmp.c_str(), path))
+    {
+        Debug_printf("Failed to rename \"%s\"\r\n", tmp.c_str());
+        return false;
+    }
+
+    Debug_printf("fnConfig::save wrote %u bytes\r\n", (unsigned)z);
+    return true;
+}
+#else
+static bool _write_atomic(const char *path, const std::string &data)
+{
+    std::string tmp = std::string(path) + CONFIG_TEMP_SUFFIX;
+
+    FILE *fout = fopen(tmp.c_str(), FILE_WRITE);
+    if (fout == nullptr)
+    {
+        Debug_printf("Failed to open \"%s\"\r\n", tmp.c_str());
+        return false;
+    }
+
+    size_t z = fwrite(data.c_str(), 1, data.length(), fout);
+    bool ok = (z == data.length()) && fflush(fout) == 0;
+#if !defined(_WIN32)
+    ok = ok && fsync(fileno(fout)) == 0;
+#endif
+    ok = (fclose(fout) == 0) && ok;
+    if (!ok)
+    {
+        Debug_printf("Failed to write \"%s\"\r\n", tmp.c_str());
+        remove(tmp.c_str());
+        return false;
+    }
+
+    // POSIX rename replaces the target atomically, Windows refuses to
+    if (rename(tmp.c_str(), path) != 0)
+    {
+        remove(path);
+        if (rename(tmp.c_str(), path) != 0)
+        {
+            Debug_printf("Failed to rename \"%s\"\r\n", tmp.c_str());
+            return false;
+        }
+    }
+
+    Debug_printf("fnConfig::save wrote %u bytes\r\n", (unsigned)z);
+    return true;
+}
+#endif
+
+/* Request saving of the configuration. Callers change several settings in
+   a row (e.g. every mount in CONFIG), so the write is deferred until things
+   have been quiet for a moment and done from service() on the main loop.
 */
 void fnConfig::save()
 {
-    int i;
+    if (!_dirty)
+    {
+        Debug_println("fnConfig::save not dirty, not saving");
+        return;
+    }
+
+    uint64_t now = fnSystem.millis();
+
+    if (!_save_pending)
+    {
+        _save_pending = true;
+        _save_first_ms = now;
+    }
+
+    _save_due_ms = now + CONFIG_SAVE_DEBOUNCE_MS;
+    if (_save_due_ms > _save_first_ms + CONFIG_SAVE_MAX_DELAY_MS)
+        _save_due_ms = _save_first_ms + CONFIG_SAVE_MAX_DELAY_MS;
+}
+
+void fnConfig::service()
+{
+    if (_save_pending && fnSystem.millis() >= _save_due_ms)
+        flush();
+}
+
+/* Save configuration data to FLASH now. If SD is mounted, save a backup copy there.
+*/
+void fnConfig::flush()
+{
+    _save_pending = false;
 
 #ifdef ESP_PLATFORM
-    Debug_println("fnConfig::save");
+    Debug_println("fnConfig::flush");
 #else
-    Debug_printf("fnConfig::save \"%s\"\r\n", _general.config_file_path.c_str());
+    Debug_printf("fnConfig::flush \"%s\"\r\n", _general.config_file_path.c_str());
 #endif
 
     if (!_dirty)
+        return;
+
+    std::string result = _serialize();
+
+#ifdef ESP_PLATFORM
+    if (fnConfig::get_general_fnconfig_spifs() == true) //only if spiffs is enabled
     {
-        Debug_println("fnConfig::save not dirty, not saving");
+        Debug_println("FLASH Config Storage: Enabled. Saving config to FLASH");
+        if (!_write_atomic(&fsFlash, CONFIG_FILENAME, result))
+            return;
+    }
+    else
+    {
+        Debug_println("FLASH Config Storage: Disabled. Saving config to SD");
+        if (!_write_atomic(&fnSDFAT, CONFIG_FILENAME, result))
+            return;
+    }
+#else
+// !ESP_PLATFORM
+    if (!_write_atomic(_general.config_file_path.c_str(), result))
         return;
+#endif
+
+    _dirty = false;
+
+#ifdef ESP_PLATFORM
+    // Copy to SD if possible, only when wrote FLASH first
+    if (fnSDFAT.running() && fnConfig::get_general_fnconfig_spifs() == true)
+    {
+        Debug_println("Attempting config copy to SD");
+        if (!_write_atomic(&fnSDFAT, CONFIG_FILENAME, result))
+            Debug_println("Failed to copy config to SD");
     }
+#endif
+}
+
+/* Finish a write that was interrupted between removing the old config
+   and renaming the new one into place, or drop a partial temporary file.
+*/
+#ifdef ESP_PLATFORM
+static void _recover_file(FileSystem *fs, const char *path)
+{
+    std::string tmp = std::string(path) + CONFIG_TEMP_SUFFIX;
+
+    if (!fs->exists(tmp.c_str()))
+        return;
+
+    if (fs->exists(path))
+        fs->remove(tmp.c_str());
+    else
+        fs->rename(tmp.c_str(), path);
+}
+#else
+static void _recover_file(const char *path)
+{
+    std::string tmp = std::string(path) + CONFIG_TEMP_SUFFIX;
+
+    if (access(tmp.c_str(), F_OK) != 0)
+        return;
+
+    if (access(path, F_OK) == 0)
+        remove(tmp.c_str());
+    else
+        rename(tmp.c_str(), path);
+}
+#endif
+
+void fnConfig::_recover_interrupted_save()
+{
+#ifdef ESP_PLATFORM
+    _recover_file(&fsFlash, CONFIG_FILENAME);
+    if (fnSDFAT.running())
+        _recover_file(&fnSDFAT, CONFIG_FILENAME);
+#else
+    _recover_file(_general.config_file_path.c_str());
+#endif
+}
+
+std::string fnConfig::_serialize()
+{
+    int i;
 
-    // We're going to write a stringstream so that we have only one write to file at the end
+    // Build the whole file in memory so that we have only one write to file at the end
     std::stringstream ss;
 
 #define LINETERM "\r\n"
@@ -199,55 +389,5 @@ void fnConfig::save()
     ss << "flowcontrol=" << _bos.flowcontrol << LINETERM;
 #endif
 
-#ifdef ESP_PLATFORM
-    // Write the results out
-    FILE *fout = NULL;
-    if (fnConfig::get_general_fnconfig_spifs() == true) //only if spiffs is enabled
-    {
-        Debug_println("FLASH Config Storage: Enabled. Saving config to FLASH");
-        if ( !(fout = fsFlash.file_open(CONFIG_FILENAME, "w")))
-        {
-            Debug_println("Failed to Open config on FLASH");
-            return;
-        }
-    }
-    else
-    {
-        Debug_println("FLASH Config Storage: Disabled. Saving config to SD");
-        if ( !(fout = fnSDFAT.file_open(CONFIG_FILENAME, "w")))
-        {
-            Debug_println("Failed to Open config on SD");
-            return;
-        }
-    }
-#else
-// !ESP_PLATFORM
-    // Write the results out
-    FILE *fout = fopen(_general.config_file_path.c_str(), FILE_WRITE);
-    if (fout == nullptr)
-    {
-        Debug_printf("Failed to open config file\r\n");
-        return;
-    }
-#endif
-    std::string result = ss.str();
-    size_t z = fwrite(result.c_str(), 1, result.length(), fout);
-    (void)z; // Get around unused var
-    Debug_printf("fnConfig::save wrote %u bytes\r\n", (unsigned)z);
-    fclose(fout);
-    
-    _dirty = false;
-
-#ifdef ESP_PLATFORM
-    // Copy to SD if possible, only when wrote FLASH first 
-    if (fnSDFAT.running() && fnConfig::get_general_fnconfig_spifs() == true)
-    {
-        Debug_println("Attempting config copy to SD");
-        if (0 == fnSystem.copy_file(&fsFlash, CONFIG_FILENAME, &fnSDFAT, CONFIG_FILENAME))
-        {
-            Debug_println("Failed to copy config to SD");
-            return;
-        }
-    }
-#endif
+    return ss.str();
 }
@@ -360,7 +360,7 @@ uint8_t iwmFuji::iwm_ctrl_disk_image_mount() // SP CTRL command
 	Debug_printf("\r\nSelecting '%s' from host #%u as %s on D%u:\n", disk.filename, disk.host_slot, flag, deviceSlot + 1);
 
 	disk.disk_dev.host = &host;
-	disk.fileh = host.fnfile_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+	disk.fileh = host.fnfile_open_image(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
 	if (disk.fileh == nullptr)
 	{
@@ -479,7 +479,7 @@ bool iwmFuji::mount_all()
 
 			Debug_printf("Selecting '%s' from host #%u as %s on D%u:\n", disk.filename, disk.host_slot, flag, i + 1);
 
-			disk.fileh = host.fnfile_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+			disk.fileh = host.fnfile_open_image(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
 			if (disk.fileh == nullptr)
 			{
@@ -34,44 +34,33 @@ mediatype_t macFloppy::mount(FILE *f, const char *filename, uint32_t disksize, m
     device_active = (id() == '4');
     _disk = new MediaTypeMOOF();
     mt = ((MediaTypeMOOF *)_disk)->mount(f);
-    track_pos = 0;
-    old_pos = 2; // makde different to force change_track buffer copy
-    change_track(0); // initialize rmt buffer
-    change_track(1); // initialize rmt buffer
-    switch (_disk->num_sides)
-    {
-    case 1:
-      fnUartBUS.write('s');
-      fnUartBUS.write(track_pos | 128);
-      break;
-    case 2:
-      fnUartBUS.write('d');
-      fnUartBUS.write(track_pos | 128);
-    default:
-      break;
-    }
+    mount_floppy();
     break;
   case MEDIATYPE_DSK:
-    Debug_printf("\nMounting Media Type DSK for DCD");
-    device_active = true;
-    _disk = new MediaTypeDCD();
-    mt = ((MediaTypeDCD *)_disk)->mount(f);
-    MAC.add_dcd_mount(id());
-    break;
   case MEDIATYPE_DC42:
-    Debug_printf("\nMounting Media Type DC42 for DCD");
+    if (id() == '4')
+    {
+      // 400K/800K sector images in the floppy drive are GCR encoded track by track
+      MediaTypeDSK *dsk = new MediaTypeDSK(disk_type == MEDIATYPE_DC42 ? 0x54 : 0);
+      mt = dsk->mount(f, disksize);
+      if (mt != MEDIATYPE_UNKNOWN)
+      {
+        Debug_printf("\nMounting Media Type %s as GCR floppy", disk_type == MEDIATYPE_DC42 ? "DC42" : "DSK");
+        device_active = true;
+        _disk = dsk;
+        mount_floppy();
+        break;
+      }
+      // f is still open, only the track cache goes
+      dsk->unmount();
+      delete dsk;
+    }
+    Debug_printf("\nMounting Media Type %s for DCD", disk_type == MEDIATYPE_DC42 ? "DC42" : "DSK");
     device_active = true;
-    _disk = new MediaTypeDCD(0x54); // offset of image data in Disk Copy 4.2 file
+    _disk = new MediaTypeDCD(disk_type == MEDIATYPE_DC42 ? 0x54 : 0); // offset of image data in Disk Copy 4.2 file
     mt = ((MediaTypeDCD *)_disk)->mount(f);
     MAC.add_dcd_mount(id());
     break;
-  // case MEDIATYPE_DSK:
-  //   Debug_printf("\nMounting Media Type DSK");
-  //   device_active = true;
-  //   _disk = new MediaTypeDSK();
-  //   mt = ((MediaTypeDSK *)_disk)->mount(f);
-  //   change_track(0); // initialize spi buffer
-  //   break;
   default:
     Debug_printf("\nMedia Type UNKNOWN - no mount in floppy.cpp");
     device_active = false;
@@ -81,6 +70,26 @@ mediatype_t macFloppy::mount(FILE *f, const char *filename, uint32_t disksize, m
   return mt;
 }
 
+void macFloppy::mount_floppy()
+{
+  track_pos = 0;
+  old_pos = 2; // makde different to force change_track buffer copy
+  change_track(0); // initialize rmt buffer
+  change_track(1); // initialize rmt buffer
+  switch (_disk->num_sides)
+  {
+  case 1:
+    fnUartBUS.write('s');
+    fnUartBUS.write(track_pos | 128);
+    break;
+  case 2:
+    fnUartBUS.write('d');
+    fnUartBUS.write(track_pos | 128);
+  default:
+    break;
+  }
+}
+
 // void macFloppy::init()
 // {
 //   track_pos = 80;
@@ -49,6 +49,7 @@ protected:
     uint32_t _disk_size_in_blocks;
 
     void dcd_status(uint8_t* buffer);
+    void mount_floppy();
 
 public:
     bool readonly;
@@ -50,9 +50,22 @@ void sioDisk::sio_read()
         return;
     }
 
+    uint16_t sectornum = UINT16_FROM_HILOBYTES(cmdFrame.aux2, cmdFrame.aux1);
+
+#ifndef ESP_PLATFORM
+    // Sectors from a TNFS/SMB/FTP host are fetched on a worker thread, the bus keeps going meanwhile
+    if (host != nullptr && host->get_type() != HOSTTYPE_LOCAL)
+    {
+        sio_defer(_disk->sector_size(sectornum),
+                  [this, sectornum]() { return _disk->read(sectornum, &_readcount); },
+                  [this](bool err) { bus_to_computer(_disk->_disk_sectorbuff, _readcount, err); });
+        return;
+    }
+#endif
+
     uint16_t readcount;
 
-    bool err = _disk->read(UINT16_FROM_HILOBYTES(cmdFrame.aux2, cmdFrame.aux1), &readcount);
+    bool err = _disk->read(sectornum, &readcount);
 
     // Send result to Atari
     bus_to_computer(_disk->_disk_sectorbuff, readcount, err);
@@ -223,6 +236,10 @@ mediatype_t sioDisk::mount(fnFile *f, const char *filename, uint32_t disksize, m
     //  MediaType::discover_disktype(filename) can detect CAS and WAV files
     Debug_print("disk MOUNT\n");
 
+#ifndef ESP_PLATFORM
+    SIO.wait_deferred(this);
+#endif
+
     // Destroy any existing MediaType
     if (_disk != nullptr)
     {
@@ -295,6 +312,10 @@ void sioDisk::unmount()
 {
     Debug_print("disk UNMOUNT\n");
 
+#ifndef ESP_PLATFORM
+    SIO.wait_deferred(this);
+#endif
+
     if (_disk != nullptr)
     {
         _disk->unmount();
@@ -9,6 +9,9 @@ class sioDisk : public virtualDevice
 {
 private:
     MediaType *_disk = nullptr;
+#ifndef ESP_PLATFORM
+    uint16_t _readcount = 0; // result of a deferred read
+#endif
 
     void sio_read();
     void sio_write(bool verify);
@@ -28,6 +31,12 @@ public:
     void unmount();
     bool write_blank(fnFile *f, uint16_t sectorSize, uint16_t numSectors);
 
+    // Copy-on-write mode, all return TRUE if an error condition occurred
+    bool overlay_open(FileSystem *fs, const char *path) { return _disk == nullptr || _disk->overlay_open(fs, path); };
+    bool overlay_commit() { return _disk == nullptr || _disk->overlay_commit(); };
+    bool overlay_discard() { return _disk == nullptr || _disk->overlay_discard(); };
+    bool has_overlay() { return _disk != nullptr && _disk->has_overlay(); };
+
     mediatype_t disktype() { return _disk == nullptr ? MEDIATYPE_UNKNOWN : _disk->_disktype; };
 
     ~sioDisk();
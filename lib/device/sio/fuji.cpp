@@ -454,7 +454,7 @@ void sioFuji::sio_disk_image_mount()
     // TODO: Refactor along with mount disk image.
     disk.disk_dev.host = &host;
 
-    disk.fileh = host.fnfile_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+    disk.fileh = host.fnfile_open_image(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
     if (disk.fileh == nullptr)
     {
@@ -472,6 +472,9 @@ void sioFuji::sio_disk_image_mount()
     // And now mount it
     disk.disk_type = disk.disk_dev.mount(disk.fileh, disk.filename, disk.disk_size);
 
+    if (options == DISK_ACCESS_MODE_OVERLAY)
+        _open_disk_overlay(deviceSlot);
+
     sio_complete();
 }
 #else
@@ -514,7 +517,7 @@ int sioFuji::sio_disk_image_mount(bool siomode, int slot)
     // TODO: Refactor along with mount disk image.
     disk.disk_dev.host = &host;
 
-    disk.fileh = host.fnfile_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+    disk.fileh = host.fnfile_open_image(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
     if (disk.fileh == nullptr)
     {
@@ -531,10 +534,84 @@ int sioFuji::sio_disk_image_mount(bool siomode, int slot)
     // And now mount it
     disk.disk_type = disk.disk_dev.mount(disk.fileh, disk.filename, disk.disk_size);
 
+    if (options == DISK_ACCESS_MODE_OVERLAY)
+        _open_disk_overlay(deviceSlot);
+
     return _on_ok(siomode);
 }
 #endif
 
+/*
+ Overlay mode: the image stays read-only and the sectors this FujiNet writes go
+ to a delta file on the SD card, named after the host and image path so the
+ same delta comes back the next time that image is mounted in overlay mode.
+ If there's no delta the disk is simply read-only.
+*/
+// Returns TRUE if an error condition occurred
+bool sioFuji::_open_disk_overlay(uint8_t deviceSlot)
+{
+    fujiDisk &disk = _fnDisks[deviceSlot];
+
+    if (fnSDFAT.running() == false)
+    {
+        Debug_println("No SD mounted - can't keep an overlay, disk is read-only");
+        return true;
+    }
+
+    // Two deltas for one file would write over each other
+    for (int i = 0; i < MAX_DISK_DEVICES; i++)
+    {
+        if (i != deviceSlot && _fnDisks[i].host_slot == disk.host_slot &&
+            strcmp(_fnDisks[i].filename, disk.filename) == 0 && _fnDisks[i].disk_dev.has_overlay())
+        {
+            Debug_printf("Image already has an overlay on D%d:, disk is read-only\n", i + 1);
+            return true;
+        }
+    }
+
+    std::string key = std::string(_fnHosts[disk.host_slot].get_hostname()) + ":" + disk.filename;
+    char path[40];
+    snprintf(path, sizeof(path), "/FujiNet/overlay/%08lx.ovl", (unsigned long)(hash_djb2a(key) & 0xFFFFFFFF));
+
+    fnSDFAT.create_path("/FujiNet/overlay");
+
+    return disk.disk_dev.overlay_open(&fnSDFAT, path);
+}
+
+// Write a device's overlay into its image, aux1 = device slot
+void sioFuji::sio_overlay_commit()
+{
+    uint8_t deviceSlot = cmdFrame.aux1;
+
+    Debug_printf("Fuji cmd: OVERLAY COMMIT 0x%02X\n", deviceSlot);
+
+    if (!_validate_device_slot(deviceSlot, "sio_overlay_commit") ||
+        _fnDisks[deviceSlot].disk_dev.overlay_commit())
+    {
+        sio_error();
+        return;
+    }
+
+    sio_complete();
+}
+
+// Throw away a device's overlay, aux1 = device slot
+void sioFuji::sio_overlay_discard()
+{
+    uint8_t deviceSlot = cmdFrame.aux1;
+
+    Debug_printf("Fuji cmd: OVERLAY DISCARD 0x%02X\n", deviceSlot);
+
+    if (!_validate_device_slot(deviceSlot, "sio_overlay_discard") ||
+        _fnDisks[deviceSlot].disk_dev.overlay_discard())
+    {
+        sio_error();
+        return;
+    }
+
+    sio_complete();
+}
+
 // Toggle boot config on/off, aux1=0 is disabled, aux1=1 is enabled
 void sioFuji::sio_set_boot_config()
 {
@@ -720,7 +797,7 @@ int sioFuji::mount_all(bool siomode)
             Debug_printf("Selecting '%s' from host #%u as %s on D%u:\n",
                          disk.filename, disk.host_slot, flag, i + 1);
 
-            disk.fileh = host.fnfile_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+            disk.fileh = host.fnfile_open_image(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
             if (disk.fileh == nullptr)
             {
@@ -745,6 +822,9 @@ int sioFuji::mount_all(bool siomode)
 
             // And now mount it
             disk.disk_type = disk.disk_dev.mount(disk.fileh, disk.filename, disk.disk_size);
+
+            if (disk.access_mode == DISK_ACCESS_MODE_OVERLAY)
+                _open_disk_overlay(i);
         }
     }
 
@@ -1864,6 +1944,8 @@ void sioFuji::_populate_slots_from_config()
                 _fnDisks[i].host_slot = Config.get_mount_host_slot(i);
                 if (Config.get_mount_mode(i) == fnConfig::mount_modes::MOUNTMODE_WRITE)
                     _fnDisks[i].access_mode = DISK_ACCESS_MODE_WRITE;
+                else if (Config.get_mount_mode(i) == fnConfig::mount_modes::MOUNTMODE_OVERLAY)
+                    _fnDisks[i].access_mode = DISK_ACCESS_MODE_OVERLAY;
                 else
                     _fnDisks[i].access_mode = DISK_ACCESS_MODE_READ;
             }
@@ -1896,7 +1978,9 @@ void sioFuji::_populate_config_from_slots()
             Config.clear_mount(i);
         else
             Config.store_mount(i, _fnDisks[i].host_slot, _fnDisks[i].filename,
-                               _fnDisks[i].access_mode == DISK_ACCESS_MODE_WRITE ? fnConfig::mount_modes::MOUNTMODE_WRITE : fnConfig::mount_modes::MOUNTMODE_READ);
+                               _fnDisks[i].access_mode == DISK_ACCESS_MODE_WRITE ? fnConfig::mount_modes::MOUNTMODE_WRITE :
+                               _fnDisks[i].access_mode == DISK_ACCESS_MODE_OVERLAY ? fnConfig::mount_modes::MOUNTMODE_OVERLAY :
+                               fnConfig::mount_modes::MOUNTMODE_READ);
     }
 }
 
@@ -2433,6 +2517,74 @@ void sioFuji::sio_hash_clear()
     sio_complete();
 }
 
+#ifndef ESP_PLATFORM
+/*
+ Searches the image index for file names containing the query
+ aux1 = host slot to search, 0xFF for all
+ aux2 = 1 to find names starting with the query instead
+*/
+void sioFuji::sio_index_search()
+{
+    char query[MAX_FILENAME_LEN];
+    uint8_t hostSlot = cmdFrame.aux1;
+    bool prefix = cmdFrame.aux2 & 0x01;
+
+    uint8_t ck = bus_to_peripheral((uint8_t *)query, sizeof(query));
+    query[sizeof(query) - 1] = '\0';
+
+    Debug_printf("Fuji cmd: INDEX SEARCH %uh \"%s\"%s\n", hostSlot, query, prefix ? " (prefix)" : "");
+
+    if (sio_checksum((uint8_t *)query, sizeof(query)) != ck)
+    {
+        sio_error();
+        return;
+    }
+
+    if (hostSlot != 0xFF && !_validate_host_slot(hostSlot))
+    {
+        sio_error();
+        return;
+    }
+
+    imageIndex.search(query, prefix, hostSlot == 0xFF ? -1 : hostSlot, INDEX_MAX_RESULTS, _index_results);
+    sio_complete();
+}
+
+/*
+ Returns one result of the last INDEX SEARCH, aux1/aux2 = result number
+ Bytes 0-1 number of results, 2 host slot (0xFF if none), 3-6 size,
+ 7-10 modified time, 11-14 media type, then the path
+*/
+void sioFuji::sio_index_result()
+{
+    uint8_t response[MAX_FILENAME_LEN];
+    memset(response, 0, sizeof(response));
+    uint16_t n = sio_get_aux();
+    uint16_t count = _index_results.size();
+
+    Debug_printf("Fuji cmd: INDEX RESULT %u of %u\n", n, count);
+
+    response[0] = count & 0xFF;
+    response[1] = count >> 8;
+
+    // Result 0 of no results still returns the count
+    if (n >= count)
+    {
+        bus_to_computer(response, sizeof(response), n != 0);
+        return;
+    }
+
+    const fujiImageIndex::result &r = _index_results[n];
+    response[2] = r.host_slot < 0 ? 0xFF : r.host_slot;
+    memcpy(&response[3], &r.size, sizeof(uint32_t));
+    memcpy(&response[7], &r.modified, sizeof(uint32_t));
+    strlcpy((char *)&response[11], r.type, 4);
+    strlcpy((char *)&response[15], r.path.c_str(), sizeof(response) - 15);
+
+    bus_to_computer(response, sizeof(response), false);
+}
+#endif
+
 void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
 {
     cmdFrame.commanddata = commanddata;
@@ -2530,6 +2682,14 @@ void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
         sio_ack();
         sio_disk_image_umount();
         break;
+    case FUJICMD_OVERLAY_COMMIT:
+        sio_ack();
+        sio_overlay_commit();
+        break;
+    case FUJICMD_OVERLAY_DISCARD:
+        sio_ack();
+        sio_overlay_discard();
+        break;
     case FUJICMD_GET_ADAPTERCONFIG:
         sio_ack();
         sio_get_adapter_config();
@@ -2658,6 +2818,16 @@ void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
         sio_ack();
         sio_hash_clear();
         break;
+#ifndef ESP_PLATFORM
+    case FUJICMD_INDEX_SEARCH:
+        sio_late_ack();
+        sio_index_search();
+        break;
+    case FUJICMD_INDEX_RESULT:
+        sio_ack();
+        sio_index_result();
+        break;
+#endif
     case FUJICMD_RANDOM_NUMBER:
         sio_ack();
         sio_random_number();
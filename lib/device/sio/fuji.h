@@ -21,6 +21,10 @@
 
 #include "hash.h"
 
+#ifndef ESP_PLATFORM
+#include "fujiImageIndex.h"
+#endif
+
 #define MAX_HOSTS 8
 #define MAX_DISK_DEVICES 8
 #define MAX_NETWORK_DEVICES 8
@@ -106,6 +110,8 @@ private:
     int _on_error(bool siomode, int rc=-1);
 #endif
 
+    bool _open_disk_overlay(uint8_t deviceSlot);
+
     appkey _current_appkey;
 
     mbedtls_md5_context _md5;
@@ -114,6 +120,10 @@ private:
     mbedtls_sha512_context _sha512;
 
     Hash::Algorithm algorithm = Hash::Algorithm::UNKNOWN;
+
+#ifndef ESP_PLATFORM
+    std::vector<fujiImageIndex::result> _index_results; // of the last INDEX SEARCH
+#endif
     
 protected:
     void sio_reset_fujinet();          // 0xFF
@@ -138,6 +148,8 @@ protected:
     void sio_read_device_slots();      // 0xF2
     void sio_write_device_slots();     // 0xF1
     void sio_enable_udpstream();       // 0xF0
+    void sio_overlay_commit();         // 0xEC
+    void sio_overlay_discard();        // 0xEB
     void sio_net_get_wifi_enabled();   // 0xEA
 #ifdef ESP_PLATFORM
     void sio_disk_image_umount();      // 0xE9
@@ -177,6 +189,10 @@ protected:
     void sio_hash_output();            // 0xC5
     void sio_get_adapter_config_extended(); // 0xC4
     void sio_hash_clear();             // 0xC2
+#ifndef ESP_PLATFORM
+    void sio_index_search();           // 0xC1
+    void sio_index_result();           // 0xC0
+#endif
 
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
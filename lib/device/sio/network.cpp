@@ -279,6 +279,22 @@ void sioNetwork::sio_read()
         return;
     }
 
+#ifndef ESP_PLATFORM
+    // Nothing buffered yet, the protocol may block on the network, so read on a worker thread.
+    // If the Atari gets an ERROR meanwhile, the data stays in receiveBuffer for the next read.
+    if (channelMode == PROTOCOL && receiveBuffer->length() < num_bytes)
+    {
+        sio_defer(num_bytes,
+                  [this, num_bytes]() { return sio_read_channel(num_bytes); },
+                  [this, num_bytes](bool err) {
+                      bus_to_computer((uint8_t *)receiveBuffer->data(), num_bytes, err);
+                      receiveBuffer->erase(0, num_bytes);
+                      receiveBuffer->shrink_to_fit();
+                  });
+        return;
+    }
+#endif
+
     // Do the channel read
     err = sio_read_channel(num_bytes);
 
@@ -9,6 +9,7 @@
 #include "../../include/debug.h"
 
 #include "fnSystem.h"
+#include "utils.h"
 
 /*
 ftpparse(&fp,buf,len) tries to parse one line of LIST output.
@@ -636,6 +637,100 @@ int ftpparse(struct ftpparse *fp, char *buf, int len)
     return 0;
 }
 
+/* Sleeps until one of the connections has something to read, or got closed.
+   Either one may be nullptr. Returns TRUE on timeout.
+*/
+static bool wait_readable(fnTcpClient *a, fnTcpClient *b, int timeout_ms)
+{
+    if ((a != nullptr && a->available() > 0) || (b != nullptr && b->available() > 0))
+        return false;
+
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    int maxfd = -1;
+    for (fnTcpClient *c : {a, b})
+    {
+        if (c == nullptr || c->fd() < 0)
+            continue;
+        FD_SET(c->fd(), &readfds);
+        if (c->fd() > maxfd)
+            maxfd = c->fd();
+    }
+    if (maxfd < 0)
+        return true;
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    return select(maxfd + 1, &readfds, nullptr, nullptr, &tv) <= 0;
+}
+
+// "YYYYMMDDHHMMSS[.sss]" in UTC, as used by MLSD and MDTM. Returns 0 if invalid
+static time_t parse_ftp_time(const char *s)
+{
+    const int widths[6] = {4, 2, 2, 2, 2, 2};
+    long v[6];
+    for (int i = 0; i < 6; i++)
+    {
+        v[i] = 0;
+        for (int j = 0; j < widths[i]; j++, s++)
+        {
+            if (*s < '0' || *s > '9')
+                return 0;
+            v[i] = v[i] * 10 + (*s - '0');
+        }
+    }
+
+    // days since 1970-01-01 of the civil date
+    long y = v[0] - (v[1] <= 2);
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (v[1] + (v[1] > 2 ? -3 : 9)) + 2) / 5 + v[2] - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = era * 146097 + doe - 719468;
+
+    return (time_t)(days * 86400 + v[3] * 3600 + v[4] * 60 + v[5]);
+}
+
+/* Parses one line of MLSD output: "type=file;size=1024;modify=20230101120000; NAME.ATR"
+   Returns TRUE if the line doesn't hold a file or directory.
+*/
+static bool parse_mlsd_line(const string &line, ftp_dir_entry &entry)
+{
+    size_t facts_end = line.find(' ');
+    if (facts_end == string::npos || facts_end + 1 >= line.length())
+        return true;
+
+    entry.name = line.substr(facts_end + 1);
+    entry.size = 0;
+    entry.is_dir = false;
+    entry.modified = 0;
+
+    size_t pos = 0;
+    while (pos < facts_end)
+    {
+        size_t end = line.find(';', pos);
+        if (end == string::npos || end > facts_end)
+            end = facts_end;
+        const char *fact = line.c_str() + pos;
+
+        if (strncasecmp(fact, "type=", 5) == 0)
+        {
+            if (strncasecmp(fact + 5, "cdir", 4) == 0 || strncasecmp(fact + 5, "pdir", 4) == 0)
+                return true; // "." and ".."
+            entry.is_dir = strncasecmp(fact + 5, "dir", 3) == 0;
+        }
+        else if (strncasecmp(fact, "size=", 5) == 0)
+            entry.size = atol(fact + 5);
+        else if (strncasecmp(fact, "modify=", 7) == 0)
+            entry.modified = parse_ftp_time(fact + 7);
+
+        pos = end + 1;
+    }
+    return false;
+}
+
 fnFTP::fnFTP()
 {
     _stor = false;
@@ -744,6 +839,8 @@ bool fnFTP::login(const string &_username, const string &_password, const string
         Debug_printf("Could not set image type. Ignoring.\r\n");
     }
 
+    get_features();
+
     return false;
 }
 
@@ -790,16 +887,8 @@ bool fnFTP::open_file(string path, bool stor)
         return true;
     }
 
-    int retries = 2;
-    while (get_data_port())
+    if (open_data_port())
     {
-        if ((is_negative_permanent_reply() || is_negative_transient_reply()) && retries--)
-        {
-            // recovery attempt
-            fnSystem.delay(2000);
-            if (!reconnect())
-                continue; // successfully reconnected
-        }
         Debug_printf("fnFTP::open_file(%s, %s) could not get data port. Aborting.\n", path.c_str(), stor ? "STOR" : "RETR");
         return true;
     }
@@ -807,6 +896,7 @@ bool fnFTP::open_file(string path, bool stor)
     // Do command
     if (stor == true)
     {
+        clear_dircache();
         STOR(path);
     }
     else
@@ -842,116 +932,217 @@ bool fnFTP::open_directory(string path, string pattern)
         return true;
     }
 
-    int retries = 2;
-    while (get_data_port())
+    _dir = nullptr;
+    _dir_pos = 0;
+    _dir_pattern = pattern;
+
+    // Reuse a recent listing of the same directory
+    unsigned long now = fnSystem.millis();
+    for (auto it = _dircache.begin(); it != _dircache.end(); ++it)
     {
-        if ((is_negative_permanent_reply() || is_negative_transient_reply()) && retries--)
+        if (it->path != path)
+            continue;
+        if (now - it->fetched_ms < FTP_DIRCACHE_TTL_MS)
         {
-            // recovery attempt
-            fnSystem.delay(2000);
-            if (!reconnect())
-                continue; // successfully reconnected
+            Debug_printf("fnFTP::open_directory(%s%s) - cached\r\n", path.c_str(), pattern.c_str());
+            _dircache.splice(_dircache.begin(), _dircache, it);
+            _dir = &_dircache.front();
+            return false;
         }
-        Debug_printf("fnFTP::open_directory(%s%s) could not get data port, aborting.\n", path.c_str(), pattern.c_str());
-        return true;
+        _dircache.erase(it);
+        break;
     }
 
-    // perform LIST
-    LIST(path, pattern);
-
-    if (parse_response())
+    dir_listing listing;
+    if (fetch_directory(path, listing.entries))
     {
-        Debug_printf("fnFTP::open_directory(%s%s) Timed out waiting for 150 response.\r\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::open_directory(%s%s) failed\r\n", path.c_str(), pattern.c_str());
         return true;
     }
+    listing.path = path;
+    listing.fetched_ms = fnSystem.millis();
 
-    Debug_printf("fnFTP::open_directory(%s%s) - %s\r\n", path.c_str(), pattern.c_str(), controlResponse.c_str());
+    _dircache.push_front(std::move(listing));
+    if (_dircache.size() > FTP_DIRCACHE_DIRS)
+        _dircache.pop_back();
+    _dir = &_dircache.front();
 
-    if (is_positive_preliminary_reply() && is_filesystem_related())
+    return false; // all good.
+}
+
+bool fnFTP::fetch_directory(const string &path, std::vector<ftp_dir_entry> &entries)
+{
+    bool use_mlsd = _has_mlsd;
+
+    while (true)
     {
-        // Do nothing.
-        Debug_printf("Got our 150\r\n");
+        if (open_data_port())
+        {
+            Debug_printf("fnFTP::fetch_directory(%s) could not get data port, aborting.\n", path.c_str());
+            return true;
+        }
+
+        if (use_mlsd)
+            MLSD(path);
+        else
+            LIST(path, "");
+
+        if (parse_response())
+        {
+            Debug_printf("fnFTP::fetch_directory(%s) Timed out waiting for 150 response.\r\n", path.c_str());
+            return true;
+        }
+
+        if (is_positive_preliminary_reply())
+            break;
+
+        data->stop();
+        if (!use_mlsd)
+        {
+            Debug_printf("Didn't get our 150: %s\r\n", controlResponse.c_str());
+            return true;
+        }
+        // Announced, but not for this path or not really working
+        Debug_printf("MLSD refused (%s), falling back to LIST\r\n", controlResponse.c_str());
+        use_mlsd = _has_mlsd = false;
     }
-    else
+
+    string listing;
+    if (read_data_connection(listing))
     {
-        Debug_printf("Didn't get our 150\r\n");
+        Debug_printf("fnFTP::fetch_directory(%s) transfer failed.\r\n", path.c_str());
         return true;
     }
 
-    uint8_t buf[256];
+    entries.clear();
+    std::istringstream lines(listing);
+    string line;
+    while (getline(lines, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
 
-    // if (buf == nullptr)
-    // {
-    //     Debug_printf("fnFTP::open_directory() - Could not allocate 2048 bytes.\r\n");
-    //     return true;
-    // }
+        ftp_dir_entry entry;
+        if (use_mlsd)
+        {
+            if (parse_mlsd_line(line, entry))
+                continue;
+        }
+        else
+        {
+            struct ftpparse parse;
+            if (ftpparse(&parse, (char *)line.c_str(), line.length()) == 0)
+                continue; // e.g. "total 42"
+            entry.name = string(parse.name, parse.namelen);
+            entry.size = parse.size;
+            entry.is_dir = (parse.flagtrycwd == 1);
+            entry.modified = (parse.mtimetype == FTPPARSE_MTIME_UNKNOWN) ? 0 : parse.mtime;
+        }
+        entries.push_back(entry);
+    }
+    Debug_printf("fnFTP::fetch_directory(%s) - %u entries via %s\r\n", path.c_str(), (unsigned)entries.size(), use_mlsd ? "MLSD" : "LIST");
 
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
+    return false;
+}
+
+bool fnFTP::read_data_connection(string &out)
+{
+    uint8_t buf[256];
     bool got_response = false;
+    bool timeout = false;
 
-    // Reset buffer
-    dirBuffer.str("");
-    dirBuffer.clear();
-    // Retrieve listing into buffer.
-    do
+    out.clear();
+    while (true)
     {
-        if (data->available() == 0)
-        {
-            if (--tmout_counter == 0)
-            {
-                // no data & no control message
-                Debug_printf("fnFTP::open_directory - Timeout\r\n");
-                break;
-            }
-            fnSystem.delay(50); // wait for more data or control message
-        }
-        if (data->available() > 0)
+        int len = data->available();
+        if (len > 0)
         {
-            Debug_printf("Retrieving directory list\r\n");
-            while (data->available())
-            {
-                int len = data->available();
-                memset(buf, 0, sizeof(buf));
-                int num_read = data->read(buf, len > sizeof(buf) ? sizeof(buf) : len);
-                dirBuffer << string((const char *)buf, num_read);
-            }
-            tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
+            int num_read = data->read(buf, len > (int)sizeof(buf) ? sizeof(buf) : len);
+            if (num_read > 0)
+                out.append((const char *)buf, num_read);
+            continue;
         }
         if (got_response == false && control->available())
         {
             got_response = !parse_response();
+            if (got_response && !is_positive_completion_reply())
+                break; // transfer aborted
+        }
+        if (!data->connected())
+            break;
+        // wait for more data or control message
+        if (wait_readable(data, got_response ? nullptr : control, FTP_TIMEOUT))
+        {
+            Debug_printf("fnFTP::read_data_connection - Timeout\r\n");
+            timeout = true;
+            break;
         }
-    } while (data->available() > 0 || data->connected());
+    }
 
     data->stop();
 
-    if (tmout_counter == 0 || (got_response == false && parse_response()))
+    if (timeout || (got_response == false && parse_response()))
     {
-        Debug_printf("fnFTP::open_directory(%s%s) Timed out waiting for 226 response.\r\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::read_data_connection - Timed out waiting for 226 response.\r\n");
         return true;
     }
 
-    return false; // all good.
+    return !is_positive_completion_reply();
 }
 
 bool fnFTP::read_directory(string &name, long &filesize, bool &is_dir)
 {
-    string line;
-    struct ftpparse parse;
+    time_t modified;
+    return read_directory(name, filesize, is_dir, modified);
+}
+
+bool fnFTP::read_directory(string &name, long &filesize, bool &is_dir, time_t &modified)
+{
+    if (_dir == nullptr)
+        return true;
+
+    while (_dir_pos < _dir->entries.size())
+    {
+        const ftp_dir_entry &entry = _dir->entries[_dir_pos++];
+        if (!_dir_pattern.empty() && !util_wildcard_match(entry.name.c_str(), _dir_pattern.c_str()))
+            continue;
+
+        name = entry.name;
+        filesize = entry.size;
+        is_dir = entry.is_dir;
+        modified = entry.modified;
+        Debug_printf("Name: %s filesize: %lu\r\n", name.c_str(), filesize);
+        return false;
+    }
+    return true;
+}
+
+bool fnFTP::file_size(string path, long &filesize)
+{
+    if (!_has_size || !control->connected())
+        return true;
+
+    SIZE(path);
+    if (parse_response() || _statusCode != 213)
+        return true;
+
+    filesize = atol(controlResponse.c_str() + 4);
+    return false;
+}
 
-    getline(dirBuffer, line);
+bool fnFTP::file_modified(string path, time_t &modified)
+{
+    if (!_has_mdtm || !control->connected())
+        return true;
 
-    if (line.empty())
+    MDTM(path);
+    if (parse_response() || _statusCode != 213)
         return true;
 
-    Debug_printf("fnFTP::read_directory - %s\r\n",line.c_str());
-    line = line.substr(0, line.size() - 1);
-    ftpparse(&parse, (char *)line.c_str(), line.length());
-    name = string(parse.name ? parse.name : "???");
-    filesize = parse.size;
-    is_dir = (parse.flagtrycwd == 1);
-    Debug_printf("Name: %s filesize: %lu\r\n", name.c_str(), filesize);
-    return dirBuffer.eof();
+    modified = parse_ftp_time(controlResponse.c_str() + 4);
+    return modified == 0;
 }
 
 bool fnFTP::read_file(uint8_t *buf, unsigned short len)
@@ -1016,6 +1207,12 @@ bool fnFTP::data_connected()
     return _expect_control_response || data->connected();
 }
 
+bool fnFTP::wait_data(int timeout_ms)
+{
+    return wait_readable(data->connected() ? data : nullptr,
+                         _expect_control_response ? control : nullptr, timeout_ms);
+}
+
 /** FTP UTILITY FUNCTIONS **********************************************************************/
 
 bool fnFTP::parse_response()
@@ -1025,6 +1222,7 @@ bool fnFTP::parse_response()
     bool multi_line = false;
 
     controlResponse.clear();
+    controlResponseBody.clear();
 
     while(true)
     {
@@ -1049,8 +1247,11 @@ bool fnFTP::parse_response()
                 }
             }
         }
-        if (multi_line) // ignore body of multi-line response
+        if (multi_line) // keep body of multi-line response, e.g. FEAT
+        {
+            controlResponseBody.append(respBuf, num_read).append("\n");
             continue;
+        }
         // error - nothing above
         Debug_printf("fnFTP::parse_response() - failed\r\n");
         _statusCode = 501;  //syntax error
@@ -1069,18 +1270,17 @@ int fnFTP::read_response_line(char *buf, int buflen)
 {
     int num_read = 0;
     int c;
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
 
     while(true)
     {
         if (control->available() == 0)
         {
-            if (--tmout_counter == 0)
+            // readable without data means the server closed the connection
+            if (wait_readable(control, nullptr, FTP_TIMEOUT) || control->available() == 0)
             {
                 Debug_printf("fnFTP::read_response_line() - Timeout waiting response\r\n");
                 return -1;
             }
-            fnSystem.delay(50);
             continue;
         }
 
@@ -1103,11 +1303,52 @@ int fnFTP::read_response_line(char *buf, int buflen)
         // store char, ignore rest of too long response
         if (num_read < buflen)
             buf[num_read++] = (char) c;
-        tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
     }
     return num_read;
 }
 
+void fnFTP::get_features()
+{
+    _has_mlsd = _has_size = _has_mdtm = false;
+
+    FEAT();
+    if (parse_response() || !is_positive_completion_reply())
+    {
+        Debug_printf("No FEAT, using LIST\r\n");
+        return;
+    }
+
+    // one feature per line, with a leading space
+    std::istringstream lines(controlResponseBody);
+    string line;
+    while (getline(lines, line))
+    {
+        const char *feature = line.c_str();
+        while (*feature == ' ')
+            feature++;
+        if (strncasecmp(feature, "MLST", 4) == 0)
+            _has_mlsd = true;
+        else if (strncasecmp(feature, "SIZE", 4) == 0)
+            _has_size = true;
+        else if (strncasecmp(feature, "MDTM", 4) == 0)
+            _has_mdtm = true;
+    }
+    Debug_printf("Server features:%s%s%s\r\n", _has_mlsd ? " MLSD" : "", _has_size ? " SIZE" : "", _has_mdtm ? " MDTM" : "");
+}
+
+bool fnFTP::open_data_port()
+{
+    int retries = 2;
+    while (get_data_port())
+    {
+        // recovery attempt
+        if ((is_negative_permanent_reply() || is_negative_transient_reply()) && retries-- && !reconnect())
+            continue; // successfully reconnected
+        return true;
+    }
+    return false;
+}
+
 bool fnFTP::get_data_port()
 {
     size_t port_pos_beg, port_pos_end;
@@ -1221,6 +1462,30 @@ void fnFTP::LIST(string path, string pattern)
     control->write("LIST " + path + pattern + "\r\n");
 }
 
+void fnFTP::MLSD(string path)
+{
+    Debug_printf("fnFTP::MLSD(%s)\r\n",path.c_str());
+    control->write("MLSD " + path + "\r\n");
+}
+
+void fnFTP::FEAT()
+{
+    Debug_printf("fnFTP::FEAT()\r\n");
+    control->write("FEAT\r\n");
+}
+
+void fnFTP::SIZE(string path)
+{
+    Debug_printf("fnFTP::SIZE(%s)\r\n",path.c_str());
+    control->write("SIZE " + path + "\r\n");
+}
+
+void fnFTP::MDTM(string path)
+{
+    Debug_printf("fnFTP::MDTM(%s)\r\n",path.c_str());
+    control->write("MDTM " + path + "\r\n");
+}
+
 void fnFTP::ABOR()
 {
     Debug_printf("fnFTP::ABOR()\r\n");
@@ -6,6 +6,9 @@
 #define FNFTP_H
 
 #include <sstream>
+#include <list>
+#include <vector>
+#include <time.h>
 
 #include "fnTcpClient.h"
 
@@ -13,6 +16,17 @@ using std::string;
 
 #define FTP_TIMEOUT 15000 // This is how long we wait for a reply packet from the server
 
+#define FTP_DIRCACHE_TTL_MS 30000 // How long a directory listing is reused
+#define FTP_DIRCACHE_DIRS 4       // Number of directory listings kept per connection
+
+struct ftp_dir_entry
+{
+    string name;
+    long size;
+    bool is_dir;
+    time_t modified; // 0 if unknown
+};
+
 class fnFTP
 {
 public:
@@ -60,6 +74,7 @@ public:
 
     /**
      * Open directory on FTP server, grab it, and return back.
+     * Listings are cached for FTP_DIRCACHE_TTL_MS.
      * @param path directory to retrieve.
      * @param pattern pattern to retrieve.
      * @return TRUE if error, FALSE if successful.
@@ -73,6 +88,31 @@ public:
      * @return TRUE if error, FALSE if successful
      */
     bool read_directory(string& name, long& filesize, bool &is_dir);
+    bool read_directory(string& name, long& filesize, bool &is_dir, time_t &modified);
+
+    /**
+     * Drop cached directory listings, e.g. after a file was stored.
+     */
+    void clear_dircache() { _dircache.clear(); _dir = nullptr; };
+
+    /**
+     * Get file size with SIZE, if the server supports it.
+     * @return TRUE if error, FALSE if successful.
+     */
+    bool file_size(string path, long &filesize);
+
+    /**
+     * Get file modification time with MDTM, if the server supports it.
+     * @return TRUE if error, FALSE if successful.
+     */
+    bool file_modified(string path, time_t &modified);
+
+    /**
+     * Wait until data (or the end of transfer) arrives on the data connection.
+     * @param timeout_ms how long to wait
+     * @return TRUE on timeout, FALSE if there is something to handle.
+     */
+    bool wait_data(int timeout_ms = FTP_TIMEOUT);
 
     /**
      * Read file from data socket into buffer.
@@ -167,9 +207,34 @@ private:
     string password;
 
     /**
-     * Directory buffer stream
+     * Optional commands the server announced in its FEAT reply
+     */
+    bool _has_mlsd = false;
+    bool _has_size = false;
+    bool _has_mdtm = false;
+
+    /**
+     * Body lines of the last multi-line response
      */
-    std::stringstream dirBuffer;
+    string controlResponseBody;
+
+    /**
+     * Recently listed directories, most recent first
+     */
+    struct dir_listing
+    {
+        string path;
+        unsigned long fetched_ms;
+        std::vector<ftp_dir_entry> entries;
+    };
+    std::list<dir_listing> _dircache;
+
+    /**
+     * Listing being read by read_directory() and the pattern it is filtered with
+     */
+    dir_listing *_dir = nullptr;
+    size_t _dir_pos = 0;
+    string _dir_pattern;
     
     /**
      * The data port returned by EPSV
@@ -188,6 +253,29 @@ private:
      */
     int read_response_line(char *buf, int buflen);
 
+    /**
+     * Send FEAT and note which optional commands the server supports.
+     */
+    void get_features();
+
+    /**
+     * Retrieve the listing of path from the server with MLSD, or LIST if MLSD is not available.
+     * @return TRUE if error, FALSE if successful.
+     */
+    bool fetch_directory(const string &path, std::vector<ftp_dir_entry> &entries);
+
+    /**
+     * Read everything the server sends on the data connection, then its completion reply.
+     * @return TRUE if error, FALSE if successful.
+     */
+    bool read_data_connection(string &out);
+
+    /**
+     * Get a data port, reconnecting once if the server refuses.
+     * @return TRUE if error, FALSE if successful.
+     */
+    bool open_data_port();
+
     /**
      * Ask server to prepare a data port for us in extended passive mode.
      * Port is set and returned in data_port variable.
@@ -305,6 +393,29 @@ private:
      */
     void LIST(string path, string pattern);
 
+    /**
+     * @brief ask server for machine readable directory listing (RFC 3659)
+     * @param path path of directory listing
+     */
+    void MLSD(string path);
+
+    /**
+     * @brief ask server which optional commands it supports (RFC 2389)
+     */
+    void FEAT();
+
+    /**
+     * @brief ask server for size of path (RFC 3659)
+     * @param path file to query
+     */
+    void SIZE(string path);
+
+    /**
+     * @brief ask server for modification time of path (RFC 3659)
+     * @param path file to query
+     */
+    void MDTM(string path);
+
     /**
      * @brief ask server to abort current transfer
      */
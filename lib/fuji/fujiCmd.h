@@ -19,6 +19,8 @@
 #define FUJICMD_WRITE_HOST_SLOTS		   0xF3
 #define FUJICMD_READ_DEVICE_SLOTS		   0xF2
 #define FUJICMD_WRITE_DEVICE_SLOTS		   0xF1
+#define FUJICMD_OVERLAY_COMMIT			   0xEC
+#define FUJICMD_OVERLAY_DISCARD			   0xEB
 #define FUJICMD_GET_WIFI_ENABLED		   0xEA
 #define FUJICMD_UNMOUNT_IMAGE			   0xE9
 #define FUJICMD_GET_ADAPTERCONFIG		   0xE8
@@ -71,6 +73,8 @@
 #define FUJICMD_GET_ADAPTERCONFIG_EXTENDED 0xC4
 #define FUJICMD_HASH_COMPUTE_NO_CLEAR	   0xC3
 #define FUJICMD_HASH_CLEAR				   0xC2
+#define FUJICMD_INDEX_SEARCH			   0xC1
+#define FUJICMD_INDEX_RESULT			   0xC0
 #define FUJICMD_SEND_ERROR				   0x02
 #define FUJICMD_SEND_RESPONSE			   0x01
 #define FUJICMD_DEVICE_READY			   0x00
@@ -17,6 +17,7 @@
 
 #define DISK_ACCESS_MODE_READ 1
 #define DISK_ACCESS_MODE_WRITE 2
+#define DISK_ACCESS_MODE_OVERLAY 3 // read-only image, writes kept in a local delta file
 #define DISK_ACCESS_MODE_FETCH 128
 
 #define INVALID_HOST_SLOT 0xFF
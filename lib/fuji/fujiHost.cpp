@@ -9,6 +9,9 @@
 #include "fnFsTNFS.h"
 #include "fnFsSMB.h"
 #include "fnFsFTP.h"
+#ifndef FNIO_IS_STDIO
+#include "fnFileGzip.h"
+#endif
 
 #include "utils.h"
 
@@ -242,6 +245,19 @@ fnFile * fujiHost::fnfile_open(const char *path, char *fullpath, int fullpathlen
     return _fs->fnfile_open(fullpath, mode);
 }
 
+fnFile * fujiHost::fnfile_open_image(const char *path, char *fullpath, int fullpathlen, const char *mode)
+{
+    fnFile *f = fnfile_open(path, fullpath, fullpathlen, mode);
+
+#ifndef FNIO_IS_STDIO
+    // Sectors are inflated as they're read, the image is never unpacked as a whole
+    if (f != nullptr && FileHandlerGzip::is_compressed_name(path))
+        f = FileHandlerGzip::open(f);
+#endif
+
+    return f;
+}
+
 /* Remove a file from the host
  * Returns true on error, false on success
 */
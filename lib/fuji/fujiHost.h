@@ -59,6 +59,8 @@ public:
     // File functions
     bool file_exists(const char *path);
     fnFile * fnfile_open(const char *path, char *fullpath, int fullpathlen, const char *mode);
+    // Same as fnfile_open, but compressed (".gz") disk images are opened decompressed
+    fnFile * fnfile_open_image(const char *path, char *fullpath, int fullpathlen, const char *mode);
 #ifdef FNIO_IS_STDIO
     // allow compilation of FILE* based fujiHost (all platforms except ATARI and APPLE)
     FILE * file_open(const char *path, char *fullpath, int fullpathlen, const char *mode) {
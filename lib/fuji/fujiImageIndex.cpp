@@ -0,0 +1,656 @@
+#ifndef ESP_PLATFORM
+
+#include "fujiImageIndex.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <stdio.h>
+#include <string.h>
+#include "compat_string.h"
+
+#include "fnConfig.h"
+#include "fnSystem.h"
+#include "fnTaskManager.h"
+#include "fnFsSD.h"
+#include "fnFsTNFS.h"
+#include "fnFsSMB.h"
+#include "fnFsFTP.h"
+#include "fujiHost.h"
+
+#include "debug.h"
+
+
+fujiImageIndex imageIndex;
+
+// Indexed file name extensions, the position is the media type
+static const char *_index_media_types[] = {
+    nullptr,
+    "ATR", "ATX", "XEX", "COM", "EXE", "CAS", "WAV",   // Atari
+    "WOZ", "PO", "DSK", "DO", "2MG", "HDV",             // Apple II
+    "D64", "D71", "D81", "PRG", "T64", "TAP", "CRT",   // Commodore
+    "DDP", "ROM", "IMG", "DMK", "VDK", "MSA", "ST",    // others
+};
+#define INDEX_MEDIA_TYPES (sizeof(_index_media_types) / sizeof(_index_media_types[0]))
+
+uint8_t fujiImageIndex::media_type(const char *filename)
+{
+    // Look at the extension before a ".gz" for compressed images
+    size_t len = strlen(filename);
+    if (len > 3 && strcasecmp(filename + len - 3, ".gz") == 0)
+        len -= 3;
+
+    size_t dot = len;
+    while (dot > 0 && filename[dot - 1] != '.')
+        dot--;
+    if (dot == 0 || len - dot > 3 || len == dot)
+        return 0;
+
+    for (uint8_t t = 1; t < INDEX_MEDIA_TYPES; t++)
+        if (strncasecmp(filename + dot, _index_media_types[t], len - dot) == 0 &&
+            _index_media_types[t][len - dot] == '\0')
+            return t;
+    return 0;
+}
+
+const char *fujiImageIndex::media_type_name(uint8_t type)
+{
+    if (type == 0 || type >= INDEX_MEDIA_TYPES)
+        return "";
+    return _index_media_types[type];
+}
+
+uint16_t fujiImageIndex::data::add_host(const std::string &host)
+{
+    for (size_t i = 0; i < hosts.size(); i++)
+        if (hosts[i] == host)
+            return i;
+    hosts.push_back(host);
+    return hosts.size() - 1;
+}
+
+void fujiImageIndex::data::add_dir(uint16_t host, const char *path, uint32_t modified)
+{
+    dir d;
+    d.path = paths.size();
+    d.modified = modified;
+    d.first_file = files.size();
+    d.files = 0;
+    d.host = host;
+    d.leaf = true;
+    dirs.push_back(d);
+
+    paths.append(path);
+    paths.push_back('\0');
+}
+
+void fujiImageIndex::data::add_file(const char *name, uint32_t size, uint32_t modified, uint8_t type)
+{
+    file f;
+    f.name = names.size();
+    f.size = size;
+    f.modified = modified;
+    f.dir = dirs.size() - 1;
+    f.type = type;
+    files.push_back(f);
+    dirs.back().files++;
+
+    names.append(name);
+    names.push_back('\0');
+}
+
+void fujiImageIndex::data::end_dir(bool leaf)
+{
+    dirs.back().leaf = leaf;
+}
+
+void fujiImageIndex::data::finish()
+{
+    lower = names;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return tolower(c); });
+
+    sorted.resize(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+        sorted[i] = i;
+    const char *l = lower.c_str();
+    std::sort(sorted.begin(), sorted.end(), [this, l](uint32_t a, uint32_t b) {
+        return strcmp(l + files[a].name, l + files[b].name) < 0;
+    });
+}
+
+/*
+ Crawls the hosts of the host slots one directory after the other. The
+ listings run on a worker thread, the new index replaces the old one when
+ all hosts are done.
+*/
+class fujiIndexCrawl : public fnTask
+{
+public:
+    fujiIndexCrawl(std::shared_ptr<const fujiImageIndex::data> previous);
+    virtual ~fujiIndexCrawl() override;
+
+protected:
+    virtual int start() override;
+    virtual int abort() override;
+    virtual int work() override;
+    virtual int step() override;
+
+private:
+    struct pending
+    {
+        std::string path;
+        uint32_t modified;
+        int depth;
+    };
+
+    std::shared_ptr<const fujiImageIndex::data> _old;
+    std::unordered_map<std::string, uint32_t> _old_dirs; // host + '\n' + path -> directory
+    std::shared_ptr<fujiImageIndex::data> _new;
+
+    std::vector<std::string> _hosts;
+    size_t _host = 0;
+    uint16_t _host_id = 0;
+    FileSystem *_fs = nullptr;
+    std::vector<pending> _stack;
+    bool _done = false;
+
+    static FileSystem *open_host(const std::string &hostname);
+    void crawl_dir(const pending &dir);
+    bool reuse_dir(const pending &dir);
+    void copy_dir(uint32_t old_dir);
+    void copy_host(const std::string &hostname);
+};
+
+fujiIndexCrawl::fujiIndexCrawl(std::shared_ptr<const fujiImageIndex::data> previous)
+    : _old(previous)
+{
+    // Directory listings go over the network
+    set_blocking(true);
+    set_priority(PRIORITY_LOW);
+}
+
+fujiIndexCrawl::~fujiIndexCrawl()
+{
+    if (_fs != nullptr)
+        delete _fs;
+}
+
+int fujiIndexCrawl::start()
+{
+    // Every host once, in host slot order
+    for (int i = 0; i < MAX_HOST_SLOTS; i++)
+    {
+        std::string hostname = Config.get_host_name(i);
+        if (!hostname.empty() && std::find(_hosts.begin(), _hosts.end(), hostname) == _hosts.end())
+            _hosts.push_back(hostname);
+    }
+    Debug_printf("fujiIndexCrawl started #%d, %u hosts\n", _id, (unsigned)_hosts.size());
+    return 0;
+}
+
+int fujiIndexCrawl::abort()
+{
+    Debug_printf("fujiIndexCrawl aborted #%d\n", _id);
+    imageIndex.crawl_done(nullptr);
+    return 0;
+}
+
+// Same host types as the file browser
+FileSystem *fujiIndexCrawl::open_host(const std::string &hostname)
+{
+    FileSystem *fs;
+    bool started;
+    char name[MAX_HOSTNAME_LEN];
+    strlcpy(name, hostname.c_str(), sizeof(name));
+
+    if (strcmp("SD", name) == 0)
+    {
+        fs = new FileSystemSDFAT;
+        started = ((FileSystemSDFAT *)fs)->start(Config.get_general_SD_path().c_str());
+    }
+    else if (strncasecmp("smb://", name, 6) == 0)
+    {
+        memcpy(name, "smb", 3);
+        fs = new FileSystemSMB;
+        started = ((FileSystemSMB *)fs)->start(name);
+    }
+    else if (strncasecmp("ftp://", name, 6) == 0)
+    {
+        fs = new FileSystemFTP;
+        started = ((FileSystemFTP *)fs)->start(name);
+    }
+    else
+    {
+        fs = new FileSystemTNFS;
+        started = ((FileSystemTNFS *)fs)->start(name);
+    }
+
+    if (!started)
+    {
+        delete fs;
+        return nullptr;
+    }
+    return fs;
+}
+
+// Runs on a worker thread
+int fujiIndexCrawl::work()
+{
+    if (_done)
+        return 0;
+
+    if (_new == nullptr)
+    {
+        _new = std::make_shared<fujiImageIndex::data>();
+        if (_old != nullptr)
+            for (uint32_t i = 0; i < _old->dirs.size(); i++)
+            {
+                const fujiImageIndex::data::dir &d = _old->dirs[i];
+                _old_dirs[_old->hosts[d.host] + '\n' + (_old->paths.c_str() + d.path)] = i;
+            }
+    }
+
+    uint64_t start_ms = fnSystem.millis();
+    do
+    {
+        if (_fs == nullptr)
+        {
+            if (_host >= _hosts.size())
+            {
+                _new->finish();
+                fujiImageIndex::save(fujiImageIndex::index_path().c_str(), *_new);
+                _done = true;
+                break;
+            }
+
+            _fs = open_host(_hosts[_host]);
+            if (_fs == nullptr)
+            {
+                // Keep what we know about a host that's down
+                Debug_printf("fujiIndexCrawl can't reach \"%s\"\n", _hosts[_host].c_str());
+                copy_host(_hosts[_host]);
+                _host++;
+                continue;
+            }
+            _host_id = _new->add_host(_hosts[_host]);
+            _stack.push_back({"/", 0, 0});
+        }
+
+        if (_stack.empty())
+        {
+            delete _fs;
+            _fs = nullptr;
+            _host++;
+            continue;
+        }
+
+        pending dir = _stack.back();
+        _stack.pop_back();
+        crawl_dir(dir);
+    } while (fnSystem.millis() - start_ms < INDEX_WORK_MS);
+
+    return 0;
+}
+
+int fujiIndexCrawl::step()
+{
+    if (!_done)
+        return 0;
+
+    Debug_printf("fujiIndexCrawl done #%d, %u files in %u directories\n", _id,
+                 (unsigned)_new->files.size(), (unsigned)_new->dirs.size());
+    imageIndex.crawl_done(_new);
+    return 1;
+}
+
+void fujiIndexCrawl::crawl_dir(const pending &dir)
+{
+    if (!_fs->dir_open(dir.path.c_str(), nullptr, 0))
+        return;
+
+    _new->add_dir(_host_id, dir.path.c_str(), dir.modified);
+
+    bool leaf = true;
+    std::vector<pending> subdirs;
+    fsdir_entry *entry;
+    while ((entry = _fs->dir_read()) != nullptr)
+    {
+        const char *name = entry->filename;
+        // Skip hidden entries, current and parent directory, and names we can't save
+        if (name[0] == '.' || name[0] == '\0' || strpbrk(name, "\t\r\n") != nullptr)
+            continue;
+
+        if (entry->isDir)
+        {
+            leaf = false;
+            if (dir.depth < INDEX_MAX_DEPTH)
+            {
+                std::string path = dir.path;
+                if (path.back() != '/')
+                    path += '/';
+                path += name;
+                // Some file systems report directories with a trailing slash
+                if (path.length() > 1 && path.back() == '/')
+                    path.pop_back();
+                subdirs.push_back({path, (uint32_t)entry->modified_time, dir.depth + 1});
+            }
+            continue;
+        }
+
+        uint8_t type = fujiImageIndex::media_type(name);
+        if (type != 0 && _new->files.size() < INDEX_MAX_FILES)
+            _new->add_file(name, entry->size, entry->modified_time, type);
+    }
+    _fs->dir_close();
+    _new->end_dir(leaf);
+
+    // In listing order, once popped off the stack
+    for (auto it = subdirs.rbegin(); it != subdirs.rend(); ++it)
+        if (!reuse_dir(*it))
+            _stack.push_back(*it);
+}
+
+/*
+ A directory without subdirectories that wasn't modified since the last crawl
+ still has the same files, copy them instead of listing it again
+*/
+bool fujiIndexCrawl::reuse_dir(const pending &dir)
+{
+    if (_old == nullptr || dir.modified == 0)
+        return false;
+
+    auto it = _old_dirs.find(_hosts[_host] + '\n' + dir.path);
+    if (it == _old_dirs.end())
+        return false;
+
+    const fujiImageIndex::data::dir &d = _old->dirs[it->second];
+    if (!d.leaf || d.modified != dir.modified)
+        return false;
+
+    copy_dir(it->second);
+    return true;
+}
+
+void fujiIndexCrawl::copy_dir(uint32_t old_dir)
+{
+    const fujiImageIndex::data::dir &d = _old->dirs[old_dir];
+    _new->add_dir(_host_id, _old->paths.c_str() + d.path, d.modified);
+    for (uint32_t i = d.first_file; i < d.first_file + d.files && _new->files.size() < INDEX_MAX_FILES; i++)
+    {
+        const fujiImageIndex::data::file &f = _old->files[i];
+        _new->add_file(_old->names.c_str() + f.name, f.size, f.modified, f.type);
+    }
+    _new->end_dir(d.leaf);
+}
+
+void fujiIndexCrawl::copy_host(const std::string &hostname)
+{
+    if (_old == nullptr)
+        return;
+
+    for (uint32_t i = 0; i < _old->dirs.size(); i++)
+    {
+        if (_old->hosts[_old->dirs[i].host] != hostname)
+            continue;
+        _host_id = _new->add_host(hostname);
+        copy_dir(i);
+    }
+}
+
+std::string fujiImageIndex::index_path()
+{
+    // Next to the config file
+    std::string path = Config.get_general_config_path();
+    size_t sep = path.find_last_of("/\\");
+    if (sep == std::string::npos)
+        return INDEX_FILENAME;
+    return path.substr(0, sep + 1) + INDEX_FILENAME;
+}
+
+/*
+ Text file, one line per host, directory and file:
+ H <host>
+ D <modified> <leaf> <path>
+ F <size> <modified> <type> <name>
+ separated by tabs. Files belong to the directory before them.
+*/
+bool fujiImageIndex::save(const char *path, const data &index)
+{
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *fout = fopen(tmp.c_str(), "w");
+    if (fout == nullptr)
+    {
+        Debug_printf("fujiImageIndex::save - failed to open \"%s\"\n", tmp.c_str());
+        return false;
+    }
+
+    fprintf(fout, "FNINDEX 1\n");
+    int host = -1;
+    for (const data::dir &d : index.dirs)
+    {
+        if (d.host != host)
+        {
+            host = d.host;
+            fprintf(fout, "H\t%s\n", index.hosts[host].c_str());
+        }
+        fprintf(fout, "D\t%u\t%d\t%s\n", d.modified, d.leaf ? 1 : 0, index.paths.c_str() + d.path);
+        for (uint32_t i = d.first_file; i < d.first_file + d.files; i++)
+        {
+            const data::file &f = index.files[i];
+            fprintf(fout, "F\t%u\t%u\t%s\t%s\n", f.size, f.modified, media_type_name(f.type), index.names.c_str() + f.name);
+        }
+    }
+
+    bool ok = ferror(fout) == 0;
+    ok = (fclose(fout) == 0) && ok;
+    if (ok)
+    {
+        // Windows doesn't rename over an existing file
+        if (rename(tmp.c_str(), path) != 0)
+        {
+            remove(path);
+            ok = rename(tmp.c_str(), path) == 0;
+        }
+    }
+    if (!ok)
+    {
+        Debug_printf("fujiImageIndex::save - failed to write \"%s\"\n", path);
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool fujiImageIndex::load(const char *path, data &index)
+{
+    FILE *fin = fopen(path, "r");
+    if (fin == nullptr)
+        return false;
+
+    char line[MAX_PATHLEN + 64];
+    if (fgets(line, sizeof(line), fin) == nullptr || strcmp(line, "FNINDEX 1\n") != 0)
+    {
+        Debug_printf("fujiImageIndex::load - \"%s\" is not an index\n", path);
+        fclose(fin);
+        return false;
+    }
+
+    int host = -1;
+    while (fgets(line, sizeof(line), fin) != nullptr)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        // Split at the tabs, the name is last and may have none
+        char *fields[5] = { nullptr };
+        int n = 0;
+        char *p = line;
+        int max_fields = line[0] == 'F' ? 5 : line[0] == 'D' ? 4 : 2;
+        while (n < max_fields)
+        {
+            fields[n++] = p;
+            if (n == max_fields || (p = strchr(p, '\t')) == nullptr)
+                break;
+            *p++ = '\0';
+        }
+        if (n != max_fields)
+            continue;
+
+        switch (line[0])
+        {
+        case 'H':
+            host = index.add_host(fields[1]);
+            break;
+        case 'D':
+            if (host < 0)
+                break;
+            index.add_dir(host, fields[3], strtoul(fields[1], nullptr, 10));
+            index.end_dir(fields[2][0] == '1');
+            break;
+        case 'F':
+            if (index.dirs.empty())
+                break;
+            index.add_file(fields[4], strtoul(fields[1], nullptr, 10), strtoul(fields[2], nullptr, 10),
+                           media_type(fields[4]));
+            break;
+        }
+    }
+    fclose(fin);
+
+    index.finish();
+    return true;
+}
+
+void fujiImageIndex::setup()
+{
+    std::string path = index_path();
+    std::shared_ptr<data> index = std::make_shared<data>();
+    if (load(path.c_str(), *index))
+    {
+        Debug_printf("fujiImageIndex loaded %u files from \"%s\"\n", (unsigned)index->files.size(), path.c_str());
+        std::lock_guard<std::mutex> lock(_mutex);
+        _data = index;
+    }
+    _next_crawl_ms = fnSystem.millis() + INDEX_FIRST_CRAWL_MS;
+}
+
+void fujiImageIndex::service()
+{
+    if (_crawl == nullptr && _next_crawl_ms != 0 && fnSystem.millis() >= _next_crawl_ms)
+        rebuild();
+}
+
+bool fujiImageIndex::rebuild()
+{
+    if (_crawl != nullptr)
+        return false;
+
+    _crawl = new fujiIndexCrawl(get_data());
+    if (taskMgr.submit_task(_crawl) <= 0)
+    {
+        delete _crawl;
+        _crawl = nullptr;
+        // Try again later
+        _next_crawl_ms = fnSystem.millis() + INDEX_FIRST_CRAWL_MS;
+        return false;
+    }
+    return true;
+}
+
+// Called by the crawl task when it's done, index is null if it was aborted
+void fujiImageIndex::crawl_done(std::shared_ptr<const data> index)
+{
+    _crawl = nullptr;
+    _next_crawl_ms = fnSystem.millis() + INDEX_RECRAWL_MS;
+    if (index == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _data = index;
+}
+
+std::shared_ptr<const fujiImageIndex::data> fujiImageIndex::get_data()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _data;
+}
+
+size_t fujiImageIndex::size()
+{
+    std::shared_ptr<const data> index = get_data();
+    return index == nullptr ? 0 : index->files.size();
+}
+
+size_t fujiImageIndex::search(const char *query, bool prefix, int host_slot, size_t max_results, std::vector<result> &results)
+{
+    results.clear();
+
+    std::shared_ptr<const data> index = get_data();
+    if (index == nullptr || query == nullptr || query[0] == '\0')
+        return 0;
+
+    std::string q(query);
+    std::transform(q.begin(), q.end(), q.begin(), [](unsigned char c) { return tolower(c); });
+
+    // Host slot of each indexed host, and the host searched for
+    std::vector<int> slots(index->hosts.size(), -1);
+    for (int i = MAX_HOST_SLOTS - 1; i >= 0; i--)
+    {
+        std::string hostname = Config.get_host_name(i);
+        for (size_t h = 0; h < index->hosts.size(); h++)
+            if (index->hosts[h] == hostname)
+                slots[h] = i;
+    }
+
+    auto add = [&](uint32_t file) {
+        const data::file &f = index->files[file];
+        const data::dir &d = index->dirs[f.dir];
+        if (host_slot >= 0 && slots[d.host] != host_slot)
+            return;
+
+        result r;
+        r.host_slot = slots[d.host];
+        r.host = index->hosts[d.host];
+        r.path = index->paths.c_str() + d.path;
+        if (r.path.back() != '/')
+            r.path += '/';
+        r.path += index->names.c_str() + f.name;
+        r.size = f.size;
+        r.modified = f.modified;
+        r.type = media_type_name(f.type);
+        results.push_back(r);
+    };
+
+    const char *lower = index->lower.c_str();
+    if (prefix)
+    {
+        // First name not before the query
+        auto it = std::lower_bound(index->sorted.begin(), index->sorted.end(), q,
+            [&index, lower](uint32_t file, const std::string &q) {
+                return strcmp(lower + index->files[file].name, q.c_str()) < 0;
+            });
+        for (; it != index->sorted.end() && results.size() < max_results; ++it)
+        {
+            if (strncmp(lower + index->files[*it].name, q.c_str(), q.length()) != 0)
+                break;
+            add(*it);
+        }
+    }
+    else
+    {
+        // The query has no '\0', so every match is within one name
+        size_t pos = 0;
+        while (results.size() < max_results && (pos = index->lower.find(q, pos)) != std::string::npos)
+        {
+            // Last file whose name starts at or before the match
+            auto it = std::upper_bound(index->files.begin(), index->files.end(), pos,
+                [](size_t pos, const data::file &f) { return pos < f.name; });
+            uint32_t file = (it - index->files.begin()) - 1;
+            add(file);
+            // Continue with the next name
+            pos = index->files[file].name + strlen(lower + index->files[file].name) + 1;
+        }
+    }
+
+    return results.size();
+}
+
+#endif // !ESP_PLATFORM
@@ -0,0 +1,126 @@
+#ifndef _FUJI_IMAGEINDEX_
+#define _FUJI_IMAGEINDEX_
+
+#ifndef ESP_PLATFORM
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Index of the disk images (and other media files) on all hosts in the host
+ * slots, so they can be found by name without walking the directories.
+ *
+ * A background task crawls the hosts and saves the index next to the config
+ * file. Crawls after the first one are incremental: the files of a directory
+ * without subdirectories are taken from the previous index if the directory's
+ * modification time hasn't changed. Searches only look at the index in memory.
+ */
+
+#define INDEX_FILENAME "fnindex.dat"
+#define INDEX_FIRST_CRAWL_MS 30000 // Leave the first half minute to the computer booting up
+#define INDEX_RECRAWL_MS 3600000   // Crawl all hosts again after an hour
+#define INDEX_MAX_DEPTH 16         // Directory levels below the host root
+#define INDEX_MAX_FILES 500000
+#define INDEX_WORK_MS 50           // Time spent crawling per task step, at least one directory
+#define INDEX_MAX_RESULTS 256      // Per search
+
+class fujiIndexCrawl;
+
+class fujiImageIndex
+{
+public:
+    struct result
+    {
+        int host_slot;      // First host slot with the host, -1 if it's in none anymore
+        std::string host;
+        std::string path;   // Full path on the host
+        uint32_t size;
+        uint32_t modified;
+        const char *type;   // Media type, as file name extension: "ATR", "XEX", ...
+    };
+
+    // Loads the index saved by the last crawl
+    void setup();
+    // Starts a crawl when one is due, called from the main loop
+    void service();
+    // Crawls all hosts now. Returns false if a crawl is already running
+    bool rebuild();
+    bool crawling() { return _crawl != nullptr; };
+
+    // Finds files whose name contains query (or starts with it), ignoring case.
+    // host_slot -1 searches all hosts. Returns the number of results
+    size_t search(const char *query, bool prefix, int host_slot, size_t max_results, std::vector<result> &results);
+
+    // Number of files in the index
+    size_t size();
+
+    // Media type of a file name, 0 if it's not a media file we index
+    static uint8_t media_type(const char *filename);
+    static const char *media_type_name(uint8_t type);
+
+    /*
+     The index itself, never changed once built. Names live in two arenas,
+     each followed by '\0'. The files of a directory are consecutive.
+    */
+    struct data
+    {
+        struct dir
+        {
+            uint32_t path;       // Offset in paths
+            uint32_t modified;
+            uint32_t first_file;
+            uint32_t files;
+            uint16_t host;       // Index in hosts
+            bool leaf;           // Has no subdirectories
+        };
+
+        struct file
+        {
+            uint32_t name;       // Offset in names and lower
+            uint32_t size;
+            uint32_t modified;
+            uint32_t dir;
+            uint8_t type;
+        };
+
+        std::vector<std::string> hosts;
+        std::vector<dir> dirs;
+        std::vector<file> files;
+        std::string paths;
+        std::string names;
+        std::string lower;           // names in lower case, for searching
+        std::vector<uint32_t> sorted; // files by lower case name, for prefix searches
+
+        uint16_t add_host(const std::string &host);
+        void add_dir(uint16_t host, const char *path, uint32_t modified);
+        void add_file(const char *name, uint32_t size, uint32_t modified, uint8_t type);
+        void end_dir(bool leaf);
+        // Sorts the names once all files are in
+        void finish();
+    };
+
+private:
+    std::shared_ptr<const data> _data;
+    std::mutex _mutex;
+
+    fujiIndexCrawl *_crawl = nullptr;
+    uint64_t _next_crawl_ms = 0;
+
+    friend class fujiIndexCrawl;
+    void crawl_done(std::shared_ptr<const data> index);
+    std::shared_ptr<const data> get_data();
+
+    static std::string index_path();
+    // Both return true on success
+    static bool load(const char *path, data &index);
+    static bool save(const char *path, const data &index);
+};
+
+extern fujiImageIndex imageIndex;
+
+#endif // !ESP_PLATFORM
+
+#endif // _FUJI_IMAGEINDEX_
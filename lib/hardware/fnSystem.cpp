@@ -57,6 +57,7 @@
 #include "fsFlash.h"
 #include "fnFsSD.h"
 #include "fnWiFi.h"
+#include "fnConfig.h"
 
 #ifdef BUILD_APPLE
 #define BUS_CLASS IWM
@@ -411,6 +412,7 @@ void SystemManager::yield()
 void SystemManager::reboot()
 {
     SYSTEM_BUS.shutdown();
+    Config.flush();
     fnWiFi.stop();
     esp_restart();
 }
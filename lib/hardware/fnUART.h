@@ -23,6 +23,11 @@
 #include <string>
 #include <cstdint>
 
+#if !defined(ESP_PLATFORM) && defined(__linux__)
+#include <atomic>
+#include <thread>
+#endif
+
 
 class UARTManager
 {
@@ -45,6 +50,21 @@ private:
     int _command_tiocm;
     int _proceed_tiocm;
     int _fd;
+#if defined(__linux__)
+    // command line monitor thread and epoll based poll(), see fnUARTUnix.cpp
+    std::thread _monitor;
+    std::atomic<bool> _monitor_active{false}; // _modem_status is kept up to date
+    std::atomic<bool> _monitor_quit{false};
+    std::atomic<bool> _monitor_done{false};
+    std::atomic<int> _modem_status{0};
+    int _epfd = -1;
+    int _wakefd = -1; // eventfd, signalled on command line changes
+
+    void _monitor_start();
+    void _monitor_end();
+    void _monitor_loop();
+    void _read_modem_status();
+#endif
 #endif
     // serial port error counter
     int _errcount;
@@ -18,6 +18,10 @@
 
 #if defined(__linux__)
 #include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <pthread.h>
 #include "linux_termios2.h"
 #elif defined(__APPLE__)
 #include <IOKit/serial/ioss.h>
@@ -44,6 +48,9 @@ UARTManager::UARTManager() :
 
 void UARTManager::end()
 {
+#if defined(__linux__)
+    _monitor_end();
+#endif
     if (_fd >= 0)
     {
         close(_fd);
@@ -53,13 +60,146 @@ void UARTManager::end()
     _initialized = false;
 }
 
+/* Waits up to ms for input data or for the command line to become asserted.
+   Returns true if the port needs handling.
+ */
 bool UARTManager::poll(int ms)
 {
+#if defined(__linux__)
+    if (_epfd >= 0)
+    {
+        epoll_event events[2];
+        int n = epoll_wait(_epfd, events, 2, ms);
+        bool rx = false;
+        bool line_changed = false;
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == _wakefd)
+            {
+                uint64_t count;
+                ::read(_wakefd, &count, sizeof(count));
+                line_changed = true;
+            }
+            else
+                rx = true;
+        }
+        // A line change right before the monitor went back to TIOCMIWAIT goes unnoticed,
+        // but a command frame always brings data with it, so read the line again then
+        if (rx && _monitor_active)
+            _read_modem_status();
+        return rx || (line_changed && command_asserted());
+    }
+#endif
     // TODO check serial port command link and input data
     fnSystem.delay_microseconds(500); // TODO use ms parameter
     return false;
 }
 
+#if defined(__linux__)
+/* Command line monitor
+
+   A thread sleeps in TIOCMIWAIT until the command line changes, stores the
+   line state in _modem_status and wakes up poll() through an eventfd. poll()
+   sleeps in epoll on that eventfd and the serial port, so an idle bus costs no
+   CPU and command_asserted() doesn't need a syscall. With a driver that doesn't
+   support TIOCMIWAIT, command_asserted() reads the line itself as before.
+*/
+
+// Only there to break the monitor thread out of TIOCMIWAIT
+static void monitor_wakeup(int) {}
+
+void UARTManager::_monitor_start()
+{
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    _wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epfd < 0 || _wakefd < 0)
+    {
+        Debug_printf("UART epoll setup error %d: %s\n", errno, strerror(errno));
+        _monitor_end();
+        return;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = _fd;
+    epoll_ctl(_epfd, EPOLL_CTL_ADD, _fd, &ev);
+    ev.data.fd = _wakefd;
+    epoll_ctl(_epfd, EPOLL_CTL_ADD, _wakefd, &ev);
+
+    if (_command_tiocm == 0)
+        return; // no command line, poll() still wakes up on input data
+
+    static bool handler_set = false;
+    if (!handler_set)
+    {
+        struct sigaction sa = {};
+        sa.sa_handler = monitor_wakeup; // no SA_RESTART, TIOCMIWAIT has to return EINTR
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGUSR2, &sa, nullptr);
+        handler_set = true;
+    }
+
+    _read_modem_status();
+    _monitor_quit = false;
+    _monitor_done = false;
+    _monitor_active = true;
+    _monitor = std::thread(&UARTManager::_monitor_loop, this);
+}
+
+void UARTManager::_monitor_end()
+{
+    if (_monitor.joinable())
+    {
+        _monitor_quit = true;
+        // the signal can land just before the thread enters TIOCMIWAIT, repeat until it's out
+        while (!_monitor_done)
+        {
+            pthread_kill(_monitor.native_handle(), SIGUSR2);
+            fnSystem.delay(1);
+        }
+        _monitor.join();
+    }
+    _monitor_active = false;
+
+    if (_epfd >= 0)
+    {
+        close(_epfd);
+        _epfd = -1;
+    }
+    if (_wakefd >= 0)
+    {
+        close(_wakefd);
+        _wakefd = -1;
+    }
+}
+
+void UARTManager::_monitor_loop()
+{
+    while (!_monitor_quit)
+    {
+        if (ioctl(_fd, TIOCMIWAIT, _command_tiocm) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            Debug_printf("UART TIOCMIWAIT error %d: %s, polling command line\n", errno, strerror(errno));
+            _monitor_active = false;
+            break;
+        }
+        _read_modem_status();
+        uint64_t one = 1;
+        ::write(_wakefd, &one, sizeof(one));
+    }
+    _monitor_done = true;
+}
+
+void UARTManager::_read_modem_status()
+{
+    int status;
+    if (ioctl(_fd, TIOCMGET, &status) == 0)
+        _modem_status = status;
+}
+#endif
+
 void UARTManager::set_port(const char *device, int command_pin, int proceed_pin)
 {
     if (device != nullptr)
@@ -222,6 +362,9 @@ void UARTManager::begin(int baud)
     // Set initialized.
     _initialized = true;
     set_baudrate(baud);
+#if defined(__linux__)
+    _monitor_start();
+#endif
 }
 
 
@@ -379,6 +522,11 @@ bool UARTManager::command_asserted(void)
             return false;
     }
 
+#if defined(__linux__)
+    if (_monitor_active)
+        return ((_modem_status & _command_tiocm) != 0);
+#endif
+
     if (ioctl(_fd, TIOCMGET, &status) < 0)
     {
         // handle serial port errors
@@ -548,6 +548,14 @@ esp_err_t fnHttpService::get_handler_print(httpd_req_t *req)
     return ESP_OK;
 }
 
+esp_err_t fnHttpService::get_handler_metrics(httpd_req_t *req)
+{
+    std::string json = fnBusMetrics.to_json();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json.c_str(), json.length());
+    return ESP_OK;
+}
+
 esp_err_t fnHttpService::get_handler_modem_sniffer(httpd_req_t *req)
 {
     Debug_printf("Modem Sniffer output request handler\n");
@@ -662,7 +670,7 @@ esp_err_t fnHttpService::get_handler_mount(httpd_req_t *req)
             fujiDisk *disk = theFuji.get_disks(ds);
             fujiHost *host = theFuji.get_hosts(hs);
 
-            disk->fileh = host->fnfile_open(qp.query_parsed["filename"].c_str(), (char *)qp.query_parsed["filename"].c_str(), qp.query_parsed["filename"].length() + 1, flag);
+            disk->fileh = host->fnfile_open_image(qp.query_parsed["filename"].c_str(), (char *)qp.query_parsed["filename"].c_str(), qp.query_parsed["filename"].length() + 1, flag);
 
             if (disk->fileh == nullptr)
             {
@@ -1238,7 +1246,7 @@ esp_err_t fnHttpService::webdav_handler(httpd_req_t *httpd_req)
         break;
     case HTTP_GET:
         ret = server->doGet(req, resp);
-        if ( ret == 200 )
+        if ( ret == 200 || ret == 206 )
             return ESP_OK;
         break;
     case HTTP_HEAD:
@@ -1280,12 +1288,12 @@ esp_err_t fnHttpService::webdav_handler(httpd_req_t *httpd_req)
     if ( (ret > 399) & (httpd_req->method != HTTP_HEAD) )
     {
         // Send error
+        resp.flushHeaders();
         httpd_resp_send(httpd_req, NULL, 0);
     }
     else
     {
-        // Send empty response
-        resp.setHeader("Connection","close");
+        // Send empty response, connection is kept alive for the next request
         resp.flushHeaders();
         resp.closeBody();
     }
@@ -1383,6 +1391,13 @@ httpd_handle_t fnHttpService::start_server(serverstate &state)
          .is_websocket = false,
          .handle_ws_control_frames = false,
          .supported_subprotocol = nullptr},
+        {.uri = "/metrics.json",
+         .method = HTTP_GET,
+         .handler = get_handler_metrics,
+         .user_ctx = NULL,
+         .is_websocket = false,
+         .handle_ws_control_frames = false,
+         .supported_subprotocol = nullptr},
         {.uri = "/modem-sniffer.txt",
          .method = HTTP_GET,
          .handler = get_handler_modem_sniffer,
@@ -134,6 +134,7 @@ public:
     static esp_err_t get_handler_file_in_path(httpd_req_t *req);
     static esp_err_t get_handler_print(httpd_req_t *req);
     static esp_err_t get_handler_modem_sniffer(httpd_req_t *req);
+    static esp_err_t get_handler_metrics(httpd_req_t *req);
     static esp_err_t get_handler_mount(httpd_req_t *req);
     static esp_err_t get_handler_eject(httpd_req_t *req);
     static esp_err_t get_handler_dir(httpd_req_t *req);
@@ -156,6 +157,7 @@ public:
     static int post_handler_config(struct mg_connection *c, struct mg_http_message *hm);
 
     static int get_handler_browse(mg_connection *c, mg_http_message *hm);
+    static int get_handler_image_index(mg_connection *c, mg_http_message *hm);
 
     void service();
 // !ESP_PLATFORM
@@ -17,6 +17,9 @@
 #include "debug.h"
 
 
+// don't read ahead while mongoose still has this much queued for the client
+#define FNWS_SEND_BACKLOG (4 * FNWS_SEND_BUFF_SIZE)
+
 class fnHttpSendFileTask : public fnTask
 {
 public:
@@ -24,6 +27,7 @@ public:
 protected:
     virtual int start() override;
     virtual int abort() override;
+    virtual int work() override;
     virtual int step() override;
 private:
     char buf[FNWS_SEND_BUFF_SIZE];
@@ -32,6 +36,8 @@ private:
     mg_connection * _c;
     size_t _filesize;
     size_t _total;
+    size_t _count;      // bytes in buf waiting to be sent
+    bool _eof;
 };
 
 fnHttpSendFileTask::fnHttpSendFileTask(FileSystem *fs, fnFile *fh, mg_connection *c)
@@ -41,6 +47,11 @@ fnHttpSendFileTask::fnHttpSendFileTask(FileSystem *fs, fnFile *fh, mg_connection
     _c = c;
     _filesize = 0;
     _total = 0;
+    _count = 0;
+    _eof = false;
+    // file reads may go over the network, keep them off the bus thread
+    set_blocking(true);
+    set_priority(PRIORITY_LOW);
 }
 
 int fnHttpSendFileTask::start()
@@ -59,18 +70,33 @@ int fnHttpSendFileTask::abort()
     return 0;
 }
 
-int fnHttpSendFileTask::step()
+// Runs on a worker thread: fetch the next chunk, unless the previous one is still pending
+int fnHttpSendFileTask::work()
 {
-    Debug_printf("fnHttpSendFileTask::step #%d\n", _id);
+    if (_count == 0 && !_eof)
+    {
+        _count = fnio::fread((uint8_t *)buf, 1, FNWS_SEND_BUFF_SIZE, _fh);
+        _eof = (_count == 0);
+    }
+    return 0;
+}
 
-    // Send the file content out in chunks
-    size_t count = 0;
-    count = fnio::fread((uint8_t *)buf, 1, FNWS_SEND_BUFF_SIZE, _fh);
-    _total += count;
-    mg_send(_c, buf, count);
+// Runs on the main loop: hand the chunk to mongoose
+int fnHttpSendFileTask::step()
+{
+    if (_count)
+    {
+        if (_c->send.len >= FNWS_SEND_BACKLOG)
+            return 0; // client is slow, try again later
 
-    if (count)
+        _total += _count;
+        mg_send(_c, buf, _count);
+        _count = 0;
         return 0; // continue
+    }
+
+    if (!_eof)
+        return 0;
 
     // done
     _c->is_resp = 0;
@@ -369,10 +395,12 @@ int fnHttpServiceBrowser::browse_listdrives(mg_connection *c, int slot, const ch
             // From what host is each disk mounted on and what disk is mounted - TODO escape host and path
             (host_slot == HOST_SLOT_INVALID) ? "" :
                 (Config.get_host_name(host_slot) + " :: "+ Config.get_mount_path(drive_slot)).c_str(),
-            // Mount mode: R / W or "Empty" for empty slot
+            // Mount mode: R / W / O (overlay) or "Empty" for empty slot
             (host_slot == HOST_SLOT_INVALID) ? "Empty" :
                 Config.get_mount_mode(drive_slot) == fnConfig::mount_modes::MOUNTMODE_READ ? 
-                    (is_mounted ? "R" : "R-") : (is_mounted ? "W" : "W-")
+                    (is_mounted ? "R" : "R-") :
+                Config.get_mount_mode(drive_slot) == fnConfig::mount_modes::MOUNTMODE_OVERLAY ?
+                    (is_mounted ? "O" : "O-") : (is_mounted ? "W" : "W-")
         );
     }
 
@@ -532,7 +532,8 @@ const string fnHttpServiceParser::substitute_tag(const string &tag)
         host_slot = Config.get_mount_host_slot(drive_slot);
         if (host_slot != HOST_SLOT_INVALID) {
             resultstream << Config.get_mount_path(drive_slot);
-            resultstream << " (" << (Config.get_mount_mode(drive_slot) == fnConfig::mount_modes::MOUNTMODE_READ ? "R" : "W") << ")";
+            resultstream << " (" << (Config.get_mount_mode(drive_slot) == fnConfig::mount_modes::MOUNTMODE_READ ? "R" :
+                                 Config.get_mount_mode(drive_slot) == fnConfig::mount_modes::MOUNTMODE_OVERLAY ? "O" : "W") << ")";
         } else {
             resultstream << "(Empty)";
         }
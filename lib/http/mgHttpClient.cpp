@@ -56,7 +56,6 @@ mgHttpClient::mgHttpClient()
     // Used for cert debugging:
     // mbedtls_debug_set_threshold(5);
 
-    _buffer = nullptr;
     load_system_certs();
 }
 
@@ -64,17 +63,7 @@ mgHttpClient::mgHttpClient()
 mgHttpClient::~mgHttpClient()
 {
     close();
-
-    if (_buffer != nullptr) {
-        free(_buffer);
-        _buffer = nullptr;
-    }
-
-    if (current_message != nullptr) {
-        freeHttpMessage(current_message);
-        current_message = nullptr;
-    }
-
+    mg_iobuf_free(&_body);
 }
 
 void mgHttpClient::load_system_certs() {
@@ -271,16 +260,23 @@ bool mgHttpClient::begin(std::string url)
     return true;
 }
 
+/*
+ Returns the number of response body bytes left to read, like the ESP client
+ does, if the server sent a Content-Length. Otherwise, or once the whole body
+ arrived, it's the number of bytes received but not read yet.
+*/
 int mgHttpClient::available()
 {
-    int result = 0;
+    if (_handle == nullptr || !_headers_done)
+        return 0;
 
-    if (_handle != nullptr) {
-        int len = _buffer_len;
-        if (len - _buffer_total_read >= 0)
-            result = len - _buffer_total_read;
-    }
-    return result;
+    // Take in whatever arrived since
+    if (!_body_done)
+        _poll(0);
+
+    if (!_body_done && _content_length >= 0)
+        return _content_length - (int)_body_read;
+    return _body.len;
 }
 
 /*
@@ -288,34 +284,69 @@ int mgHttpClient::available()
  Return value is bytes stored in buffer or -1 on error
  Buffer will NOT be zero-terminated
  Return value >= 0 but less than dest_bufflen indicates end of data
+
+ Waits for the server as long as more of the body is expected, the body is
+ received while it's read, never buffered beyond HTTP_STREAM_BUFFER.
 */
 int mgHttpClient::read(uint8_t *dest_buffer, int dest_bufflen)
 {
     if (_handle == nullptr || dest_buffer == nullptr)
         return -1;
 
-    int bytes_left;
-    int bytes_to_copy;
-
     int bytes_copied = 0;
+    uint64_t ms_update = fnSystem.millis();
 
-    // Start by using our own buffer if there's still data there
-    // if (_buffer_pos > 0 && _buffer_pos < _buffer_len)
-    if (_buffer_len > 0 && _buffer_pos < _buffer_len)
+    while (bytes_copied < dest_bufflen)
     {
-        bytes_left = _buffer_len - _buffer_pos;
-        bytes_to_copy = dest_bufflen > bytes_left ? bytes_left : dest_bufflen;
+        if (_body.len > 0)
+        {
+            int bytes_to_copy = dest_bufflen - bytes_copied;
+            if (bytes_to_copy > (int)_body.len)
+                bytes_to_copy = _body.len;
+
+            memcpy(dest_buffer + bytes_copied, _body.buf, bytes_to_copy);
+            mg_iobuf_del(&_body, 0, bytes_to_copy);
+            _body_read += bytes_to_copy;
+            bytes_copied += bytes_to_copy;
+            ms_update = fnSystem.millis();
+            continue;
+        }
 
-        //Debug_printf("::read from buffer %d\n", bytes_to_copy);
-        memcpy(dest_buffer, _buffer + _buffer_pos, bytes_to_copy);
-        _buffer_pos += bytes_to_copy;
-        _buffer_total_read += bytes_to_copy;
+        // Nothing more is coming
+        if (!_headers_done || _body_done)
+            break;
 
-        bytes_copied = bytes_to_copy;
+        if (!_poll(50) && (fnSystem.millis() - ms_update) > HTTP_TIMEOUT)
+        {
+            Debug_printf("mgHttpClient::read timed-out waiting for data\n");
+            _body_error = true;
+            _close_connection();
+            break;
+        }
     }
 
+    if (bytes_copied == 0 && _body_error)
+        return -1;
+
     return bytes_copied;
+}
+
+/*
+ Moves what's already received into the body buffer and, if there's room
+ for more, services the connection
+ Returns true if anything happened on the connection
+*/
+bool mgHttpClient::_poll(int timeout_ms)
+{
+    if (_conn != nullptr && _headers_done)
+        receive_body(_conn, false);
 
+    if (_conn == nullptr || _body.len >= HTTP_STREAM_BUFFER)
+        return false;
+
+    _progressed = false;
+    mg_mgr_poll(_handle.get(), timeout_ms);
+    return _progressed;
 }
 
 void mgHttpClient::_flush_response()
@@ -326,10 +357,23 @@ void mgHttpClient::_flush_response()
 void mgHttpClient::close()
 {
     Debug_println("mgHttpClient::close");
+    _close_connection();
+    mg_iobuf_del(&_body, 0, _body.len);
     _stored_headers.clear();
     _request_headers.clear();
 }
 
+// Closes the current connection right away, its events won't mix with the next one's
+void mgHttpClient::_close_connection()
+{
+    if (_conn == nullptr || _handle == nullptr)
+        return;
+
+    _conn->is_closing = 1;
+    while (_conn != nullptr)
+        mg_mgr_poll(_handle.get(), 0);
+}
+
 void mgHttpClient::handle_connect(struct mg_connection *c)
 {
 #ifdef VERBOSE_HTTP
@@ -438,53 +482,20 @@ void mgHttpClient::handle_connect(struct mg_connection *c)
     }
 }
 
-void mgHttpClient::deepCopyHttpMessage(const struct mg_http_message *src, struct mg_http_message *dest) {
-    // First, shallow copy the entire struct to copy over the non-pointer fields
-    *dest = *src;
-
-    // Now, deep copy each mg_str field that contains a pointer
-    dest->method.ptr = util_strndup(src->method.ptr, src->method.len);
-    dest->uri.ptr = util_strndup(src->uri.ptr, src->uri.len);
-    dest->query.ptr = util_strndup(src->query.ptr, src->query.len);
-    dest->proto.ptr = util_strndup(src->proto.ptr, src->proto.len);
-    dest->body.ptr = util_strndup(src->body.ptr, src->body.len);
-    dest->head.ptr = util_strndup(src->head.ptr, src->head.len);
-    dest->message.ptr = util_strndup(src->message.ptr, src->message.len);
-
-    // Deep copy headers array
-    for (int i = 0; i < MG_MAX_HTTP_HEADERS && src->headers[i].name.len > 0; ++i) {
-        dest->headers[i].name.ptr = util_strndup(src->headers[i].name.ptr, src->headers[i].name.len);
-        dest->headers[i].value.ptr = util_strndup(src->headers[i].value.ptr, src->headers[i].value.len);
-    }
-}
-
-void mgHttpClient::freeHttpMessage(struct mg_http_message *msg) {
-    // Free each allocated string
-    free((void*)msg->method.ptr);
-    free((void*)msg->uri.ptr);
-    free((void*)msg->query.ptr);
-    free((void*)msg->proto.ptr);
-    free((void*)msg->body.ptr);
-    free((void*)msg->head.ptr);
-    free((void*)msg->message.ptr);
-
-    // Free headers
-    for (int i = 0; i < MG_MAX_HTTP_HEADERS && msg->headers[i].name.len > 0; ++i) {
-        free((void*)msg->headers[i].name.ptr);
-        free((void*)msg->headers[i].value.ptr);
-    }
-}
-
-void mgHttpClient::send_data(struct mg_http_message *hm, int status_code)
+/*
+ Parses the status line and headers where they were received, only the
+ headers asked for with create_empty_stored_headers() are copied
+*/
+void mgHttpClient::handle_headers(struct mg_connection *c, struct mg_http_message *hm)
 {
+    _status_code = mg_http_status(hm);
+
 #ifdef VERBOSE_HTTP
-    Debug_printf("mgHttpClient: send_data\n");
+    Debug_printf("mgHttpClient: handle_headers\n");
+    Debug_printf("  Status: %d\n", _status_code);
+    Debug_printf("  Headers: %lu bytes\n", (unsigned long) hm->head.len);
 #endif
 
-    // get response status code and content length
-    _status_code = status_code;
-    _content_length = (int)hm->body.len;
-
     if (_status_code == 301 || _status_code == 302)
     {
         // remember Location on redirect response
@@ -495,7 +506,7 @@ void mgHttpClient::send_data(struct mg_http_message *hm, int status_code)
 
     // get response headers client is interested in
     size_t max_headers = sizeof(hm->headers) / sizeof(hm->headers[0]);
-    for (int i = 0; i < max_headers && hm->headers[i].name.len > 0; i++) 
+    for (int i = 0; i < max_headers && hm->headers[i].name.len > 0; i++)
     {
         // Check to see if we should store this response header
         if (_stored_headers.size() <= 0)
@@ -504,118 +515,200 @@ void mgHttpClient::send_data(struct mg_http_message *hm, int status_code)
         set_header_value(&hm->headers[i].name, &hm->headers[i].value);
     }
 
-    // allocate buffer for received data
-    // realloc == malloc if first param is NULL
-    _buffer = (char *)realloc(_buffer, hm->body.len);
+    struct mg_str *te = mg_http_get_header(hm, "Transfer-Encoding");
+    _chunked = te != nullptr && mg_vcasecmp(te, "chunked") == 0;
+    _chunk_state = CHUNK_SIZE;
 
-    // copy received data into buffer
-    _buffer_pos = 0;
-    if (_buffer != nullptr) {
-        _buffer_len = hm->body.len;
-        memcpy(_buffer, hm->body.ptr, _buffer_len);
-    }
-    else {
-        _buffer_len = 0;
-        if (hm->body.len != 0) {
-            Debug_printf("mgHttpClient ERROR: buffer was not allocated for received data.");
-        }
+    struct mg_str *cl = mg_http_get_header(hm, "Content-Length");
+    _content_length = (cl != nullptr && !_chunked) ? (int)strtol(std::string(cl->ptr, cl->len).c_str(), nullptr, 10) : -1;
+
+    // Responses without a body
+    if (_method == HTTP_HEAD || _status_code < 200 || _status_code == 204 || _status_code == 304)
+    {
+        _chunked = false;
+        _content_length = 0;
     }
 
+    _headers_done = true;
+    _processed = true; // Tell _perform() the response is here, the body is read as it comes
+
+    // The body of a redirect isn't needed
+    if (!_location.empty())
+        end_body(c, false);
+    else if (_content_length == 0)
+        end_body(c, false);
 }
 
-void mgHttpClient::handle_http_msg(struct mg_connection *c, struct mg_http_message *hm)
+/*
+ Moves body data from the connection's receive buffer to the body buffer,
+ as much as fits in HTTP_STREAM_BUFFER unless all is set. What doesn't fit
+ is left in the connection, which isn't serviced until the body is read.
+*/
+void mgHttpClient::receive_body(struct mg_connection *c, bool all)
 {
-#ifdef VERBOSE_HTTP
-    Debug_printf("mgHttpClient: handle_http_msg\n");
-    Debug_printf("  Status: %.*s\n", (int) hm->uri.len, hm->uri.ptr);
-    Debug_printf("  Received: %ld\n", (unsigned long) hm->message.len);
-    Debug_printf("  Body: %ld bytes\n", (unsigned long) hm->body.len);
-#endif
-
-    int status_code = std::stoi(std::string(hm->uri.ptr, hm->uri.len));
-    send_data(hm, status_code);
+    while (c->recv.len > 0 && !_body_done)
+    {
+        size_t room = all ? c->recv.len : (_body.len < HTTP_STREAM_BUFFER ? HTTP_STREAM_BUFFER - _body.len : 0);
+        size_t used;
 
-    c->is_closing = 1;          // Tell mongoose to close this connection as it's completed
-    c->recv.len = 0;            // Reset the buffer to 0
-    _processed = true;    // Tell event loop to stop
+        if (_chunked)
+        {
+            used = receive_chunked(c->recv.buf, c->recv.len, room);
+        }
+        else
+        {
+            used = c->recv.len;
+            if (_content_length >= 0 && used > _content_length - _body_received)
+                used = _content_length - _body_received;
+            if (used > room)
+                used = room;
+            used = mg_iobuf_add(&_body, _body.len, c->recv.buf, used);
+            _body_received += used;
+
+            if (_content_length >= 0 && _body_received >= (size_t)_content_length)
+                end_body(c, false);
+        }
 
+        if (used == 0)
+            break;
+        mg_iobuf_del(&c->recv, 0, used);
+    }
 }
 
-void mgHttpClient::handle_read(struct mg_connection *c)
+/*
+ Decodes chunked transfer encoding, adding at most room bytes to the body
+ Returns the number of bytes of data used, 0 if it needs more
+*/
+size_t mgHttpClient::receive_chunked(const uint8_t *data, size_t len, size_t room)
 {
-#ifdef VERBOSE_HTTP
-    Debug_printf("mgHttpClient: handle_read\n");
-#endif
+    const uint8_t *eol;
 
-    struct mg_http_message hm;
-    int n = mg_http_parse((const char *) c->recv.buf, c->recv.len, &hm);
-    // Debug_printf("handle_read, n: %d, recv: %s, recv.len: %d, hm.body: >%s<, len: %d\n", n, c->recv.buf, c->recv.len, hm.body.ptr, hm.body.len);
-    if (hm.body.len == -1 && n > 0) {
-        // 1st block of chunked data, decode it. we abuse the string data as we'll empty it at the end anyway. sorry const
-        int decoded_len = process_chunked_data_in_place((char *) hm.body.ptr, c->recv.size);
-        if (decoded_len == 0) {
-            Debug_printf("mgHttpClient: no chunks in data, but also no content-length! quitting processing this as a block.\n");
-            return;
+    switch (_chunk_state)
+    {
+    case CHUNK_SIZE:
+    {
+        // chunk size in hex, maybe followed by extensions, and CRLF
+        if ((eol = (const uint8_t *)memchr(data, '\n', len)) == nullptr)
+        {
+            if (len > 256)
+            {
+                Debug_printf("mgHttpClient: bad chunk size line\n");
+                end_body(_conn, true);
+            }
+            return 0;
         }
-
-        // looks like it was chunked data, so continue.
-        hm.body.len = decoded_len;
-        is_chunked = true;
-
-        // Debug_printf("[1] about to send '%s' [%d]\n", hm.body.ptr, hm.body.len);
-
-        // keep a copy of the http message for subsequent blocks, we will amend its data. we need the headers kept around
-        if (current_message != nullptr) {
-            freeHttpMessage(current_message);
+        if (!isxdigit(data[0]))
+        {
+            Debug_printf("mgHttpClient: bad chunk size\n");
+            end_body(_conn, true);
+            return 0;
         }
-        current_message = (struct mg_http_message *) malloc(sizeof(struct mg_http_message));
-        deepCopyHttpMessage(&hm, current_message);
-
-        int status_code = std::stoi(std::string(current_message->uri.ptr, current_message->uri.len));
-        send_data(current_message, status_code);
+        _chunk_left = strtoul(std::string((const char *)data, eol - data).c_str(), nullptr, 16);
+        _chunk_state = _chunk_left > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+        return eol - data + 1;
+    }
 
-        // is this correct? we might get a small chunked block that is complete.
-        c->is_closing = 0;
-        c->recv.len = 0;
-        _processed = true;
+    case CHUNK_DATA:
+    {
+        size_t n = len;
+        if (n > _chunk_left)
+            n = _chunk_left;
+        if (n > room)
+            n = room;
+        n = mg_iobuf_add(&_body, _body.len, data, n);
+        _body_received += n;
+        _chunk_left -= n;
+        if (_chunk_left == 0)
+            _chunk_state = CHUNK_DATA_END;
+        return n;
+    }
 
+    case CHUNK_DATA_END:
+        // CRLF after the chunk data
+        if ((eol = (const uint8_t *)memchr(data, '\n', len)) == nullptr)
+            return 0;
+        _chunk_state = CHUNK_SIZE;
+        return eol - data + 1;
+
+    case CHUNK_TRAILER:
+        // trailer headers, up to an empty line
+        if ((eol = (const uint8_t *)memchr(data, '\n', len)) == nullptr)
+            return 0;
+        if (eol == data || (eol == data + 1 && data[0] == '\r'))
+            end_body(_conn, false);
+        return eol - data + 1;
     }
-    else if (is_chunked) {
-        // subsequent chunked data without the http header, just the data
-        if (c->recv.len > 0) {
-            // Turn the recv buffer into a processable chunk by null terminating it. This stops the chunk processing from running into old data in case this isn't the last chunk.
-            c->recv.buf[c->recv.len] = '\0';
-        }
 
-        size_t new_len = process_chunked_data_in_place((char *) c->recv.buf, c->recv.size);
+    return 0;
+}
 
-        // Allocate or reallocate memory for current_message->body.ptr to hold the new data
-        char* new_body_ptr = (char*)realloc((void*)current_message->body.ptr, new_len);
+// No more body data will come, closes the connection (it's HTTP/1.0)
+void mgHttpClient::end_body(struct mg_connection *c, bool error)
+{
+    _body_done = true;
+    _body_error = error;
+    _transaction_done = true;
+    if (c != nullptr)
+        c->is_closing = 1;
+}
 
-        // Since realloc might return a different pointer, update current_message->body.ptr
-        current_message->body.ptr = new_body_ptr;
+void mgHttpClient::handle_read(struct mg_connection *c)
+{
+#ifdef VERBOSE_HTTP
+    Debug_printf("mgHttpClient: handle_read\n");
+#endif
 
-        // Copy the processed data into the newly allocated memory
-        memcpy((void*)current_message->body.ptr, c->recv.buf, new_len);
+    if (!_headers_done)
+    {
+        struct mg_http_message hm;
+        int n = mg_http_parse((const char *) c->recv.buf, c->recv.len, &hm);
+        if (n == 0)
+            return; // Headers are not all here yet
+        if (n < 0)
+        {
+            Debug_printf("mgHttpClient: bad HTTP response\n");
+            _status_code = 901; // Fake HTTP status code to indicate connection error
+            _processed = true;
+            end_body(c, true);
+            return;
+        }
+        handle_headers(c, &hm);
+        mg_iobuf_del(&c->recv, 0, n);
+    }
 
-        // Update current_message->body.len with the new length
-        current_message->body.len = new_len;
+    receive_body(c, false);
+}
 
-        // Debug_printf("[2] about to send '%s' [%d]\n", current_message.body.ptr, current_message.body.len);
-        send_data(current_message, 200);
+void mgHttpClient::handle_close(struct mg_connection *c)
+{
+#ifdef VERBOSE_HTTP
+    Debug_printf("mgHttpClient: Connection closed\n");
+#endif
 
-        c->is_closing = c->recv.len == 0 ? 1 : 0;      // there's more data to get yet, so don't close until we have got the end of message, which is when recv.len is 0.
-        c->recv.len = 0;
-        // reset the buffer_total_read for this new block of data. If it's over the size that is subsequently requested, it'll come out of the buffer
-        _buffer_total_read = 0;
+    if (!_headers_done)
+    {
+        // Closed before a response
+        if (_status_code < 0)
+            _status_code = 901;
         _processed = true;
+        _body_done = true;
     }
-    else {
-#ifdef VERBOSE_HTTP
-        Debug_printf("mgHttpClient: handle_read ignoring this block\n");
-#endif
+    else if (!_body_done)
+    {
+        // Keep all that arrived, the receive buffer goes away with the connection
+        receive_body(c, true);
+        if (!_body_done)
+        {
+            // Without Content-Length and chunks, the body ends when the connection does
+            bool truncated = _chunked || _content_length >= 0;
+            if (truncated)
+                Debug_printf("mgHttpClient: connection closed after %lu bytes of the body\n", (unsigned long)_body_received);
+            end_body(nullptr, truncated);
+        }
     }
 
+    _transaction_done = true;
+    _conn = nullptr;
 }
 
 void report_unhandled(int ev)
@@ -675,20 +768,12 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
         client->handle_connect(c);
         break;
 
-    case MG_EV_HTTP_MSG:
-        client->handle_http_msg(c, (struct mg_http_message *) ev_data);
-        break;
-
     case MG_EV_READ:
         client->handle_read(c);
         break;
 
     case MG_EV_CLOSE:
-#ifdef VERBOSE_HTTP
-        Debug_printf("mgHttpClient: Connection closed\n");
-#endif
-        client->_transaction_done = true;
-        client->is_chunked = false;
+        client->handle_close(c);
         break;
     
     case MG_EV_ERROR:
@@ -708,7 +793,8 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
 
     }
 
-    client->_progressed = progress;
+    if (progress)
+        client->_progressed = true;
 
 }
 
@@ -725,25 +811,21 @@ int mgHttpClient::_perform()
     // We want to process the response body (if any)
     _ignore_response_body = false;
 
-    _processed = false;
-    _progressed = false;
     _redirect_count = 0;
     bool done = false;
 
-    uint64_t ms_update = fnSystem.millis();
-    // create client connection if this is a new request. If we were in the middle of processing chunks, we don't redo it.
-    if (_transaction_done) {
-        _perform_connect();
-    }
+    // create client connection, the response of a previous request is dropped
+    _perform_connect();
 
     while (!done)
     {
+        uint64_t ms_update = fnSystem.millis();
         while (!_processed)
         {
+            _progressed = false;
             mg_mgr_poll(_handle.get(), 50);
             if (_progressed)
             {
-                _progressed = false;
                 ms_update = fnSystem.millis();
             }
             else 
@@ -756,6 +838,7 @@ int mgHttpClient::_perform()
         if (!_processed)
         {
             Debug_printf("Timed-out waiting for HTTP response\n");
+            _close_connection();
             _status_code = 408; // 408 Request Timeout
         }
 
@@ -775,7 +858,6 @@ int mgHttpClient::_perform()
                     _url = _location;
                     _location.clear();
                     // need more processing
-                    _processed = false;
                     done = false;
                     // create new connection
                     _perform_connect();
@@ -795,7 +877,7 @@ int mgHttpClient::_perform()
     int status = _status_code;
     int length = _content_length;
 
-    Debug_printf("%08lx _perform status = %d, length = %d, chunked = %d\n", (unsigned long)fnSystem.millis(), status, length, is_chunked ? 1 : 0);
+    Debug_printf("%08lx _perform status = %d, length = %d, chunked = %d\n", (unsigned long)fnSystem.millis(), status, length, _chunked ? 1 : 0);
     return status;
 }
 
@@ -804,12 +886,31 @@ int mgHttpClient::_perform()
  */
 void mgHttpClient::_perform_connect()
 {
+    _close_connection();
+
     _status_code = -1;
-    _content_length = 0;
-    _buffer_len = 0;
-    _buffer_total_read = 0;
-    
-    mg_http_connect(_handle.get(), _url.c_str(), _httpevent_handler, this);  // Create client connection
+    _content_length = -1;
+    _processed = false;
+    _headers_done = false;
+    _body_done = false;
+    _body_error = false;
+    _body_received = 0;
+    _body_read = 0;
+    _chunked = false;
+    mg_iobuf_del(&_body, 0, _body.len);
+    _location.clear();
+    _transaction_done = false;
+
+    // Plain connection, the response is parsed here as it arrives
+    _conn = mg_connect(_handle.get(), _url.c_str(), _httpevent_handler, this);  // Create client connection
+    if (_conn == nullptr)
+    {
+        Debug_printf("mgHttpClient: failed to connect\n");
+        _status_code = 901;
+        _processed = true;
+        _body_done = true;
+        _transaction_done = true;
+    }
 }
 
 int mgHttpClient::PUT(const char *put_data, int put_datalen)
@@ -996,77 +1097,4 @@ void mgHttpClient::set_header_value(const struct mg_str *name, const struct mg_s
     }
 }
 
-/*
- * Replaces a piece of chunked html (with size and data) with just the data.
- * Works for multiple blocks.
- * Also ignores any CHUNK EXTENSIONS, e.g. D;foo=bar;baz;qux=123\r\n
- * 
- * Data is only changed if any valid chunk blocks are detected within the upper_bound size given.
- * If none are found, 0 is returned and data is untouched.
- * 
- */
-size_t mgHttpClient::process_chunked_data_in_place(char* data, size_t upper_bound) {
-    if (!std::isxdigit(data[0])) {
-        return 0; // Not chunk-encoded data
-    }
-
-    std::string decoded_data; // Accumulate decoded chunks here
-    char* input_ptr = data;
-    size_t processed_length = 0; // Track how much of the input we have processed
-
-    while (processed_length < upper_bound) {
-        char* end_of_chunk_size_line = strstr(input_ptr, "\r\n");
-        if (!end_of_chunk_size_line) {
-            // No complete chunk size line found
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        char* semicolon_pos = strchr(input_ptr, ';');
-        if (semicolon_pos && semicolon_pos < end_of_chunk_size_line) {
-            *semicolon_pos = '\0'; // Ignore extensions for simplicity
-        } else {
-            *end_of_chunk_size_line = '\0';
-        }
-
-        unsigned int chunk_size;
-        if (sscanf(input_ptr, "%x", &chunk_size) != 1) {
-            // Failed to parse chunk size
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        // Restore the modified character
-        if (semicolon_pos && semicolon_pos < end_of_chunk_size_line) {
-            *semicolon_pos = ';';
-        } else {
-            *end_of_chunk_size_line = '\r';
-        }
-
-        if (chunk_size == 0) {
-            // This is the last chunk
-            break;
-        }
-
-        input_ptr = end_of_chunk_size_line + 2; // Move past the chunk size line
-        processed_length += (input_ptr - data); // Update processed length
-
-        if (processed_length + chunk_size + 2 > upper_bound || strncmp(input_ptr + chunk_size, "\r\n", 2) != 0) {
-            // No end of chunk marker or chunk data exceeds buffer
-            break; // Stop processing, but keep valid chunks processed so far
-        }
-
-        decoded_data.append(input_ptr, chunk_size); // Add chunk data to decoded_data
-        input_ptr += chunk_size + 2; // Move to the next chunk
-        processed_length += chunk_size + 2; // Update processed length
-    }
-
-    if (!decoded_data.empty()) {
-        // Replace the original buffer with the accumulated decoded data
-        memcpy(data, decoded_data.c_str(), decoded_data.size());
-        data[decoded_data.size()] = '\0'; // Null-terminate the result
-        return decoded_data.size(); // Return the length of the decoded data
-    }
-
-    return 0; // No valid chunks were processed
-}
-
 #endif // !ESP_PLATFORM
\ No newline at end of file
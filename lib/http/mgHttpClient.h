@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 #include <cstdint>
 
 #include "mongoose.h"
@@ -14,6 +15,9 @@
 // while debugging, increase timeout
 // #define HTTP_TIMEOUT 600000
 
+// max response body bytes received ahead of read(), the socket isn't read while the buffer is full
+#define HTTP_STREAM_BUFFER 16384
+
 // using namespace fujinet;
 
 // on Windows/MinGW DELETE is defined already ...
@@ -38,23 +42,32 @@ private:
 
     std::string _url;
 
-    char *_buffer; // Will be allocated to hold message received by mongoose
+    // current connection, null when there is none
+    struct mg_connection *_conn = nullptr;
 
-    // char *_dechunk_buffer; // allocated to handle dechunking
-    // will the read keep returning the old data? or can we detect and move on? the service won't be repeating, so we need to reset buffer correctly after dechunking
-    // uint16_t old_chunk_length = 0;
+    // response body received but not read yet, a FIFO of at most HTTP_STREAM_BUFFER bytes
+    struct mg_iobuf _body = {nullptr, 0, 0, MG_IO_SIZE};
+    bool _headers_done = false; // status line and headers were parsed
+    bool _body_done = true;     // nothing more will be added to _body
+    bool _body_error = false;   // the body ended before it was complete
+    size_t _body_received = 0;  // bytes of the body received, after dechunking
+    size_t _body_read = 0;      // bytes of the body returned by read()
 
-    int _buffer_pos;
-    int _buffer_len;
-    int _buffer_total_read;
+    // chunked transfer encoding decoder
+    enum chunk_state
+    {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILER
+    };
+    bool _chunked = false;
+    chunk_state _chunk_state = CHUNK_SIZE;
+    size_t _chunk_left = 0;
 
-    // TaskHandle_t _taskh_consumer = nullptr;
-    // TaskHandle_t _taskh_subtask = nullptr;
     bool _processed;
     bool _progressed;
 
-    // bool _chunked;
-
     bool _ignore_response_body = false;
     bool _transaction_begin;
     bool _transaction_done = true;
@@ -70,7 +83,7 @@ private:
     // esp_http_client_handle_t _handle = nullptr;
     std::unique_ptr<mg_mgr, MgMgrDeleter> _handle;
 
-    // http response status code and content length
+    // http response status code and content length, -1 if the server didn't send it
     int _status_code;
     int _content_length;
 
@@ -110,18 +123,17 @@ private:
 
     int _perform();
     void _perform_connect();
-    // int _perform_stream(esp_http_client_method_t method, uint8_t *write_data, int write_size);
+    void _close_connection();
+    bool _poll(int timeout_ms);
 
-    bool is_chunked = false;
-    size_t process_chunked_data_in_place(char* data, size_t upper_bound);
     void handle_connect(struct mg_connection *c);
-    void handle_http_msg(struct mg_connection *c, struct mg_http_message *hm);
     void handle_read(struct mg_connection *c);
-    void send_data(struct mg_http_message *hm, int status_code);
+    void handle_close(struct mg_connection *c);
+    void handle_headers(struct mg_connection *c, struct mg_http_message *hm);
+    void receive_body(struct mg_connection *c, bool all);
+    size_t receive_chunked(const uint8_t *data, size_t len, size_t room);
+    void end_body(struct mg_connection *c, bool error);
 
-    void deepCopyHttpMessage(const struct mg_http_message *src, struct mg_http_message *dest);
-    void freeHttpMessage(struct mg_http_message *msg);
-    struct mg_http_message *current_message = nullptr;
     std::string certDataStorage; // Store the processed certificate data
 
 public:
@@ -21,6 +21,8 @@
 #include "httpServiceConfigurator.h"
 #include "httpServiceParser.h"
 #include "httpServiceBrowser.h"
+#include "busMetrics.h"
+#include "fujiImageIndex.h"
 
 #include "../../include/debug.h"
 
@@ -395,6 +397,48 @@ int fnHttpService::get_handler_browse(mg_connection *c, mg_http_message *hm)
     return 0;
 }
 
+/*
+ Searches the image index: /search?q=<name>[&prefix=1][&slot=<1..8>]
+ or starts a new crawl of all hosts: /search?rebuild=1
+*/
+int fnHttpService::get_handler_image_index(mg_connection *c, mg_http_message *hm)
+{
+    char query[MAX_FILENAME_LEN] = "";
+    char prefix[3] = "", slot[3] = "", rebuild[3] = "";
+    mg_http_get_var(&hm->query, "q", query, sizeof(query));
+    mg_http_get_var(&hm->query, "prefix", prefix, sizeof(prefix));
+    mg_http_get_var(&hm->query, "slot", slot, sizeof(slot));
+    mg_http_get_var(&hm->query, "rebuild", rebuild, sizeof(rebuild));
+
+    if (atoi(rebuild))
+        imageIndex.rebuild();
+
+    // slot is 1..8 like in /browse, anything else searches all hosts
+    int host_slot = atoi(slot) - 1;
+    if (host_slot >= MAX_HOSTS)
+        host_slot = -1;
+
+    std::vector<fujiImageIndex::result> results;
+    imageIndex.search(query, atoi(prefix) != 0, host_slot, INDEX_MAX_RESULTS, results);
+
+    char buf[MAX_PATHLEN * 2 + 128];
+    mg_snprintf(buf, sizeof(buf), "{\"files\":%lu,\"crawling\":%s,\"results\":[",
+                (unsigned long)imageIndex.size(), imageIndex.crawling() ? "true" : "false");
+    std::string out = buf;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const fujiImageIndex::result &r = results[i];
+        mg_snprintf(buf, sizeof(buf), "%s{\"slot\":%d,\"host\":%m,\"path\":%m,\"size\":%lu,\"modified\":%lu,\"type\":%m}",
+                    i ? "," : "", r.host_slot + 1, MG_ESC(r.host.c_str()), MG_ESC(r.path.c_str()),
+                    (unsigned long)r.size, (unsigned long)r.modified, MG_ESC(r.type));
+        out += buf;
+    }
+    out += "]}\n";
+
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%s", out.c_str());
+    return 0;
+}
+
 int fnHttpService::get_handler_swap(mg_connection *c, mg_http_message *hm)
 {
     // rotate disk images
@@ -538,6 +582,11 @@ void fnHttpService::cb(struct mg_connection *c, int ev, void *ev_data)
             // browse handler
             get_handler_browse(c, hm);
         }
+        else if (mg_http_match_uri(hm, "/search"))
+        {
+            // image index search
+            get_handler_image_index(c, hm);
+        }
         else if (mg_http_match_uri(hm, "/swap"))
         {
             // browse handler
@@ -553,6 +602,18 @@ void fnHttpService::cb(struct mg_connection *c, int ev, void *ev_data)
             // eject handler
             get_handler_eject(c, hm);
         }
+        else if (mg_http_match_uri(hm, "/metrics"))
+        {
+            // bus metrics in Prometheus text format
+            mg_http_reply(c, 200, "Content-Type: text/plain; version=0.0.4\r\n", "%s",
+                          fnBusMetrics.to_prometheus().c_str());
+        }
+        else if (mg_http_match_uri(hm, "/metrics.json"))
+        {
+            // bus metrics as JSON
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%s",
+                          fnBusMetrics.to_json().c_str());
+        }
         else if (mg_http_match_uri(hm, "/restart"))
         {
             // get "exit" query variable
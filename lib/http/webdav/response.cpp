@@ -1,6 +1,8 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <string.h>
 
 #include "response.h"
 
@@ -9,7 +11,6 @@ using namespace WebDav;
 void Response::setDavHeaders() {
     setHeader("DAV", "1");
     setHeader("Allow", "COPY,DELETE,GET,HEAD,LOCK,MKCOL,MOVE,OPTIONS,PROPFIND,PROPPATCH,PUT,UNLOCK");
-    setHeader("Connection", "close");
 }
 
 void Response::setHeader(std::string header, std::string value) {
@@ -25,5 +26,34 @@ void Response::setHeader(std::string header, size_t value) {
 void Response::flushHeaders() {
     for (const auto &h: headers)
         writeHeader(h.first.c_str(), h.second.c_str());
-    headers.clear();
+}
+
+bool Response::write(const char *buf, size_t len) {
+    if (wbuf == nullptr) {
+        wbuf = (char *)malloc(WRITE_BUFFER_SIZE);
+        if (wbuf == nullptr)
+            return sendChunk(buf, len);
+    }
+
+    while (len > 0) {
+        size_t n = std::min(len, WRITE_BUFFER_SIZE - wlen);
+        memcpy(wbuf + wlen, buf, n);
+        wlen += n;
+        buf += n;
+        len -= n;
+
+        if (wlen == WRITE_BUFFER_SIZE && !flushWrite())
+            return false;
+    }
+
+    return true;
+}
+
+bool Response::flushWrite() {
+    if (wlen == 0)
+        return true;
+
+    bool ok = sendChunk(wbuf, wlen);
+    wlen = 0;
+    return ok;
 }
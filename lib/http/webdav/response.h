@@ -12,7 +12,9 @@
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_201      "201 Created"
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
+#define HTTPD_206      "206 Partial Content"        /*!< HTTP Response 206 */
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_304      "304 Not Modified"           /*!< HTTP Response 304 */
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_403      "403 Forbidden"
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
@@ -21,6 +23,7 @@
 #define HTTPD_409      "409 Conflict"
 #define HTTPD_412      "412 Precondition Failed"
 #define HTTPD_415      "415 Unspported Media Type"
+#define HTTPD_416      "416 Range Not Satisfiable"
 #define HTTPD_500      "500 Internal Server Error"  /*!< HTTP Response 500 */
 #define HTTPD_501      "501 Not Implemented"
 #define HTTPD_507      "507 Insufficient Storage"
@@ -44,7 +47,7 @@ namespace WebDav
             req = httpd_req;
             setDavHeaders();
         }
-        ~Response() {}
+        ~Response() { free(wbuf); }
 
         void setDavHeaders();
         void setHeader(std::string header, std::string value);
@@ -66,9 +69,15 @@ namespace WebDav
                 case 204:
                     status = HTTPD_204;
                     break;
+                case 206:
+                    status = HTTPD_206;
+                    break;
                 case 207:
                     status = HTTPD_207;
                     break;
+                case 304:
+                    status = HTTPD_304;
+                    break;
                 case 400:
                     status = HTTPD_400;
                     break;
@@ -93,6 +102,9 @@ namespace WebDav
                 case 415:
                     status = HTTPD_415;
                     break;
+                case 416:
+                    status = HTTPD_416;
+                    break;
                 case 500:
                     status = HTTPD_500;
                     break;
@@ -130,10 +142,19 @@ namespace WebDav
 
         void closeChunk()
         {
+            flushWrite();
             httpd_resp_send_chunk(req, NULL, 0);
             chunked = false;
+            headers.clear();
         }
 
+        // Buffered chunk output, so many small pieces (e.g. PROPFIND entries)
+        // go out as a few full-size chunks instead of one chunk each
+        bool write(const char *buf, size_t len);
+        bool write(const char *buf) { return write(buf, strlen(buf)); }
+        bool write(const std::string &s) { return write(s.data(), s.size()); }
+        bool flushWrite();
+
         void sendBody(const char *buf, ssize_t len = -1)
         {
             httpd_resp_send(req, buf, len);
@@ -144,6 +165,7 @@ namespace WebDav
             //Debug_printv("chunked[%d]", chunked);
             //if (!chunked)
                 httpd_resp_send(req, "", 0);
+            headers.clear();
         }
 
 private:
@@ -156,6 +178,12 @@ private:
         httpd_req_t *req;
         bool chunked = false;
 
+        static const size_t WRITE_BUFFER_SIZE = 1400;
+        char *wbuf = nullptr;
+        size_t wlen = 0;
+
+        // httpd_resp_set_hdr() keeps pointers to these, so they stay until
+        // the response has been sent by closeChunk() or closeBody()
         std::map<std::string, std::string> headers;
     };
 
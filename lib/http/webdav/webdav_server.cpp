@@ -11,12 +11,18 @@
 #include <sys/stat.h>
 #include <cctype>
 #include <iomanip>
+#include <time.h>
+#include <algorithm>
 
 #include "file-utils.h"
 #include "string_utils.h"
 
 using namespace WebDav;
 
+// A literal, so the multipart Content-Type can be one too: httpd only keeps
+// a pointer to it until the headers are sent
+#define BYTERANGES_BOUNDARY "FUJINET_BYTERANGES"
+
 Server::Server(std::string rootURI, std::string rootPath) : rootURI(rootURI), rootPath(rootPath)  {}
 
 std::string Server::uriToPath(std::string uri)
@@ -54,33 +60,194 @@ std::string Server::formatTime(time_t t)
     return std::string(buf);
 }
 
-static void xmlElement(std::ostringstream &s, const char *name, const char *value)
+std::string Server::formatETag(const struct stat &sb)
 {
-    s << "<" << name << ">" << value << "</" << name << ">\r\n";
+    // Inode alone is not enough: FAT reports the same (or no) inode number
+    // for a file rewritten in place, so include size and mtime as well
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx\"",
+             (unsigned long)sb.st_ino, (unsigned long)sb.st_mtime, (unsigned long)sb.st_size);
+
+    return std::string(buf);
 }
 
-void Server::sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr)
+// RFC 9110 13.1.2: If-None-Match takes precedence over If-Modified-Since
+bool Server::isNotModified(Request &req, const struct stat &sb)
 {
-    std::ostringstream s;
+    std::string inm = req.getHeader("If-None-Match");
+    if (!inm.empty())
+    {
+        std::string etag = formatETag(sb);
+        for (auto tag : mstr::split(inm, ','))
+        {
+            mstr::trim(tag);
+            if (mstr::startsWith(tag, "W/"))
+                tag = tag.substr(2);
+            if (tag == "*" || tag == etag)
+                return true;
+        }
+        return false;
+    }
 
-    s << "<D:response xmlns:esp=\"DAV:\">\r\n";
-    xmlElement(s, "D:href", msr.href.c_str());
-    s << "<D:propstat>\r\n";
-    xmlElement(s, "D:status", msr.status.c_str());
+    std::string ims = req.getHeader("If-Modified-Since");
+    if (!ims.empty())
+    {
+        if (ims == formatTime(sb.st_mtime))
+            return true;
 
-    s << "<D:prop>\r\n";
-    for (const auto &p : msr.props)
-        xmlElement(s, p.first.c_str(), p.second.c_str());
+        struct tm tm = {};
+        if (strptime(ims.c_str(), "%a, %d %b %Y %H:%M:%S", &tm) != nullptr)
+        {
+            tm.tm_isdst = -1;
+            return sb.st_mtime <= mktime(&tm);
+        }
+    }
+
+    return false;
+}
+
+// Fills ranges with the satisfiable byte ranges of a "Range: bytes=..." header.
+// An empty list means the whole file should be sent. Returns false if the
+// header is valid but none of its ranges can be satisfied (416).
+bool Server::parseRange(Request &req, const struct stat &sb, std::vector<ByteRange> &ranges)
+{
+    const size_t maxRanges = 16;
+
+    ranges.clear();
+
+    std::string range = req.getHeader("Range");
+    if (range.empty() || !mstr::startsWith(range, "bytes="))
+        return true;
+
+    // A stale If-Range validator means the client wants the whole new file
+    std::string ifRange = req.getHeader("If-Range");
+    if (!ifRange.empty() && ifRange != formatETag(sb) && ifRange != formatTime(sb.st_mtime))
+        return true;
+
+    off_t size = sb.st_size;
+    bool requested = false;
+
+    for (auto spec : mstr::split(range.substr(6), ','))
+    {
+        mstr::trim(spec);
+
+        size_t dash = spec.find('-');
+        if (spec.empty() || dash == std::string::npos)
+        {
+            ranges.clear();
+            return true;
+        }
+
+        char *end;
+        ByteRange r;
+
+        if (dash == 0)
+        {
+            // Suffix range: last N bytes
+            off_t n = strtoll(spec.c_str() + 1, &end, 10);
+            if (*end != '\0')
+            {
+                ranges.clear();
+                return true;
+            }
+            requested = true;
+            if (n == 0 || size == 0)
+                continue;
+            r.first = (n < size) ? size - n : 0;
+            r.last = size - 1;
+        }
+        else
+        {
+            r.first = strtoll(spec.c_str(), &end, 10);
+            if (end != spec.c_str() + dash)
+            {
+                ranges.clear();
+                return true;
+            }
 
-    xmlElement(s, "esp:resourcetype", msr.isCollection ? "<D:collection/>" : "");
-    s << "</D:prop>\r\n";
+            if (dash + 1 < spec.length())
+            {
+                r.last = strtoll(spec.c_str() + dash + 1, &end, 10);
+                if (*end != '\0' || r.last < r.first)
+                {
+                    ranges.clear();
+                    return true;
+                }
+            }
+            else
+                r.last = size - 1;
+
+            requested = true;
+            if (r.first >= size)
+                continue;
+            if (r.last >= size)
+                r.last = size - 1;
+        }
 
-    s << "</D:propstat>\r\n";
-    s << "</D:response>\r\n";
+        // Too many pieces isn't worth serving as multipart, send it all
+        if (ranges.size() == maxRanges)
+        {
+            ranges.clear();
+            return true;
+        }
 
-    //Debug_printv("[%s]", s.str().c_str());
+        ranges.push_back(r);
+    }
 
-    resp.sendChunk(s.str().c_str());
+    return !requested || !ranges.empty();
+}
+
+bool Server::sendFileRange(Response &resp, FILE *f, char *buf, size_t bufSize, const ByteRange &range)
+{
+    if (!resp.flushWrite())
+        return false;
+
+    if (fseek(f, range.first, SEEK_SET) != 0)
+        return false;
+
+    off_t remaining = range.last - range.first + 1;
+    while (remaining > 0)
+    {
+        size_t r = fread(buf, 1, std::min((off_t)bufSize, remaining), f);
+        if (r == 0)
+            return false;
+
+        if (!resp.sendChunk(buf, r))
+            return false;
+
+        remaining -= r;
+    }
+
+    return true;
+}
+
+static void xmlElement(Response &resp, const char *name, const char *value)
+{
+    resp.write("<");
+    resp.write(name);
+    resp.write(">");
+    resp.write(value);
+    resp.write("</");
+    resp.write(name);
+    resp.write(">\r\n");
+}
+
+void Server::sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr)
+{
+    resp.write("<D:response xmlns:esp=\"DAV:\">\r\n");
+    xmlElement(resp, "D:href", msr.href.c_str());
+    resp.write("<D:propstat>\r\n");
+    xmlElement(resp, "D:status", msr.status.c_str());
+
+    resp.write("<D:prop>\r\n");
+    for (const auto &p : msr.props)
+        xmlElement(resp, p.first.c_str(), p.second.c_str());
+
+    xmlElement(resp, "esp:resourcetype", msr.isCollection ? "<D:collection/>" : "");
+    resp.write("</D:prop>\r\n");
+
+    resp.write("</D:propstat>\r\n");
+    resp.write("</D:response>\r\n");
 }
 
 int Server::sendPropResponse(Response &resp, std::string path, int recurse)
@@ -94,6 +261,7 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse)
     MultiStatusResponse r;
 
     r.href = uri;
+    r.isCollection = false;
 
     if ( exists )
     {
@@ -113,7 +281,7 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse)
         {
             r.props["esp:getcontentlength"] = std::to_string(sb.st_size);
             r.props["esp:getcontenttype"] = HTTPD_TYPE_OCTET;
-            r.props["esp:getetag"] = std::to_string(sb.st_ino);
+            r.props["esp:getetag"] = formatETag(sb);
         }
         //Debug_printv("Found!");
     }
@@ -228,42 +396,88 @@ int Server::doGet(Request &req, Response &resp)
     if ((sb.st_mode & S_IFMT) == S_IFDIR)
         return 405;
 
+    resp.setHeader("ETag", formatETag(sb));
+    resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
+    resp.setHeader("Accept-Ranges", "bytes");
+
+    if (isNotModified(req, sb))
+        return 304;
+
+    std::vector<ByteRange> ranges;
+    if (!parseRange(req, sb, ranges))
+    {
+        resp.setHeader("Content-Range", "bytes */" + std::to_string(sb.st_size));
+        return 416;
+    }
+
     // Send File
     FILE *f = fopen(path.c_str(), "r");
     if (!f)
         return 404;
 
-    resp.setHeader("Content-Length", sb.st_size);
-    resp.setHeader("ETag", sb.st_ino);
-    resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
-    resp.setHeader("Connection","close");
-
-    ret = 0;
-
     const int chunkSize = 8192;
     char *chunk = (char *)malloc(chunkSize);
+    if (!chunk)
+    {
+        fclose(f);
+        return 500;
+    }
+
+    ret = ranges.empty() ? 200 : 206;
+    resp.setStatus(ret);
+
+    bool ok = true;
 
-    for (;;)
+    if (ranges.size() > 1)
     {
-        size_t r = fread(chunk, 1, chunkSize, f);
-        if (r <= 0)
-            break;
+        resp.setContentType("multipart/byteranges; boundary=" BYTERANGES_BOUNDARY);
+        resp.flushHeaders();
 
-        if (!resp.sendChunk(chunk, r))
+        for (const auto &r : ranges)
         {
-            ret = -1;
-            break;
+            char part[128];
+            snprintf(part, sizeof(part),
+                     "\r\n--%s\r\nContent-Type: " HTTPD_TYPE_OCTET "\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                     BYTERANGES_BOUNDARY, (long long)r.first, (long long)r.last, (long long)sb.st_size);
+            resp.write(part);
+
+            if (!(ok = sendFileRange(resp, f, chunk, chunkSize, r)))
+                break;
+        }
+
+        if (ok)
+        {
+            resp.write("\r\n--");
+            resp.write(BYTERANGES_BOUNDARY);
+            resp.write("--\r\n");
         }
     }
+    else
+    {
+        ByteRange whole = {0, sb.st_size - 1};
+        const ByteRange &r = ranges.empty() ? whole : ranges[0];
+
+        if (!ranges.empty())
+        {
+            char range[80];
+            snprintf(range, sizeof(range), "bytes %lld-%lld/%lld",
+                     (long long)r.first, (long long)r.last, (long long)sb.st_size);
+            resp.setHeader("Content-Range", range);
+        }
+        resp.setContentType(HTTPD_TYPE_OCTET);
+        resp.flushHeaders();
+
+        ok = sendFileRange(resp, f, chunk, chunkSize, r);
+    }
 
     free(chunk);
     fclose(f);
     resp.closeChunk();
 
-    if (ret != 0)
+    if (!ok)
         return 500;
 
-    return 200;
+    return ret;
 }
 
 int Server::doHead(Request &req, Response &resp)
@@ -278,8 +492,12 @@ int Server::doHead(Request &req, Response &resp)
         return 404;
 
     resp.setHeader("Content-Length", sb.st_size);
-    resp.setHeader("ETag", sb.st_ino);
+    resp.setHeader("ETag", formatETag(sb));
     resp.setHeader("Last-Modified", formatTime(sb.st_mtime));
+    resp.setHeader("Accept-Ranges", "bytes");
+
+    if (isNotModified(req, sb))
+        return 304;
 
     return 200;
 }
@@ -392,11 +610,11 @@ int Server::doPropfind(Request &req, Response &resp)
     resp.setContentType("application/xml;charset=utf-8");
     resp.flushHeaders();
 
-    resp.sendChunk("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n");
-    resp.sendChunk("<D:multistatus xmlns:D=\"DAV:\">\r\n");
+    resp.write("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n");
+    resp.write("<D:multistatus xmlns:D=\"DAV:\">\r\n");
 
     sendPropResponse(resp, path, recurse);
-    resp.sendChunk("</D:multistatus>\r\n");
+    resp.write("</D:multistatus>\r\n");
     resp.closeChunk();
 
     return 207;
@@ -454,9 +672,6 @@ int Server::doPut(Request &req, Response &resp)
 
     free(chunk);
     fclose(f);
-    resp.closeChunk();
-
-    resp.setHeader("Connection","close");
 
     if (ret < 0)
         return 500;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <sys/stat.h>
+#include <vector>
+
 #include "request.h"
 #include "response.h"
 
@@ -29,7 +32,16 @@ public:
 private:
         std::string rootURI, rootPath;
 
+        struct ByteRange {
+                off_t first;
+                off_t last;
+        };
+
         std::string formatTime(time_t t);
+        std::string formatETag(const struct stat &sb);
+        bool isNotModified(Request &req, const struct stat &sb);
+        bool parseRange(Request &req, const struct stat &sb, std::vector<ByteRange> &ranges);
+        bool sendFileRange(Response &resp, FILE *f, char *buf, size_t bufSize, const ByteRange &range);
         int sendPropResponse(Response &resp, std::string path, int recurse);
         void sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr);
 };
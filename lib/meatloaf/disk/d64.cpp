@@ -1,6 +1,8 @@
 
 #include "d64.h"
 
+#include <string.h>
+
 //#include "meat_broker.h"
 #include "endianness.h"
 
@@ -33,15 +35,13 @@ bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
 
     // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
 
-    return containerStream->seek((index * block_size) + offset);
+    return seekContainer((index * block_size) + offset);
 }
 
-bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
+int32_t D64MStream::blockIndex(uint8_t track, uint8_t sector)
 {
     uint16_t sectorOffset = 0;
 
-    //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
-
     // Is this a valid track?
     uint16_t c = partitions[partition].block_allocation_map.size() - 1;
     uint8_t start_track = partitions[partition].block_allocation_map[0].start_track;
@@ -49,7 +49,7 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
     if (track < start_track || track > end_track)
     {
         Debug_printv("Invalid Track: track[%d] start_track[%d] end_track[%d]", track, start_track, end_track);
-        return false;
+        return -1;
     }
 
     // Is this a valid sector?
@@ -57,17 +57,25 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
     if (sector > c)
     {
         Debug_printv("Invalid Sector: sector[%d] sectorsPerTrack[%d]", sector, c);
-        return false;
+        return -1;
     }
 
-    track--;
-    for (uint8_t index = 0; index < track; ++index)
+    for (uint8_t index = 1; index < track; ++index)
     {
-        sectorOffset += getSectorCount(index + 1);
-        //Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", (index + 1), speedZone(index), getSectorCount(index + 1), sectorOffset);
+        sectorOffset += getSectorCount(index);
+        //Debug_printv("track[%d] speedZone[%d] secotorsPerTrack[%d] sectorOffset[%d]", index, speedZone(index), getSectorCount(index), sectorOffset);
     }
-    track++;
-    sectorOffset += sector;
+
+    return sectorOffset + sector;
+}
+
+bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
+{
+    //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
+
+    int32_t sectorOffset = blockIndex(track, sector);
+    if (sectorOffset < 0)
+        return false;
 
     this->block = sectorOffset;
     this->track = track;
@@ -75,7 +83,7 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 
     //Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
 
-    return containerStream->seek((sectorOffset * block_size) + offset);
+    return seekContainer((sectorOffset * block_size) + offset);
 }
 
 bool D64MStream::seekSector(std::vector<uint8_t> trackSectorOffset)
@@ -88,6 +96,148 @@ std::string D64MStream::readBlock(uint8_t track, uint8_t sector)
     return "";
 }
 
+const uint8_t *D64MStream::cachedSector(uint8_t track, uint8_t sector)
+{
+    int32_t block = blockIndex(track, sector);
+    if (block < 0)
+        return nullptr;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t slot = 0; slot < cache_block.size(); slot++)
+        {
+            if (cache_block[slot] == block)
+            {
+                cache_used[slot] = ++cache_clock;
+                return &cache_data[slot * block_size];
+            }
+        }
+
+        if (pass == 0 && !fillCache(track, sector))
+            break;
+    }
+
+    return nullptr;
+}
+
+bool D64MStream::fillCache(uint8_t track, uint8_t sector)
+{
+    if (cache_block.empty())
+    {
+        cache_data.resize(D64_SECTOR_CACHE_BLOCKS * block_size);
+        cache_block.assign(D64_SECTOR_CACHE_BLOCKS, -1);
+        cache_used.assign(D64_SECTOR_CACHE_BLOCKS, 0);
+    }
+
+    // Files and the directory mostly continue on the same track, so read the whole
+    // track (or as much of it as allowed from the requested sector on) with one seek
+    uint16_t count = getSectorCount(track);
+    uint16_t first = (count <= D64_PREFETCH_BLOCKS || sector >= count) ? 0 : sector;
+    uint16_t blocks = std::min(count - first, D64_PREFETCH_BLOCKS);
+    if (sector >= first + blocks)
+    {
+        // Sector number past the end of the track, see the check in blockIndex()
+        first = sector;
+        blocks = 1;
+    }
+
+    int32_t first_block = blockIndex(track, first);
+    if (first_block < 0 || !seekContainer(first_block * block_size))
+        return false;
+
+    std::vector<uint8_t> run(blocks * block_size);
+    uint32_t r = readContainer(run.data(), run.size());
+    blocks = r / block_size;
+    Debug_printv("track[%d] sector[%d] blocks[%d]", track, first, blocks);
+
+    for (uint16_t i = 0; i < blocks; i++)
+    {
+        int32_t block = first_block + i;
+
+        // Replace the same block or the least recently used one
+        size_t slot = 0;
+        for (size_t j = 0; j < cache_block.size(); j++)
+        {
+            if (cache_block[j] == block)
+            {
+                slot = j;
+                break;
+            }
+            if (cache_used[j] < cache_used[slot])
+                slot = j;
+        }
+
+        memcpy(&cache_data[slot * block_size], &run[i * block_size], block_size);
+        cache_block[slot] = block;
+        cache_used[slot] = ++cache_clock;
+    }
+
+    return blocks > 0;
+}
+
+size_t D64MStream::footprint()
+{
+    return MMediaStream::footprint() + cache_data.capacity() +
+           (cache_block.capacity() + cache_used.capacity()) * sizeof(uint32_t) +
+           dir_index.capacity() * sizeof(IndexEntry) +
+           dir_names.size() * (sizeof(std::string) + sizeof(uint16_t) + 32);
+}
+
+std::string D64MStream::entryName(const Entry &e)
+{
+    std::string name(e.filename, strnlen(e.filename, sizeof(e.filename)));
+    mstr::rtrimA0(name);
+    return mstr::toUTF8(name);
+}
+
+bool D64MStream::buildIndex()
+{
+    dir_index.clear();
+    dir_names.clear();
+    dir_partition = partition;
+
+    uint8_t t = partitions[partition].directory_track;
+    uint8_t s = partitions[partition].directory_sector;
+
+    // A damaged directory chain could loop, it can't be longer than the image
+    uint32_t max_blocks = containerStream->size() / block_size;
+    for (uint32_t n = 0; t != 0 && n < max_blocks; n++)
+    {
+        const uint8_t *data = cachedSector(t, s);
+        if (data == nullptr)
+            break;
+
+        // 8 Entries Per Sector, 32 bytes Per Entry
+        for (uint16_t offset = 0; offset + sizeof(Entry) <= block_size; offset += 32)
+        {
+            IndexEntry e;
+            memcpy(&e.entry, data + offset, sizeof(Entry));
+            e.track = t;
+            e.sector = s;
+            dir_names.emplace(entryName(e.entry), dir_index.size());
+            dir_index.push_back(e);
+        }
+
+        t = data[0];
+        s = data[1];
+    }
+
+    Debug_printv("entries[%d]", dir_index.size());
+    return !dir_index.empty();
+}
+
+void D64MStream::seekHeader()
+{
+    const uint8_t *data = cachedSector(
+        partitions[partition].header_track,
+        partitions[partition].header_sector);
+
+    if (data != nullptr && partitions[partition].header_offset + sizeof(header) <= block_size)
+        memcpy(&header, data + partitions[partition].header_offset, sizeof(header));
+    else
+        memset(&header, 0, sizeof(header));
+}
+
 bool D64MStream::writeBlock(uint8_t track, uint8_t sector, std::string data)
 {
     return true;
@@ -196,44 +346,40 @@ bool D64MStream::isBlockFree(uint8_t track, uint8_t sector)
 
 bool D64MStream::seekEntry(std::string filename)
 {
-    uint16_t index = 1;
     mstr::replaceAll(filename, "\\", "/");
     bool wildcard = (mstr::contains(filename, "*") || mstr::contains(filename, "?"));
 
+    if (dir_partition != partition)
+        buildIndex();
+
     // Read Directory Entries
     if (filename.size())
     {
-        while (seekEntry(index))
+        if (!wildcard) // Match exact
         {
-            std::string entryFilename = entry.filename;
-            mstr::rtrimA0(entryFilename);
-            entryFilename = mstr::toUTF8(entryFilename);
-
-            Debug_printv("index[%d] track[%d] sector[%d] filename[%s] entry.filename[%.16s]", index, track, sector, filename.c_str(), entryFilename.c_str());
-
-            // Debug_printv("filename[%s] entry[%s]", filename.c_str(), entryFilename.c_str());
-
-            if (filename == entryFilename) // Match exact
-            {
-                return true;
-            }
-            else if (wildcard) // Wildcard Match
+            auto found = dir_names.find(filename);
+            if (found != dir_names.end())
+                return seekEntry(found->second + 1);
+        }
+        else // Wildcard Match, first entry in directory order
+        {
+            for (uint16_t index = 0; index < dir_index.size(); index++)
             {
-                if (filename == "*") // Match first PRG
+                std::string entryFilename = entryName(dir_index[index].entry);
+                if (filename == entryFilename)
+                {
+                    return seekEntry(index + 1);
+                }
+                else if (filename == "*") // Match first PRG
                 {
-                    if (entry.file_type & 0b00000111)
-                    {
-                        filename = entryFilename;
-                        return true;
-                    }
+                    if (dir_index[index].entry.file_type & 0b00000111)
+                        return seekEntry(index + 1);
                 }
                 else if (mstr::compare(filename, entryFilename)) // X?XX?X* Wildcard match
                 {
-                    return true;
+                    return seekEntry(index + 1);
                 }
             }
-
-            index++;
         }
 
         Debug_printv("File not found!");
@@ -249,71 +395,22 @@ bool D64MStream::seekEntry(std::string filename)
 
 bool D64MStream::seekEntry(uint16_t index)
 {
-    // Calculate Sector offset & Entry offset
-    // 8 Entries Per Sector, 32 bytes Per Entry
-    index--;
-    uint16_t sectorOffset = index / 8;
-    uint16_t entryOffset = (index % 8) * 32;
-
-    // Debug_printv("----------");
-    // Debug_printv("index[%d] sectorOffset[%d] entryOffset[%d] entry_index[%d]", index, sectorOffset, entryOffset, entry_index);
-
-    if (index == 0 || index != entry_index)
-    {
-        // Start at first sector of directory
-        next_track = 0;
-        if (!seekSector(
-                partitions[partition].directory_track,
-                partitions[partition].directory_sector,
-                partitions[partition].directory_offset))
-            return false;
-
-        // Find sector with requested entry
-        do
-        {
-            if (next_track)
-            {
-                Debug_printv("next_track[%d] next_sector[%d]", entry.next_track, entry.next_sector);
-                if (!seekSector(entry.next_track, entry.next_sector))
-                    return false;
-            }
-
-            readContainer((uint8_t *)&entry, sizeof(entry));
-            next_track = entry.next_track;
-            next_sector = entry.next_sector;
-
-            Debug_printv("sectorOffset[%d] -> track[%d] sector[%d]", sectorOffset, track, sector);
-
-        } while (sectorOffset-- > 0);
-        if (!seekSector(track, sector, entryOffset))
-            return false;
-    }
-    else
-    {
-        if (entryOffset == 0)
-        {
-            if (next_track == 0)
-                return false;
-
-            // Debug_printv("Follow link track[%d] sector[%d] entryOffset[%d]", next_track, next_sector, entryOffset);
-            if (!seekSector(next_track, next_sector, entryOffset))
-                return false;
-        }
-    }
+    if (dir_partition != partition)
+        buildIndex();
 
-    readContainer((uint8_t *)&entry, sizeof(entry));
+    if (index == 0 || index > dir_index.size())
+        return false;
 
-    // If we are at the first entry in the sector then get next_track/next_sector
-    if (entryOffset == 0)
-    {
-        next_track = entry.next_track;
-        next_sector = entry.next_sector;
-    }
+    const IndexEntry &e = dir_index[index - 1];
+    entry = e.entry;
+    track = e.track;
+    sector = e.sector;
+    next_track = dir_index[(index - 1) & ~7].entry.next_track;
+    next_sector = dir_index[(index - 1) & ~7].entry.next_sector;
 
-    // Debug_printv("r[%d] file_type[%02X] file_name[%.16s]", r, entry.file_type, entry.filename);
+    // Debug_printv("index[%d] track[%d] sector[%d] file_type[%02X] file_name[%.16s]", index, track, sector, entry.file_type, entry.filename);
 
-    // if ( next_track == 0 && next_sector == 0xFF )
-    entry_index = index + 1;
+    entry_index = index;
 
     return true;
 }
@@ -324,23 +421,24 @@ uint16_t D64MStream::blocksFree()
 
     for (uint8_t x = 0; x < partitions[partition].block_allocation_map.size(); x++)
     {
-        uint8_t bam[partitions[partition].block_allocation_map[x].byte_count];
-        // Debug_printv("start_track[%d] end_track[%d]", block_allocation_map[x].start_track, block_allocation_map[x].end_track);
+        auto &map = partitions[partition].block_allocation_map[x];
+        // Debug_printv("start_track[%d] end_track[%d]", map.start_track, map.end_track);
 
-        if (!seekSector(
-                partitions[partition].block_allocation_map[x].track,
-                partitions[partition].block_allocation_map[x].sector,
-                partitions[partition].block_allocation_map[x].offset))
+        const uint8_t *data = cachedSector(map.track, map.sector);
+        if (data == nullptr)
             return 0;
 
-        for (uint8_t i = partitions[partition].block_allocation_map[x].start_track; i <= partitions[partition].block_allocation_map[x].end_track; i++)
+        uint16_t offset = map.offset;
+        for (uint8_t i = map.start_track; i <= map.end_track && offset + map.byte_count <= block_size; i++)
         {
-            readContainer((uint8_t *)&bam, sizeof(bam));
-            if (sizeof(bam) > 3)
+            const uint8_t *bam = data + offset;
+            offset += map.byte_count;
+
+            if (map.byte_count > 3)
             {
                 if (i != partitions[partition].directory_track)
                 {
-                    // Debug_printv("x[%d] track[%d] count[%d] size[%d]", x, i, bam[0], sizeof(bam));
+                    // Debug_printv("x[%d] track[%d] count[%d] size[%d]", x, i, bam[0], map.byte_count);
                     free_count += bam[0];
                 }
             }
@@ -352,7 +450,7 @@ uint16_t D64MStream::blocksFree()
                 bit_count += std::bitset<8>(bam[1]).count();
                 bit_count += std::bitset<8>(bam[2]).count();
 
-                // Debug_printv("x[%d] track[%d] count[%d] size[%d] bam0[%d] bam1[%d] bam2[%d] (counting 1 bits)", x, i, bit_count, sizeof(bam), bam[0], bam[1], bam[2]);
+                // Debug_printv("x[%d] track[%d] count[%d] size[%d] bam0[%d] bam1[%d] bam2[%d] (counting 1 bits)", x, i, bit_count, map.byte_count, bam[0], bam[1], bam[2]);
                 free_count += bit_count;
             }
         }
@@ -361,45 +459,76 @@ uint16_t D64MStream::blocksFree()
     return free_count;
 }
 
-uint16_t D64MStream::readFile(uint8_t *buf, uint16_t size)
+uint32_t D64MStream::seekFileSize(uint8_t start_track, uint8_t start_sector)
 {
-
-    if (sector_offset % block_size == 0)
+    // Follow the chain through the sector cache, which also prefetches the file for readFile()
+    uint32_t max_blocks = containerStream->size() / block_size;
+    uint32_t blocks = 0;
+    uint8_t t = start_track;
+    uint8_t s = start_sector;
+    while (blocks < max_blocks)
     {
-        // We are at the beginning of the block
-        // Read track/sector link
-        readContainer((uint8_t *)&next_track, 1);
-        readContainer((uint8_t *)&next_sector, 1);
-        sector_offset += 2;
-        // Debug_printv("next_track[%d] next_sector[%d] sector_offset[%d]", next_track, next_sector, sector_offset);
+        const uint8_t *data = cachedSector(t, s);
+        if (data == nullptr)
+            break;
+
+        blocks++;
+        if (data[0] == 0)
+        {
+            // Last block, the sector byte is the offset of its last used byte
+            return ((blocks - 1) * (block_size - 2)) + (data[1] ? data[1] - 1 : 0);
+        }
+        t = data[0];
+        s = data[1];
     }
 
+    // Broken chain, count the blocks that could be read
+    return blocks * (block_size - 2);
+}
+
+uint16_t D64MStream::readFile(uint8_t *buf, uint16_t size)
+{
     uint16_t bytesRead = 0;
     if (size > available())
         size = available();
 
-    if (size > 0)
+    while (bytesRead < size)
     {
-        bytesRead += readContainer(buf, size);
-        sector_offset += bytesRead;
+        const uint8_t *data = cachedSector(track, sector);
+        if (data == nullptr)
+            break;
+
+        if (sector_offset % block_size == 0)
+        {
+            // We are at the beginning of the block
+            // Read track/sector link
+            next_track = data[0];
+            next_sector = data[1];
+            sector_offset += 2;
+            // Debug_printv("next_track[%d] next_sector[%d] sector_offset[%d]", next_track, next_sector, sector_offset);
+        }
+
+        uint16_t pos = sector_offset % block_size;
+        uint16_t count = std::min<uint16_t>(size - bytesRead, block_size - pos);
+        memcpy(buf + bytesRead, data + pos, count);
+        bytesRead += count;
+        sector_offset += count;
 
         if (sector_offset % block_size == 0)
         {
             // We are at the end of the block
             // Follow track/sector link to move to next block
-            if (!seekSector(next_track, next_sector))
-            {
-                return 0;
-            }
+            int32_t b = blockIndex(next_track, next_sector);
+            if (b < 0)
+                break;
+
+            block = b;
+            track = next_track;
+            sector = next_sector;
             // Debug_printv("track[%d] sector[%d] sector_offset[%d]", track, sector, sector_offset);
         }
     }
 
-    // if ( !bytesRead )
-    // {
-    //     sector_offset = 0;
-    // }
-
     return bytesRead;
 }
 
@@ -434,8 +563,15 @@ bool D64MStream::seekPath(std::string path)
         uint8_t s = entry.start_sector;
         _size = seekFileSize(t, s);
 
-        // Set position to beginning of file
-        bool r = seekSector(t, s);
+        // Set position to beginning of file, readFile() gets it from the sector cache
+        int32_t b = blockIndex(t, s);
+        bool r = (b >= 0);
+        if (r)
+        {
+            block = b;
+            track = t;
+            sector = s;
+        }
 
         Debug_printv("File Size: blocks[%d] size[%d] available[%d] r[%d]", entry.blocks, _size, available(), r);
 
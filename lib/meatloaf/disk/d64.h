@@ -18,6 +18,8 @@
 #include <map>
 #include <bitset>
 #include <ctime>
+#include <unordered_map>
+#include <vector>
 
 #include "../meat_media.h"
 #include "string_utils.h"
@@ -27,6 +29,11 @@
  * Streams
  ********************************************************/
 
+// Sectors kept in memory per open image, see D64MStream::cachedSector()
+#define D64_SECTOR_CACHE_BLOCKS 32
+// Most sectors of a track read from the container in one go
+#define D64_PREFETCH_BLOCKS 21
+
 class D64MStream : public MMediaStream {
 
 protected:
@@ -220,14 +227,7 @@ public:
     bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) override;
     bool seekSector( std::vector<uint8_t> trackSectorOffset ) override;
 
-    void seekHeader() override {
-        seekSector( 
-            partitions[partition].header_track, 
-            partitions[partition].header_sector, 
-            partitions[partition].header_offset 
-        );
-        containerStream->read((uint8_t*)&header, sizeof(header));
-    }
+    void seekHeader() override;
     uint16_t getSectorCount( uint16_t track )
     {
         return sectorsPerTrack[speedZone(track)];
@@ -243,6 +243,9 @@ public:
 
     virtual bool seekPath(std::string path) override;
     uint16_t readFile(uint8_t* buf, uint16_t size) override;
+    uint32_t seekFileSize( uint8_t start_track, uint8_t start_sector ) override;
+
+    size_t footprint() override;
 
     Header header;      // Directory header data
     Entry entry;        // Directory entry data
@@ -264,6 +267,31 @@ private:
     bool seekEntry( std::string filename ) override;
     bool seekEntry( uint16_t index = 0 ) override;
 
+    // Block number of track/sector in the image, -1 if it's not on the disk
+    int32_t blockIndex( uint8_t track, uint8_t sector );
+
+    // Sector contents from the cache, reading its track from the container on a miss
+    const uint8_t *cachedSector( uint8_t track, uint8_t sector );
+    bool fillCache( uint8_t track, uint8_t sector );
+
+    std::vector<uint8_t> cache_data;    // D64_SECTOR_CACHE_BLOCKS sectors
+    std::vector<int32_t> cache_block;   // block held by each slot, -1 if empty
+    std::vector<uint32_t> cache_used;   // last use of each slot, for LRU
+    uint32_t cache_clock = 0;
+
+    // Directory read once into memory, in directory order
+    struct IndexEntry {
+        Entry entry;
+        uint8_t track;
+        uint8_t sector;
+    };
+    std::vector<IndexEntry> dir_index;
+    std::unordered_map<std::string, uint16_t> dir_names; // normalised name -> first entry with that name
+    int16_t dir_partition = -1;                          // partition dir_index was built for
+
+    bool buildIndex();
+    std::string entryName( const Entry &e );
+
     std::string readBlock( uint8_t track, uint8_t sector );
     bool writeBlock( uint8_t track, uint8_t sector, std::string data );
     bool allocateBlock( uint8_t track, uint8_t sector );
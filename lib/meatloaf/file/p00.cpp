@@ -9,7 +9,7 @@
 uint16_t P00MStream::readFile(uint8_t* buf, uint16_t size) {
     uint16_t bytesRead = 0;
 
-    bytesRead += containerStream->read(buf, size);
+    bytesRead += readContainer(buf, size);
     _position += bytesRead;
 
     return bytesRead;
@@ -31,8 +31,8 @@ protected:
     };
 
     void seekHeader() override {
-        containerStream->seek(0x00);
-        containerStream->read((uint8_t*)&header, sizeof(header));
+        seekContainer(0x00);
+        readContainer((uint8_t*)&header, sizeof(header));
     }
     bool seekNextImageEntry() override {
         if ( entry_index == 0 ) {
@@ -1,6 +1,112 @@
 #include "meat_media.h"
 
-std::unordered_map<std::string, MMediaStream*> ImageBroker::repo;
+#include <algorithm>
+#include <string.h>
+
+std::unordered_map<std::string, ImageBroker::Entry> ImageBroker::repo;
+std::list<std::string> ImageBroker::lru;
+size_t ImageBroker::max_entries = IMAGE_BROKER_MAX_ENTRIES;
+size_t ImageBroker::max_bytes = IMAGE_BROKER_MAX_BYTES;
+ImageBrokerStats ImageBroker::counters;
+
+/********************************************************
+ * ImageBroker
+ ********************************************************/
+
+std::shared_ptr<MMediaStream> ImageBroker::find(const std::string &url)
+{
+    auto it = repo.find(url);
+    if (it == repo.end())
+    {
+        counters.misses++;
+        return nullptr;
+    }
+
+    counters.hits++;
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return it->second.stream;
+}
+
+void ImageBroker::add(const std::string &url, std::shared_ptr<MMediaStream> stream, size_t size)
+{
+    auto it = repo.find(url);
+    if (it != repo.end())
+        evict(it);
+
+    lru.push_front(url);
+    repo.insert(std::make_pair(url, Entry{stream, size, lru.begin()}));
+
+    // The new image is held by the caller, so this only closes older idle ones
+    trim();
+}
+
+void ImageBroker::evict(std::unordered_map<std::string, Entry>::iterator it)
+{
+    // Take the stream out first, its destructor calls back into dispose()
+    std::shared_ptr<MMediaStream> stream = std::move(it->second.stream);
+    lru.erase(it->second.lru);
+    repo.erase(it);
+    stream.reset();
+}
+
+void ImageBroker::dispose(std::string url)
+{
+    auto it = repo.find(url);
+    if (it != repo.end())
+        evict(it);
+}
+
+void ImageBroker::dispose(MMediaStream *stream)
+{
+    for (auto it = repo.begin(); it != repo.end(); ++it)
+    {
+        if (it->second.stream.get() == stream)
+        {
+            evict(it);
+            return;
+        }
+    }
+}
+
+void ImageBroker::trim(bool purge)
+{
+    size_t bytes = 0;
+    for (auto &it : repo)
+        bytes += cost(it.second);
+
+    // Oldest first, skipping images that are still in use
+    auto url = lru.end();
+    while (url != lru.begin() && (purge || repo.size() > max_entries || bytes > max_bytes))
+    {
+        --url;
+        auto it = repo.find(*url);
+        if (it->second.stream.use_count() > 1)
+            continue;
+
+        Debug_printv("evict [%s]", url->c_str());
+        bytes -= cost(it->second);
+        counters.evictions++;
+        url = std::next(url);
+        evict(it);
+    }
+}
+
+void ImageBroker::setLimits(size_t entries, size_t bytes)
+{
+    max_entries = entries;
+    max_bytes = bytes;
+    trim();
+}
+
+ImageBrokerStats ImageBroker::stats()
+{
+    ImageBrokerStats s = counters;
+    s.entries = repo.size();
+    s.bytes = 0;
+    for (auto &it : repo)
+        s.bytes += cost(it.second);
+    return s;
+}
 
 // Utility Functions
 
@@ -67,7 +173,7 @@ bool MMediaStream::open()
 void MMediaStream::close()
 {
     Debug_printv("url[%s]", url.c_str());
-    ImageBroker::dispose(url);
+    ImageBroker::dispose(this);
 };
 
 uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
@@ -91,9 +197,116 @@ uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
 };
 
 
+bool MMediaStream::fillReadBuffer()
+{
+    if (read_buffer.empty())
+        read_buffer.resize(MMEDIA_READ_BUFFER_SIZE);
+
+    // Keep what hasn't been handed out yet and read more behind it
+    size_t left = read_buffer_len - read_buffer_pos;
+    if (left == read_buffer.size())
+        return false;
+    if (left && read_buffer_pos)
+        memmove(&read_buffer[0], &read_buffer[read_buffer_pos], left);
+    if (read_buffer_start >= 0)
+        read_buffer_start += read_buffer_pos;
+    read_buffer_pos = 0;
+
+    uint32_t r = containerStream->read(&read_buffer[left], read_buffer.size() - left);
+    read_buffer_len = left + r;
+    return r > 0;
+}
+
 uint16_t MMediaStream::readContainer(uint8_t *buf, uint16_t size)
 {
-    return containerStream->read(buf, size);
+    uint16_t bytesRead = 0;
+
+    while (bytesRead < size)
+    {
+        size_t left = read_buffer_len - read_buffer_pos;
+        if (left == 0)
+        {
+            if (size - bytesRead >= MMEDIA_READ_BUFFER_SIZE)
+            {
+                // Big reads go straight to the caller
+                if (read_buffer_start >= 0)
+                    read_buffer_start += read_buffer_len;
+                read_buffer_pos = read_buffer_len = 0;
+
+                uint32_t r = containerStream->read(buf + bytesRead, size - bytesRead);
+                if (read_buffer_start >= 0)
+                    read_buffer_start += r;
+                bytesRead += r;
+                break;
+            }
+
+            if (!fillReadBuffer())
+                break;
+            continue;
+        }
+
+        size_t n = std::min<size_t>(left, size - bytesRead);
+        memcpy(buf + bytesRead, &read_buffer[read_buffer_pos], n);
+        read_buffer_pos += n;
+        bytesRead += n;
+    }
+
+    return bytesRead;
+}
+
+bool MMediaStream::seekContainer(uint32_t pos)
+{
+    // Within the window there's no need to touch the container
+    if (read_buffer_start >= 0 && pos >= read_buffer_start && pos <= read_buffer_start + read_buffer_len)
+    {
+        read_buffer_pos = pos - read_buffer_start;
+        return true;
+    }
+
+    read_buffer_pos = read_buffer_len = 0;
+    bool r = containerStream->seek(pos);
+    read_buffer_start = r ? pos : -1;
+    return r;
+}
+
+std::string_view MMediaStream::peek(size_t size)
+{
+    if (size > MMEDIA_READ_BUFFER_SIZE)
+        size = MMEDIA_READ_BUFFER_SIZE;
+
+    while (read_buffer_len - read_buffer_pos < size && fillReadBuffer())
+        ;
+
+    size = std::min(size, read_buffer_len - read_buffer_pos);
+    return std::string_view((const char *)read_buffer.data() + read_buffer_pos, size);
+}
+
+std::string_view MMediaStream::readUntilView(uint8_t delimiter, bool *found)
+{
+    size_t scanned = 0;
+    do
+    {
+        const char *start = (const char *)read_buffer.data() + read_buffer_pos;
+        size_t left = read_buffer_len - read_buffer_pos;
+        const char *hit = (const char *)memchr(start + scanned, delimiter, left - scanned);
+        if (hit != nullptr)
+        {
+            size_t n = hit - start;
+            read_buffer_pos += n + 1;
+            if (found)
+                *found = true;
+            return std::string_view(start, n);
+        }
+        scanned = left;
+    } while (fillReadBuffer()); // until the window is full or the container ends
+
+    // No delimiter within reach, hand out what there is
+    const char *start = (const char *)read_buffer.data() + read_buffer_pos;
+    size_t n = read_buffer_len - read_buffer_pos;
+    read_buffer_pos += n;
+    if (found)
+        *found = false;
+    return std::string_view(start, n);
 }
 
 
@@ -6,8 +6,11 @@
 
 #include <map>
 #include <bitset>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <sstream>
+#include <string_view>
 
 #include "../../include/debug.h"
 
@@ -18,6 +21,12 @@
  * Streams
  ********************************************************/
 
+// Estimated heap held by an open container stream (file handle or connection and its buffers)
+#define IMAGE_BROKER_CONTAINER_COST 4096
+
+// Read window for small container reads (headers, directory entries), see readContainer()
+#define MMEDIA_READ_BUFFER_SIZE 1024
+
 class MMediaStream: public MStream {
 
 public:
@@ -44,57 +53,43 @@ public:
     // read = (size) => this.containerStream.read(size);
     virtual uint8_t read() {
         uint8_t b = 0;
-        containerStream->read( &b, 1 );
+        readContainer( &b, 1 );
         _position++;
         return b;
     }
     // readUntil = (delimiter = 0x00) => this.containerStream.readUntil(delimiter);
     virtual std::string readUntil( uint8_t delimiter = 0x00 )
     {
-        uint8_t b = 0, r = 0;
-        std::string bytes = "";
-        do
+        std::string bytes;
+        bool found = false;
+        while ( !found )
         {
-            r = containerStream->read( &b, 1 );
-            if ( b != delimiter )
-            {
-                bytes += b;
-                _position++;
-            }
-            else
+            std::string_view chunk = readUntilView( delimiter, &found );
+            if ( chunk.empty() && !found )
                 break;
-        } while ( r );
-
+            bytes.append( chunk );
+        }
+        _position += bytes.size();
         return bytes;
     }
     // readString = (size) => this.containerStream.readString(size);
     virtual std::string readString( uint8_t size )
     {
-        uint8_t b[size];
-        if ( auto s = containerStream->read( b, size ) )
-        {
-            _position += s;
-            return std::string((char *)b);
-        }
-        return std::string();
+        std::string bytes( size, '\0' );
+        bytes.resize( readContainer( (uint8_t *)&bytes[0], size ) );
+        _position += bytes.size();
+        return bytes;
     }
     // readStringUntil = (delimiter = 0x00) => this.containerStream.readStringUntil(delimiter);
     virtual std::string readStringUntil( uint8_t delimiter = '\0' )
     {
-        uint8_t b[1];
-        std::stringstream ss;
-        while( containerStream->read( b, 1 ) )
-        {
-            if ( b[0] == delimiter )
-                ss << b;
-        }
-        return ss.str();
+        return readUntil( delimiter );
     }
 
     // seek = (offset) => this.containerStream.seek(offset + this.media_header_size);
-    bool seek(uint32_t offset) override { return containerStream->seek(offset + media_header_size); }
-    // seekCurrent = (offset) => this.containerStream.seekCurrent(offset);
-    bool seekCurrent(uint32_t offset) { return containerStream->seek(offset); }
+    bool seek(uint32_t offset) override { return seekContainer(offset + media_header_size); }
+    // seekCurrent = (offset) => this.containerStream.seek(offset);
+    bool seekCurrent(uint32_t offset) { return seekContainer(offset); }
 
     bool seekPath(std::string path) override { return false; };
     std::string seekNextEntry() override { return ""; };
@@ -113,6 +108,9 @@ public:
     bool isOpen() override;
     std::string url;
 
+    // Rough heap use besides the stream object itself (container stream, caches), for ImageBroker
+    virtual size_t footprint() { return IMAGE_BROKER_CONTAINER_COST + read_buffer.capacity(); }
+
 protected:
 
     bool seekCalled = false;
@@ -151,13 +149,33 @@ protected:
     virtual bool seekEntry( std::string filename ) { return false; };
     virtual bool seekEntry( uint16_t index ) { return false; };
 
+    /* Container access goes through a read window, so parsing a header or directory
+       byte by byte doesn't turn into one container (maybe network) read per byte.
+       Subclasses use these instead of containerStream->read()/seek() directly,
+       otherwise the window gets out of step with the container.
+    */
     virtual uint16_t readContainer(uint8_t *buf, uint16_t size);
+    bool seekContainer(uint32_t pos);
+
+    // Next bytes without consuming them, at most MMEDIA_READ_BUFFER_SIZE. Valid until the next read or seek
+    std::string_view peek(size_t size);
+    // Bytes up to delimiter (consumed but not included), at most what's in the window.
+    // found tells whether the delimiter was reached. Valid until the next read or seek
+    std::string_view readUntilView(uint8_t delimiter, bool *found = nullptr);
+
     virtual uint16_t readFile(uint8_t* buf, uint16_t size) = 0;
     virtual std::string decodeType(uint8_t file_type, bool show_hidden = false);
     virtual std::string decodeType(std::string file_type);
 
 private:
 
+    bool fillReadBuffer();
+
+    std::vector<uint8_t> read_buffer;   // allocated on first use
+    size_t read_buffer_pos = 0;         // next byte to hand out
+    size_t read_buffer_len = 0;         // valid bytes
+    int64_t read_buffer_start = -1;     // container position of read_buffer[0], -1 if unknown
+
     // Commodore Media
     // CARTRIDGE
     friend class CRTFile;
@@ -190,14 +208,52 @@ private:
 /********************************************************
  * Utility implementations
  ********************************************************/
+
+// Default budget for images kept open by ImageBroker, see ImageBroker::setLimits()
+#define IMAGE_BROKER_MAX_ENTRIES 8
+#define IMAGE_BROKER_MAX_BYTES (64 * 1024)
+
+struct ImageBrokerStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+/*
+ Keeps media streams open between calls, so walking a directory or reading
+ files from the same image doesn't reopen its container every time.
+
+ obtain() hands out shared_ptr handles. An image no caller holds a handle to
+ is idle; idle images are closed least recently used first as soon as the
+ broker is over its entry or memory budget. Images in use are never closed,
+ so the budget can be exceeded while they are held.
+*/
 class ImageBroker {
-    static std::unordered_map<std::string, MMediaStream*> repo;
+    struct Entry {
+        std::shared_ptr<MMediaStream> stream;
+        size_t size; // sizeof the concrete stream class
+        std::list<std::string>::iterator lru;
+    };
+
+    static std::unordered_map<std::string, Entry> repo;
+    static std::list<std::string> lru; // most recently used first
+    static size_t max_entries;
+    static size_t max_bytes;
+    static ImageBrokerStats counters;
+
+    static size_t cost(const Entry &entry) { return entry.size + entry.stream->footprint(); }
+    static std::shared_ptr<MMediaStream> find(const std::string &url);
+    static void add(const std::string &url, std::shared_ptr<MMediaStream> stream, size_t size);
+    static void evict(std::unordered_map<std::string, Entry>::iterator it);
+
 public:
-    template<class T> static T* obtain(std::string url) {
+    template<class T> static std::shared_ptr<T> obtain(std::string url) {
         // obviously you have to supply STREAMFILE.url to this function!
-        if(repo.find(url)!=repo.end()) {
-            return (T*)repo.at(url);
-        }
+        auto found = find(url);
+        if (found)
+            return std::static_pointer_cast<T>(found);
 
         // create and add stream to broker if not found
         auto newFile = MFSOwner::File(url);
@@ -213,22 +269,28 @@ public:
             Debug_printv("SINGLE FILE [%s]", url.c_str());
         }
 
-        repo.insert(std::make_pair(url, newStream));
         delete newFile;
-        return newStream;
+        if (newStream == nullptr)
+            return nullptr;
+
+        std::shared_ptr<T> stream(newStream);
+        add(url, stream, sizeof(T));
+        return stream;
     }
 
-    static MMediaStream* obtain(std::string url) {
+    static std::shared_ptr<MMediaStream> obtain(std::string url) {
         return obtain<MMediaStream>(url);
     }
 
-    static void dispose(std::string url) {
-        if(repo.find(url)!=repo.end()) {
-            auto toDelete = repo.at(url);
-            repo.erase(url);
-            delete toDelete;
-        }
-    }
+    // Drop the image from the broker, it's closed once the last handle is released
+    static void dispose(std::string url);
+    static void dispose(MMediaStream *stream);
+
+    // Close idle images until the broker is within budget, all idle images if purge is set
+    static void trim(bool purge = false);
+
+    static void setLimits(size_t entries, size_t bytes);
+    static ImageBrokerStats stats();
 };
 
 #endif // MEATLOAF_MEDIA
@@ -75,8 +75,8 @@ bool T64MStream::seekEntry( uint16_t index )
     //Debug_printv("----------");
     //Debug_printv("index[%d] sectorOffset[%d] entryOffset[%d] entry_index[%d]", index, sectorOffset, entryOffset, entry_index);
 
-    containerStream->seek(entryOffset);
-    containerStream->read((uint8_t *)&entry, sizeof(entry));
+    seekContainer(entryOffset);
+    readContainer((uint8_t *)&entry, sizeof(entry));
 
     //Debug_printv("r[%d] file_type[%02X] file_name[%.16s]", r, entry.file_type, entry.filename);
 
@@ -107,7 +107,7 @@ uint16_t T64MStream::readFile(uint8_t* buf, uint16_t size) {
     }
     else
     {
-        bytesRead += containerStream->read(buf, size);
+        bytesRead += readContainer(buf, size);
     }
 
     return bytesRead;
@@ -140,7 +140,7 @@ bool T64MStream::seekPath(std::string path) {
 
         // Set position to beginning of file
         _position = 0;
-        containerStream->seek(entry.data_offset);
+        seekContainer(entry.data_offset);
 
         Debug_printv("File Size: size[%d] available[%d] position[%d]", _size, available(), _position);
 
@@ -38,8 +38,8 @@ protected:
     };
 
     void seekHeader() override {
-        containerStream->seek(0x28);
-        containerStream->read((uint8_t*)&header, 24);
+        seekContainer(0x28);
+        readContainer((uint8_t*)&header, 24);
     }
 
     bool seekNextImageEntry() override {
@@ -39,8 +39,8 @@ protected:
     };
 
     void seekHeader() override {
-        containerStream->seek(0x18);
-        containerStream->read((uint8_t*)&header, sizeof(header));
+        seekContainer(0x18);
+        readContainer((uint8_t*)&header, sizeof(header));
     }
 
     bool seekNextImageEntry() override {
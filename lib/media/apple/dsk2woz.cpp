@@ -0,0 +1,440 @@
+#ifdef BUILD_APPLE
+
+/* Track layout and sector encoding from dsk2woz:
+
+MIT License
+
+Copyright (c) 2018 Thomas Harte
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include "dsk2woz.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define DSK2WOZ_SSSE3
+#endif
+
+#define WOZ1_BITSTREAM_LEN 6646
+
+// 6-bit values to disk bytes
+alignas(16) static constexpr uint8_t six_and_two_mapping[64] = {
+    0x96, 0x97, 0x9a, 0x9b, 0x9d, 0x9e, 0x9f, 0xa6,
+    0xa7, 0xab, 0xac, 0xad, 0xae, 0xaf, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb9, 0xba, 0xbb, 0xbc,
+    0xbd, 0xbe, 0xbf, 0xcb, 0xcd, 0xce, 0xcf, 0xd3,
+    0xd6, 0xd7, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde,
+    0xdf, 0xe5, 0xe6, 0xe7, 0xe9, 0xea, 0xeb, 0xec,
+    0xed, 0xee, 0xef, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
+    0xf7, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+// Built at compile time, so they're in flash rather than RAM on the ESP32
+struct translate_tables
+{
+    uint8_t four_and_four[256][2]; // odd bits, then even bits, each OR'd with 0xaa
+    uint16_t six_and_two[4096];    // two 6-bit values (first << 6 | second) to their two disk bytes
+
+    constexpr translate_tables() : four_and_four(), six_and_two()
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            four_and_four[b][0] = (b >> 1) | 0xaa;
+            four_and_four[b][1] = b | 0xaa;
+        }
+        for (int v = 0; v < 4096; v++)
+            six_and_two[v] = (six_and_two_mapping[v >> 6] << 8) | six_and_two_mapping[v & 0x3f];
+    }
+};
+
+static constexpr translate_tables tables;
+
+// Self sync nibbles (0xff and two 0 bits), sixteen of them fill twenty bytes, the rest is read past the end
+static const uint8_t sync_pattern[24] = {
+    0xff, 0x3f, 0xcf, 0xf3, 0xfc, 0xff, 0x3f, 0xcf, 0xf3, 0xfc,
+    0xff, 0x3f, 0xcf, 0xf3, 0xfc, 0xff, 0x3f, 0xcf, 0xf3, 0xfc};
+
+#define WORD_BYTES sizeof(size_t)
+#define WORD_BITS (WORD_BYTES * 8)
+
+// Every byte of a machine word set to b
+#define BYTES(b) (SIZE_MAX / 0xff * (b))
+// Every 16 bits of a machine word set to h
+#define HALVES(h) (SIZE_MAX / 0xffff * (h))
+
+// Big endian machine words, so a shift moves bits along the track
+static inline size_t load_be(const uint8_t *p)
+{
+    size_t w;
+    memcpy(&w, p, sizeof(w));
+#if SIZE_MAX > 0xFFFFFFFF
+    return __builtin_bswap64(w);
+#else
+    return __builtin_bswap32(w);
+#endif
+}
+
+static inline void store_be(uint8_t *p, size_t w)
+{
+#if SIZE_MAX > 0xFFFFFFFF
+    w = __builtin_bswap64(w);
+#else
+    w = __builtin_bswap32(w);
+#endif
+    memcpy(p, &w, sizeof(w));
+}
+
+/* Packs bits into the track MSB first. Bits that don't fill a byte yet wait in
+   _acc. Everything goes in as whole bytes, or a machine word of them, shifted
+   into place when the track isn't at a byte boundary.
+*/
+class bit_writer
+{
+public:
+    bit_writer(uint8_t *dest) : _out(dest) {}
+
+    inline void byte(uint8_t value)
+    {
+        _acc = (_acc << 8) | value;
+        *_out++ = _acc >> _pending;
+        _bits += 8;
+    }
+
+    /* The first n bytes of a machine word, the first one in the top bits. The
+       whole word is stored, the track must have room for it past the n bytes.
+    */
+    inline void word(size_t w, size_t n = WORD_BYTES)
+    {
+        store_be(_out, (_acc << (WORD_BITS - 1 - _pending) << 1) | (w >> _pending));
+        _acc = w >> ((WORD_BYTES - n) * 8);
+        _out += n;
+        _bits += n * 8;
+    }
+
+    // src is read a whole machine word at a time, past the n bytes if they don't fill the last one
+    void bytes(const uint8_t *src, size_t n)
+    {
+        for (; n >= WORD_BYTES; n -= WORD_BYTES, src += WORD_BYTES)
+            word(load_be(src));
+        if (n)
+            word(load_be(src), n);
+    }
+
+    // The first count bits of src, count % 8 of them taken from the top of the last byte
+    void bits(const uint8_t *src, size_t count)
+    {
+        bytes(src, count / 8);
+        int tail = count % 8;
+        if (tail)
+        {
+            _acc = (_acc << tail) | (src[count / 8] >> (8 - tail));
+            _pending += tail;
+            if (_pending >= 8)
+            {
+                _pending -= 8;
+                *_out++ = _acc >> _pending;
+            }
+            _bits += tail;
+        }
+    }
+
+    // Up to 16 sync nibbles, straight from the precomputed pattern
+    inline void syncs(int count)
+    {
+        bits(sync_pattern, count * 10);
+    }
+
+    // Where the next byte goes, the bits still to go before it are the bottom pending() of last()
+    uint8_t *out() { return _out; }
+    int pending() { return _pending; }
+    uint8_t last() { return _acc; }
+
+    // n bytes were put at out() by the caller, shifted the same way, ending with last
+    void wrote(size_t n, uint8_t last)
+    {
+        _acc = last;
+        _out += n;
+        _bits += n * 8;
+    }
+
+    // Write out the last partial byte, returns the number of bits in the track
+    size_t finish()
+    {
+        if (_pending)
+            *_out++ = _acc << (8 - _pending);
+        return _bits;
+    }
+
+private:
+    uint8_t *_out;
+    size_t _acc = 0;
+    int _pending = 0;
+    size_t _bits = 0;
+};
+
+/* The 6-and-2 encoding of 256 bytes is 342 6-bit values: 86 holding the bottom
+   two bits of each source byte (swapped), then the top six bits of each. Every
+   value is XORed with the one before it, the last one is repeated as checksum
+   and all 343 are mapped to disk bytes, here a machine word of values at a time
+   straight from the source.
+*/
+
+// Swap the bottom two bits of every byte of w, clear the rest
+static inline size_t low_bits(size_t w)
+{
+    return ((w & BYTES(0x01)) << 1) | ((w >> 1) & BYTES(0x01));
+}
+
+// XOR a word of values with the ones before them, prev holds the value before the first in its bottom byte
+static inline size_t xor_chain(size_t v, size_t prev)
+{
+    return v ^ ((v >> 8) | (prev << (WORD_BITS - 8)));
+}
+
+// Disk bytes for a word of values, two at a time from the pair table
+static inline size_t six_and_two_bytes(size_t x)
+{
+    size_t pairs = ((x >> 2) & HALVES(0x0fc0)) | (x & HALVES(0x003f));
+    const uint16_t *t = tables.six_and_two;
+    size_t w = t[pairs & 0xfff] | ((size_t)t[(pairs >> 16) & 0xfff] << 16);
+#if SIZE_MAX > 0xFFFFFFFF
+    w |= ((size_t)t[(pairs >> 32) & 0xfff] << 32) | ((size_t)t[pairs >> 48] << 48);
+#endif
+    return w;
+}
+
+static void write_6_and_2(bit_writer &track, const uint8_t *src)
+{
+    // A local copy stays in registers, the track stores could alias it otherwise
+    bit_writer w = track;
+    size_t prev = 0;
+
+    // Bottom bits of src[c], src[c + 86] and src[c + 172], the last of these running out first
+    for (int c = 0; c < 86; c += WORD_BYTES)
+    {
+        size_t third = 0;
+        if (c + 172 + WORD_BYTES <= 256)
+            third = load_be(&src[c + 172]);
+        else if (c + 172 < 256)
+            third = load_be(&src[256 - WORD_BYTES]) << ((c + 172 + WORD_BYTES - 256) * 8);
+        size_t v = low_bits(load_be(&src[c])) | (low_bits(load_be(&src[c + 86])) << 2) | (low_bits(third) << 4);
+
+        int n = c + WORD_BYTES <= 86 ? WORD_BYTES : 86 - c;
+        w.word(six_and_two_bytes(xor_chain(v, prev)), n);
+        prev = v >> ((WORD_BYTES - n) * 8);
+    }
+
+    // Top bits of every byte
+    for (int c = 0; c < 256; c += WORD_BYTES)
+    {
+        size_t v = (load_be(&src[c]) >> 2) & BYTES(0x3f);
+        w.word(six_and_two_bytes(xor_chain(v, prev)));
+        prev = v;
+    }
+
+    // Checksum
+    w.byte(six_and_two_mapping[prev & 0x3f]);
+    track = w;
+}
+
+#ifdef DSK2WOZ_SSSE3
+/* The same 6-and-2 stream with SSSE3 on PC builds, sixteen values at a time:
+   each PSHUFB maps through 16 entries, a cascade of four covers all 64. The
+   disk bytes are shifted into the track right away, 352 bytes are stored.
+*/
+#define SSSE3 __attribute__((target("ssse3")))
+
+SSSE3 static inline __m128i low_bits_x16(__m128i w)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(w, one), 1), _mm_and_si128(_mm_srli_epi16(w, 1), one));
+}
+
+SSSE3 static inline __m128i load_x16(const uint8_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+// Maps values to disk bytes and shifts them into the track, sixteen at a time
+struct six_and_two_x16
+{
+    uint8_t *dest;
+    bool aligned;
+    __m128i shift, carry_shift, keep;
+    __m128i t0, t1, t2, t3;
+    __m128i prev_r;
+
+    SSSE3 six_and_two_x16(bit_writer &w) : dest(w.out()), aligned(w.pending() == 0)
+    {
+        shift = _mm_cvtsi32_si128(w.pending());
+        carry_shift = _mm_cvtsi32_si128(8 - w.pending());
+        keep = _mm_set1_epi8(0xff >> w.pending());
+        prev_r = _mm_insert_epi16(_mm_setzero_si128(), w.last() << 8, 7);
+
+        // six_and_two_mapping in four parts, each after the first XORed with the one before
+        const __m128i *m = (const __m128i *)six_and_two_mapping;
+        t0 = m[0];
+        t1 = _mm_xor_si128(m[0], m[1]);
+        t2 = _mm_xor_si128(m[1], m[2]);
+        t3 = _mm_xor_si128(m[2], m[3]);
+    }
+
+    // The next sixteen values, already XORed with the ones before
+    SSSE3 inline void put(__m128i x)
+    {
+        const __m128i sixteen = _mm_set1_epi8(16);
+
+        __m128i r = _mm_shuffle_epi8(t0, x);
+        x = _mm_sub_epi8(x, sixteen);
+        r = _mm_xor_si128(r, _mm_shuffle_epi8(t1, x));
+        x = _mm_sub_epi8(x, sixteen);
+        r = _mm_xor_si128(r, _mm_shuffle_epi8(t2, x));
+        x = _mm_sub_epi8(x, sixteen);
+        r = _mm_xor_si128(r, _mm_shuffle_epi8(t3, x));
+
+        if (aligned)
+            _mm_storeu_si128((__m128i *)dest, r);
+        else
+        {
+            // Each disk byte moves down by the pending bits, the end of the one before fills the top
+            __m128i before = _mm_alignr_epi8(r, prev_r, 15);
+            before = _mm_andnot_si128(keep, _mm_sll_epi16(before, carry_shift));
+            _mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_and_si128(_mm_srl_epi16(r, shift), keep), before));
+        }
+        prev_r = r;
+        dest += 16;
+    }
+};
+
+// XOR values with the ones before them, prev holds the value before the first in its top byte
+SSSE3 static inline __m128i xor_chain_x16(__m128i v, __m128i prev)
+{
+    return _mm_xor_si128(v, _mm_alignr_epi8(v, prev, 15));
+}
+
+SSSE3 static void write_6_and_2_ssse3(bit_writer &w, const uint8_t *src)
+{
+    const __m128i top_bits = _mm_set1_epi8(0x3f);
+    six_and_two_x16 out(w);
+    __m128i prev = _mm_setzero_si128();
+    __m128i v;
+
+    // Bottom bits of src[c], src[c + 86] and src[c + 172]
+    for (int c = 0; c < 80; c += 16)
+    {
+        v = low_bits_x16(load_x16(&src[c]));
+        v = _mm_or_si128(v, _mm_slli_epi16(low_bits_x16(load_x16(&src[c + 86])), 2));
+        v = _mm_or_si128(v, _mm_slli_epi16(low_bits_x16(load_x16(&src[c + 172])), 4));
+        out.put(xor_chain_x16(v, prev));
+        prev = v;
+    }
+
+    // The last six of them, src[c + 172] running out at 256, and the first ten top bits
+    v = low_bits_x16(load_x16(&src[80]));
+    v = _mm_or_si128(v, _mm_slli_epi16(low_bits_x16(load_x16(&src[166])), 2));
+    v = _mm_or_si128(v, _mm_slli_epi16(low_bits_x16(_mm_srli_si128(load_x16(&src[240]), 12)), 4));
+    v = _mm_and_si128(v, _mm_srli_si128(_mm_set1_epi8(-1), 10));
+    v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi16(_mm_slli_si128(load_x16(&src[0]), 6), 2), top_bits));
+    out.put(xor_chain_x16(v, prev));
+
+    // Top bits, the XOR commutes with the shift so it's done on the source bytes
+    for (int c = 10; c < 250; c += 16)
+        out.put(_mm_and_si128(_mm_srli_epi16(_mm_xor_si128(load_x16(&src[c]), load_x16(&src[c - 1])), 2), top_bits));
+
+    // The last six, then zeros so value 342 becomes the checksum
+    prev = _mm_and_si128(_mm_srli_epi16(load_x16(&src[234]), 2), top_bits);
+    v = _mm_and_si128(_mm_srli_epi16(_mm_srli_si128(load_x16(&src[240]), 10), 2), top_bits);
+    out.put(xor_chain_x16(v, prev));
+
+    // The checksum is the last disk byte, number 6 of the last sixteen
+    w.wrote(343, _mm_extract_epi16(out.prev_r, 3) & 0xff);
+}
+#endif // DSK2WOZ_SSSE3
+
+static inline uint8_t *encode_4_and_4(uint8_t *dest, uint8_t value)
+{
+    *dest++ = tables.four_and_four[value][0];
+    *dest++ = tables.four_and_four[value][1];
+    return dest;
+}
+
+size_t dsk2woz_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos)
+{
+    bit_writer w(dest);
+#ifdef DSK2WOZ_SSSE3
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+    // Gap 1
+    w.syncs(16);
+
+    // Sectors in physical order, the address field is built byte aligned and then shifted into the track.
+    // Fields are padded to whole machine words for bit_writer::bytes().
+    uint8_t address[16] = {0xd5, 0xaa, 0x96};
+    static const uint8_t data_prologue[8] = {0xd5, 0xaa, 0xad};
+    static const uint8_t epilogue[8] = {0xde, 0xaa, 0xeb};
+    memcpy(&address[11], epilogue, 3);
+
+    for (int sector = 0; sector < DSK_SECTORS_PER_TRACK; sector++)
+    {
+        // Address field: volume, track, sector and checksum in 4-and-4
+        uint8_t *p = &address[3];
+        p = encode_4_and_4(p, 254);
+        p = encode_4_and_4(p, track_number);
+        p = encode_4_and_4(p, sector);
+        encode_4_and_4(p, 254 ^ track_number ^ sector);
+        w.bytes(address, 14);
+
+        // Gap 2
+        w.syncs(7);
+
+        // Data field
+        int logical_sector = (sector == 15) ? 15 : ((sector * (is_prodos ? 8 : 7)) % 15);
+        w.bytes(data_prologue, 3);
+#ifdef DSK2WOZ_SSSE3
+        if (ssse3)
+            write_6_and_2_ssse3(w, &src[logical_sector * DSK_BYTES_PER_SECTOR]);
+        else
+#endif
+        write_6_and_2(w, &src[logical_sector * DSK_BYTES_PER_SECTOR]);
+        w.bytes(epilogue, 3);
+
+        // Gap 3
+        w.syncs(16);
+    }
+
+    size_t bits = w.finish();
+    size_t bytes = (bits + 7) >> 3;
+    memset(dest + bytes, 0, WOZ1_TRACK_RECORD - bytes);
+
+    // Track suffix
+    dest[WOZ1_BITSTREAM_LEN] = bytes & 0xff;
+    dest[WOZ1_BITSTREAM_LEN + 1] = (bytes >> 8) & 0xff; // Byte count.
+    dest[WOZ1_BITSTREAM_LEN + 2] = bits & 0xff;
+    dest[WOZ1_BITSTREAM_LEN + 3] = (bits >> 8) & 0xff;  // Bit count.
+    dest[WOZ1_BITSTREAM_LEN + 4] = dest[WOZ1_BITSTREAM_LEN + 5] = 0x00; // Splice information.
+    dest[WOZ1_BITSTREAM_LEN + 6] = 0xff;
+    dest[WOZ1_BITSTREAM_LEN + 7] = 10;
+
+    return bits;
+}
+
+#endif // BUILD_APPLE
@@ -0,0 +1,30 @@
+#ifndef _DSK2WOZ_
+#define _DSK2WOZ_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ DSK track to WOZ1 track conversion, same output as dsk2woz by Tom Harte
+ (https://github.com/TomHarte/dsk2woz).
+
+ Disk bytes come from translate tables (4-and-4 for the address field, 6-and-2
+ for the sector data, in pairs) and are packed into the bitstream a machine word
+ at a time, sixteen bytes at a time with SSSE3 on PC builds, so a track is cheap
+ enough to build when it's first needed.
+*/
+
+#define DSK_BYTES_PER_SECTOR 256
+#define DSK_SECTORS_PER_TRACK 16
+#define DSK_BYTES_PER_TRACK (DSK_SECTORS_PER_TRACK * DSK_BYTES_PER_SECTOR)
+
+// WOZ1 TRKS entry: bitstream padded to 6646 bytes, then bytes used, bit count and splice info
+#define WOZ1_TRACK_RECORD 6656
+
+/* Encode one track of a DSK image (16 sectors in DOS 3.3 or ProDOS order) as a
+   complete WOZ1 TRKS entry. dest holds WOZ1_TRACK_RECORD bytes, all of which
+   are written. Returns the number of bits in the track.
+*/
+size_t dsk2woz_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos);
+
+#endif // _DSK2WOZ_
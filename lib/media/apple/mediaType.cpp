@@ -40,26 +40,29 @@ mediatype_t MediaType::discover_mediatype(const char *filename)
 {
     //should probably look inside the file to help figure it out
     int l = strlen(filename);
+    // GAMES.PO.gz is a compressed PO image
+    if (l > 3 && strcasecmp(filename + l - 3, ".gz") == 0)
+        l -= 3;
     if (l > 4 && filename[l - 4] == '.')
     {
         // Check the last 3 characters of the string
         const char *ext = filename + l - 3;
-        if (strcasecmp(ext, "HDV") == 0)
+        if (strncasecmp(ext, "HDV", 3) == 0)
             return MEDIATYPE_PO;
-        else if (strcasecmp(ext,"2MG") == 0)
+        else if (strncasecmp(ext, "2MG", 3) == 0)
             return MEDIATYPE_PO;
-        else if (strcasecmp(ext, "WOZ") == 0)
+        else if (strncasecmp(ext, "WOZ", 3) == 0)
             return MEDIATYPE_WOZ;
-        else if (strcasecmp(ext, "DSK") == 0)
+        else if (strncasecmp(ext, "DSK", 3) == 0)
             return MEDIATYPE_DSK;
     }
     else if (l > 3 && filename[l - 3] == '.')
     {
         // Check the last 3 characters of the string
         const char *ext = filename + l - 2;
-        if (strcasecmp(ext, "PO") == 0)
+        if (strncasecmp(ext, "PO", 2) == 0)
             return MEDIATYPE_PO;
-        else if (strcasecmp(ext, "DO") == 0)
+        else if (strncasecmp(ext, "DO", 2) == 0)
             return MEDIATYPE_DO;
     }
     return MEDIATYPE_UNKNOWN;
@@ -35,7 +35,7 @@ bool MediaTypePO::write(uint32_t blockNum, uint16_t *count, uint8_t* buffer)
     {
         Debug_printf("high score: Swapping file handles\r\n");
         oldFileh = _media_fileh;
-        hsFileh = _media_host->fnfile_open(_disk_filename, _disk_filename, strlen(_disk_filename) +1, "rb+");
+        hsFileh = _media_host->fnfile_open_image(_disk_filename, _disk_filename, strlen(_disk_filename) +1, "rb+");
         _media_fileh = hsFileh;
     }
 
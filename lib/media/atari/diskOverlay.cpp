@@ -0,0 +1,234 @@
+#ifdef BUILD_ATARI // temporary
+
+#include "diskOverlay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "../../include/debug.h"
+
+#include "utils.h"
+
+#define OVERLAY_MAGIC "FNOV"
+#define OVERLAY_VERSION 1
+#define OVERLAY_HEADER_SIZE 16
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::open(FileSystem *fs, const char *path, uint16_t sectorSize, uint32_t numSectors, uint32_t imageSize)
+{
+    close();
+
+    if (fs == nullptr || numSectors == 0 || numSectors > 65535 || sectorSize == 0)
+        return true;
+
+    _fs = fs;
+    snprintf(_path, sizeof(_path), "%s", path);
+    _sector_size = sectorSize;
+    _num_sectors = numSectors;
+    _image_size = imageSize;
+
+    _bitmap = (uint8_t *)calloc((_num_sectors + 7) / 8, 1);
+    if (_bitmap == nullptr)
+        return true;
+
+    bool err = true;
+    _fileh = _fs->fnfile_open(_path, FILE_READ_WRITE);
+    if (_fileh != nullptr)
+        err = _load();
+    if (err)
+    {
+        Debug_printf("Creating new overlay \"%s\"\r\n", _path);
+        err = _create();
+    }
+
+    if (err)
+        close();
+    else
+        Debug_printf("Overlay \"%s\": %u sectors written\r\n", _path, (unsigned)_used_slots);
+
+    return err;
+}
+
+void DiskOverlay::close()
+{
+    if (_fileh != nullptr)
+    {
+        fnio::fclose(_fileh);
+        _fileh = nullptr;
+    }
+    if (_bitmap != nullptr)
+    {
+        free(_bitmap);
+        _bitmap = nullptr;
+    }
+    _num_sectors = 0;
+    _used_slots = 0;
+}
+
+// Starts an empty delta, replacing whatever was in the file
+bool DiskOverlay::_create()
+{
+    if (_fileh != nullptr)
+        fnio::fclose(_fileh);
+    _fileh = _fs->fnfile_open(_path, "wb+");
+    if (_fileh == nullptr)
+    {
+        Debug_printf("Failed to create overlay \"%s\", errno=%d\r\n", _path, errno);
+        return true;
+    }
+
+    uint8_t buf[256];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, OVERLAY_MAGIC, 4);
+    buf[4] = OVERLAY_VERSION;
+    buf[6] = LOBYTE_FROM_UINT16(_sector_size);
+    buf[7] = HIBYTE_FROM_UINT16(_sector_size);
+    for (int i = 0; i < 4; i++)
+    {
+        buf[8 + i] = (_num_sectors >> (i * 8)) & 0xFF;
+        buf[12 + i] = (_image_size >> (i * 8)) & 0xFF;
+    }
+    if (fnio::fwrite(buf, 1, OVERLAY_HEADER_SIZE, _fileh) != OVERLAY_HEADER_SIZE)
+        return true;
+
+    // Empty slot map
+    memset(buf, 0, sizeof(buf));
+    uint32_t left = _num_sectors * 2;
+    while (left > 0)
+    {
+        size_t n = left < sizeof(buf) ? left : sizeof(buf);
+        if (fnio::fwrite(buf, 1, n, _fileh) != n)
+            return true;
+        left -= n;
+    }
+
+    memset(_bitmap, 0, (_num_sectors + 7) / 8);
+    _used_slots = 0;
+
+    return fnio::fflush(_fileh) != 0;
+}
+
+// Reads the header and rebuilds the bitmap from the slot map
+bool DiskOverlay::_load()
+{
+    uint8_t buf[256];
+    if (fnio::fseek(_fileh, 0, SEEK_SET) != 0 ||
+        fnio::fread(buf, 1, OVERLAY_HEADER_SIZE, _fileh) != OVERLAY_HEADER_SIZE)
+        return true;
+
+    uint32_t num_sectors = 0, image_size = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        num_sectors |= (uint32_t)buf[8 + i] << (i * 8);
+        image_size |= (uint32_t)buf[12 + i] << (i * 8);
+    }
+    if (memcmp(buf, OVERLAY_MAGIC, 4) != 0 || buf[4] != OVERLAY_VERSION ||
+        UINT16_FROM_HILOBYTES(buf[7], buf[6]) != _sector_size ||
+        num_sectors != _num_sectors || image_size != _image_size)
+    {
+        Debug_printf("Overlay \"%s\" doesn't match the image, starting over\r\n", _path);
+        return true;
+    }
+
+    _used_slots = 0;
+    uint32_t sectornum = 1;
+    uint32_t left = _num_sectors * 2;
+    while (left > 0)
+    {
+        size_t n = left < sizeof(buf) ? left : sizeof(buf);
+        if (fnio::fread(buf, 1, n, _fileh) != n)
+            return true;
+        for (size_t i = 0; i < n; i += 2, sectornum++)
+        {
+            if (buf[i] == 0 && buf[i + 1] == 0)
+                continue;
+            _bitmap[(sectornum - 1) >> 3] |= 1 << ((sectornum - 1) & 7);
+            _used_slots++;
+        }
+        left -= n;
+    }
+
+    return false;
+}
+
+bool DiskOverlay::_find_slot(uint16_t sectornum, uint32_t *slot)
+{
+    uint8_t entry[2];
+    if (fnio::fseek(_fileh, _map_offset(sectornum), SEEK_SET) != 0 ||
+        fnio::fread(entry, 1, sizeof(entry), _fileh) != sizeof(entry))
+        return true;
+
+    uint16_t v = UINT16_FROM_HILOBYTES(entry[1], entry[0]);
+    if (v == 0)
+        return true;
+
+    *slot = v - 1;
+    return false;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::read(uint16_t sectornum, uint8_t *buf, uint16_t size)
+{
+    uint32_t slot;
+    if (_fileh == nullptr || !contains(sectornum) || size > _sector_size || _find_slot(sectornum, &slot))
+        return true;
+
+    return fnio::fseek(_fileh, _slot_offset(slot), SEEK_SET) != 0 ||
+           fnio::fread(buf, 1, size, _fileh) != size;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::write(uint16_t sectornum, const uint8_t *buf, uint16_t size)
+{
+    if (_fileh == nullptr || sectornum < 1 || sectornum > _num_sectors || size > _sector_size)
+        return true;
+
+    bool is_new = !contains(sectornum);
+    uint32_t slot = _used_slots;
+    if (!is_new && _find_slot(sectornum, &slot))
+        return true;
+
+    // Sector data goes in first, a new slot only shows up in the map once its data is there
+    if (fnio::fseek(_fileh, _slot_offset(slot), SEEK_SET) != 0 ||
+        fnio::fwrite(buf, 1, size, _fileh) != size)
+    {
+        Debug_printf("Overlay write error, errno=%d\r\n", errno);
+        return true;
+    }
+
+    if (is_new)
+    {
+        uint16_t v = slot + 1;
+        uint8_t entry[2] = {LOBYTE_FROM_UINT16(v), HIBYTE_FROM_UINT16(v)};
+        if (fnio::fseek(_fileh, _map_offset(sectornum), SEEK_SET) != 0 ||
+            fnio::fwrite(entry, 1, sizeof(entry), _fileh) != sizeof(entry))
+        {
+            Debug_printf("Overlay map write error, errno=%d\r\n", errno);
+            return true;
+        }
+        _bitmap[(sectornum - 1) >> 3] |= 1 << ((sectornum - 1) & 7);
+        _used_slots++;
+    }
+
+    // Since we might get reset at any moment, go ahead and sync the file
+    return fnio::fflush(_fileh) != 0;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::discard()
+{
+    if (_fs == nullptr || _bitmap == nullptr)
+        return true;
+
+    Debug_printf("Discarding overlay \"%s\" (%u sectors)\r\n", _path, (unsigned)_used_slots);
+    return _create();
+}
+
+DiskOverlay::~DiskOverlay()
+{
+    close();
+}
+
+#endif // BUILD_ATARI
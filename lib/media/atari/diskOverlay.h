@@ -0,0 +1,69 @@
+#ifndef _DISK_OVERLAY_
+#define _DISK_OVERLAY_
+
+#include <stdint.h>
+#include "fnio.h"
+#include "fnFS.h"
+
+/*
+ Copy-on-write delta for a disk image that is shared read-only (e.g. one TNFS
+ library used by many FujiNets). Written sectors go to a local delta file,
+ reads check the delta first and fall through to the image otherwise.
+
+ Delta file layout:
+  00-03 'FNOV'
+  04    version
+  05    reserved
+  06-07 sector size
+  08-0B number of sectors
+  0C-0F image size, a delta made for a different image is thrown away
+  then a 16-bit slot map entry per sector (0 = not written, otherwise slot + 1)
+  then the sector data, one sector sized slot per written sector, in the order
+  the sectors were first written.
+
+ Only the bitmap of written sectors is kept in memory.
+*/
+
+class DiskOverlay
+{
+private:
+    FileSystem *_fs = nullptr;
+    fnFile *_fileh = nullptr;
+    char _path[64];
+    uint8_t *_bitmap = nullptr;
+    uint16_t _sector_size = 0;
+    uint32_t _num_sectors = 0;
+    uint32_t _image_size = 0;
+    uint32_t _used_slots = 0;
+
+    uint32_t _map_offset(uint16_t sectornum) { return 16 + (sectornum - 1) * 2; };
+    uint32_t _slot_offset(uint32_t slot) { return 16 + _num_sectors * 2 + slot * _sector_size; };
+
+    bool _create();
+    bool _load();
+    bool _find_slot(uint16_t sectornum, uint32_t *slot);
+
+public:
+    // Opens the delta at path, creating it if missing or made for a different image.
+    // Returns TRUE if an error condition occurred
+    bool open(FileSystem *fs, const char *path, uint16_t sectorSize, uint32_t numSectors, uint32_t imageSize);
+    void close();
+
+    bool contains(uint16_t sectornum)
+    {
+        return sectornum >= 1 && sectornum <= _num_sectors &&
+               (_bitmap[(sectornum - 1) >> 3] & (1 << ((sectornum - 1) & 7))) != 0;
+    };
+    uint32_t count() { return _used_slots; };
+
+    // Returns TRUE if an error condition occurred
+    bool read(uint16_t sectornum, uint8_t *buf, uint16_t size);
+    // Returns TRUE if an error condition occurred
+    bool write(uint16_t sectornum, const uint8_t *buf, uint16_t size);
+    // Drops every written sector. Returns TRUE if an error condition occurred
+    bool discard();
+
+    ~DiskOverlay();
+};
+
+#endif // _DISK_OVERLAY_
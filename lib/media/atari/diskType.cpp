@@ -39,6 +39,29 @@ bool MediaType::format(uint16_t *responsesize)
     return true;
 }
 
+// Default OVERLAY is not implemented
+bool MediaType::overlay_open(FileSystem *fs, const char *path)
+{
+    Debug_print("DISK OVERLAY NOT IMPLEMENTED\r\n");
+    return true;
+}
+
+// Default OVERLAY COMMIT is not implemented
+bool MediaType::overlay_commit()
+{
+    Debug_print("DISK OVERLAY COMMIT NOT IMPLEMENTED\r\n");
+    return true;
+}
+
+bool MediaType::overlay_discard()
+{
+    if (_overlay == nullptr)
+        return true;
+
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+    return _overlay->discard();
+}
+
 // Update PERCOM block from the total # of sectors
 void MediaType::derive_percom_block(uint16_t numSectors)
 {
@@ -136,6 +159,12 @@ void MediaType::dump_percom_block()
 
 void MediaType::unmount()
 {
+    // The delta stays on storage for the next mount of the same image
+    if (_overlay != nullptr)
+    {
+        delete _overlay;
+        _overlay = nullptr;
+    }
     if (_disk_fileh != nullptr)
     {
         fnio::fclose(_disk_fileh);
@@ -146,35 +175,38 @@ void MediaType::unmount()
 mediatype_t MediaType::discover_disktype(const char *filename)
 {
     int l = strlen(filename);
+    // A compressed image goes by the extension in front of ".gz"
+    if (l > 3 && strcasecmp(filename + l - 3, ".gz") == 0)
+        l -= 3;
     if (l > 4 && filename[l - 4] == '.')
     {
         // Check the last 3 characters of the string
         const char *ext = filename + l - 3;
-        if (strcasecmp(ext, "XEX") == 0)
+        if (strncasecmp(ext, "XEX", 3) == 0)
         {
             return MEDIATYPE_XEX;
         }
-        else if (strcasecmp(ext, "COM") == 0)
+        else if (strncasecmp(ext, "COM", 3) == 0)
         {
             return MEDIATYPE_XEX;
         }
-        else if (strcasecmp(ext, "BIN") == 0)
+        else if (strncasecmp(ext, "BIN", 3) == 0)
         {
             return MEDIATYPE_XEX;
         }
-        else if (strcasecmp(ext, "ATR") == 0)
+        else if (strncasecmp(ext, "ATR", 3) == 0)
         {
             return MEDIATYPE_ATR;
         }
-        else if (strcasecmp(ext, "ATX") == 0)
+        else if (strncasecmp(ext, "ATX", 3) == 0)
         {
             return MEDIATYPE_ATX;
         }
-        else if (strcasecmp(ext, "CAS") == 0)
+        else if (strncasecmp(ext, "CAS", 3) == 0)
         {
             return MEDIATYPE_CAS;
         }
-        else if (strcasecmp(ext, "WAV") == 0)
+        else if (strncasecmp(ext, "WAV", 3) == 0)
         {
             return MEDIATYPE_WAV;
         }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "fnio.h"
 #include "fujiHost.h"
+#include "diskOverlay.h"
 
 #define INVALID_SECTOR_VALUE 65536
 
@@ -53,6 +54,7 @@ protected:
     bool _disk_readonly = true;
     uint16_t _high_score_sector = 0; /* High score sector to allow write. 1-65535 */
     uint8_t _high_score_num_sectors = 0;
+    DiskOverlay *_overlay = nullptr; /* Local copy-on-write delta, writes never reach the image */
     
 public:
     struct
@@ -93,6 +95,14 @@ public:
     // Returns TRUE if an error condition occurred
     virtual bool write(uint16_t sectornum, bool verify);
 
+    // Keep writes in a delta file on fs instead of the image. Returns TRUE if an error condition occurred
+    virtual bool overlay_open(FileSystem *fs, const char *path);
+    // Copy the delta into the image and empty it. Returns TRUE if an error condition occurred
+    virtual bool overlay_commit();
+    // Returns TRUE if an error condition occurred
+    bool overlay_discard();
+    bool has_overlay() { return _overlay != nullptr; };
+
     // Always returns 128 for the first 3 sectors, otherwise _sectorSize
     virtual uint16_t sector_size(uint16_t sectornum);
     
@@ -69,6 +69,14 @@ bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 
     memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
 
+    // Sectors written while in overlay mode come from the delta
+    if (_overlay != nullptr && _overlay->contains(sectornum))
+    {
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        *readcount = sectorSize;
+        return _overlay->read(sectornum, _disk_sectorbuff, sectorSize);
+    }
+
     bool err = false;
     // Perform a seek if we're not reading the sector after the last one we read
     if (sectornum != _disk_last_sector + 1)
@@ -112,6 +120,13 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
         return true;
     }
 
+    // Leave the image alone, the delta takes the sector
+    if (_overlay != nullptr)
+    {
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        return _overlay->write(sectornum, _disk_sectorbuff, sector_size(sectornum));
+    }
+
     if (_high_score_sector != 0)
     {
         Debug_printf("High score mode activated, attempting write open\r\n");
@@ -122,7 +137,7 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
         else
         {
             oldFileh = _disk_fileh;
-            hsFileh = _disk_host->fnfile_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "rb+");
+            hsFileh = _disk_host->fnfile_open_image(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "rb+");
             _disk_fileh = hsFileh;
         }
     }
@@ -169,6 +184,89 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
     return false;
 }
 
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::overlay_open(FileSystem *fs, const char *path)
+{
+    Debug_printf("ATR OVERLAY \"%s\"\r\n", path);
+
+    if (_disktype != MEDIATYPE_ATR)
+        return true;
+
+    if (_overlay == nullptr)
+        _overlay = new DiskOverlay();
+
+    if (_overlay->open(fs, path, _disk_sector_size, _disk_num_sectors, _disk_image_size))
+    {
+        delete _overlay;
+        _overlay = nullptr;
+        return true;
+    }
+
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+    return false;
+}
+
+/*
+ Copy every sector in the delta into the image, then empty the delta. The image
+ is opened for writing only for the duration, like a high score write.
+*/
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::overlay_commit()
+{
+    Debug_print("ATR OVERLAY COMMIT\r\n");
+
+    if (_overlay == nullptr || _disk_host == nullptr)
+        return true;
+
+    if (_overlay->count() == 0)
+        return false;
+
+    fnFile *wFileh = _disk_host->fnfile_open_image(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "rb+");
+    if (wFileh == nullptr)
+    {
+        Debug_printf("::overlay_commit can't open image for writing, errno=%d\r\n", errno);
+        return true;
+    }
+
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+
+    bool err = false;
+    uint32_t copied = 0;
+    int32_t last_sector = INVALID_SECTOR_VALUE;
+    for (uint32_t sectornum = 1; sectornum <= _disk_num_sectors && err == false; sectornum++)
+    {
+        if (!_overlay->contains(sectornum))
+            continue;
+
+        uint16_t sectorSize = sector_size(sectornum);
+        err = _overlay->read(sectornum, _disk_sectorbuff, sectorSize);
+
+        // Runs of sectors are written without seeking
+        if (err == false && (int32_t)sectornum != last_sector + 1)
+            err = fnio::fseek(wFileh, _sector_to_offset(sectornum), SEEK_SET) != 0;
+
+        if (err == false)
+            err = fnio::fwrite(_disk_sectorbuff, 1, sectorSize, wFileh) != sectorSize;
+
+        last_sector = sectornum;
+        copied++;
+    }
+
+    if (fnio::fflush(wFileh) != 0)
+        err = true;
+    fnio::fclose(wFileh);
+
+    if (err)
+    {
+        Debug_printf("::overlay_commit failed after %u sectors, errno=%d\r\n", (unsigned)copied, errno);
+        return true;
+    }
+
+    Debug_printf("::overlay_commit wrote %u sectors\r\n", (unsigned)copied);
+
+    return overlay_discard();
+}
+
 void MediaTypeATR::status(uint8_t statusbuff[4])
 {
     statusbuff[0] = DISK_DRIVE_STATUS_CLEAR;
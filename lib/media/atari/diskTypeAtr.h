@@ -16,6 +16,9 @@ public:
 
     virtual mediatype_t mount(fnFile *f, uint32_t disksize) override;
 
+    virtual bool overlay_open(FileSystem *fs, const char *path) override;
+    virtual bool overlay_commit() override;
+
     virtual void status(uint8_t statusbuff[4]) override;
 
     static bool create(fnFile *f, uint16_t sectorSize, uint16_t numSectors);
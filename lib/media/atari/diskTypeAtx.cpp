@@ -4,6 +4,7 @@
 
 #include <memory.h>
 #include <string.h>
+#include <algorithm>
 #include <esp_timer.h>
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 #include <esp_random.h>
@@ -31,17 +32,6 @@
   0.20833... / 26042 = 0.0000079998976013... = 8 microseconds per angular position
 
 */
-/*
- Frequency with which to update the angular position counter.
- Counter is updated every 
- US_ANGULAR_UNIT_TIME * ANGULAR_POSITION_UPDATE_FREQ microseconds.
- ANGULAR_POSITION_UPDATE_FREQ must be at least '8' (updates every
- 8*8 = 64 microseconds) because the ESP timer fucntion won't allow
- frequencies lower than every 50 microseconds.
- "29" evenly divides 26042
-*/
-#define ANGULAR_POSITION_UPDATE_FREQ 29
-#define ANGULAR_POSITION_INVALID 65535
 
 // Most of the following timing constants come from S-Drive Max sources atx.c
 // (converted from milliseconds to microseconds)
@@ -50,6 +40,8 @@
 #define ANGULAR_UNIT_TOTAL 26042
 // Number of microseconds for each angular unit
 #define US_ANGULAR_UNIT_TIME 8
+// Number of microseconds for a full disk rotation
+#define US_FULL_ROTATION (ANGULAR_UNIT_TOTAL * US_ANGULAR_UNIT_TIME)
 // Number of microseconds drive takes to process a request
 #define US_DRIVE_REQUEST_DELAY_810 3220
 #define US_DRIVE_REQUEST_DELAY_1050 3220
@@ -66,188 +58,87 @@
 #define MAX_RETRIES_1050 1
 #define MAX_RETRIES_810 4
 
-AtxTrack::~AtxTrack()
-{
-    if (data != nullptr)
-        delete[] data;
-
-    data = nullptr;
-};
-
-AtxTrack::AtxTrack(){
-
-};
-
-AtxSector::~AtxSector(){
-
-};
-
-AtxSector::AtxSector(sector_header_t &header)
-{
-    number = header.number;
-    position = header.position;
-    status = header.status;
-    start_data = header.start_data;
-};
-
 MediaTypeATX::~MediaTypeATX()
 {
-    // Destory any timer we may have
-    if (_atx_timer != nullptr)
-    {
-        esp_timer_stop(_atx_timer);
-        esp_timer_delete(_atx_timer);
-    }
 }
 
 // Constructor initializes the AtxTrack vector to assume we have 40 tracks
 MediaTypeATX::MediaTypeATX()
 {
-    _tracks.reserve(ATX_DEFAULT_NUMTRACKS);
-    int i = 0;
-    for (auto it = _tracks.begin(); i < ATX_DEFAULT_NUMTRACKS; i++)
-        _tracks.emplace(it++);
+    _tracks.resize(ATX_DEFAULT_NUMTRACKS);
 
     // Disallow HSIO
     _allow_hsio = false;
-
-    // Create a timer to track our fake disk rotating
-    esp_timer_create_args_t tcfg;
-    tcfg.arg = this;
-    tcfg.callback = on_timer;
-    tcfg.dispatch_method = esp_timer_dispatch_t::ESP_TIMER_TASK;
-    tcfg.name = nullptr;
-    esp_timer_create(&tcfg, &_atx_timer);
-    ESP_ERROR_CHECK(esp_timer_start_periodic(_atx_timer,
-        US_ANGULAR_UNIT_TIME * ANGULAR_POSITION_UPDATE_FREQ));
 }
 
 /*
-    Some notes on esp_timer_get_time() from:
-    https://github.com/espressif/arduino-esp32/pull/1424
-    * returns monotonic time in microseconds
-    * can be called from tasks and interrupts
-    * does not use any critical sections/mutexes
-    * is thread safe
-    * takes less than 1 microsecond to execute
+    Our fake disk spins continuously, so the head position is simply a function
+    of time. esp_timer_get_time() is monotonic, thread safe and cheap to call,
+    which lets us work out in advance when the head will be over a sector
+    instead of polling for it.
 */
-void MediaTypeATX::on_timer(void *info)
-{
-    MediaTypeATX *pAtx = (MediaTypeATX *)info;
-
-    portENTER_CRITICAL(&pAtx->__atx_timerMux);
-
-    pAtx->__atx_position_time = esp_timer_get_time();
-    pAtx->__atx_current_angular_pos += ANGULAR_POSITION_UPDATE_FREQ;
-
-    if (pAtx->__atx_current_angular_pos >= ANGULAR_UNIT_TOTAL)
-    {
-        pAtx->__atx_current_angular_pos -= ANGULAR_UNIT_TOTAL;
-        pAtx->_atx_total_rotations++;
-    }
-
-    portEXIT_CRITICAL(&pAtx->__atx_timerMux);
-}
-
-uint16_t MediaTypeATX::_get_head_position()
+uint16_t MediaTypeATX::_head_position(uint64_t us_time)
 {
-    uint64_t us_now = esp_timer_get_time();
-
-    portENTER_CRITICAL(&__atx_timerMux);
-    uint64_t us_then = __atx_position_time;
-    uint16_t pos = __atx_current_angular_pos;
-    portEXIT_CRITICAL(&__atx_timerMux);
-
-    /*
-     Adjust the recorded angular position by the number of microseconds passed since
-     it was recorded.
-    */
-    uint64_t us_diff;
-
-    // Handle the rare case of a timer roll-over
-    if (us_now > us_then)
-    {
-        us_diff = us_now - us_then;
-    }
-    else
-    {
-        us_diff = UINT64_MAX - us_now + us_then;
-    }
-
-    pos += us_diff / US_ANGULAR_UNIT_TIME;
-    if (pos >= ANGULAR_UNIT_TOTAL)
-        pos -= ANGULAR_UNIT_TOTAL;
-
-    return pos;
+    return (us_time / US_ANGULAR_UNIT_TIME) % ANGULAR_UNIT_TOTAL;
 }
 
-void MediaTypeATX::_wait_full_rotation()
+// Microseconds until the head moves from angular position 'from' to 'to'
+uint32_t MediaTypeATX::_us_until_position(uint16_t from, uint32_t to)
 {
-    uint32_t pos = _get_head_position();
+    uint32_t units = (to + ANGULAR_UNIT_TOTAL - from) % ANGULAR_UNIT_TOTAL;
 
-    // Wait for a roll-over to occur
-    do
-    {
-        NOP();
-    } while (pos <= _get_head_position());
+    // Close enough, we're already there
+    if (units <= HEAD_TOLERANCE)
+        return 0;
 
-    // Wait for the head to be over the previous position
-    do
-    {
-        NOP();
-    } while (pos > _get_head_position());
+    return units * US_ANGULAR_UNIT_TIME;
 }
 
-void MediaTypeATX::_wait_head_position(uint16_t pos, uint16_t extra_delay)
+/*
+    Wait until the given esp_timer_get_time() deadline. Long waits (track steps,
+    head settling, a missed sector) give up the CPU for whole ticks and only the
+    remainder is spent in a precise delay.
+*/
+void MediaTypeATX::_wait_until(uint64_t deadline)
 {
-    pos += extra_delay;
-    if (pos >= ANGULAR_UNIT_TOTAL)
-        pos -= ANGULAR_UNIT_TOTAL;
-
-    uint16_t current = _get_head_position();
+    int64_t remaining = (int64_t)(deadline - esp_timer_get_time());
 
-    if (current == pos)
-    {
-        return;
-    }
+    // Leave at least one tick for the precise part since vTaskDelay may wake early or late by part of a tick
+    TickType_t ticks = remaining / (portTICK_PERIOD_MS * 1000);
+    if (ticks > 1)
+        vTaskDelay(ticks - 1);
 
-    while (abs(_get_head_position() - pos) > HEAD_TOLERANCE)
-    {
-        NOP();
-    }
+    remaining = (int64_t)(deadline - esp_timer_get_time());
+    if (remaining > 0)
+        fnSystem.delay_microseconds(remaining);
 }
 
-void MediaTypeATX::_process_sector(AtxTrack &track, AtxSector *psector, uint16_t sectorsize)
+void MediaTypeATX::_process_sector(const AtxSector &sector, uint16_t sectorsize)
 {
-    // Pause for the read head to be in the position of the sector
-    _wait_head_position(psector->position, ANGULAR_UNIT_TOTAL / _atx_sectors_per_track);
-
     // Copy data from the sector into the buffer if any is available
-    if ((psector->status & ATX_SECTOR_STATUS_MISSING_DATA) == 0)
+    if ((sector.status & ATX_SECTOR_STATUS_MISSING_DATA) == 0)
     {
-        // Make sure we have a reasonable offset and data to copy
-        if (track.data != nullptr && psector->start_data >= track.offset_to_data_start)
+        // Offsets were checked against the track data when the image was mounted
+        if (sector.data_offset != ATX_DATA_OFFSET_NONE)
         {
-            // Adjust the start_data value by the number of bytes into the Track Record the data chunk started
-            uint32_t data_offset = psector->start_data - track.offset_to_data_start;
-            memcpy(_disk_sectorbuff, track.data + data_offset, sectorsize);
+            memcpy(_disk_sectorbuff, _atx_data.data() + sector.data_offset,
+                   sector.data_length < sectorsize ? sector.data_length : sectorsize);
         }
         else
         {
-            Debug_printf("## Invalid sector data offset (%u < %u) or track data buffer (%p)\r\n",
-                         psector->start_data, track.offset_to_data_start, track.data);
+            Debug_print("## Invalid sector data offset\r\n");
             // Act as if the ATX_SECTOR_STATUS_MISSING_DATA bit was set
             _disk_controller_status |= DISK_CTRL_STATUS_SECTOR_MISSING;
         }
 
         // Replace bytes with random data if this sector has a WEAKOFFSET value
-        if (psector->weakoffset != ATX_WEAKOFFSET_NONE)
+        if (sector.weakoffset != ATX_WEAKOFFSET_NONE)
         {
-            Debug_printf("## Weak sector data starting at offset %u\r\n", psector->weakoffset);
+            Debug_printf("## Weak sector data starting at offset %u\r\n", sector.weakoffset);
             uint32_t rand = esp_random();
             // Fill the buffer from the offset position to the end with our random 32 bit value
-            for (int x = psector->weakoffset; x < sectorsize; x += sizeof(uint32_t))
-                *((uint32_t *)(_disk_sectorbuff + x)) = rand;
+            for (int x = sector.weakoffset; x < sectorsize; x += sizeof(uint32_t))
+                memcpy(_disk_sectorbuff + x, &rand, x + sizeof(uint32_t) <= sectorsize ? sizeof(uint32_t) : sectorsize - x);
         }
     }
     else
@@ -256,17 +147,17 @@ void MediaTypeATX::_process_sector(AtxTrack &track, AtxSector *psector, uint16_t
         Debug_printf("## Skipped data copy, setting DISK_CTRL_STATUS_SECTOR_MISSING\r\n");
     }
 
-    if (psector->status & ATX_SECTOR_STATUS_DELETED)
+    if (sector.status & ATX_SECTOR_STATUS_DELETED)
     {
         _disk_controller_status |= DISK_CTRL_STATUS_SECTOR_DELETED;
         Debug_print("## Setting DISK_CTRL_STATUS_SECTOR_DELETED\r\n");
     }
-    if (psector->status & ATX_SECTOR_STATUS_FDC_CRC_ERROR)
+    if (sector.status & ATX_SECTOR_STATUS_FDC_CRC_ERROR)
     {
         _disk_controller_status |= DISK_CTRL_STATUS_CRC_ERROR;
         Debug_print("## Setting DISK_CTRL_STATUS_CRC_ERROR\r\n");
     }
-    if (psector->status & ATX_SECTOR_STATUS_FDC_LOSTDATA_ERROR)
+    if (sector.status & ATX_SECTOR_STATUS_FDC_LOSTDATA_ERROR)
     {
         _disk_controller_status |= DISK_CTRL_STATUS_DATA_LOST;
         Debug_print("## Setting DISK_CTRL_STATUS_DATA_LOST\r\n");
@@ -283,9 +174,42 @@ void MediaTypeATX::_process_sector(AtxTrack &track, AtxSector *psector, uint16_t
     }
 }
 
-// Copies data for given track sector into disk buffer and sets status bits as appropriate
-// Returns TRUE on error reading sector
-bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum, uint16_t sectorsize)
+/*
+    Find the first sector with the given number that passes under the head at or after
+    head_pos. Duplicate sectors are sorted by position in the lookup table, so this is a
+    binary search for the number followed by one for the position, wrapping around to the
+    first copy on the next rotation if they're all behind the head.
+*/
+const AtxSector *MediaTypeATX::_find_sector(const AtxTrack &track, uint8_t sectornum, uint16_t head_pos)
+{
+    if (track.sector_count == 0)
+        return nullptr;
+
+    const uint16_t *first = _atx_lookup.data() + track.first_sector;
+    const uint16_t *last = first + track.sector_count;
+
+    first = std::lower_bound(first, last, sectornum,
+                             [this](uint16_t i, uint8_t num) { return _atx_sectors[i].number < num; });
+    last = std::upper_bound(first, last, sectornum,
+                            [this](uint8_t num, uint16_t i) { return num < _atx_sectors[i].number; });
+    if (first == last)
+        return nullptr;
+
+    const uint16_t *next = std::lower_bound(first, last, head_pos,
+                                            [this](uint16_t i, uint16_t pos) { return _atx_sectors[i].position < pos; });
+    if (next == last)
+        next = first;
+
+    return &_atx_sectors[*next];
+}
+
+/*
+ Copies data for given track sector into disk buffer and sets status bits as appropriate.
+ 'deadline' is the time at which the drive starts looking for the sector and is advanced
+ by the time the drive would spend on it.
+ Returns TRUE on error reading sector
+*/
+bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum, uint16_t sectorsize, uint64_t &deadline)
 {
     Debug_printf("copy data track %d, sector %d\r\n", tracknum, sectornum);
 
@@ -293,7 +217,7 @@ bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum,
     // because they check the checksum value, so we won't do it either...
     // memset(_disk_sectorbuff, 0, sectorsize);
 
-    AtxTrack &track = _tracks[tracknum];
+    const AtxTrack &track = _tracks[tracknum];
 
     _disk_controller_status = DISK_CTRL_STATUS_CLEAR;
 
@@ -302,40 +226,15 @@ bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum,
     {
         retries--;
 
-        // Iterate through every sector stored for this track and find the one closest to the current drive head position
-        uint16_t current_pos = _get_head_position();
-        AtxSector *pSector = nullptr;
-        for (auto &it : track.sectors)
-        {
-            if (it.number == sectornum)
-            {
-                if (pSector == nullptr)
-                {
-                    pSector = &it;
-                }
-                else
-                // Compare the distance from the head to this sector and the head to the previous matching sector
-                {
-                    int diff_this = it.position - current_pos;
-                    int diff_last = pSector->position - current_pos;
-
-                    // Conditions under which to replace the last matching sector:
-                    if (
-                        (diff_this == 0) ||                                          // We're currently over the right sector
-                        (diff_this > 0 && diff_last < 0) ||                          // This sector is ahead of the current pos and the last was behind
-                        (diff_this > 0 && diff_last > 0 && diff_this < diff_last) || // Both are ahead but this one is closer
-                        (diff_this < 0 && diff_last < 0 && diff_this < diff_last)    // Both are behind but this one is closer
-                    )
-                    {
-                        pSector = &it;
-                    }
-                }
-            }
-        }
+        // Find the matching sector that comes up next under the drive head
+        uint16_t current_pos = _head_position(deadline);
+        const AtxSector *pSector = _find_sector(track, sectornum, current_pos);
 
         if (pSector != nullptr)
         {
-            _process_sector(track, pSector, sectorsize);
+            // The read completes once the head has passed over the sector
+            deadline += _us_until_position(current_pos, pSector->position + ANGULAR_UNIT_TOTAL / _atx_sectors_per_track);
+            _process_sector(*pSector, sectorsize);
             // Skip any retires if our status is clear
             if (_disk_controller_status == DISK_CTRL_STATUS_CLEAR)
                 retries = 0;
@@ -348,12 +247,9 @@ bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum,
 
         // Wait a full disk rotation before trying again
         if (retries != 0)
-            _wait_full_rotation();
+            deadline += US_FULL_ROTATION;
     }
 
-    // Delay for the CRC calculation
-    fnSystem.delay_microseconds(_atx_drive_model == ATX_DRIVE_MODEL_810 ? US_CRC_CALCULATION_810 : US_CRC_CALCULATION_1050);
-
     // Return error condition if our controller status isn't clear
     return _disk_controller_status != DISK_CTRL_STATUS_CLEAR;
 }
@@ -361,7 +257,9 @@ bool MediaTypeATX::_copy_track_sector_data(uint8_t tracknum, uint8_t sectornum,
 // Returns TRUE if an error condition occurred
 bool MediaTypeATX::read(uint16_t sectornum, uint16_t *readcount)
 {
-    Debug_printf("ATX READ (%d) rots=%u\r\n", sectornum, _atx_total_rotations);
+    uint64_t deadline = esp_timer_get_time();
+
+    Debug_printf("ATX READ (%d) rots=%llu\r\n", sectornum, deadline / US_FULL_ROTATION);
 
     *readcount = 0;
 
@@ -383,16 +281,21 @@ bool MediaTypeATX::read(uint16_t sectornum, uint16_t *readcount)
     if (trackdiff > 0)
     {
         uint32_t us_delay = _atx_drive_model == ATX_DRIVE_MODEL_810 ? US_TRACK_STEP_810 * trackdiff + US_HEAD_SETTLE_810 : US_TRACK_STEP_1050 * trackdiff + US_HEAD_SETTLE_1050;
-        fnSystem.delay_microseconds(us_delay);
+        deadline += us_delay;
     }
 
     // Add a fake drive CPU request handling delay
-    fnSystem.delay_microseconds(
-        _atx_drive_model == ATX_DRIVE_MODEL_810 ? US_DRIVE_REQUEST_DELAY_810 : US_DRIVE_REQUEST_DELAY_1050);
+    deadline += _atx_drive_model == ATX_DRIVE_MODEL_810 ? US_DRIVE_REQUEST_DELAY_810 : US_DRIVE_REQUEST_DELAY_1050;
 
     *readcount = sectorSize;
 
-    bool result = _copy_track_sector_data((uint8_t)tracknumber, (uint8_t)tracksector, sectorSize);
+    bool result = _copy_track_sector_data((uint8_t)tracknumber, (uint8_t)tracksector, sectorSize, deadline);
+
+    // Delay for the CRC calculation
+    deadline += _atx_drive_model == ATX_DRIVE_MODEL_810 ? US_CRC_CALCULATION_810 : US_CRC_CALCULATION_1050;
+
+    // All the drive's delays add up to a single wait
+    _wait_until(deadline);
 
     //util_dump_bytes(_disk_sectorbuff, sectorSize);
 
@@ -419,254 +322,118 @@ void MediaTypeATX::status(uint8_t statusbuff[4])
     statusbuff[2] = _atx_density == ATX_DENSITY_DOUBLE ? ATX_FORMAT_TIMEOUT_XF551 : ATX_FORMAT_TIMEOUT_810_1050;
 }
 
-bool MediaTypeATX::_load_atx_chunk_weak_sector(chunk_header_t &chunk_hdr, AtxTrack &track)
+static uint16_t _atx_extended_size(uint16_t header_data)
 {
-    #ifdef VERBOSE_ATX
-    Debug_printf("::_load_atx_chunk_weak_sector (%hu = 0x%04x)\r\n",
-                 chunk_hdr.sector_index, chunk_hdr.header_data);
-    #endif
-
-    if (chunk_hdr.sector_index >= track.sector_count)
-    {
-        Debug_println("ERROR: _load_atx_chunk_weak_sector sector index > sector_count");
-        return false;
-    }
-    track.sectors[chunk_hdr.sector_index].weakoffset = chunk_hdr.header_data;
-    return true;
-}
-
-bool MediaTypeATX::_load_atx_chunk_extended_sector(chunk_header_t &chunk_hdr, AtxTrack &track)
-{
-    #ifdef VERBOSE_ATX
-    Debug_printf("::_load_atx_chunk_extended_sector (%hu = 0x%04x)\r\n",
-                 chunk_hdr.sector_index, chunk_hdr.header_data);
-    #endif
-
-    if (chunk_hdr.sector_index >= track.sector_count)
-    {
-        Debug_println("ERROR: _load_atx_chunk_extended_sector sector index > sector_count");
-        return false;
-    }
-
-    uint16_t xsize;
-    switch (chunk_hdr.header_data)
+    switch (header_data)
     {
     case ATX_EXTENDEDSIZE_128:
-        xsize = 128;
-        break;
+        return 128;
     case ATX_EXTENDEDSIZE_256:
-        xsize = 256;
-        break;
+        return 256;
     case ATX_EXTENDEDSIZE_512:
-        xsize = 512;
-        break;
+        return 512;
     case ATX_EXTENDEDSIZE_1024:
-        xsize = 1024;
-        break;
+        return 1024;
     default:
-        Debug_println("WARNING: Invalid extended sector value");
-        return false;
+        return 0;
     }
-    track.sectors[chunk_hdr.sector_index].extendedsize = xsize;
-    return true;
 }
 
-bool MediaTypeATX::_load_atx_chunk_sector_data(chunk_header_t &chunk_hdr, AtxTrack &track)
+/*
+    Compile the sectors parsed from a track record into the image-wide arrays:
+    sector data is appended to _atx_data with each sector's data offset resolved against it,
+    sectors are stored sorted by angular position, and the lookup table gets the same
+    sectors sorted by (number, position).
+    'record' is the whole Track Record, data_start/data_end the bounds of its sector data chunk.
+*/
+bool MediaTypeATX::_compile_atx_track(AtxTrack &track, const uint8_t *record, std::vector<AtxSector> &sectors,
+                                      uint32_t data_start, uint32_t data_end)
 {
-    #ifdef VERBOSE_ATX
-    Debug_print("::_load_atx_chunk_sector_data\r\n");
-    #endif
-
-    // Just in case we already read data for this track
-    if (track.data != nullptr)
-        delete[] track.data;
-
-    // We take the number of bytes to read from the chunk length header value
-    int data_size = chunk_hdr.length - sizeof(chunk_hdr);
-
-    // Skip if there's nothing to do
-    if (data_size == 0)
-        return true;
-    
-    // Attempt to the sector data
-    track.data = (uint8_t *)heap_caps_malloc(data_size * sizeof(uint8_t), MALLOC_CAP_DEFAULT);
-
-    int i;
-    if ((i = fnio::fread(track.data, 1, data_size, _disk_fileh)) != data_size)
+    if (_atx_sectors.size() + sectors.size() > UINT16_MAX)
     {
-        Debug_printf("failed reading %d sector data chunk bytes (%d, %d)\r\n", data_size, i, errno);
-        delete[] track.data;
-        track.data = nullptr;
+        Debug_print("ERROR: too many sectors in image\r\n");
         return false;
     }
 
+    uint32_t data_base = _atx_data.size();
+    _atx_data.insert(_atx_data.end(), record + data_start, record + data_end);
+
     /*
     The start_data value in each sector header is an offset into the overall Track Record,
     including headers and other chunks that preceed it, where that sector's actual data begins
-    in the data chunk.
-
-    We record the number of bytes into the Track Record the data chunk begins so we
-    can adjust the start_data value later when we want to read the right section from this
-    array of bytes.
+    in the data chunk. We turn that into an offset into _atx_data here so reads don't need to.
     */
-    track.offset_to_data_start = track.record_bytes_read;
-    // Keep a count of how many bytes we've read into the Track Record
-    track.record_bytes_read += data_size;
-
-    //util_dump_bytes(track.data, 64);
-
-    return true;
-}
-
-bool MediaTypeATX::_load_atx_chunk_sector_list(chunk_header_t &chunk_hdr, AtxTrack &track)
-{
-    #ifdef VERBOSE_ATX
-    Debug_print("::_load_atx_chunk_sector_list\r\n");
-    #endif
-
-    // Skip all this if this track has no sectors
-    if (track.sector_count == 0)
-        return true;
-
-    int readz = sizeof(sector_header) * track.sector_count;
-    if(chunk_hdr.length != readz + sizeof(chunk_hdr))
-    {
-        Debug_printf("WARNING: Chunk length %U != expected\r\n", chunk_hdr.length);
-    }
-
-    // Attempt to read sector_header * sector_count
-    sector_header_t *sector_list = (sector_header_t *)heap_caps_malloc(track.sector_count * sizeof(sector_header_t), MALLOC_CAP_DEFAULT);
-    int i;
-
-    if ((i = fnio::fread(sector_list, 1, readz, _disk_fileh)) != readz)
+    for (auto &sector : sectors)
     {
-        Debug_printf("failed reading sector list chunk bytes (%d, %d)\r\n", i, errno);
-        delete[] sector_list;
-        return false;
-    }
-
-    // Keep a count of how many bytes we've read into the Track Record
-    track.record_bytes_read += readz;
+        if (sector.status & ATX_SECTOR_STATUS_MISSING_DATA)
+        {
+            sector.data_offset = ATX_DATA_OFFSET_NONE;
+            continue;
+        }
 
-    // Stuff the data into our sector objects
-    track.sectors.reserve(track.sector_count);
-    for (i = 0; i < track.sector_count; i++)
-    {
-        if (sector_list[i].position >= ANGULAR_UNIT_TOTAL)
+        uint32_t start = sector.data_offset; // still the Track Record offset
+        if (start >= data_start && start < data_end)
         {
-            Debug_printf("WARNING: sector position = %hu\r\n", sector_list[i].position);
-            sector_list[i].position = 0;
+            sector.data_offset = data_base + start - data_start;
+            sector.data_length = std::min<uint32_t>(data_end - start, UINT16_MAX);
+        }
+        else
+        {
+            Debug_printf("WARNING: sector %hu data offset %u outside data chunk (%u-%u)\r\n",
+                         sector.number, start, data_start, data_end);
+            sector.data_offset = ATX_DATA_OFFSET_NONE;
         }
-        track.sectors.emplace_back(sector_list[i]);
     }
 
-    delete[] sector_list;
+    std::stable_sort(sectors.begin(), sectors.end(),
+                     [](const AtxSector &a, const AtxSector &b) { return a.position < b.position; });
 
-    return true;
-}
-
-// Skip over unknown chunks if needed
-bool MediaTypeATX::_load_atx_chunk_unknown(chunk_header_t &chunk_hdr, AtxTrack &track)
-{
-    Debug_print("::_load_atx_chunk_UNKNOWN - skipping\r\n");
+    // The track only becomes visible to reads once it's complete
+    track.first_sector = _atx_sectors.size();
+    track.sector_count = sectors.size();
+    _atx_sectors.insert(_atx_sectors.end(), sectors.begin(), sectors.end());
 
+    _atx_lookup.resize(_atx_sectors.size());
+    auto lookup = _atx_lookup.begin() + track.first_sector;
+    for (int i = 0; i < track.sector_count; i++)
+        lookup[i] = track.first_sector + i;
+    std::stable_sort(lookup, lookup + track.sector_count,
+                     [this](uint16_t a, uint16_t b) { return _atx_sectors[a].number < _atx_sectors[b].number; });
 
-    uint32_t chunk_size = chunk_hdr.length - sizeof(chunk_hdr);
-    if (chunk_size > 0)
-    {
-        Debug_printf("seeking +%u to skip this chunk\r\n", chunk_size);
-        int i;
-        if ((i = fnio::fseek(_disk_fileh, chunk_size, SEEK_CUR)) < 0)
-        {
-            Debug_printf("seek failed (%d, %d)\r\n", i, errno);
-            return false;
-        }
-        // Keep a count of how many bytes we've read into the Track Record
-        track.record_bytes_read += chunk_size;
-    }
     return true;
 }
 
 /*
-    Returns:
-    0 = Ok
-    1 = Done (reached terminator chunk)
-   -1 = Error
+    Reads a whole Track Record into memory in one go and walks its chunks from there.
+    Returns FALSE on error
 */
-int MediaTypeATX::_load_atx_track_chunk(track_header_t &trk_hdr, AtxTrack &track)
+bool MediaTypeATX::_load_atx_track_record(record_header_t &rec_hdr)
 {
     #ifdef VERBOSE_ATX
-    Debug_print("::_load_atx_track_chunk\r\n");
+    Debug_printf("::_load_atx_track_record len %u\r\n", rec_hdr.length);
     #endif
 
-    chunk_header_t chunk_hdr;
-
-    int i;
-    if ((i = fnio::fread(&chunk_hdr, 1, sizeof(chunk_hdr), _disk_fileh)) != sizeof(chunk_hdr))
-    {
-        Debug_printf("failed reading track chunk bytes (%d, %d)\r\n", i, errno);
-        return -1;
-    }
-
-    // Keep a count of how many bytes we've read into the Track Record
-    track.record_bytes_read += sizeof(chunk_header_t);
-
-    // Check for a terminating marker
-    if (chunk_hdr.length == 0)
+    if (rec_hdr.length < sizeof(record_header_t) + sizeof(track_header_t))
     {
-        #ifdef VERBOSE_ATX
-        Debug_print("track chunk terminator\r\n");
-        #endif
-        return 1; // 1 = done
-    }
-
-    #ifdef VERBOSE_ATX
-    Debug_printf("chunk size=%u, type=0x%02hx, secindex=%d, hdata=0x%04hx\r\n",
-                 chunk_hdr.length, chunk_hdr.type, chunk_hdr.sector_index, chunk_hdr.header_data);
-    #endif
-
-    switch (chunk_hdr.type)
-    {
-    case ATX_CHUNKTYPE_SECTOR_LIST:
-        if (false == _load_atx_chunk_sector_list(chunk_hdr, track))
-            return -1;
-        break;
-    case ATX_CHUNKTYPE_SECTOR_DATA:
-        if (false == _load_atx_chunk_sector_data(chunk_hdr, track))
-            return -1;
-        break;
-    case ATX_CHUNKTYPE_WEAK_SECTOR:
-        if (false == _load_atx_chunk_weak_sector(chunk_hdr, track))
-            return -1;
-        break;
-    case ATX_CHUNKTYPE_EXTENDED_HEADER:
-        if (false == _load_atx_chunk_extended_sector(chunk_hdr, track))
-            return -1;
-        break;
-    default:
-        if (false == _load_atx_chunk_unknown(chunk_hdr, track))
-            return -1;
-        break;
+        Debug_printf("ERROR: track record too short (%u)\r\n", rec_hdr.length);
+        return false;
     }
 
-    return 0;
-}
-
-bool MediaTypeATX::_load_atx_track_record(uint32_t length)
-{
-    #ifdef VERBOSE_ATX
-    Debug_printf("::_load_atx_track_record len %u\r\n", length);
-    #endif
-
-    track_header_t trk_hdr;
+    // Keep the record header in the buffer so offsets within the record can be used as-is
+    std::vector<uint8_t, PSRAMAllocator<uint8_t>> record(rec_hdr.length);
+    memcpy(record.data(), &rec_hdr, sizeof(rec_hdr));
 
     int i;
-    if ((i = fnio::fread(&trk_hdr, 1, sizeof(trk_hdr), _disk_fileh)) != sizeof(trk_hdr))
+    int readz = rec_hdr.length - sizeof(rec_hdr);
+    if ((i = fnio::fread(record.data() + sizeof(rec_hdr), 1, readz, _disk_fileh)) != readz)
     {
-        Debug_printf("failed reading track header bytes (%d, %d)\r\n", i, errno);
+        Debug_printf("failed reading track record bytes (%d, %d)\r\n", i, errno);
         return false;
     }
 
+    track_header_t trk_hdr;
+    memcpy(&trk_hdr, record.data() + sizeof(rec_hdr), sizeof(trk_hdr));
+
     #ifdef VERBOSE_ATX
     Debug_printf("track #%hu, sectors=%hu, rate=%hu, flags=0x%04x, headersize=%u\r\n",
                  trk_hdr.track_number, trk_hdr.sector_count,
@@ -691,41 +458,114 @@ bool MediaTypeATX::_load_atx_track_record(uint32_t length)
 
     // Store basic track info
     track.track_number = trk_hdr.track_number;
-    track.rate = trk_hdr.rate;
     track.flags = trk_hdr.flags;
-    track.sector_count = trk_hdr.sector_count;
-
-    // Keep a count of how many bytes we've read into the Track Record
-    // So far we've read record_header + track_header bytes into this record
-    track.record_bytes_read = sizeof(record_header_t) + sizeof(track_header_t);
 
     _atx_num_tracks++;
 
-    // If needed, skip ahead to the first track chunk given the header size value
-    // (The 'header_size' value includes both the current track header and the 'parent' record header)
-    uint32_t chunk_start_offset = trk_hdr.header_size - sizeof(trk_hdr) - sizeof(record_header);
-    if (chunk_start_offset > 0)
+    // Sector data offsets are still relative to the Track Record here, _compile_atx_track() resolves them
+    uint16_t sector_count = trk_hdr.sector_count;
+    std::vector<AtxSector> sectors(sector_count);
+    uint32_t data_start = 0;
+    uint32_t data_end = 0;
+
+    // The 'header_size' value includes both the current track header and the 'parent' record header
+    uint32_t offset = trk_hdr.header_size;
+    for (;;)
     {
+        chunk_header_t chunk_hdr;
+        if (offset + sizeof(chunk_hdr) > rec_hdr.length)
+        {
+            Debug_print("ERROR: track record ends without chunk terminator\r\n");
+            return false;
+        }
+        memcpy(&chunk_hdr, record.data() + offset, sizeof(chunk_hdr));
+
+        // Check for a terminating marker
+        if (chunk_hdr.length == 0)
+        {
+            #ifdef VERBOSE_ATX
+            Debug_print("track chunk terminator\r\n");
+            #endif
+            break;
+        }
+
         #ifdef VERBOSE_ATX
-        Debug_printf("seeking +%u to first chunk start pos\r\n", chunk_start_offset);
+        Debug_printf("chunk size=%u, type=0x%02hx, secindex=%d, hdata=0x%04hx\r\n",
+                     chunk_hdr.length, chunk_hdr.type, chunk_hdr.sector_index, chunk_hdr.header_data);
         #endif
-        if ((i = fnio::fseek(_disk_fileh, chunk_start_offset, SEEK_CUR)) < 0)
+
+        if (chunk_hdr.length < sizeof(chunk_hdr) || chunk_hdr.length > rec_hdr.length - offset)
         {
-            Debug_printf("failed seeking to first chunk in track record (%d, %d)\r\n", i, errno);
+            Debug_printf("ERROR: bad chunk length %u\r\n", chunk_hdr.length);
             return false;
         }
-        // Keep a count of how many bytes we've read into the Track Record
-        track.record_bytes_read += chunk_start_offset;
-    }
 
-    // Reserve space for the sectors we're eventually going to read for this track
-    track.sectors.reserve(track.sector_count);
+        uint32_t payload = offset + sizeof(chunk_hdr);
+        uint32_t payload_size = chunk_hdr.length - sizeof(chunk_hdr);
 
-    // Read the chunks in the track
-    while ((i = _load_atx_track_chunk(trk_hdr, track)) == 0)
-        ;
+        switch (chunk_hdr.type)
+        {
+        case ATX_CHUNKTYPE_SECTOR_LIST:
+        {
+            uint32_t expected = sizeof(sector_header_t) * sector_count;
+            if (payload_size < expected)
+            {
+                Debug_printf("ERROR: sector list chunk length %u too short\r\n", chunk_hdr.length);
+                return false;
+            }
+            if (payload_size != expected)
+                Debug_printf("WARNING: Chunk length %u != expected\r\n", chunk_hdr.length);
+
+            for (int s = 0; s < sector_count; s++)
+            {
+                sector_header_t sec_hdr;
+                memcpy(&sec_hdr, record.data() + payload + s * sizeof(sec_hdr), sizeof(sec_hdr));
+                if (sec_hdr.position >= ANGULAR_UNIT_TOTAL)
+                {
+                    Debug_printf("WARNING: sector position = %hu\r\n", sec_hdr.position);
+                    sec_hdr.position = 0;
+                }
+                sectors[s].number = sec_hdr.number;
+                sectors[s].status = sec_hdr.status;
+                sectors[s].position = sec_hdr.position;
+                sectors[s].data_offset = sec_hdr.start_data;
+            }
+            break;
+        }
+        case ATX_CHUNKTYPE_SECTOR_DATA:
+            // Just in case there's more than one, the last one wins
+            data_start = payload;
+            data_end = payload + payload_size;
+            break;
+        case ATX_CHUNKTYPE_WEAK_SECTOR:
+            if (chunk_hdr.sector_index >= sector_count)
+            {
+                Debug_println("ERROR: weak sector chunk sector index > sector_count");
+                return false;
+            }
+            sectors[chunk_hdr.sector_index].weakoffset = chunk_hdr.header_data;
+            break;
+        case ATX_CHUNKTYPE_EXTENDED_HEADER:
+            if (chunk_hdr.sector_index >= sector_count)
+            {
+                Debug_println("ERROR: extended sector chunk sector index > sector_count");
+                return false;
+            }
+            if ((sectors[chunk_hdr.sector_index].extendedsize = _atx_extended_size(chunk_hdr.header_data)) == 0)
+            {
+                Debug_println("WARNING: Invalid extended sector value");
+                return false;
+            }
+            break;
+        default:
+            Debug_print("::_load_atx_chunk_UNKNOWN - skipping\r\n");
+            break;
+        }
+
+        offset += chunk_hdr.length;
+    }
 
-    return i == 1; // Return FALSE on error condition
+    return _compile_atx_track(track, record.data(), sectors, data_start, data_end);
 }
 
 /*
@@ -770,7 +610,7 @@ bool MediaTypeATX::_load_atx_record()
     }
 
     // Try to read the track into memory
-    return _load_atx_track_record(rec_hdr.length);
+    return _load_atx_track_record(rec_hdr);
 }
 
 /*
@@ -864,14 +704,26 @@ mediatype_t MediaTypeATX::mount(fnFile *f, uint32_t disksize)
 
     _disk_fileh = f;
 
+    // The compiled image is never bigger than the file
+    _atx_data.reserve(disksize);
+
     // Load all the actual ATX records into memory (return immediately if we fail)
     if (_load_atx_data(hdr) == false)
     {
         _disk_fileh = nullptr;
         _tracks.clear();
+        _atx_sectors.clear();
+        _atx_lookup.clear();
+        _atx_data.clear();
         return MEDIATYPE_UNKNOWN;
     }
 
+    _atx_data.shrink_to_fit();
+    _atx_sectors.shrink_to_fit();
+    _atx_lookup.shrink_to_fit();
+    Debug_printf("ATX compiled: %u sectors, %u data bytes\r\n",
+                 (unsigned)_atx_sectors.size(), (unsigned)_atx_data.size());
+
     _disk_num_sectors = 720;
 
     Debug_printv("Heap free: %lu",esp_get_free_internal_heap_size());
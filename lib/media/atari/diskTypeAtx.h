@@ -28,6 +28,7 @@
 #define ATX_SECTOR_STATUS_EXTENDED 0x40
 
 #define ATX_WEAKOFFSET_NONE 0xFFFF
+#define ATX_DATA_OFFSET_NONE 0xFFFFFFFF
 
 #define ATX_EXTENDEDSIZE_128 0x00
 #define ATX_EXTENDEDSIZE_256 0x01
@@ -116,51 +117,39 @@ struct sector_header
 } __attribute__((packed));
 typedef struct sector_header sector_header_t;
 
-class AtxSector
+/*
+    Sectors of all tracks compiled at mount time into one flat array. Within a
+    track the entries are sorted by angular position and everything a read needs
+    (data location, weak offset, long sector size) is resolved in advance.
+*/
+struct AtxSector
 {
-public:
-    // 1-based and possible to have duplicates    
+    // 0-based starting angular position of sector in 8us intervals (1/26042th of a rotation or ~0.0138238 degrees). Nominally 0-26042
+    uint16_t position = 0;
+    // 1-based and possible to have duplicates
     uint8_t number = 0;
-    // ATX_SECTOR_STATUS bit flags     
+    // ATX_SECTOR_STATUS bit flags
     uint8_t status = 0;
-    // 0-based starting angular position of sector in 8us intervals (1/26042th of a rotation or ~0.0138238 degrees). Nominally 0-26042    
-    uint16_t position = 0;
-    // Byte offset from start of track data record to first byte of sector data within the sector data chunk. No data is present when sector status bit 4 set
-    uint32_t start_data = 0;
-
-    // Byte offset within sector at which weak (random) data should be returned    
+    // Offset of the sector data in the image data buffer or ATX_DATA_OFFSET_NONE
+    uint32_t data_offset = ATX_DATA_OFFSET_NONE;
+    // Number of bytes available at data_offset (up to the end of the track data chunk)
+    uint16_t data_length = 0;
+    // Byte offset within sector at which weak (random) data should be returned
     uint16_t weakoffset = ATX_WEAKOFFSET_NONE;
-    // Physical size of long sector (one of ATX_EXTENDESIZE)
+    // Physical size of long sector in bytes (0 if not a long sector)
     uint16_t extendedsize = 0;
-
-    ~AtxSector();
-    AtxSector(sector_header_t & header);
 };
 
-class AtxTrack
+struct AtxTrack
 {
-public:
     // We assume there are 40 tracks and no duplicates, but this serves as a safety check
     int8_t track_number = -1;
     // Number of physical sectors in track
     uint16_t sector_count = 0;
-    // ? unknown use ?
-    uint16_t rate;
+    // Index of the track's first sector in the sector array and lookup table
+    uint16_t first_sector = 0;
     // ATX_TRACK_FLAGS bit flags
-    uint32_t flags;
-
-    // Keep count of bytes read into ATX track record
-    uint32_t record_bytes_read = 0;
-    uint32_t offset_to_data_start = 0;
-
-    // Actual sector data
-    uint8_t * data = nullptr;
-
-    // Actual sectors
-    std::vector<AtxSector,PSRAMAllocator<AtxSector>> sectors;
-
-    ~AtxTrack();
-    AtxTrack();
+    uint32_t flags = 0;
 };
 
 class MediaTypeATX : public MediaType
@@ -177,19 +166,13 @@ private:
 
     uint8_t _atx_drive_model = ATX_DRIVE_MODEL_810;
 
-#ifdef ESP_PLATFORM
-    portMUX_TYPE __atx_timerMux = portMUX_INITIALIZER_UNLOCKED;
-#endif
-
-    uint64_t __atx_position_time;
-    uint16_t __atx_current_angular_pos = 0;
-    uint32_t _atx_total_rotations = 0;
-
-#ifdef ESP_PLATFORM
-    esp_timer_handle_t _atx_timer = nullptr;
-#endif
-
     std::vector<AtxTrack,PSRAMAllocator<AtxTrack>> _tracks;
+    // All sectors of the image, grouped by track and sorted by angular position
+    std::vector<AtxSector,PSRAMAllocator<AtxSector>> _atx_sectors;
+    // Per track indexes into _atx_sectors sorted by (number, position) for binary search
+    std::vector<uint16_t,PSRAMAllocator<uint16_t>> _atx_lookup;
+    // Sector data of all tracks
+    std::vector<uint8_t,PSRAMAllocator<uint8_t>> _atx_data;
 
     // ATX header.density
     uint8_t _atx_density = ATX_DENSITY_SINGLE;
@@ -198,21 +181,17 @@ private:
 
     bool _load_atx_data(atx_header_t &atx_hdr);
     bool _load_atx_record();
-    bool _load_atx_track_record(uint32_t length);
-    int _load_atx_track_chunk(track_header_t &trk_hdr, AtxTrack &track);
+    bool _load_atx_track_record(record_header_t &rec_hdr);
+    bool _compile_atx_track(AtxTrack &track, const uint8_t *record, std::vector<AtxSector> &sectors,
+                            uint32_t data_start, uint32_t data_end);
 
-    bool _load_atx_chunk_sector_list(chunk_header_t &chunk_hdr, AtxTrack &track);
-    bool _load_atx_chunk_sector_data(chunk_header_t &chunk_hdr, AtxTrack &track);
-    bool _load_atx_chunk_weak_sector(chunk_header_t &chunk_hdr, AtxTrack &track);
-    bool _load_atx_chunk_extended_sector(chunk_header_t &chunk_hdr, AtxTrack &track);
-    bool _load_atx_chunk_unknown(chunk_header_t &chunk_hdr, AtxTrack &track);
+    const AtxSector *_find_sector(const AtxTrack &track, uint8_t sectornum, uint16_t head_pos);
+    bool _copy_track_sector_data(uint8_t tracknum, uint8_t sectornum, uint16_t sectorsize, uint64_t &deadline);
+    void _process_sector(const AtxSector &sector, uint16_t sectorsize);
 
-    bool _copy_track_sector_data(uint8_t tracknum, uint8_t sectornum, uint16_t sectorsize);
-    void _process_sector(AtxTrack &track, AtxSector *sectorp, uint16_t sectorsize);
-
-    uint16_t _get_head_position();
-    void _wait_full_rotation();
-    void _wait_head_position(uint16_t pos, uint16_t extra_delay);
+    static uint16_t _head_position(uint64_t us_time);
+    static uint32_t _us_until_position(uint16_t from, uint32_t to);
+    static void _wait_until(uint64_t deadline);
 
 public:
     virtual bool read(uint16_t sectornum, uint16_t *readcount) override;
@@ -222,8 +201,6 @@ public:
 
     virtual void status(uint8_t statusbuff[4]) override;
 
-    static void on_timer(void *info);
-
     MediaTypeATX();
     ~MediaTypeATX();
 };
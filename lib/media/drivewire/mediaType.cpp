@@ -44,15 +44,18 @@ void MediaType::unmount()
 mediatype_t MediaType::discover_mediatype(const char *filename)
 {
     int l = strlen(filename);
+    // Look past ".gz" on compressed images
+    if (l > 3 && strcasecmp(filename + l - 3, ".gz") == 0)
+        l -= 3;
     if (l > 4 && filename[l - 4] == '.')
     {
         // Check the last 3 characters of the string
         const char *ext = filename + l - 3;
-        if (strcasecmp(ext, "DSK") == 0)
+        if (strncasecmp(ext, "DSK", 3) == 0)
         {
             return MEDIATYPE_DSK;
         }
-        else if (strcasecmp(ext, "MRM") == 0 || strcasecmp(ext, "RMM") == 0)
+        else if (strncasecmp(ext, "MRM", 3) == 0 || strncasecmp(ext, "RMM", 3) == 0)
         {
             return MEDIATYPE_MRM;
         }
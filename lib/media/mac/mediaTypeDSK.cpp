@@ -0,0 +1,324 @@
+#ifdef BUILD_MAC
+
+#include "mediaTypeDSK.h"
+
+#include <string.h>
+#include "../../include/debug.h"
+
+/*
+ Sony 400K/800K GCR format: 80 cylinders in 5 speed zones of 16, with 12 sectors
+ per track on the outer zone down to 8 on the inner one. Sectors are 12 tag bytes
+ plus 512 data bytes, 2:1 interleaved. The bit cell is 2 us on every zone, the
+ drive spins slower on the outer zones so those hold more bits.
+*/
+
+#define GCR_BIT_TIMING 16   // 2 us, in MOOF units of 125 ns
+#define GCR_TAG_BYTES 12
+#define GCR_SECTOR_BYTES (GCR_TAG_BYTES + 512)
+#define GCR_MAX_SECTORS 12
+#define GCR_SECTOR_SYNCS 5  // self sync nibbles ahead of each address and data field
+#define GCR_DATA_NIBBLES 703 // 524 bytes as 699 nibbles plus 4 checksum nibbles
+
+// Bits in one encoded sector: sync, D5 AA 96, 5 header nibbles, DE AA FF, sync, D5 AA AD, sector, data, DE AA FF
+#define GCR_SECTOR_BITS (2 * GCR_SECTOR_SYNCS * 10 + (11 + 4 + GCR_DATA_NIBBLES + 3) * 8)
+
+// One revolution at 2 us per bit for each zone: 394, 429, 472, 525 and 590 rpm
+static const uint32_t zone_bits[5] = {76142, 69930, 63559, 57142, 50847};
+
+// 6-and-2 GCR: the 64 disk bytes with the high bit set and no more than one pair of adjacent zeros
+static const uint8_t gcr_6and2[64] = {
+    0x96, 0x97, 0x9a, 0x9b, 0x9d, 0x9e, 0x9f, 0xa6,
+    0xa7, 0xab, 0xac, 0xad, 0xae, 0xaf, 0xb2, 0xb3,
+    0xb4, 0xb5, 0xb6, 0xb7, 0xb9, 0xba, 0xbb, 0xbc,
+    0xbd, 0xbe, 0xbf, 0xcb, 0xcd, 0xce, 0xcf, 0xd3,
+    0xd6, 0xd7, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde,
+    0xdf, 0xe5, 0xe6, 0xe7, 0xe9, 0xea, 0xeb, 0xec,
+    0xed, 0xee, 0xef, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6,
+    0xf7, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff};
+
+// Leading gap of self sync nibbles, the rest of the revolution after the sectors
+static int gap_syncs(int cylinder)
+{
+    int n = MediaTypeDSK::sectors_per_track(cylinder);
+    return (zone_bits[cylinder / 16] - n * GCR_SECTOR_BITS) / 10;
+}
+
+static uint32_t track_bits(int cylinder)
+{
+    return gap_syncs(cylinder) * 10 + MediaTypeDSK::sectors_per_track(cylinder) * GCR_SECTOR_BITS;
+}
+
+// Bits go MSB first, the buffer must be cleared beforehand
+static size_t write_byte(uint8_t *buffer, size_t position, uint8_t value)
+{
+    size_t shift = position & 7;
+    size_t byte_position = position >> 3;
+
+    buffer[byte_position] |= value >> shift;
+    if (shift)
+        buffer[byte_position + 1] |= value << (8 - shift);
+
+    return position + 8;
+}
+
+static size_t write_sync(uint8_t *buffer, size_t position)
+{
+    position = write_byte(buffer, position, 0xff);
+    return position + 2; // 10 bit self sync nibble, two 0s
+}
+
+static size_t write_nibble(uint8_t *buffer, size_t position, uint8_t value)
+{
+    return write_byte(buffer, position, gcr_6and2[value & 0x3f]);
+}
+
+/*
+ Sony 524 byte sector to 703 six bit values. The bytes are taken three at a time,
+ each XORed with a running checksum (c1 is rotated left every round, carries
+ propagate c1 -> c3 -> c2 -> c1), and their top two bits are packed into a
+ fourth value. The three checksum bytes follow the same way.
+*/
+static void encode_sector(uint8_t *dest, const uint8_t *tags, const uint8_t *data)
+{
+    uint8_t b1[175], b2[175], b3[175];
+    uint32_t c1 = 0, c2 = 0, c3 = 0;
+
+    int i = 0;
+    for (int j = 0;; j++)
+    {
+        c1 = (c1 & 0xff) << 1;
+        if (c1 & 0x0100)
+            c1++;
+
+        uint8_t val = i < GCR_TAG_BYTES ? tags[i] : data[i - GCR_TAG_BYTES];
+        i++;
+        c3 += val;
+        if (c1 & 0x0100)
+        {
+            c3++;
+            c1 &= 0xff;
+        }
+        b1[j] = val ^ c1;
+
+        val = i < GCR_TAG_BYTES ? tags[i] : data[i - GCR_TAG_BYTES];
+        i++;
+        c2 += val;
+        if (c3 > 0xff)
+        {
+            c2++;
+            c3 &= 0xff;
+        }
+        b2[j] = val ^ c3;
+
+        if (i == GCR_SECTOR_BYTES)
+        {
+            b3[j] = 0;
+            break;
+        }
+
+        val = i < GCR_TAG_BYTES ? tags[i] : data[i - GCR_TAG_BYTES];
+        i++;
+        c1 += val;
+        if (c2 > 0xff)
+        {
+            c1++;
+            c2 &= 0xff;
+        }
+        b3[j] = val ^ c2;
+    }
+
+    int n = 0;
+    for (int j = 0; j < 175; j++)
+    {
+        dest[n++] = ((b1[j] & 0xc0) >> 2) | ((b2[j] & 0xc0) >> 4) | ((b3[j] & 0xc0) >> 6);
+        dest[n++] = b1[j] & 0x3f;
+        dest[n++] = b2[j] & 0x3f;
+        if (j != 174)
+            dest[n++] = b3[j] & 0x3f;
+    }
+
+    dest[n++] = ((c1 & 0xc0) >> 6) | ((c2 & 0xc0) >> 4) | ((c3 & 0xc0) >> 2);
+    dest[n++] = c3 & 0x3f;
+    dest[n++] = c2 & 0x3f;
+    dest[n++] = c1 & 0x3f;
+}
+
+/*
+ Lay out one track: a gap of self sync nibbles, then each sector as an address
+ field (D5 AA 96, track, sector, side, format, checksum, DE AA) and a data field
+ (D5 AA AD, sector, encoded data, DE AA). tags/data hold the track's sectors in
+ logical order. Returns the number of bits written.
+*/
+static size_t encode_track(uint8_t *dest, const uint8_t *tags, const uint8_t *data, int cylinder, int side, int sides)
+{
+    int n = MediaTypeDSK::sectors_per_track(cylinder);
+
+    // 2:1 interleave, logical sector at each physical position
+    int order[GCR_MAX_SECTORS];
+    bool used[GCR_MAX_SECTORS] = {};
+    int p = 0;
+    for (int s = 0; s < n; s++)
+    {
+        while (used[p])
+            p = (p + 1) % n;
+        order[p] = s;
+        used[p] = true;
+        p = (p + 2) % n;
+    }
+
+    uint8_t track_lo = cylinder & 0x3f;
+    uint8_t side_hi = (side ? 0x20 : 0x00) | (cylinder >> 6);
+    uint8_t format = (sides == 2 ? 0x20 : 0x00) | 0x02; // sides, interleave
+    uint8_t nibbles[GCR_DATA_NIBBLES];
+
+    memset(dest, 0, (track_bits(cylinder) + 7) / 8);
+    size_t position = 0;
+    for (int i = gap_syncs(cylinder); i > 0; i--)
+        position = write_sync(dest, position);
+
+    for (int i = 0; i < n; i++)
+    {
+        uint8_t sector = order[i];
+
+        for (int j = 0; j < GCR_SECTOR_SYNCS; j++)
+            position = write_sync(dest, position);
+        position = write_byte(dest, position, 0xd5);
+        position = write_byte(dest, position, 0xaa);
+        position = write_byte(dest, position, 0x96);
+        position = write_nibble(dest, position, track_lo);
+        position = write_nibble(dest, position, sector);
+        position = write_nibble(dest, position, side_hi);
+        position = write_nibble(dest, position, format);
+        position = write_nibble(dest, position, track_lo ^ sector ^ side_hi ^ format);
+        position = write_byte(dest, position, 0xde);
+        position = write_byte(dest, position, 0xaa);
+        position = write_byte(dest, position, 0xff);
+
+        for (int j = 0; j < GCR_SECTOR_SYNCS; j++)
+            position = write_sync(dest, position);
+        position = write_byte(dest, position, 0xd5);
+        position = write_byte(dest, position, 0xaa);
+        position = write_byte(dest, position, 0xad);
+        position = write_nibble(dest, position, sector);
+        encode_sector(nibbles, &tags[sector * GCR_TAG_BYTES], &data[sector * 512]);
+        for (int j = 0; j < GCR_DATA_NIBBLES; j++)
+            position = write_nibble(dest, position, nibbles[j]);
+        position = write_byte(dest, position, 0xde);
+        position = write_byte(dest, position, 0xaa);
+        position = write_byte(dest, position, 0xff);
+    }
+
+    return position;
+}
+
+/*
+ A failed mount doesn't keep f, the caller still owns it and may mount it
+ with another media type
+*/
+mediatype_t MediaTypeDSK::mount(FILE *f, uint32_t disksize)
+{
+    _media_fileh = f;
+    floppy_emulation = true;
+
+    uint32_t datasize = disksize - offset;
+    if (offset != 0 && read_dc42_header(&datasize))
+    {
+        _media_fileh = nullptr;
+        return MEDIATYPE_UNKNOWN;
+    }
+
+    switch (datasize)
+    {
+    case GCR_400K_BLOCKS * 512:
+        num_sides = 1;
+        break;
+    case GCR_800K_BLOCKS * 512:
+        num_sides = 2;
+        break;
+    default:
+        Debug_printf("\nMediaTypeDSK: %lu bytes is not a 400K or 800K floppy", datasize);
+        _media_fileh = nullptr;
+        return MEDIATYPE_UNKNOWN;
+    }
+    optimal_bit_timing = GCR_BIT_TIMING;
+
+    // trks[].start_block is the first block of the track in the sector image
+    memset(tmap, 0xff, sizeof(tmap));
+    memset(trks, 0, sizeof(trks));
+    num_blocks = 0;
+    uint16_t block = 0;
+    for (int c = 0; c < MAX_CYLINDERS; c++)
+    {
+        for (int side = 0; side < num_sides; side++)
+        {
+            int t = c * 2 + side;
+            tmap[t] = t;
+            trks[t].start_block = block;
+            trks[t].bit_count = track_bits(c);
+            trks[t].block_count = (trks[t].bit_count + 4095) / 4096;
+            if (trks[t].block_count > num_blocks)
+                num_blocks = trks[t].block_count;
+            block += sectors_per_track(c);
+        }
+    }
+
+    sector_buf = (uint8_t *)heap_caps_malloc(GCR_MAX_SECTORS * GCR_SECTOR_BYTES, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+    if (sector_buf == nullptr || alloc_track_cache(num_blocks * 512))
+    {
+        Debug_printf("\nNo RAM allocated!");
+        _media_fileh = nullptr;
+        return MEDIATYPE_UNKNOWN;
+    }
+
+    Debug_printf("\nMediaTypeDSK: %s sided GCR floppy, %s", num_sides == 1 ? "single" : "double", tag_offset ? "with tags" : "no tags");
+    return offset != 0 ? MEDIATYPE_DC42 : MEDIATYPE_DSK;
+}
+
+void MediaTypeDSK::unmount()
+{
+    MediaTypeMOOF::unmount();
+    free(sector_buf);
+    sector_buf = nullptr;
+}
+
+bool MediaTypeDSK::read_dc42_header(uint32_t *datasize)
+{
+    // big endian data size and tag size at 0x40, data follows the header, then the tags
+    uint8_t hdr[8];
+    if (fseek(_media_fileh, 0x40, SEEK_SET) || fread(hdr, 1, sizeof(hdr), _media_fileh) != sizeof(hdr))
+        return true;
+
+    *datasize = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | hdr[3];
+    uint32_t tagsize = ((uint32_t)hdr[4] << 24) | ((uint32_t)hdr[5] << 16) | ((uint32_t)hdr[6] << 8) | hdr[7];
+    if (tagsize != 0 && tagsize == *datasize / 512 * GCR_TAG_BYTES)
+        tag_offset = offset + *datasize;
+    return false;
+}
+
+bool MediaTypeDSK::read_track(int trk, uint8_t *buffer)
+{
+    int cylinder = trk / 2;
+    int n = sectors_per_track(cylinder);
+    uint32_t block = trks[trk].start_block;
+
+    // tags for the whole track first, then the data
+    uint8_t *tags = sector_buf;
+    uint8_t *data = sector_buf + n * GCR_TAG_BYTES;
+
+    memset(tags, 0, n * GCR_TAG_BYTES);
+    if (tag_offset != 0)
+    {
+        if (fseek(_media_fileh, tag_offset + block * GCR_TAG_BYTES, SEEK_SET) ||
+            fread(tags, 1, n * GCR_TAG_BYTES, _media_fileh) != (size_t)n * GCR_TAG_BYTES)
+            return true;
+    }
+    if (fseek(_media_fileh, offset + block * 512, SEEK_SET) ||
+        fread(data, 1, n * 512, _media_fileh) != (size_t)n * 512)
+        return true;
+
+    size_t bits = encode_track(buffer, tags, data, cylinder, trk % 2, num_sides);
+    // Debug_printf("\nEncoded track %d, %d sectors, %d bits", trk, n, bits);
+    return bits != trks[trk].bit_count;
+}
+
+#endif // BUILD_MAC
@@ -0,0 +1,42 @@
+#ifndef _MEDIATYPE_DSK_
+#define _MEDIATYPE_DSK_
+
+#include <stdio.h>
+
+#include "mediaTypeMOOF.h"
+
+/*
+ 400K/800K sector images (raw .dsk or Disk Copy 4.2) presented to the floppy
+ drive. Each track is GCR encoded the first time the head gets to it and then
+ kept in the MOOF track cache, so only a few tracks are in RAM at a time.
+*/
+
+#define GCR_400K_BLOCKS 800
+#define GCR_800K_BLOCKS 1600
+
+class MediaTypeDSK : public MediaTypeMOOF
+{
+private:
+    uint32_t offset = 0;       // start of the sector data in the file
+    uint32_t tag_offset = 0;   // start of the 12 byte sector tags, 0 if there are none
+    uint8_t *sector_buf = nullptr;
+
+    bool read_dc42_header(uint32_t *datasize);
+
+protected:
+    virtual bool read_track(int trk, uint8_t *buffer) override;
+
+public:
+    MediaTypeDSK(int x = 0) : offset(x) {}
+
+    virtual bool read(uint32_t blockNum, uint8_t *buffer) override { return true; };
+    virtual bool write(uint32_t blockNum, uint8_t *buffer) override { return true; };
+
+    virtual mediatype_t mount(FILE *f, uint32_t disksize) override;
+    virtual void unmount() override;
+
+    // Sectors per track for cylinder c, 12 on the outer zone down to 8 on the inner one
+    static int sectors_per_track(int c) { return 12 - c / 16; }
+};
+
+#endif // _MEDIATYPE_DSK_
@@ -28,18 +28,13 @@ mediatype_t MediaTypeMOOF::mount(FILE *f, uint32_t disksize)
 void MediaTypeMOOF::unmount()
 {
     MediaType::unmount();
-#ifdef CACHE_IMAGE
-    for (int i = 0; i < MAX_TRACKS; i++)
+    for (auto &slot : trk_cache)
     {
-        if (trk_ptrs[i] != nullptr)
-            free(trk_ptrs[i]);
-            
-        trk_ptrs[i] = nullptr;
+        free(slot.data);
+        slot.data = nullptr;
+        slot.trk = -1;
     }
-#else
-    free(trk_buffer);
-    trk_buffer = nullptr;
-#endif
+    trk_buffer_size = 0;
 }
 
 bool MediaTypeMOOF::moof_check_header()
@@ -156,18 +151,59 @@ bool MediaTypeMOOF::moof_read_tmap()
 
 uint8_t *MediaTypeMOOF::get_track(int t)
 {
+    int trk = tmap[t];
+    if (trk == 255)
+        return nullptr;
 
-#ifdef CACHE_IMAGE
-    return trk_ptrs[tmap[t]];
-#else
-    size_t s = trks[t].block_count * 512;
-    Debug_printf("\nReading %d bytes of track %d", s, t);
-    fseek(_media_fileh, trks[t].start_block * 512, SEEK_SET);
-    fread(trk_buffer, 1, s, _media_fileh);
-    // Debug_printf("\n%d, %d, %lu", trks[t].start_block, trks[t].block_count, trks[t].bit_count);
-    return trk_buffer; 
-#endif
+    moof_track_slot_t *victim = &trk_cache[0];
+    for (auto &slot : trk_cache)
+    {
+        if (slot.trk == trk)
+        {
+            slot.used = ++trk_clock;
+            return slot.data;
+        }
+        if (slot.used < victim->used)
+            victim = &slot;
+    }
 
+    victim->trk = -1;
+    if (victim->data == nullptr || read_track(trk, victim->data))
+    {
+        Debug_printf("\nError reading track %d", t);
+        return nullptr;
+    }
+    victim->trk = trk;
+    victim->used = ++trk_clock;
+    return victim->data;
+}
+
+bool MediaTypeMOOF::read_track(int trk, uint8_t *buffer)
+{
+    size_t s = trks[trk].block_count * 512;
+    if (s > trk_buffer_size)
+        return true;
+    // Debug_printf("\nReading %d bytes of track %d", s, trk);
+    if (fseek(_media_fileh, trks[trk].start_block * 512, SEEK_SET))
+        return true;
+    return fread(buffer, 1, s, _media_fileh) != s;
+}
+
+bool MediaTypeMOOF::alloc_track_cache(size_t size)
+{
+    for (auto &slot : trk_cache)
+    {
+        slot.trk = -1;
+        slot.data = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+        if (slot.data == nullptr)
+        {
+            Debug_printf("\nNo RAM allocated!");
+            return true;
+        }
+    }
+    trk_buffer_size = size;
+    Debug_printf("\n%d x %d bytes allocated for MOOF track cache", MOOF_TRACK_CACHE, size);
+    return false;
 }
 
 bool MediaTypeMOOF::moof_read_tracks()
@@ -180,45 +216,12 @@ bool MediaTypeMOOF::moof_read_tracks()
         Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
 #endif
 
-#ifdef CACHE_IMAGE
-    // read MOOF tracks into RAM
+    // tracks are read from the file as they're needed
     for (int i = 0; i < MAX_TRACKS; i++)
-    {
-        trk_ptrs[i] = nullptr;
-        size_t s = trks[i].block_count * 512;
-        if (s != 0)
-        {
-            trk_ptrs[i] = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-            if (trk_ptrs[i] != nullptr)
-            {
-                Debug_printf("\nReading %d bytes of track %d into location %lu", s, i, trk_ptrs[i]);
-                fseek(_media_fileh, trks[i].start_block * 512, SEEK_SET);
-                fread(trk_ptrs[i], 1, s, _media_fileh);
-                Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
-            }
-            else
-            {
-                Debug_printf("\nNo RAM allocated!");
-                return true;
-            }
-        }
-    }
-#else
-    size_t s = num_blocks * 512;
-    if (s != 0)
-    {
-        trk_buffer = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-        if (trk_buffer != nullptr)
-        {
-            Debug_printf("\n%d bytes allocated for MOOF track buffer", s);
-        }
-        else
-        {
-            Debug_printf("\nNo RAM allocated!");
-            return true;
-        }
-    }
-#endif
+        if (trks[i].block_count > num_blocks)
+            num_blocks = trks[i].block_count;
+    if (num_blocks != 0 && alloc_track_cache(num_blocks * 512))
+        return true;
 
     return false;
 }
@@ -9,7 +9,8 @@
 #define MAX_SIDES 2
 #define MAX_TRACKS (MAX_SIDES * MAX_CYLINDERS)
 
-#define CACHE_IMAGE
+// Tracks held in RAM at a time, enough for both sides of two cylinders
+#define MOOF_TRACK_CACHE 4
 
 struct TRK_t
 {
@@ -18,6 +19,13 @@ struct TRK_t
     uint32_t bit_count;
 };
 
+struct moof_track_slot_t
+{
+    int trk = -1;       // TRKS index loaded into data, -1 if none
+    uint32_t used = 0;  // LRU stamp
+    uint8_t *data = nullptr;
+};
+
 enum class moof_disk_type_t
 {
     UNKNOWN,
@@ -36,14 +44,19 @@ private:
     bool moof_read_tmap();
     bool moof_read_tracks();
 
+    // Tracks are loaded when the head gets to them, least recently used one is replaced
+    moof_track_slot_t trk_cache[MOOF_TRACK_CACHE];
+    uint32_t trk_clock = 0;
+    size_t trk_buffer_size = 0;
+
 protected:
     uint8_t tmap[MAX_TRACKS];
     TRK_t trks[MAX_TRACKS];
-#ifdef CACHE_IMAGE
-    uint8_t *trk_ptrs[MAX_TRACKS] = {};
-#else
-    uint8_t *trk_buffer;
-#endif
+
+    // Allocate the track cache, size is the largest track in bytes. Returns TRUE on error
+    bool alloc_track_cache(size_t size);
+    // Fill buffer with the bitstream of TRKS entry trk. Returns TRUE on error
+    virtual bool read_track(int trk, uint8_t *buffer);
 
 public:
     MediaTypeMOOF() {};
@@ -43,6 +43,7 @@
 #include "mac/mediaType.h"
 #include "mac/mediaTypeMOOF.h"
 #include "mac/mediaTypeDCD.h"
+#include "mac/mediaTypeDSK.h"
 #endif
 
 #ifdef BUILD_S100
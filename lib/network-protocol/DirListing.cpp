@@ -0,0 +1,117 @@
+/**
+ * DirListing
+ *
+ * Implementation
+ */
+
+#include "DirListing.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "compat_string.h"
+#include "utils.h"
+
+void DirListing::begin(const std::string &pattern)
+{
+    clear();
+    _pattern = pattern;
+}
+
+void DirListing::add(const char *name, uint32_t size, bool is_dir, bool is_locked)
+{
+    // skip current and parent directory, some servers report them
+    if (name[0] == '\0' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return;
+
+    // not every server applies the pattern (or applies it the same way)
+    if (!is_dir && !_pattern.empty() && _pattern != "*" && !util_wildcard_match(name, _pattern.c_str()))
+        return;
+
+    entry e;
+    e.name = _names.size();
+    e.size = size;
+    e.is_dir = is_dir;
+    e.is_locked = is_locked;
+    _entries.push_back(e);
+
+    _names.append(name);
+    _names.push_back('\0');
+}
+
+void DirListing::end(DirFormat format, const std::string &lineEnding, const std::string &trailer)
+{
+    _format = format;
+    _lineEnding = lineEnding;
+    _trailer = trailer;
+    _next = 0;
+    _out.clear();
+    _ready = true;
+
+    // directories first, then by name
+    const char *names = _names.c_str();
+    std::sort(_entries.begin(), _entries.end(), [names](const entry &left, const entry &right) {
+        if (left.is_dir != right.is_dir)
+            return left.is_dir;
+        return strcasecmp(names + left.name, names + right.name) < 0;
+    });
+}
+
+bool DirListing::format_next()
+{
+    if (!_ready || _next > _entries.size())
+        return false;
+
+    if (_next == _entries.size())
+    {
+        _out += _trailer;
+        _next++;
+        return true;
+    }
+
+    const entry &e = _entries[_next++];
+    const char *name = _names.c_str() + e.name;
+
+    switch (_format)
+    {
+    case SHORT:
+        _out += util_entry(util_crunch(name), e.size, e.is_dir, e.is_locked);
+        break;
+    case LONG:
+        _out += util_long_entry(name, e.size, e.is_dir);
+        break;
+    case APPLE2_80COL:
+        _out += util_long_entry_apple2_80col(name, e.size, e.is_dir);
+        break;
+    }
+    _out += _lineEnding;
+
+    return true;
+}
+
+size_t DirListing::buffered(size_t want)
+{
+    while (_out.length() < want && format_next())
+        ;
+    return _out.length();
+}
+
+size_t DirListing::read(std::string &dest, size_t len)
+{
+    len = std::min(len, buffered(len));
+    dest.append(_out, 0, len);
+    _out.erase(0, len);
+    return len;
+}
+
+void DirListing::clear()
+{
+    _entries.clear();
+    _entries.shrink_to_fit();
+    _names.clear();
+    _names.shrink_to_fit();
+    _out.clear();
+    _pattern.clear();
+    _ready = false;
+    _next = 0;
+}
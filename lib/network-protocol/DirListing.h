@@ -0,0 +1,127 @@
+/**
+ * Directory listing shared by the filesystem protocol adapters
+ */
+
+#ifndef NETWORKPROTOCOL_DIRLISTING
+#define NETWORKPROTOCOL_DIRLISTING
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Collects the entries of one directory listing from any NetworkProtocolFS
+ *        backend, filters and sorts them once, then turns them into text lines
+ *        only as fast as the computer reads them.
+ */
+class DirListing
+{
+public:
+    /**
+     * Line formats
+     */
+    typedef enum _dirFormat
+    {
+        SHORT,        // 8.3 name, sectors
+        LONG,         // full name, size
+        APPLE2_80COL  // full name, size, for 80 column Apple II
+    } DirFormat;
+
+    /**
+     * @brief Drop the previous listing and start collecting a new one
+     * @param pattern entries have to match this wildcard, directories always do
+     */
+    void begin(const std::string &pattern);
+
+    /**
+     * @brief Add one entry as reported by the backend
+     */
+    void add(const char *name, uint32_t size, bool is_dir, bool is_locked);
+
+    /**
+     * @brief Sort the collected entries and get ready to deliver lines
+     * @param format line format
+     * @param lineEnding appended to each line
+     * @param trailer text sent after the last entry, e.g. free sectors line
+     */
+    void end(DirFormat format, const std::string &lineEnding, const std::string &trailer);
+
+    /**
+     * @brief Format lines until at least want bytes are waiting, or the listing is done
+     * @return number of bytes waiting
+     */
+    size_t buffered(size_t want);
+
+    /**
+     * @brief Move up to len bytes of listing text to the end of dest
+     * @return number of bytes moved
+     */
+    size_t read(std::string &dest, size_t len);
+
+    /**
+     * @brief Number of entries in the listing
+     */
+    size_t count() { return _entries.size(); };
+
+    /**
+     * @brief Drop everything
+     */
+    void clear();
+
+private:
+    /**
+     * One listing entry, the name lives in _names
+     */
+    struct entry
+    {
+        uint32_t name;
+        uint32_t size;
+        bool is_dir;
+        bool is_locked;
+    };
+
+    /**
+     * Entries, in delivery order after end()
+     */
+    std::vector<entry> _entries;
+
+    /**
+     * Entry names, each followed by '\0'
+     */
+    std::string _names;
+
+    /**
+     * Pattern from begin()
+     */
+    std::string _pattern;
+
+    /**
+     * Formatting of the delivered lines
+     */
+    DirFormat _format = LONG;
+    std::string _lineEnding;
+    std::string _trailer;
+
+    /**
+     * Set by end(), nothing is delivered before
+     */
+    bool _ready = false;
+
+    /**
+     * Next entry to format
+     */
+    size_t _next = 0;
+
+    /**
+     * Formatted text not read yet, only a few lines long
+     */
+    std::string _out;
+
+    /**
+     * Append the next line (or the trailer) to _out
+     * @return FALSE if nothing is left to format
+     */
+    bool format_next();
+};
+
+#endif /* NETWORKPROTOCOL_DIRLISTING */
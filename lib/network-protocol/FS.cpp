@@ -72,8 +72,7 @@ bool NetworkProtocolFS::open_file()
 bool NetworkProtocolFS::open_dir()
 {
     openMode = DIR;
-    dirBuffer.clear();
-    dirBuffer.shrink_to_fit();
+    dirListing.clear();
     update_dir_filename(opened_url);
 
     // assume everything if no filename.
@@ -95,30 +94,27 @@ bool NetworkProtocolFS::open_dir()
 
     std::vector<uint8_t> entryBuffer(ENTRY_BUFFER_SIZE);
 
+    // Collect the whole listing, lines are formatted as they are read
+    dirListing.begin(filename);
     while (read_dir_entry((char *)entryBuffer.data(), ENTRY_BUFFER_SIZE - 1) == false)
     {
-        if (aux2_open & 0x80)
-        {
-            // Long entry
-            if (aux2_open == 0x81) // Apple2 80 col format.
-                dirBuffer += util_long_entry_apple2_80col((char *)entryBuffer.data(), fileSize, is_directory) + lineEnding;
-            else
-                dirBuffer += util_long_entry((char *)entryBuffer.data(), fileSize, is_directory) + lineEnding;
-        }
-        else
-        {
-            // 8.3 entry
-            dirBuffer += util_entry(util_crunch((char *)entryBuffer.data()), fileSize, is_directory, is_locked) + lineEnding;
-        }
+        dirListing.add((char *)entryBuffer.data(), fileSize, is_directory, is_locked);
         fserror_to_error();
 
         // Clearing the buffer for reuse
         std::fill(entryBuffer.begin(), entryBuffer.end(), 0); // fenrock was right.
     }
+    Debug_printf("NetworkProtocolFS::open_dir - %u entries\r\n", (unsigned)dirListing.count());
+
+    DirListing::DirFormat format = DirListing::SHORT;
+    if (aux2_open & 0x80)
+        format = (aux2_open == 0x81) ? DirListing::APPLE2_80COL : DirListing::LONG; // 0x81 is Apple2 80 col format.
 
 #ifdef BUILD_ATARI
     // Finally, drop a FREE SECTORS trailer.
-    dirBuffer += "999+FREE SECTORS\x9b";
+    dirListing.end(format, lineEnding, "999+FREE SECTORS\x9b");
+#else
+    dirListing.end(format, lineEnding, "");
 #endif /* BUILD_ATARI */
 
     if (error == NETWORK_ERROR_END_OF_FILE)
@@ -173,6 +169,7 @@ bool NetworkProtocolFS::close_file()
 
 bool NetworkProtocolFS::close_dir()
 {
+    dirListing.clear();
     return close_dir_handle();
 }
 
@@ -198,6 +195,7 @@ bool NetworkProtocolFS::read(unsigned short len)
 bool NetworkProtocolFS::read_file(unsigned short len)
 {
     std::vector<uint8_t> buf = std::vector<uint8_t>(len);
+    size_t start = receiveBuffer->length();
 
     Debug_printf("NetworkProtocolFS::read_file(%u)\r\n", len);
 
@@ -217,24 +215,18 @@ bool NetworkProtocolFS::read_file(unsigned short len)
     else
         error = NETWORK_ERROR_SUCCESS;
 
-    // Pass back to base class for translation.
-    return NetworkProtocol::read(len);
+    // Translate what was appended
+    return read_appended(start);
 }
 
 bool NetworkProtocolFS::read_dir(unsigned short len)
 {
-    bool ret;
-
-    if (receiveBuffer->length() == 0)
-    {
-        *receiveBuffer = dirBuffer.substr(0, len);
-        dirBuffer.erase(0, len);
-        dirBuffer.shrink_to_fit();
-    }
+    size_t start = receiveBuffer->length();
 
-    ret = NetworkProtocol::read(len);
+    if (start == 0)
+        dirListing.read(*receiveBuffer, len);
 
-    return ret;
+    return read_appended(start);
 }
 
 bool NetworkProtocolFS::write(unsigned short len)
@@ -288,9 +280,16 @@ bool NetworkProtocolFS::status_file(NetworkStatus *status)
 
 bool NetworkProtocolFS::status_dir(NetworkStatus *status)
 {
-    status->rxBytesWaiting = dirBuffer.length();
-    status->connected = dirBuffer.length() > 0 ? 1 : 0;
-    status->error = dirBuffer.length() > 0 ? error : NETWORK_ERROR_END_OF_FILE;
+    // Only a window of the listing is formatted ahead, like reads of a file
+#ifdef BUILD_ATARI
+    size_t waiting = dirListing.buffered(512);
+#else
+    size_t waiting = dirListing.buffered(65534);
+#endif
+
+    status->rxBytesWaiting = waiting;
+    status->connected = waiting > 0 ? 1 : 0;
+    status->error = waiting > 0 ? error : NETWORK_ERROR_END_OF_FILE;
 
     NetworkProtocol::status(status);
 
@@ -6,6 +6,7 @@
 #define NETWORKPROTOCOL_FS
 
 #include "Protocol.h"
+#include "DirListing.h"
 
 class NetworkProtocolFS : public NetworkProtocol
 {
@@ -151,9 +152,9 @@ protected:
     int fileSize = 0;
 
     /**
-     * Directory buffer
+     * Directory listing
      */
-    std::string dirBuffer;
+    DirListing dirListing;
     
     /**
      * Is open file a directory?
@@ -151,8 +151,6 @@ bool NetworkProtocolHTTP::open_file_handle()
 
 bool NetworkProtocolHTTP::open_dir_handle()
 {
-    int len, actual_len;
-
     Debug_printf("NetworkProtocolHTTP::open_dir_handle()\r\n");
 
     if (client != nullptr)
@@ -184,68 +182,48 @@ bool NetworkProtocolHTTP::open_dir_handle()
         return true;
     }
 
-    std::vector<uint8_t> buf;
+    // The response body is parsed as read_dir_entry() asks for entries
+    dirResponseDone = false;
+    return false;
+}
+
+bool NetworkProtocolHTTP::parse_dir_chunk()
+{
+    if (dirResponseDone)
+        return true;
+
+    uint8_t buf[WEBDAV_CHUNK_SIZE];
 
-    // Process all response chunks
-    while ( !client->is_transaction_done() || client->available() > 0)
+    // Waits for the HTTP client to deliver data, a short read is the end of the response
+    int len = client->read(buf, sizeof(buf));
+    if (len < 0)
     {
-        len = client->available();
-        if (len > 0)
-        {
-            Debug_printf("data available %d ...\n", len);
-            // increase chunk buffer if necessary
-            if (len >= buf.size())
-                buf.resize(len+1); // +1 for '\0'
-
-            // Grab the buffer
-            actual_len = client->read(buf.data(), len);
-
-            if (actual_len != len)
-            {
-                Debug_printf("Expected %d bytes, actually got %d bytes.\r\n", len, actual_len);
-                error = NETWORK_ERROR_GENERAL;
-                break;
-            }
-            buf[len] = '\0'; // make buffer C string compatible for Debug_printf()
-
-            // Parse the buffer
-            if (webDAV.parse((char *)buf.data(), len, false))
-            {
-                Debug_printf("Could not parse buffer, returning 144\r\n");
-                error = NETWORK_ERROR_GENERAL;
-                break;
-            }
-        }
-        else if (len == 0)
-        {
-            Debug_println("waiting for data");
-#ifdef ESP_PLATFORM
-            vTaskDelay(100 / portTICK_PERIOD_MS); // TBD !!!
-#endif
-        }
-        else // if (len < 0)
-        {
-            Debug_println("something went wrong");
-            error = NETWORK_ERROR_GENERAL;
-            break;
-        }
+        Debug_println("something went wrong");
+        error = NETWORK_ERROR_GENERAL;
+        end_dir_response();
+        return true;
     }
 
-    if (error != NETWORK_ERROR_SUCCESS)
+    bool last = len < (int)sizeof(buf);
+    if (webDAV.parse((char *)buf, len, last))
     {
-        Debug_printf("NetworkProtocolHTTP::open_dir_handle() - error %u\r\n", error);
-        webDAV.end_parser(true); // release parser resources + clear collected entries
+        Debug_printf("Could not parse buffer, returning 144\r\n");
+        error = NETWORK_ERROR_GENERAL;
+        end_dir_response();
         return true;
     }
 
-    // finish parsing (not sure if this is necessary)
-    webDAV.parse(nullptr, 0, true);
+    if (last)
+        end_dir_response();
 
-    // Release parser resources (keep directory entries)
-    webDAV.end_parser();
+    return false;
+}
 
-    // Scoot to beginning of directory entries.
-    dirEntryCursor = webDAV.rewind();
+void NetworkProtocolHTTP::end_dir_response()
+{
+    // Release parser resources (keep decoded directory entries)
+    webDAV.end_parser();
+    dirResponseDone = true;
 
     if (client != nullptr)
     {
@@ -253,9 +231,6 @@ bool NetworkProtocolHTTP::open_dir_handle()
         client = new HTTP_CLIENT_CLASS();
         client->begin(opened_url->url);
     }
-
-    // Directory parsed, ready to be returned by read_dir_entry()
-    return false;
 }
 
 bool NetworkProtocolHTTP::mount(PeoplesUrlParser *url)
@@ -407,11 +382,7 @@ bool NetworkProtocolHTTP::status_file(NetworkStatus *status)
     {
     case DATA:
     {
-#ifdef ESP_PLATFORM
         if (!fromInterrupt && resultCode == 0)
-#else
-        if (!fromInterrupt && (resultCode == 0 || (!client->is_transaction_done() && client->available() == 0)))
-#endif
         {
             Debug_printf("calling http_transaction\r\n");
             http_transaction();
@@ -489,26 +460,28 @@ bool NetworkProtocolHTTP::read_file_handle_data(uint8_t *buf, unsigned short len
 
 bool NetworkProtocolHTTP::read_dir_entry(char *buf, unsigned short len)
 {
-    bool err = false;
-
     Debug_printf("NetworkProtocolHTTP::read_dir_entry(%p,%u)\r\n", buf, len);
 
-    if (dirEntryCursor != webDAV.entries.end())
-    {
-        strlcpy(buf, dirEntryCursor->filename.c_str(), len);
-        fileSize = atoi(dirEntryCursor->fileSize.c_str());
-        is_directory = dirEntryCursor->isDir;
-        ++dirEntryCursor;
-        Debug_printf("Returning: %s, %u, %s\r\n", buf, fileSize, is_directory ? "DIR" : "FILE");
-    }
-    else
+    WebDAV::DAVEntry entry;
+
+    // Decode more of the response until an entry turns up
+    while (webDAV.next(entry))
     {
-        // EOF
-        error = NETWORK_ERROR_END_OF_FILE;
-        err = true;
+        if (parse_dir_chunk())
+        {
+            // EOF
+            if (error == NETWORK_ERROR_SUCCESS)
+                error = NETWORK_ERROR_END_OF_FILE;
+            return true;
+        }
     }
 
-    return err;
+    strlcpy(buf, entry.filename.c_str(), len);
+    fileSize = atoi(entry.fileSize.c_str());
+    is_directory = entry.isDir;
+    Debug_printf("Returning: %s, %u, %s\r\n", buf, fileSize, is_directory ? "DIR" : "FILE");
+
+    return false;
 }
 
 bool NetworkProtocolHTTP::close_file_handle()
@@ -529,6 +502,9 @@ bool NetworkProtocolHTTP::close_file_handle()
 bool NetworkProtocolHTTP::close_dir_handle()
 {
     Debug_printf("NetworkProtocolHTTP::close_dir_handle()\r\n");
+    // stopped before the end of the response
+    if (!dirResponseDone)
+        end_dir_response();
     webDAV.clear(); // release directory entries
     return false;
 }
@@ -245,9 +245,20 @@ private:
     WebDAV webDAV;
 
     /**
-     * Current Directory entry cursor
+     * Is the PROPFIND response fully parsed (or abandoned)?
      */
-    std::vector<WebDAV::DAVEntry>::iterator dirEntryCursor;
+    bool dirResponseDone = true;
+
+    /**
+     * @brief Feed the next piece of the PROPFIND response to the WebDAV parser
+     * @return TRUE if nothing is left to parse or on error.
+     */
+    bool parse_dir_chunk();
+
+    /**
+     * @brief Release the parser and get a fresh client once the PROPFIND response is done
+     */
+    void end_dir_response();
 
     /**
      * Do HTTP transaction
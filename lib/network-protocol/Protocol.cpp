@@ -13,6 +13,7 @@
 #include "status_error_codes.h"
 #include "utils.h"
 #include "string_utils.h"
+#include "byte_translator.h"
 
 #include <vector>
 
@@ -158,6 +159,18 @@ bool NetworkProtocol::read(unsigned short len)
     return false;
 }
 
+/**
+ * @brief Finish a read() which appended new data to receiveBuffer.
+ * @param start length of receiveBuffer before the new data was appended.
+ * @return error flag. FALSE if successful, TRUE if error.
+ */
+bool NetworkProtocol::read_appended(size_t start)
+{
+    translate_receive_buffer(start);
+    error = 1;
+    return false;
+}
+
 /**
  * @brief Write len bytes from tx_buf to protocol.
  * @param len The # of bytes to transmit, len should not be larger than buffer.
@@ -185,78 +198,120 @@ bool NetworkProtocol::status(NetworkStatus *status)
 }
 
 /**
- * Perform end of line translation on receive buffer. based on translation_mode.
- * @param rx_buf The receive buffer to transform
- * @param len The length of the receive buffer
- * @return length after transformation.
-  */
-void NetworkProtocol::translate_receive_buffer()
+ * Build the receive translation table for a translation mode, same steps as
+ * translating the buffer with one std::replace() per character.
+ */
+static ByteTranslator make_receive_translator(unsigned char mode)
 {
-    // Debug_printf("#### Translating receive buffer, mode: %u\r\n", translation_mode);
-    if (translation_mode == 0)
-        return;
-
-    #ifdef BUILD_ATARI
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BELL, ATASCII_BUZZER);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BACKSPACE, ATASCII_DEL);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_TAB, ATASCII_TAB);
-    #endif   
+    ByteTranslator t;
+    if (mode == TRANSLATION_MODE_NONE)
+        return t;
+
+#ifdef BUILD_ATARI
+    t.replace(ASCII_BELL, ATASCII_BUZZER);
+    t.replace(ASCII_BACKSPACE, ATASCII_DEL);
+    t.replace(ASCII_TAB, ATASCII_TAB);
+#endif
 
-    switch (translation_mode)
+    switch (mode)
     {
     case TRANSLATION_MODE_CR:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
+        t.replace(ASCII_CR, EOL);
         break;
     case TRANSLATION_MODE_LF:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_LF, EOL);
+        t.replace(ASCII_LF, EOL);
         break;
     case TRANSLATION_MODE_CRLF:
-    #ifndef BUILD_APPLE
+#ifndef BUILD_APPLE
         // With Apple2, we would be translating CR to CR; a waste of CPU
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
-    #endif
+        t.replace(ASCII_CR, EOL);
+#endif
+        t.replace(ASCII_LF, nullptr, 0);
         break;
     case TRANSLATION_MODE_PETSCII:
-        Debug_printf("!!! PETSCII !!!\r\n");
-        *receiveBuffer = mstr::toUTF8(*receiveBuffer);
+        t.compose(mstr::petsciiToUTF8Table());
         break;
     }
-
-    if (translation_mode == TRANSLATION_MODE_CRLF)
-        receiveBuffer->erase(std::remove(receiveBuffer->begin(), receiveBuffer->end(), '\n'), receiveBuffer->end());
+    return t;
 }
 
 /**
- * Perform end of line translation on transmit buffer. based on translation_mode
- * @return new length after translation
+ * Build the transmit translation table for a translation mode.
  */
-unsigned short NetworkProtocol::translate_transmit_buffer()
+static ByteTranslator make_transmit_translator(unsigned char mode)
 {
-    // Debug_printf("#### Translating transmit buffer, mode: %u\r\n", translation_mode);
-    if (translation_mode == 0)
-        return transmitBuffer->length();
-
-    #ifdef BUILD_ATARI
-    util_replaceAll(*transmitBuffer, STR_ATASCII_BUZZER, STR_ASCII_BELL);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_DEL, STR_ASCII_BACKSPACE);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_TAB, STR_ASCII_TAB);
-    #endif
+    ByteTranslator t;
+    if (mode == TRANSLATION_MODE_NONE)
+        return t;
+
+#ifdef BUILD_ATARI
+    t.replace(ATASCII_BUZZER, ASCII_BELL);
+    t.replace(ATASCII_DEL, ASCII_BACKSPACE);
+    t.replace(ATASCII_TAB, ASCII_TAB);
+#endif
 
-    switch (translation_mode)
+    switch (mode)
     {
     case TRANSLATION_MODE_CR:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CR);
+        t.replace(EOL, ASCII_CR);
         break;
     case TRANSLATION_MODE_LF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_LF);
+        t.replace(EOL, ASCII_LF);
         break;
     case TRANSLATION_MODE_CRLF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CRLF);
+        t.replace(EOL, STR_ASCII_CRLF, 2);
         break;
     case TRANSLATION_MODE_PETSCII:
-        *transmitBuffer = mstr::toUTF8(*transmitBuffer);
+        t.compose(mstr::petsciiToUTF8Table());
         break;
     }
+    return t;
+}
+
+// Translation tables, built on first use. Higher modes only get the platform character mapping.
+#define TRANSLATION_TABLE_COUNT 6
+
+static const ByteTranslator &receive_translator(unsigned char mode)
+{
+    static const ByteTranslator tables[TRANSLATION_TABLE_COUNT] = {
+        make_receive_translator(0), make_receive_translator(1), make_receive_translator(2),
+        make_receive_translator(3), make_receive_translator(4), make_receive_translator(5)};
+    return tables[std::min<unsigned>(mode, TRANSLATION_TABLE_COUNT - 1)];
+}
+
+static const ByteTranslator &transmit_translator(unsigned char mode)
+{
+    static const ByteTranslator tables[TRANSLATION_TABLE_COUNT] = {
+        make_transmit_translator(0), make_transmit_translator(1), make_transmit_translator(2),
+        make_transmit_translator(3), make_transmit_translator(4), make_transmit_translator(5)};
+    return tables[std::min<unsigned>(mode, TRANSLATION_TABLE_COUNT - 1)];
+}
+
+/**
+ * Perform end of line translation on receive buffer. based on translation_mode.
+ * @param start offset of the first byte not translated yet, bytes before it were
+ *        translated by an earlier call and are left alone.
+ */
+void NetworkProtocol::translate_receive_buffer(size_t start)
+{
+    // Debug_printf("#### Translating receive buffer, mode: %u\r\n", translation_mode);
+    if (translation_mode == 0)
+        return;
+
+    receive_translator(translation_mode).apply(*receiveBuffer, start);
+}
+
+/**
+ * Perform end of line translation on transmit buffer. based on translation_mode
+ * @return new length after translation
+ */
+unsigned short NetworkProtocol::translate_transmit_buffer()
+{
+    // Debug_printf("#### Translating transmit buffer, mode: %u\r\n", translation_mode);
+    if (translation_mode == 0)
+        return transmitBuffer->length();
+
+    transmit_translator(translation_mode).apply(*transmitBuffer);
 
     return transmitBuffer->length();
 }
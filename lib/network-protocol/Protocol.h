@@ -205,8 +205,16 @@ protected:
 
     /**
      * Perform end of line translation on receive buffer.
+     * @param start offset of the first byte to translate, earlier bytes are already translated.
      */
-    void translate_receive_buffer();
+    void translate_receive_buffer(size_t start = 0);
+
+    /**
+     * Translate data a read() appended to receiveBuffer at offset start and return success.
+     * Subclasses call this instead of NetworkProtocol::read(), so data still waiting
+     * in receiveBuffer from an earlier read isn't translated twice.
+     */
+    bool read_appended(size_t start);
 
     /**
      * Perform end of line translation on transmit buffer.
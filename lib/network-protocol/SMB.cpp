@@ -18,6 +18,7 @@
 
 #include "status_error_codes.h"
 #include "utils.h"
+#include "fnSmbPool.h"
 
 #include <vector>
 
@@ -29,13 +30,12 @@ NetworkProtocolSMB::NetworkProtocolSMB(std::string *rx_buf, std::string *tx_buf,
     mkdir_implemented = true;
     rmdir_implemented = true;
     Debug_printf("NetworkProtocolSMB::ctor\r\n");
-    smb = smb2_init_context();
 }
 
 NetworkProtocolSMB::~NetworkProtocolSMB()
 {
     Debug_printf("NetworkProtocolSMB::dtor\r\n");
-    smb2_destroy_context(smb);
+    umount();
 }
 
 bool NetworkProtocolSMB::open_file_handle()
@@ -111,36 +111,30 @@ bool NetworkProtocolSMB::mount(PeoplesUrlParser *url)
         openURL = openURL.substr(0, openURL.find_last_of("/"));
 
     Debug_printf("NetworkProtocolSMB::mount() - openURL: %s\r\n", openURL.c_str());
-    smb_url = smb2_parse_url(smb, openURL.c_str());
-    if (smb_url == nullptr) 
-    {
-        Debug_printf("aNetworkProtocolSMB::mount(%s) - failed to parse URL, SMB2 error: %s\n", openURL.c_str(), smb2_get_error(smb));
-        fserror_to_error();
-        return true;
-    }
 
-    smb2_set_security_mode(smb, SMB2_NEGOTIATE_SIGNING_ENABLED);
+    // a previous mount of this channel
+    umount();
 
+    // Connected session for the share, reused if one is idle
     if (login != nullptr)
+        smb = smbPool.acquire(openURL.c_str(), login->c_str(), password->c_str());
+    else // no u/p
+        smb = smbPool.acquire(openURL.c_str());
+
+    if (smb == nullptr)
     {
-        smb2_set_user(smb, login->c_str());
-        smb2_set_password(smb, password->c_str());
-
-        if ((smb_error = smb2_connect_share(smb, smb_url->server, smb_url->share, login->c_str())) != 0)
-        {
-            Debug_printf("aNetworkProtocolSMB::mount(%s) - could not mount, SMB2 error: %s\r\n", openURL.c_str(), smb2_get_error(smb));
-            fserror_to_error();
-            return true;
-        }
+        Debug_printf("aNetworkProtocolSMB::mount(%s) - could not mount\r\n", openURL.c_str());
+        fserror_to_error();
+        return true;
     }
-    else // no u/p
+
+    smb_url = smb2_parse_url(smb, openURL.c_str());
+    if (smb_url == nullptr) 
     {
-        if ((smb_error = smb2_connect_share(smb, smb_url->server, smb_url->share, smb_url->user)) != 0)
-        {
-            Debug_printf("aNetworkProtocolSMB::mount(%s) - could not mount, SMB2 error: %s\r\n", openURL.c_str(), smb2_get_error(smb));
-            fserror_to_error();
-            return true;
-        }
+        Debug_printf("aNetworkProtocolSMB::mount(%s) - failed to parse URL, SMB2 error: %s\n", openURL.c_str(), smb2_get_error(smb));
+        fserror_to_error();
+        umount();
+        return true;
     }
 
     return false;
@@ -151,12 +145,14 @@ bool NetworkProtocolSMB::umount()
     if (smb == nullptr)
         return true;
 
-    smb2_disconnect_share(smb);
-
-    if (smb_url == nullptr)
-        return true;
+    if (smb_url != nullptr)
+    {
+        smb2_destroy_url(smb_url);
+        smb_url = nullptr;
+    }
 
-    smb2_destroy_url(smb_url);
+    smbPool.release(smb);
+    smb = nullptr;
     return false;
 }
 
@@ -264,7 +260,8 @@ bool NetworkProtocolSMB::del(PeoplesUrlParser *url, cmdFrame_t *cmdFrame)
 
 bool NetworkProtocolSMB::mkdir(PeoplesUrlParser *url, cmdFrame_t *cmdFrame)
 {
-    mount(url);
+    if (mount(url))
+        return true;
 
     if (smb2_mkdir(smb, smb_url->path) != 0)
     {
@@ -279,7 +276,8 @@ bool NetworkProtocolSMB::mkdir(PeoplesUrlParser *url, cmdFrame_t *cmdFrame)
 
 bool NetworkProtocolSMB::rmdir(PeoplesUrlParser *url, cmdFrame_t *cmdFrame)
 {
-    mount(url);
+    if (mount(url))
+        return true;
 
     if (smb2_rmdir(smb, smb_url->path) != 0)
     {
@@ -116,6 +116,7 @@ bool NetworkProtocolTCP::read(unsigned short len)
 {
     unsigned short actual_len = 0;
     std::vector<uint8_t> newData = std::vector<uint8_t>(len);
+    size_t start = receiveBuffer->length();
 
     Debug_printf("NetworkProtocolTCP::read(%u)\r\n", len);
 
@@ -147,8 +148,7 @@ bool NetworkProtocolTCP::read(unsigned short len)
         // Add new data to buffer.
         receiveBuffer->insert(receiveBuffer->end(), newData.begin(), newData.end());
     }    
-    error = 1;
-    return NetworkProtocol::read(len);
+    return read_appended(start);
 }
 
 /**
@@ -105,6 +105,7 @@ NetworkProtocolTELNET::~NetworkProtocolTELNET()
 bool NetworkProtocolTELNET::read(unsigned short len)
 {
     std::vector<uint8_t> newData = std::vector<uint8_t>(len);
+    size_t start = receiveBuffer->length();
 
     Debug_printf("NetworkProtocolTELNET::read(%u)\r\n", len);
 
@@ -130,12 +131,10 @@ bool NetworkProtocolTELNET::read(unsigned short len)
         }
     }
 
-    // Return success
-    error = 1;
-
     Debug_printf("NetworkProtocolTELNET::read(%d) - %s\r\n", newRxLen, receiveBuffer->c_str());
 
-    return NetworkProtocol::read(newRxLen); // Set by calls into telnet_recv()
+    // Data was appended by calls into telnet_recv()
+    return read_appended(start);
 }
 
 /**
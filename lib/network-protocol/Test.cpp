@@ -61,7 +61,9 @@ bool NetworkProtocolTest::close()
 
 bool NetworkProtocolTest::read(unsigned short len)
 {
-    if (receiveBuffer->length() == 0)
+    size_t start = receiveBuffer->length();
+
+    if (start == 0)
         *receiveBuffer += test_data.substr(0, len);
 
     error = 1;
@@ -71,7 +73,7 @@ bool NetworkProtocolTest::read(unsigned short len)
         Debug_printf("%02x ", (unsigned char)receiveBuffer->at(i));
     Debug_printf("\r\n");
 
-    return NetworkProtocol::read(len);
+    return read_appended(start);
 }
 
 bool NetworkProtocolTest::write(unsigned short len)
@@ -15,8 +15,6 @@
 #include "status_error_codes.h"
 #include "fnDNS.h"
 
-#include <vector>
-
 
 
 NetworkProtocolUDP::NetworkProtocolUDP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
@@ -55,6 +53,10 @@ bool NetworkProtocolUDP::open(PeoplesUrlParser *urlParser, cmdFrame_t *cmdFrame)
         port = atoi(urlParser->port.c_str());
     }
 
+    packet_mode = (cmdFrame->aux2 & 0x80) != 0;
+    rx_remote_ip = IPADDR_NONE;
+    rx_remote_port = 0;
+
     // Attempt to bind port.
 #ifdef ESP_PLATFORM
     unsigned short bind_port = port;
@@ -94,32 +96,45 @@ bool NetworkProtocolUDP::close()
     return false; // all good.
 }
 
-bool NetworkProtocolUDP::read(unsigned short len)
+bool NetworkProtocolUDP::next_datagram()
 {
-    std::vector<uint8_t> newData = std::vector<uint8_t>(len);
+    fnUDPDatagram datagram;
 
-    Debug_printf("NetworkProtocolUDP::read(%u)\r\n", len);
+    udp.receive();
+    if (!udp.nextDatagram(datagram))
+        return false;
 
-    if (receiveBuffer->length() == 0)
+    rx_remote_ip = datagram.ip;
+    rx_remote_port = datagram.port;
+
+    // Reply to whoever sent the data, unless the program tracks senders itself
+    if (!packet_mode)
     {
-        if (udp.available() == 0)
-        {
-            errno_to_error();
-            return true;
-        }
+        dest = std::string(compat_inet_ntoa(datagram.ip));
+        port = datagram.port;
+    }
 
-        // Do the read.
-        udp.read(newData.data(), len);
+    // Datagrams are handed over one at a time, so boundaries survive
+    receiveBuffer->append(datagram.data);
+    translate_receive_buffer();
 
-        // Add new data to buffer.
-        receiveBuffer->insert(receiveBuffer->end(),newData.begin(),newData.end());
+    return true;
+}
+
+bool NetworkProtocolUDP::read(unsigned short len)
+{
+    Debug_printf("NetworkProtocolUDP::read(%u)\r\n", len);
+
+    if (receiveBuffer->length() == 0 && !next_datagram())
+    {
+        errno_to_error();
+        return true;
     }
 
     // Return success
-    Debug_printf("errno = %u\r\n", errno);
     error = 1;
-    
-    return NetworkProtocol::read(len);
+
+    return false;
 }
 
 bool NetworkProtocolUDP::write(unsigned short len)
@@ -160,27 +175,10 @@ bool NetworkProtocolUDP::write(unsigned short len)
 
 bool NetworkProtocolUDP::status(NetworkStatus *status)
 {
+    if (receiveBuffer->length() == 0)
+        next_datagram();
 
-    if (receiveBuffer->length() > 0)
-        status->rxBytesWaiting = receiveBuffer->length();
-    else
-    {
-        in_addr_t addr = udp.remoteIP();
-
-        status->rxBytesWaiting = udp.parsePacket();
-        
-        // Only change dest if we need to.
-#ifdef ESP_PLATFORM
-        if (udp.remoteIP() != IPADDR_NONE)
-#else
-        if (status->rxBytesWaiting > 0 && addr != IPADDR_NONE)
-#endif
-        {
-            dest = std::string(compat_inet_ntoa(addr));
-            port = udp.remotePort();
-        }
-    }
-
+    status->rxBytesWaiting = receiveBuffer->length();
     status->connected = 1; // Always 'connected'
     status->error = error;
 
@@ -197,10 +195,10 @@ uint8_t NetworkProtocolUDP::special_inquiry(uint8_t cmd)
     {
     case 'D':           // set destination
         return 0x80;
-#ifndef ESP_PLATFORM
     case 'r':           // get remote
         return 0x40;
-#endif
+    case 'l':           // get loss counters
+        return 0x40;
     }
 
     return 0xFF;
@@ -213,17 +211,15 @@ bool NetworkProtocolUDP::special_00(cmdFrame_t *cmdFrame)
 
 bool NetworkProtocolUDP::special_40(uint8_t *sp_buf, unsigned short len, cmdFrame_t *cmdFrame)
 {
-#ifdef ESP_PLATFORM
-    return true; // none implemented.
-#else
     switch (cmdFrame->comnd)
     {
     case 'r':
         return get_remote(sp_buf, len);
+    case 'l':
+        return get_loss_counters(sp_buf, len);
     default:
         return true;
     }
-#endif
 }
 
 bool NetworkProtocolUDP::special_80(uint8_t *sp_buf, unsigned short len, cmdFrame_t *cmdFrame)
@@ -271,19 +267,49 @@ bool NetworkProtocolUDP::set_destination(uint8_t *sp_buf, unsigned short len)
     return false; // no error.
 }
 
-#ifndef ESP_PLATFORM
 bool NetworkProtocolUDP::get_remote(uint8_t *sp_buf, unsigned short len)
 {
     char port_part[8];
+    in_addr_t ip = rx_remote_ip;
+    uint16_t remote_port = rx_remote_port;
+
+    // Nothing received yet, report the last peer the socket talked to
+    if (ip == IPADDR_NONE)
+    {
+        ip = udp.remoteIP();
+        remote_port = udp.remotePort();
+    }
 
-    snprintf(port_part, sizeof port_part, ":%d\x9b", udp.remotePort());
-    strlcpy((char *)sp_buf, compat_inet_ntoa(udp.remoteIP()), len);
+    snprintf(port_part, sizeof port_part, ":%d\x9b", remote_port);
+    strlcpy((char *)sp_buf, compat_inet_ntoa(ip), len);
     strlcat((char *)sp_buf, port_part, len);
     Debug_printf("UDP remote is %s\n", sp_buf);
 
     return false; // no error.
 }
-#endif
+
+bool NetworkProtocolUDP::get_loss_counters(uint8_t *sp_buf, unsigned short len)
+{
+    const fnUDPStats &stats = udp.stats();
+    uint32_t counters[3] = {stats.received, stats.dropped, stats.truncated};
+
+    if (len < sizeof(counters))
+        return true;
+
+    memset(sp_buf, 0, len);
+    for (int i = 0; i < 3; i++)
+    {
+        sp_buf[i * 4 + 0] = counters[i] & 0xFF;
+        sp_buf[i * 4 + 1] = (counters[i] >> 8) & 0xFF;
+        sp_buf[i * 4 + 2] = (counters[i] >> 16) & 0xFF;
+        sp_buf[i * 4 + 3] = (counters[i] >> 24) & 0xFF;
+    }
+
+    Debug_printf("UDP received %lu dropped %lu truncated %lu\n",
+                 (unsigned long)stats.received, (unsigned long)stats.dropped, (unsigned long)stats.truncated);
+
+    return false; // no error.
+}
 
 bool NetworkProtocolUDP::is_multicast()
 {
@@ -105,6 +105,24 @@ protected:
      */
     bool multicast_write = false;
 
+    /**
+     * Packet mode (aux2 bit 7): replies are not redirected to each sender,
+     * get_remote() reports the sender of the datagram being read.
+     */
+    bool packet_mode = false;
+
+    /**
+     * Sender of the datagram currently in receiveBuffer
+     */
+    in_addr_t rx_remote_ip = IPADDR_NONE;
+    uint16_t rx_remote_port = 0;
+
+    /**
+     * @brief Move the next queued datagram into receiveBuffer
+     * @return true if a datagram was available
+     */
+    bool next_datagram();
+
     /**
      * @brief Set destination address
      * @param sp_buf pointer to received special buffer.
@@ -112,14 +130,19 @@ protected:
      */
     bool set_destination(uint8_t *sp_buf, unsigned short len);
 
-#ifndef ESP_PLATFORM
     /**
      * @brief Get remote address
      * @param sp_buf pointer to transmit special buffer.
      * @param len of special transmit buffer
      */
     bool get_remote(uint8_t *sp_buf, unsigned short len);
-#endif
+
+    /**
+     * @brief Get receive counters: received, dropped, truncated (uint32 LE each)
+     * @param sp_buf pointer to transmit special buffer.
+     * @param len of special transmit buffer
+     */
+    bool get_loss_counters(uint8_t *sp_buf, unsigned short len);
 
 private:
     /**
@@ -48,7 +48,6 @@ unsigned char trans(unsigned char mem39212, unsigned char mem39213);
 
 // contains the final soundbuffer
 extern int bufferpos;
-extern char *buffer;
 
 //timetable for more accurate c64 simulation
 int timetable[5][5] =
@@ -70,7 +69,7 @@ void Output8BitAry(int index, unsigned char ary[5])
     for (k = 0; k < 5; k++)
     {
         // printf("%d %d\r\n", bufferpos,k);
-        buffer[bufferpos / 50 + k] = ary[k];
+        WriteSample(bufferpos / 50 + k, ary[k]);
     }
 }
 void Output8Bit(int index, unsigned char A)
@@ -977,14 +976,14 @@ void Render()
                 X = 26;
                 // mem[54296] = X;
                 bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
+                WriteSample(bufferpos / 50, (X & 15) * 16);
             }
             else
             {
                 //mem[54296] = 6;
                 X = 6;
                 bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
+                WriteSample(bufferpos / 50, (X & 15) * 16);
             }
 
             for (X = wait2; X > 0; X--)
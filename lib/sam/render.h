@@ -4,4 +4,7 @@
 void Render();
 void SetMouthThroat(unsigned char mouth, unsigned char throat);
 
+// Set output sample pos (bufferpos / 50 based), see sam.c
+void WriteSample(int pos, unsigned char value);
+
 #endif
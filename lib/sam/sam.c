@@ -1,8 +1,6 @@
 
 #include "sam.h"
 
-#include <esp_heap_caps.h>
-
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -43,9 +41,24 @@ unsigned char phonemeIndexOutput[60];  //tab47296
 unsigned char stressOutput[60];        //tab47365
 unsigned char phonemeLengthOutput[60]; //tab47416
 
-// contains the final soundbuffer
+// output position in samples * 50
 int bufferpos = 0;
-char *buffer = NULL;
+
+/*
+ Render() writes each sample a few positions ahead of bufferpos / 50 and may
+ overwrite those again, but never goes back before bufferpos / 50. Everything
+ before that is final and goes to the sink right away, so only a small window
+ of samples is kept instead of a buffer for the whole utterance.
+*/
+#define SAM_WINDOW 16
+#define SAM_CHUNK 256
+
+static short window[SAM_WINDOW]; // -1 if not written, the DAC keeps the previous level
+static unsigned char chunk[SAM_CHUNK];
+static int chunk_length = 0;
+static int flushed = 0; // samples passed on so far
+static unsigned char level = 0;
+static SamSink sink = NULL;
 
 void SetInput(char *_input)
 {
@@ -63,9 +76,34 @@ void SetPitch(unsigned char _pitch) { pitch = _pitch; }
 void SetMouth(unsigned char _mouth) { mouth = _mouth; }
 void SetThroat(unsigned char _throat) { throat = _throat; }
 void EnableSingmode() { singmode = 1; }
-char *GetBuffer() { return buffer; }
+void SetSink(SamSink _sink) { sink = _sink; }
 int GetBufferLength() { return bufferpos; }
-void FreeBuffer() { free(buffer); }
+
+static void FlushOutput(int pos)
+{
+    while (flushed < pos)
+    {
+        short *s = &window[flushed % SAM_WINDOW];
+        if (*s >= 0)
+            level = (unsigned char)*s;
+        *s = -1;
+        chunk[chunk_length++] = level;
+        flushed++;
+
+        if (chunk_length == SAM_CHUNK)
+        {
+            if (sink != NULL)
+                sink(chunk, chunk_length);
+            chunk_length = 0;
+        }
+    }
+}
+
+void WriteSample(int pos, unsigned char value)
+{
+    FlushOutput(bufferpos / 50);
+    window[pos % SAM_WINDOW] = value;
+}
 
 void Init();
 int Parser1();
@@ -97,17 +135,11 @@ void Init()
     SetMouthThroat(mouth, throat);
 
     bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    /*
-    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
-    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
-    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
-    */
-
-    // printf("buffer pointer %d\r\n", buffer);
+    flushed = 0;
+    chunk_length = 0;
+    level = 0;
+    for (i = 0; i < SAM_WINDOW; i++)
+        window[i] = -1;
 
     /*
     freq2data = &mem[45136];
@@ -184,6 +216,12 @@ int SAMMain()
 
     PrepareOutput();
 
+    // Pass on the tail
+    FlushOutput(bufferpos / 50);
+    if (chunk_length > 0 && sink != NULL)
+        sink(chunk, chunk_length);
+    chunk_length = 0;
+
     return 1;
 }
 
@@ -16,9 +16,12 @@ extern "C"
 
     int SAMMain();
 
-    char *GetBuffer();
+    // Receives the finished 8 bit unsigned 22050 Hz samples while SAMMain() renders,
+    // a few hundred at a time, so the utterance never has to be held in memory
+    typedef void (*SamSink)(const unsigned char *samples, int count);
+    void SetSink(SamSink _sink);
+
     int GetBufferLength();
-    void FreeBuffer();
     
     //char input[]={"/HAALAOAO MAYN NAAMAEAE IHSTT SAEBAASTTIHAAN \x9b\x9b\0"};
     //unsigned char input[]={"/HAALAOAO \x9b\0"};
@@ -1,30 +1,42 @@
 
 #include "samlib.h"
 
+#ifdef ESP_PLATFORM
+#include <atomic>
+
 #include <freertos/FreeRTOS.h>
-#include <freertos/timers.h>
-#include <driver/gpio.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <esp_idf_version.h>
 #ifndef CONFIG_IDF_TARGET_ESP32S3
 #include <driver/dac.h>
+#define SAM_DAC
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <driver/gptimer.h>
+#include <hal/dac_ll.h>
+#define SAM_DAC_TIMER
+#endif
 #endif
-
 
 #include "fnSystem.h"
+#endif
+
+#include "../../include/debug.h"
 
 #ifdef __cplusplus
 extern char input[256];
-extern char *buffer;
 #endif
 
 int debug = 0;
 
 #ifndef ESP_PLATFORM
 
-void WriteWav(char *filename, char *buffer, int bufferlength)
+// WAV file written as SAM renders, the sizes in the header are filled in by wav_close()
+static FILE *wav_file = NULL;
+static unsigned int wav_length = 0;
+
+static void wav_header(FILE *file, unsigned int bufferlength)
 {
-    FILE *file = fopen(filename, "wb");
-    if (file == NULL)
-        return;
     //RIFF header
     fwrite("RIFF", 4, 1, file);
     unsigned int filesize = bufferlength + 12 + 16 + 8 - 8;
@@ -50,12 +62,160 @@ void WriteWav(char *filename, char *buffer, int bufferlength)
     //data chunk
     fwrite("data", 4, 1, file);
     fwrite(&bufferlength, 4, 1, file);
-    fwrite(buffer, bufferlength, 1, file);
+}
 
-    fclose(file);
+static bool wav_open(const char *filename)
+{
+    wav_file = fopen(filename, "wb");
+    if (wav_file == NULL)
+        return false;
+    wav_length = 0;
+    wav_header(wav_file, 0);
+    return true;
 }
+
+static void wav_write(const unsigned char *samples, int count)
+{
+    wav_length += fwrite(samples, 1, count, wav_file);
+}
+
+static void wav_close()
+{
+    fseek(wav_file, 0, SEEK_SET);
+    wav_header(wav_file, wav_length);
+    fclose(wav_file);
+    wav_file = NULL;
+}
+
 #endif // NOT ESP_PLATFORM
 
+#ifdef SAM_DAC
+
+/*
+ Rendered samples wait in a small ring until they're played. With IDF 5 a
+ hardware timer interrupt feeds the DAC at the sample rate, so the SAM task
+ only renders ahead until the ring is full. Older IDF versions have no
+ gptimer, there the SAM task writes the DAC itself.
+*/
+#define SAM_SAMPLE_RATE 22050
+#define SAM_RING_SIZE 2048 // about 90 ms
+
+#ifdef SAM_DAC_TIMER
+
+// The 80 MHz APB clock has no integer divider giving 22050 Hz. At 1 MHz the
+// nearest alarm is 45 ticks, 22222 Hz. APB / 2 allows 1814 ticks, 22050.7 Hz.
+#define SAM_TIMER_RESOLUTION 40000000
+
+static uint8_t ring[SAM_RING_SIZE];
+static std::atomic<uint32_t> ring_head(0); // written by the SAM task
+static std::atomic<uint32_t> ring_tail(0); // read by the timer interrupt
+
+static gptimer_handle_t sam_timer = NULL;
+static bool sam_playing = false;
+
+static bool IRAM_ATTR sam_timer_isr(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *arg)
+{
+    uint32_t tail = ring_tail.load(std::memory_order_relaxed);
+    if (tail != ring_head.load(std::memory_order_acquire))
+    {
+        dac_ll_update_output_value(DAC_CHANNEL_1, ring[tail % SAM_RING_SIZE]);
+        ring_tail.store(tail + 1, std::memory_order_release);
+    }
+    return false;
+}
+
+static void sam_output_start()
+{
+    if (sam_playing)
+        return;
+
+    if (sam_timer == NULL)
+    {
+        gptimer_config_t config = {};
+        config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+        config.direction = GPTIMER_COUNT_UP;
+        config.resolution_hz = SAM_TIMER_RESOLUTION;
+        ESP_ERROR_CHECK(gptimer_new_timer(&config, &sam_timer));
+
+        gptimer_event_callbacks_t callbacks = {};
+        callbacks.on_alarm = sam_timer_isr;
+        ESP_ERROR_CHECK(gptimer_register_event_callbacks(sam_timer, &callbacks, NULL));
+
+        gptimer_alarm_config_t alarm = {};
+        alarm.alarm_count = (SAM_TIMER_RESOLUTION + SAM_SAMPLE_RATE / 2) / SAM_SAMPLE_RATE;
+        alarm.flags.auto_reload_on_alarm = true;
+        ESP_ERROR_CHECK(gptimer_set_alarm_action(sam_timer, &alarm));
+        ESP_ERROR_CHECK(gptimer_enable(sam_timer));
+    }
+
+    dac_output_enable(DAC_CHANNEL_1);
+    gptimer_start(sam_timer);
+    sam_playing = true;
+}
+
+static void sam_output(const unsigned char *samples, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t head = ring_head.load(std::memory_order_relaxed);
+        while (head - ring_tail.load(std::memory_order_acquire) >= SAM_RING_SIZE)
+        {
+            // Ring is full, wait for the timer to play some of it
+            sam_output_start();
+            vTaskDelay(1);
+        }
+        ring[head % SAM_RING_SIZE] = samples[i];
+        ring_head.store(head + 1, std::memory_order_release);
+    }
+
+    // Start as soon as the first chunk is there
+    sam_output_start();
+}
+
+static void sam_output_stop()
+{
+    if (!sam_playing)
+        return;
+
+    // Play out what's left
+    while (ring_tail.load(std::memory_order_acquire) != ring_head.load(std::memory_order_relaxed))
+        vTaskDelay(pdMS_TO_TICKS(10));
+
+    gptimer_stop(sam_timer);
+    dac_output_disable(DAC_CHANNEL_1);
+    sam_playing = false;
+}
+
+#else
+
+static bool sam_playing = false;
+
+static void sam_output(const unsigned char *samples, int count)
+{
+    if (!sam_playing)
+    {
+        dac_output_enable(DAC_CHANNEL_1);
+        sam_playing = true;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        dac_output_voltage(DAC_CHANNEL_1, samples[i]);
+        fnSystem.delay_microseconds(40);
+    }
+}
+
+static void sam_output_stop()
+{
+    if (sam_playing)
+        dac_output_disable(DAC_CHANNEL_1);
+    sam_playing = false;
+}
+
+#endif // SAM_DAC_TIMER
+
+#endif // SAM_DAC
+
 void PrintUsage()
 {
     /*
@@ -104,89 +264,7 @@ void PrintUsage()
     */
 }
 
-#ifdef USESDL
-
-int pos = 0;
-void MixAudio(void *unused, Uint8 *stream, int len)
-{
-    int bufferpos = GetBufferLength();
-    char *buffer = GetBuffer();
-    int i;
-    if (pos >= bufferpos)
-        return;
-    if ((bufferpos - pos) < len)
-        len = (bufferpos - pos);
-    for (i = 0; i < len; i++)
-    {
-        stream[i] = buffer[pos];
-        pos++;
-    }
-}
-
-void OutputSound()
-{
-    int bufferpos = GetBufferLength();
-    bufferpos /= 50;
-    SDL_AudioSpec fmt;
-
-    fmt.freq = 22050;
-    fmt.format = AUDIO_U8;
-    fmt.channels = 1;
-    fmt.samples = 2048;
-    fmt.callback = MixAudio;
-    fmt.userdata = NULL;
-
-    /* Open the audio device and start playing sound! */
-    if (SDL_OpenAudio(&fmt, NULL) < 0)
-    {
-        printf("Unable to open audio: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_PauseAudio(0);
-    //SDL_Delay((bufferpos)/7);
-
-    while (pos < bufferpos)
-    {
-        SDL_Delay(100);
-    }
-
-    SDL_CloseAudio();
-}
-
-#else
-
-void OutputSound()
-{
-#ifdef ESP_PLATFORM
-#ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
-
-    //fnSystem.dac_output_enable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    //fnSystem.dac_output_voltage(SystemManager::dac_channel_t::DAC_CHANNEL_1, 100);
-
-    dac_output_enable(DAC_CHANNEL_1);
-
-    for (int i = 0; i < n; i++)
-    {
-        //dacWrite(DAC1, s[i]);
-        // fnSystem.dac_write(PIN_DAC1, s[i]);
-        dac_output_voltage(DAC_CHANNEL_1, s[i]);
-        //delayMicroseconds(40);
-        fnSystem.delay_microseconds(40);
-    }
-
-    //fnSystem.dac_output_disable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    dac_output_disable(DAC_CHANNEL_1);
-
-    FreeBuffer();
-#endif
-#endif
-}
-
-#endif
-
-int sam(int argc, char **argv)
+static int sam_say(int argc, char **argv)
 {
     int i;
     int phonetic = 0;
@@ -293,34 +371,119 @@ int sam(int argc, char **argv)
 
         // printf("done phonetic processing\r\n");
 
-#ifdef USESDL
-    if (SDL_Init(SDL_INIT_AUDIO) < 0)
-    {
-        printf("Unable to init SDL: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    atexit(SDL_Quit);
-#endif
-
 #ifndef __cplusplus
     SetInput(input);
 #endif
 
+    // Samples go out as they're rendered
+#ifndef ESP_PLATFORM
+    if (wavfilename != NULL && !wav_open(wavfilename))
+        return 1;
+    SetSink(wavfilename != NULL ? wav_write : NULL);
+#elif defined(SAM_DAC)
+    SetSink(sam_output);
+#else
+    SetSink(NULL);
+#endif
+
     // printf("right before SAMMain");
 
-    if (!SAMMain())
+    int r = SAMMain();
+    // printf("right after SAMMain");
+
+#ifndef ESP_PLATFORM
+    if (wavfilename != NULL)
+        wav_close();
+#elif defined(SAM_DAC)
+    sam_output_stop();
+#endif
+
+    if (!r)
     {
         PrintUsage();
         return 1;
     }
-    // printf("right after SAMMain");
 
-#ifndef ESP_PLATFORM
-    if (wavfilename != NULL)
-        WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
-    else
-#endif // ESP_PLATFORM
-        OutputSound();
+    return 0;
+}
+
+
+#ifdef ESP_PLATFORM
+
+/*
+ sam() only queues the request, the SAM task renders and plays it. The
+ arguments are copied into the request since the caller's buffers are reused
+ as soon as it returns.
+*/
+#define SAM_QUEUE_LENGTH 4
+#define SAM_MAX_ARGS 16
+#define SAM_ARGS_SIZE 320
+
+struct SamRequest
+{
+    int argc;
+    uint16_t argv[SAM_MAX_ARGS]; // offsets into args
+    char args[SAM_ARGS_SIZE];
+};
+
+static QueueHandle_t sam_queue = NULL;
+
+static void sam_task(void *param)
+{
+    SamRequest request;
+    char *argv[SAM_MAX_ARGS];
+
+    while (true)
+    {
+        if (xQueueReceive(sam_queue, &request, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        for (int i = 0; i < request.argc; i++)
+            argv[i] = request.args + request.argv[i];
+        sam_say(request.argc, argv);
+    }
+}
+
+int sam(int argc, char **argv)
+{
+    if (sam_queue == NULL)
+    {
+        sam_queue = xQueueCreate(SAM_QUEUE_LENGTH, sizeof(SamRequest));
+        xTaskCreate(sam_task, "sam_task", 4096, NULL, 5, NULL);
+    }
+
+    SamRequest request;
+    size_t used = 0;
+    request.argc = 0;
+    for (int i = 0; i < argc; i++)
+    {
+        size_t len = strlen(argv[i]) + 1;
+        if (i == SAM_MAX_ARGS || used + len > sizeof(request.args))
+        {
+            // Saying part of it, or losing an option, would be worse
+            Debug_printf("SAM arguments exceed %d args or %d bytes, dropping utterance\r\n",
+                         SAM_MAX_ARGS, SAM_ARGS_SIZE);
+            return 1;
+        }
+        memcpy(request.args + used, argv[i], len);
+        request.argv[request.argc++] = used;
+        used += len;
+    }
+
+    if (xQueueSend(sam_queue, &request, 0) != pdTRUE)
+    {
+        Debug_println("SAM busy, dropping utterance");
+        return 1;
+    }
 
     return 0;
 }
+
+#else
+
+int sam(int argc, char **argv)
+{
+    return sam_say(argc, argv);
+}
+
+#endif // ESP_PLATFORM
@@ -7,11 +7,6 @@
 #include "sam.h"
 #include "samdebug.h"
 
-#ifdef USESDL
-#include <SDL.h>
-#include <SDL_audio.h>
-#endif
-
 #ifdef ESP_PLATFORM
 #include "../../include/pinmap.h"
 #endif
@@ -20,17 +15,10 @@
 extern char input[256];
 #endif
 
-#ifndef ESP_PLATFORM
-void WriteWav(char *filename, char *buffer, int bufferlength);
-#endif // ESP_PLATFORM
-
 void PrintUsage();
 
-#ifdef USESDL
-void MixAudio(void *unused, Uint8 *stream, int len);
-void OutputSound();
-#else
-void OutputSound();
-#endif
-
+/* Say something, argv as for the sam command line tool. On the ESP32 this only
+   queues the utterance and returns, the SAM task renders it and feeds the DAC
+   while the bus carries on. On PC it renders to the -wav file, if given.
+*/
 int sam(int argc, char **argv);
@@ -0,0 +1,362 @@
+#include "fnSmbPool.h"
+
+#include <fcntl.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#define poll(a, b, c) WSAPoll((a), (b), (c))
+#else
+// esp-idf has <sys/poll.h> but not <poll.h>
+#include <sys/poll.h>
+#endif
+
+#include <smb2/smb2.h>
+#include <smb2/libsmb2-raw.h>
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+fnSmbPool smbPool;
+
+// "smb://[user@]server/share[/path][?args]" without the path, plus the credentials
+std::string fnSmbPool::make_key(const char *url, const char *user, const char *password)
+{
+    std::string u(url);
+    size_t args = u.find('?');
+    std::string key = u.substr(0, args);
+
+    // keep the part up to the share name
+    size_t server = key.find("://");
+    server = (server == std::string::npos) ? 0 : server + 3;
+    size_t share = key.find('/', server);
+    if (share != std::string::npos)
+        key = key.substr(0, key.find('/', share + 1));
+
+    if (args != std::string::npos)
+        key += u.substr(args);
+
+    key += '\n';
+    if (user != nullptr)
+        key += user;
+    key += '\n';
+    if (password != nullptr)
+        key += password;
+
+    return key;
+}
+
+void fnSmbPool::destroy(struct smb2_context *smb)
+{
+    if (smb2_get_fd(smb) >= 0)
+        smb2_disconnect_share(smb);
+    smb2_destroy_context(smb);
+}
+
+// An idle session has nothing to say, anything readable means the server hung up
+bool fnSmbPool::is_alive(struct smb2_context *smb)
+{
+    struct pollfd pfd;
+    pfd.fd = smb2_get_fd(smb);
+    if (pfd.fd < 0)
+        return false;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
+// Collects idle sessions to drop, the caller destroys them outside the lock
+void fnSmbPool::prune(uint64_t now, std::vector<struct smb2_context *> &drop)
+{
+    int idle = 0;
+    // newest sessions are at the end
+    for (int i = (int)_sessions.size() - 1; i >= 0; i--)
+    {
+        smb_session &s = _sessions[i];
+        if (s.leased)
+            continue;
+        if (++idle > SMB_POOL_IDLE_MAX || now - s.idle_since > SMB_POOL_IDLE_MS)
+        {
+            drop.push_back(s.smb);
+            _sessions.erase(_sessions.begin() + i);
+        }
+    }
+}
+
+struct smb2_context *fnSmbPool::acquire(const char *url, const char *user, const char *password)
+{
+    if (url == nullptr || url[0] == '\0')
+        return nullptr;
+
+    std::string key = make_key(url, user, password);
+    std::vector<struct smb2_context *> drop;
+    struct smb2_context *smb = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        prune(fnSystem.millis(), drop);
+        for (int i = (int)_sessions.size() - 1; i >= 0; i--)
+        {
+            smb_session &s = _sessions[i];
+            if (s.leased || s.key != key)
+                continue;
+            if (!is_alive(s.smb))
+            {
+                drop.push_back(s.smb);
+                _sessions.erase(_sessions.begin() + i);
+                continue;
+            }
+            s.leased = true;
+            smb = s.smb;
+            break;
+        }
+    }
+
+    for (struct smb2_context *d : drop)
+        destroy(d);
+
+    if (smb != nullptr)
+    {
+        Debug_printf("fnSmbPool::acquire - reusing session %p\n", smb);
+        return smb;
+    }
+
+    // Nothing idle, open a new session
+    smb = smb2_init_context();
+    if (smb == nullptr)
+    {
+        Debug_printf("fnSmbPool::acquire - failed to init SMB2 context\n");
+        return nullptr;
+    }
+
+    struct smb2_url *smb_url = smb2_parse_url(smb, url);
+    if (smb_url == nullptr)
+    {
+        Debug_printf("fnSmbPool::acquire - failed to parse URL, SMB2 error: %s\n", smb2_get_error(smb));
+        smb2_destroy_context(smb);
+        return nullptr;
+    }
+
+    smb2_set_security_mode(smb, SMB2_NEGOTIATE_SIGNING_ENABLED);
+    smb2_set_timeout(smb, SMB_TIMEOUT_MS / 1000);
+
+    if (user != nullptr)
+        smb2_set_user(smb, user);
+    if (password != nullptr)
+        smb2_set_password(smb, password);
+
+    int smb_error = smb2_connect_share(smb, smb_url->server, smb_url->share, user != nullptr ? user : smb_url->user);
+    if (smb_error != 0)
+    {
+        Debug_printf("fnSmbPool::acquire - failed to connect share \"//%s/%s\", SMB2 error: %s\n",
+                     smb_url->server, smb_url->share, smb2_get_error(smb));
+        smb2_destroy_url(smb_url);
+        smb2_destroy_context(smb);
+        return nullptr;
+    }
+    Debug_printf("fnSmbPool::acquire - new session %p for //%s/%s\n", smb, smb_url->server, smb_url->share);
+    smb2_destroy_url(smb_url);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sessions.push_back({key, smb, true, false, 0});
+    return smb;
+}
+
+void fnSmbPool::release(struct smb2_context *smb, bool broken)
+{
+    if (smb == nullptr)
+        return;
+
+    std::vector<struct smb2_context *> drop;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint64_t now = fnSystem.millis();
+        for (size_t i = 0; i < _sessions.size(); i++)
+        {
+            if (_sessions[i].smb != smb)
+                continue;
+            smb_session s = _sessions[i];
+            _sessions.erase(_sessions.begin() + i);
+            if (broken || s.broken || smb2_get_fd(smb) < 0)
+            {
+                drop.push_back(smb);
+            }
+            else
+            {
+                // most recently used at the end
+                s.leased = false;
+                s.idle_since = now;
+                _sessions.push_back(s);
+            }
+            break;
+        }
+        prune(now, drop);
+    }
+
+    for (struct smb2_context *d : drop)
+        destroy(d);
+}
+
+/*
+ State of one compound fetch. It lives on the heap until all three replies
+ came back (or got cancelled with the session), even if fetch() gave up on
+ them earlier.
+*/
+struct smb_fetch_data
+{
+    int pending = 3;
+    bool abandoned = false;
+    uint32_t status = SMB2_STATUS_SUCCESS;
+    uint64_t file_size = 0;
+    uint32_t length = 0;
+    std::vector<uint8_t> buf;
+};
+
+static void fetch_done(smb_fetch_data *fd)
+{
+    if (--fd->pending == 0 && fd->abandoned)
+        delete fd;
+}
+
+static void fetch_create_cb(struct smb2_context *smb2, int status, void *command_data, void *private_data)
+{
+    smb_fetch_data *fd = (smb_fetch_data *)private_data;
+    if (status != SMB2_STATUS_SUCCESS)
+        fd->status = (uint32_t)status;
+    else
+        fd->file_size = ((struct smb2_create_reply *)command_data)->end_of_file;
+    fetch_done(fd);
+}
+
+static void fetch_read_cb(struct smb2_context *smb2, int status, void *command_data, void *private_data)
+{
+    smb_fetch_data *fd = (smb_fetch_data *)private_data;
+    // reading an empty file ends with END_OF_FILE
+    if (status == SMB2_STATUS_SUCCESS)
+        fd->length = ((struct smb2_read_reply *)command_data)->data_length;
+    else if ((uint32_t)status != SMB2_STATUS_END_OF_FILE && fd->status == SMB2_STATUS_SUCCESS)
+        fd->status = (uint32_t)status;
+    fetch_done(fd);
+}
+
+static void fetch_close_cb(struct smb2_context *smb2, int status, void *command_data, void *private_data)
+{
+    fetch_done((smb_fetch_data *)private_data);
+}
+
+// Services the session until the fetch is complete. Returns TRUE on error
+static bool fetch_wait(struct smb2_context *smb, smb_fetch_data *fd)
+{
+    while (fd->pending > 0)
+    {
+        struct pollfd pfd;
+        pfd.fd = smb2_get_fd(smb);
+        pfd.events = smb2_which_events(smb);
+        pfd.revents = 0;
+        if (pfd.fd < 0 || poll(&pfd, 1, SMB_TIMEOUT_MS) <= 0)
+            return true;
+        if (smb2_service(smb, pfd.revents) < 0)
+            return true;
+    }
+    return false;
+}
+
+void fnSmbPool::set_broken(struct smb2_context *smb)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (smb_session &s : _sessions)
+        if (s.smb == smb)
+            s.broken = true;
+}
+
+bool fnSmbPool::fetch(struct smb2_context *smb, const char *path, std::vector<uint8_t> &data,
+                      uint32_t max_size, uint64_t *file_size)
+{
+    if (smb == nullptr || path == nullptr)
+        return true;
+
+    if (max_size > SMB_FETCH_MAX)
+        max_size = SMB_FETCH_MAX;
+    if (max_size > smb2_get_max_read_size(smb))
+        max_size = smb2_get_max_read_size(smb);
+
+    smb_fetch_data *fd = new smb_fetch_data;
+    fd->buf.resize(max_size);
+
+    // CREATE
+    struct smb2_create_request cr_req;
+    memset(&cr_req, 0, sizeof(cr_req));
+    cr_req.requested_oplock_level = SMB2_OPLOCK_LEVEL_NONE;
+    cr_req.impersonation_level = SMB2_IMPERSONATION_IMPERSONATION;
+    cr_req.desired_access = SMB2_FILE_READ_DATA | SMB2_FILE_READ_ATTRIBUTES;
+    cr_req.share_access = SMB2_FILE_SHARE_READ | SMB2_FILE_SHARE_WRITE;
+    cr_req.create_disposition = SMB2_FILE_OPEN;
+    cr_req.create_options = SMB2_FILE_NON_DIRECTORY_FILE;
+    cr_req.name = path;
+
+    struct smb2_pdu *pdu = smb2_cmd_create_async(smb, &cr_req, fetch_create_cb, fd);
+    if (pdu == nullptr)
+    {
+        delete fd;
+        return true;
+    }
+
+    // READ, of the file just opened
+    struct smb2_read_request rd_req;
+    memset(&rd_req, 0, sizeof(rd_req));
+    rd_req.length = fd->buf.size();
+    rd_req.offset = 0;
+    rd_req.buf = fd->buf.data();
+    memcpy(rd_req.file_id, compound_file_id, SMB2_FD_SIZE);
+    rd_req.channel = SMB2_CHANNEL_NONE;
+
+    struct smb2_pdu *next_pdu = smb2_cmd_read_async(smb, &rd_req, fetch_read_cb, fd);
+    if (next_pdu == nullptr)
+    {
+        smb2_free_pdu(smb, pdu);
+        delete fd;
+        return true;
+    }
+    smb2_add_compound_pdu(smb, pdu, next_pdu);
+
+    // CLOSE
+    struct smb2_close_request cl_req;
+    memset(&cl_req, 0, sizeof(cl_req));
+    memcpy(cl_req.file_id, compound_file_id, SMB2_FD_SIZE);
+
+    next_pdu = smb2_cmd_close_async(smb, &cl_req, fetch_close_cb, fd);
+    if (next_pdu == nullptr)
+    {
+        smb2_free_pdu(smb, pdu);
+        delete fd;
+        return true;
+    }
+    smb2_add_compound_pdu(smb, pdu, next_pdu);
+
+    smb2_queue_pdu(smb, pdu);
+
+    if (fetch_wait(smb, fd))
+    {
+        Debug_printf("fnSmbPool::fetch(\"%s\") - no reply\n", path);
+        // replies may still come in, or get cancelled when the session goes
+        fd->abandoned = true;
+        set_broken(smb);
+        return true;
+    }
+
+    bool err = fd->status != SMB2_STATUS_SUCCESS || fd->file_size > fd->length;
+    if (fd->status != SMB2_STATUS_SUCCESS)
+        Debug_printf("fnSmbPool::fetch(\"%s\") - failed with 0x%08x\n", path, (unsigned)fd->status);
+    else if (file_size != nullptr)
+        *file_size = fd->file_size;
+
+    if (!err)
+    {
+        fd->buf.resize(fd->length);
+        data.swap(fd->buf);
+    }
+    delete fd;
+
+    return err;
+}
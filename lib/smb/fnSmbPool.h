@@ -0,0 +1,66 @@
+#ifndef _FN_SMBPOOL_H
+#define _FN_SMBPOOL_H
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <smb2/libsmb2.h>
+
+/*
+ Pool of connected SMB sessions.
+
+ Every user of a share (host slot directory listings, each open image, each N:
+ channel) leases its own connection, so one of them waiting on the server
+ doesn't hold up the others. Released sessions stay connected for a while and
+ are handed out again to the next user of the same share and credentials,
+ which saves the negotiate, session setup and tree connect round trips.
+*/
+
+// max idle sessions kept
+#define SMB_POOL_IDLE_MAX 4
+// idle sessions older than this are disconnected
+#define SMB_POOL_IDLE_MS 60000
+// biggest file read with a single CREATE+READ+CLOSE compound, one credit worth
+#define SMB_FETCH_MAX 65536
+// give up waiting for the server after this
+#define SMB_TIMEOUT_MS 10000
+
+class fnSmbPool
+{
+private:
+    struct smb_session
+    {
+        std::string key;
+        struct smb2_context *smb;
+        bool leased;
+        bool broken;
+        uint64_t idle_since;
+    };
+
+    std::vector<smb_session> _sessions;
+    std::mutex _mutex;
+
+    static std::string make_key(const char *url, const char *user, const char *password);
+    static void destroy(struct smb2_context *smb);
+    static bool is_alive(struct smb2_context *smb);
+    void prune(uint64_t now, std::vector<struct smb2_context *> &drop);
+    void set_broken(struct smb2_context *smb);
+
+public:
+    // Returns a connected session for the share in url ("smb://[user@]server/share[/path][?args]"),
+    // nullptr on error
+    struct smb2_context *acquire(const char *url, const char *user = nullptr, const char *password = nullptr);
+    // Hands the session back, broken sessions (or disconnected ones) are not reused
+    void release(struct smb2_context *smb, bool broken = false);
+
+    // Reads a whole file of up to max_size bytes in one round trip.
+    // Returns TRUE on error, or if the file is bigger (file_size is set then)
+    bool fetch(struct smb2_context *smb, const char *path, std::vector<uint8_t> &data,
+                      uint32_t max_size, uint64_t *file_size);
+};
+
+extern fnSmbPool smbPool;
+
+#endif // _FN_SMBPOOL_H
@@ -10,6 +10,13 @@ fnTask::fnTask()
     _state = TASK_READY;
     _reason = TASK_COMPLETED;
     _callback = nullptr;
+    _priority = PRIORITY_NORMAL;
+    _budget_us = 500;
+    _blocking = false;
+    _work_busy = false;
+    _work_done = false;
+    _work_result = 0;
+    _abort_pending = false;
 }
 
 
@@ -2,6 +2,7 @@
 #define _FN_TASK_H
 
 #include <stdint.h>
+#include <atomic>
 
 class fnTaskManager;
 
@@ -22,6 +23,15 @@ public:
         TASK_ABORTED
     };
 
+    // higher priority tasks are stepped first in each service() pass
+    enum task_priority
+    {
+        PRIORITY_LOW = 0,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+        PRIORITY_COUNT
+    };
+
     fnTask();
     virtual ~fnTask() = 0;
 
@@ -31,6 +41,11 @@ public:
     virtual int get_progress() {return 0;};         // optional
     virtual void * get_result() {return nullptr;};  // optional
 
+    // scheduling, set before the task is submitted
+    void set_priority(task_priority p) {_priority = p;};
+    void set_budget_us(uint32_t us) {_budget_us = us;};   // max time spent stepping per service() pass
+    void set_blocking(bool b) {_blocking = b;};           // work() may block, run it on a worker thread
+
 protected:
     // task state management
     // READY -> RUNNING
@@ -43,6 +58,9 @@ protected:
     virtual int abort() {return 0;};                // optional
     // do some work
     virtual int step() = 0;                         // mandatory, must be implemented in sub-class
+    // blocking part of the work (file/network I/O) for blocking tasks,
+    // called before each step(), on a worker thread if workers are running
+    virtual int work() {return 0;};                 // optional
 
     friend fnTaskManager;
 
@@ -50,6 +68,16 @@ protected:
     task_state _state;
     done_reason _reason;
     void (*_callback)(fnTask *t, task_state new_state);
+
+    task_priority _priority;
+    uint32_t _budget_us;
+    bool _blocking;
+
+    // worker thread hand-off, owned by fnTaskManager
+    std::atomic<bool> _work_busy;                   // work() queued or running
+    bool _work_done;                                // work() finished, step() may run
+    int _work_result;
+    bool _abort_pending;                            // abort requested while work() was busy
 };
 
 class fnTestTask : public fnTask
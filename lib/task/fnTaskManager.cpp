@@ -1,8 +1,7 @@
 #ifndef ESP_PLATFORM
 
-#include <list>
-
 #include "fnTaskManager.h"
+#include "fnSystem.h"
 #include "debug.h"
 
 // global task manager object
@@ -12,8 +11,13 @@ fnTaskManager taskMgr;
 fnTaskManager::fnTaskManager()
 {
     // Debug_println("fnTaskManager::fnTaskManager");
+    for (int i = 0; i < TASK_TABLE_SIZE; i++)
+        _table[i] = nullptr;
+    _cursor = 0;
     _next_tid = 1;
     _task_count = 0;
+    _stats_since = 0;
+    _workers_stop = false;
 }
 
 fnTaskManager::~fnTaskManager()
@@ -24,42 +28,111 @@ fnTaskManager::~fnTaskManager()
 
 void fnTaskManager::shutdown()
 {
+    // let running work() calls finish first
+    stop_workers();
+
     // abort tasks, if any
-    for (auto it = _task_map.begin(); it != _task_map.end(); ++it)
+    for (int i = 0; i < TASK_TABLE_SIZE; i++)
     {
-        Debug_printf("Aborting task %d\n", it->first);
-        it->second->abort();
-        delete it->second;
+        fnTask *task = _table[i];
+        if (task == nullptr)
+            continue;
+        Debug_printf("Aborting task %d\n", task->_id);
+        task->abort();
+        delete task;
+        _table[i] = nullptr;
     }
-    _task_map.clear();
     _task_count = 0;
 }
 
+void fnTaskManager::start_workers(int count)
+{
+    if (!_workers.empty())
+        return;
+
+    Debug_printf("fnTaskManager starting %d worker thread(s)\n", count);
+    _workers_stop = false;
+    for (int i = 0; i < count; i++)
+        _workers.emplace_back(&fnTaskManager::worker_loop, this);
+}
+
+void fnTaskManager::stop_workers()
+{
+    if (_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        _workers_stop = true;
+    }
+    _work_cv.notify_all();
+
+    for (auto &t : _workers)
+        t.join();
+    _workers.clear();
+
+    // anything left in the queue never ran, it will run inline from now on
+    for (fnTask *task : _work_queue)
+        task->_work_busy = false;
+    _work_queue.clear();
+}
+
+void fnTaskManager::worker_loop()
+{
+    for (;;)
+    {
+        fnTask *task;
+        {
+            std::unique_lock<std::mutex> lock(_work_mutex);
+            _work_cv.wait(lock, [this] { return _workers_stop || !_work_queue.empty(); });
+            if (_workers_stop)
+                return;
+            task = _work_queue.front();
+            _work_queue.pop_front();
+        }
+
+        task->_work_result = task->work();
+        task->_work_done = true;
+        // publish the result, main loop checks _work_busy before reading it
+        task->_work_busy = false;
+    }
+}
+
 int fnTaskManager::submit_task(fnTask * t)
 {
     Debug_println("submit_task");
 
-    for (auto it = _task_map.begin(); it != _task_map.end(); ++it)
+    int free_slot = -1;
+    for (int i = 0; i < TASK_TABLE_SIZE; i++)
     {
-        if (it->second == t)
+        if (_table[i] == t)
         {
-            Debug_printf(" alredy submitted (task %d)!\n", it->first);
+            Debug_printf(" alredy submitted (task %d)!\n", t->_id);
             return 0;
         }
+        if (_table[i] == nullptr && free_slot < 0)
+            free_slot = i;
+    }
+
+    if (free_slot < 0)
+    {
+        Debug_println(" task table is full");
+        return 0;
     }
 
     uint8_t tid = get_free_tid();
-    if (tid == 0) 
+    if (tid == 0)
     {
         Debug_println(" failed to get free task ID");
     }
-    else 
+    else
     {
         // store task
         t->_id = tid;
         _task_count += 1;
-        _task_map[tid] = t;
+        _table[free_slot] = t;
         _next_tid = tid+1;
+        if (_next_tid == 0) _next_tid = 1;
         Debug_printf(" submitted #%d\n", tid);
     }
     return tid;
@@ -69,7 +142,7 @@ uint8_t fnTaskManager::get_free_tid()
 {
     uint8_t stop = _next_tid;
     uint8_t tid = _next_tid;
-    while(_task_map.find(tid) != _task_map.end())
+    while(find_slot(tid) >= 0)
     {
         // try next ID, skip ID 0
         if (++tid == 0) ++tid;
@@ -83,13 +156,28 @@ uint8_t fnTaskManager::get_free_tid()
     return tid;
 }
 
+int fnTaskManager::find_slot(uint8_t tid)
+{
+    for (int i = 0; i < TASK_TABLE_SIZE; i++)
+        if (_table[i] != nullptr && _table[i]->_id == tid)
+            return i;
+    return -1;
+}
+
+void fnTaskManager::remove_slot(int slot)
+{
+    delete _table[slot];
+    _table[slot] = nullptr;
+    _task_count -= 1;
+}
+
 fnTask * fnTaskManager::get_task(uint8_t tid)
 {
     Debug_printf("get_task %d\n", tid);
-    std::map<uint8_t, fnTask *>::iterator it = _task_map.find(tid);
-    if (it == _task_map.end())
+    int slot = find_slot(tid);
+    if (slot < 0)
         return nullptr;
-    return it->second;
+    return _table[slot];
 }
 
 int fnTaskManager::pause_task(uint8_t tid)
@@ -123,91 +211,186 @@ int fnTaskManager::resume_task(uint8_t tid)
 int fnTaskManager::abort_task(uint8_t tid)
 {
     Debug_printf("abort_task %d\n", tid);
-    fnTask *task = get_task(tid);
-    if (task == nullptr)
+    int slot = find_slot(tid);
+    if (slot < 0)
         return -1;
+    fnTask *task = _table[slot];
+    if (task->_work_busy)
+    {
+        // work() is using the task's resources, finish the abort in service()
+        task->_abort_pending = true;
+        return 0;
+    }
     int result = task->abort();
     task->_state = fnTask::TASK_DONE;
     task->_reason = fnTask::TASK_ABORTED;
     // TODO callback
     // remove aborted task
-    _task_count -= 1;
-    _task_map.erase(tid);
-    delete task;
+    remove_slot(slot);
     return result;
 }
 
 int fnTaskManager::complete_task(uint8_t tid)
 {
     Debug_printf("complete_task %d\n", tid);
-    fnTask *task = get_task(tid);
-    if (task == nullptr)
+    int slot = find_slot(tid);
+    if (slot < 0)
         return -1;
+    fnTask *task = _table[slot];
     task->_state = fnTask::TASK_DONE;
     task->_reason = fnTask::TASK_COMPLETED;
     // TODO callback
     // remove completed task
-    _task_count -= 1;
-    _task_map.erase(tid);
-    delete task;
+    remove_slot(slot);
     return 0;
 }
 
-bool fnTaskManager::service()
+/* Step one task for up to its own budget, without exceeding the pass budget.
+   Returns true if the task did (or is doing) some work.
+*/
+bool fnTaskManager::run_task(int slot, uint64_t pass_start, uint32_t budget_us)
+{
+    fnTask *task = _table[slot];
+
+    if (task->_abort_pending)
+    {
+        if (!task->_work_busy)
+            abort_task(task->_id);
+        return true;
+    }
+
+    switch (task->_state)
+    {
+    case fnTask::TASK_READY:
+        if (task->start() < 0)
+            // failed to start task
+            abort_task(task->_id);
+        else
+            task->_state = fnTask::TASK_RUNNING;
+        return true;
+
+    case fnTask::TASK_RUNNING:
+        break;
+
+    default:
+        return false;
+    }
+
+    uint64_t task_start = fnSystem.micros();
+    uint64_t now;
+    do
+    {
+        if (task->_blocking)
+        {
+            if (task->_work_busy)
+                return true; // still on a worker thread
+
+            if (!task->_work_done)
+            {
+                if (_workers.empty())
+                {
+                    task->_work_result = task->work();
+                    task->_work_done = true;
+                }
+                else
+                {
+                    task->_work_busy = true;
+                    {
+                        std::lock_guard<std::mutex> lock(_work_mutex);
+                        _work_queue.push_back(task);
+                    }
+                    _work_cv.notify_one();
+                    return true;
+                }
+            }
+
+            task->_work_done = false;
+            if (task->_work_result < 0)
+            {
+                // failure in blocking part
+                abort_task(task->_id);
+                return true;
+            }
+        }
+
+        int result = task->step();
+        if (result < 0)
+        {
+            // failure in task execution
+            abort_task(task->_id);
+            return true;
+        }
+        if (result > 0)
+        {
+            // task completed
+            complete_task(task->_id);
+            return true;
+        }
+
+        now = fnSystem.micros();
+    } while (now - task_start < task->_budget_us && now - pass_start < budget_us);
+
+    return true;
+}
+
+bool fnTaskManager::service(uint32_t budget_us)
 {
     if (_task_count == 0)
         return true; // idle
 
+    uint64_t start = fnSystem.micros();
     bool idle = true; // was service() idle?
-    int result;
-    fnTask *task;
-    std::list <uint8_t> failed;
-    std::list <uint8_t> completed;
+    bool out_of_time = false;
 
-    // update READY and RUNNING tasks
-    for (auto it = _task_map.begin(); it != _task_map.end(); ++it)
+    // visit higher priorities first, each task at most once per pass
+    for (int prio = fnTask::PRIORITY_COUNT - 1; prio >= 0 && !out_of_time; prio--)
     {
-        task = it->second;
-        switch (task->_state)
+        for (int n = 0; n < TASK_TABLE_SIZE; n++)
         {
-        case fnTask::TASK_READY:
-            idle = false;
-            result = task->start();
-            if (result < 0)
-                // failed to start task
-                failed.push_back(it->first);
-            else
-                task->_state = fnTask::TASK_RUNNING;
-            break;
+            int slot = (_cursor + n) % TASK_TABLE_SIZE;
+            if (_table[slot] == nullptr || _table[slot]->_priority != prio)
+                continue;
+
+            if (run_task(slot, start, budget_us))
+                idle = false;
 
-        case fnTask::TASK_RUNNING:
-            idle = false;
-            result = task->step();
-            if (result < 0)
-                // failure in task execution
-                failed.push_back(it->first);
-            else if (result > 0)
+            if (fnSystem.micros() - start >= budget_us)
             {
-                // task completed
-                completed.push_back(it->first);
+                out_of_time = true;
+                break;
             }
-            break;
-        default:
-            ;
         }
     }
+    _cursor = (_cursor + 1) % TASK_TABLE_SIZE;
 
     if (!idle)
-    {
-        // handle failed tasks, if any
-        for (auto it = failed.begin(); it != failed.end(); ++it)
-            abort_task(*it);
-        // handle completed tasks, if any
-        for (auto it = completed.begin(); it != completed.end(); ++it)
-            complete_task(*it);
-    }
+        update_stats(start);
 
     return idle;
 }
 
-#endif // !ESP_PLATFORM
\ No newline at end of file
+// Track how long service() holds up the main loop, report it periodically
+void fnTaskManager::update_stats(uint64_t start)
+{
+    uint64_t now = fnSystem.micros();
+    uint32_t elapsed = (uint32_t)(now - start);
+
+    _stats.passes++;
+    _stats.total_us += elapsed;
+    if (elapsed > _stats.max_us)
+        _stats.max_us = elapsed;
+
+    uint64_t now_ms = now / 1000;
+    if (_stats_since == 0)
+        _stats_since = now_ms;
+    else if (now_ms - _stats_since >= TASK_STATS_INTERVAL_MS)
+    {
+        Debug_printf("fnTaskManager: %u passes, avg %u us, max %u us, %u task(s)\n",
+                     (unsigned)_stats.passes, (unsigned)(_stats.total_us / _stats.passes),
+                     (unsigned)_stats.max_us, (unsigned)_task_count);
+        _stats = fnTaskStats();
+        _stats_since = now_ms;
+    }
+}
+
+#endif // !ESP_PLATFORM
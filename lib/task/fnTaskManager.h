@@ -2,10 +2,27 @@
 #define _FN_TASKMANAGER_H
 
 #include <stdint.h>
-#include <map>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "fnTask.h"
 
+// max number of tasks submitted at the same time
+#define TASK_TABLE_SIZE 16
+// max time spent in one service() call before returning to the bus
+#define TASK_SERVICE_BUDGET_US 1000
+// interval of main loop timing reports
+#define TASK_STATS_INTERVAL_MS 10000
+
+struct fnTaskStats
+{
+    uint32_t passes = 0;        // service() calls with active tasks
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+};
 
 class fnTaskManager
 {
@@ -18,16 +35,37 @@ public:
     int pause_task(uint8_t tid);
     int resume_task(uint8_t tid);
     int abort_task(uint8_t tid);
-    bool service();
+    bool service(uint32_t budget_us = TASK_SERVICE_BUDGET_US);
+
+    // optional pool of threads to run work() of blocking tasks
+    void start_workers(int count);
+    void stop_workers();
+
+    const fnTaskStats &get_stats() { return _stats; }
 
 private:
     int complete_task(uint8_t tid);
     uint8_t get_free_tid();
+    int find_slot(uint8_t tid);
+    void remove_slot(int slot);
+    bool run_task(int slot, uint64_t pass_start, uint32_t budget_us);
+    void update_stats(uint64_t start);
+    void worker_loop();
     void shutdown();
 
-    std::map<uint8_t, fnTask *> _task_map;
+    fnTask *_table[TASK_TABLE_SIZE];
+    int _cursor;                // first slot to visit, rotates for fairness within a priority
     uint8_t _next_tid;
     uint8_t _task_count;
+
+    fnTaskStats _stats;
+    uint64_t _stats_since;
+
+    std::vector<std::thread> _workers;
+    std::deque<fnTask *> _work_queue;
+    std::mutex _work_mutex;
+    std::condition_variable _work_cv;
+    bool _workers_stop;
 };
 
 // global task manager
@@ -16,6 +16,8 @@
 
 
 #define UDP_RXTX_BUFLEN 1460
+// Datagrams fetched per recvmmsg() call
+#define UDP_RX_BATCH 8
 
 #if defined(_WIN32)
 // this only eliminates compilation errors on Windows
@@ -48,6 +50,14 @@ void fnUDP::stop()
         delete b;
     }
 
+    if (rx_scratch)
+    {
+        delete[] rx_scratch;
+        rx_scratch = nullptr;
+    }
+    rx_queue.clear();
+    rx_queue_bytes = 0;
+
     if (udp_server == -1)
         return;
 
@@ -112,6 +122,13 @@ bool fnUDP::begin(in_addr_t address, uint16_t port)
         return false;
     }
 
+    rx_stats = fnUDPStats();
+#ifdef __linux__
+    // Have the kernel report how many datagrams it dropped for lack of buffer space
+    rx_kernel_drops = 0;
+    setsockopt(udp_server, SOL_SOCKET, SO_RXQ_OVFL, &yes, sizeof(yes));
+#endif
+
 #if defined(_WIN32)
     unsigned long on = 1;
     ioctlsocket(udp_server, FIONBIO, &on);
@@ -233,21 +250,83 @@ size_t fnUDP::write(const uint8_t *buffer, size_t size)
     return i;
 }
 
-int fnUDP::parsePacket()
+int fnUDP::receive_batch()
 {
-    if (rx_buffer)
+    size_t room = UDP_RX_QUEUE_PACKETS - rx_queue.size();
+    if (udp_server == -1 || room == 0 || rx_queue_bytes >= UDP_RX_QUEUE_BYTES)
         return 0;
 
+#ifdef __linux__
+    if (room > UDP_RX_BATCH)
+        room = UDP_RX_BATCH;
+
+    if (!rx_scratch)
+        rx_scratch = new char[UDP_RX_BATCH * UDP_RXTX_BUFLEN];
+
+    struct mmsghdr msgs[UDP_RX_BATCH];
+    struct iovec iovs[UDP_RX_BATCH];
+    struct sockaddr_in addrs[UDP_RX_BATCH];
+    char control[UDP_RX_BATCH][CMSG_SPACE(sizeof(uint32_t))];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (size_t i = 0; i < room; i++)
+    {
+        iovs[i].iov_base = rx_scratch + i * UDP_RXTX_BUFLEN;
+        iovs[i].iov_len = UDP_RXTX_BUFLEN;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = control[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    int n = recvmmsg(udp_server, msgs, room, MSG_DONTWAIT, nullptr);
+    if (n < 0)
+    {
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+            Debug_printf("could not receive data: %d\r\n", errno);
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        struct msghdr *hdr = &msgs[i].msg_hdr;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+            {
+                uint32_t drops;
+                memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                rx_stats.dropped += drops - rx_kernel_drops;
+                rx_kernel_drops = drops;
+            }
+        }
+
+        rx_stats.received++;
+        if (hdr->msg_flags & MSG_TRUNC)
+            rx_stats.truncated++;
+
+        if (msgs[i].msg_len == 0)
+            continue;
+
+        rx_queue.push_back({addrs[i].sin_addr.s_addr, ntohs(addrs[i].sin_port),
+                            std::string((char *)iovs[i].iov_base, msgs[i].msg_len)});
+        rx_queue_bytes += msgs[i].msg_len;
+    }
+
+    return n;
+#else
+    if (!rx_scratch)
+        rx_scratch = new char[UDP_RXTX_BUFLEN];
+
     struct sockaddr_in si_other;
     int slen = sizeof(si_other);
     int len;
-    char *buf = new char[UDP_RXTX_BUFLEN];
-    if (!buf)
-        return 0;
 
-    if ((len = recvfrom(udp_server, buf, UDP_RXTX_BUFLEN, MSG_DONTWAIT, (struct sockaddr *)&si_other, (socklen_t *)&slen)) == -1)
+    if ((len = recvfrom(udp_server, rx_scratch, UDP_RXTX_BUFLEN, MSG_DONTWAIT, (struct sockaddr *)&si_other, (socklen_t *)&slen)) == -1)
     {
-        delete[] buf;
         int err = compat_getsockerr();
 #if defined(_WIN32)
         if (err != WSAEWOULDBLOCK)
@@ -258,16 +337,56 @@ int fnUDP::parsePacket()
         return 0;
     }
 
-    remote_ip = si_other.sin_addr.s_addr;
-    remote_port = ntohs(si_other.sin_port);
+    rx_stats.received++;
 
     if (len > 0)
     {
-        rx_buffer = new cbuf(len);
-        rx_buffer->write(buf, len);
+        rx_queue.push_back({si_other.sin_addr.s_addr, ntohs(si_other.sin_port), std::string(rx_scratch, len)});
+        rx_queue_bytes += len;
     }
-    delete[] buf;
-    return len;
+
+    return 1;
+#endif
+}
+
+int fnUDP::receive()
+{
+    while (receive_batch() > 0)
+        ;
+
+    return rx_queue.size();
+}
+
+bool fnUDP::nextDatagram(fnUDPDatagram &datagram)
+{
+    if (rx_queue.empty())
+        return false;
+
+    datagram = std::move(rx_queue.front());
+    rx_queue.pop_front();
+    rx_queue_bytes -= datagram.data.size();
+
+    return true;
+}
+
+int fnUDP::parsePacket()
+{
+    if (rx_buffer)
+        return 0;
+
+    receive();
+
+    fnUDPDatagram datagram;
+    if (!nextDatagram(datagram))
+        return 0;
+
+    remote_ip = datagram.ip;
+    remote_port = datagram.port;
+
+    rx_buffer = new cbuf(datagram.data.size());
+    rx_buffer->write(datagram.data.data(), datagram.data.size());
+
+    return datagram.data.size();
 }
 
 int fnUDP::read()
@@ -5,8 +5,30 @@
 
 #include "compat_inet.h"
 
+#include <deque>
+#include <string>
+
 #include "cbuf.h"
 
+// Received datagrams are drained from the socket into a bounded queue,
+// so bursts arriving between polls are not dropped by the small socket buffer
+#define UDP_RX_QUEUE_PACKETS 16
+#define UDP_RX_QUEUE_BYTES 8192
+
+struct fnUDPDatagram
+{
+    in_addr_t ip;
+    uint16_t port;
+    std::string data;
+};
+
+struct fnUDPStats
+{
+    uint32_t received = 0;  // datagrams taken from the socket
+    uint32_t dropped = 0;   // datagrams dropped by the socket (Linux only)
+    uint32_t truncated = 0; // datagrams larger than the receive buffer (Linux only)
+};
+
 
 class fnUDP
 {
@@ -19,6 +41,16 @@ private:
     char * tx_buffer = nullptr;
     size_t tx_buffer_len = 0;
     cbuf * rx_buffer = nullptr;
+    char * rx_scratch = nullptr;
+
+    std::deque<fnUDPDatagram> rx_queue;
+    size_t rx_queue_bytes = 0;
+    fnUDPStats rx_stats;
+#ifdef __linux__
+    uint32_t rx_kernel_drops = 0;
+#endif
+
+    int receive_batch();
 
 public:
     fnUDP();
@@ -43,6 +75,13 @@ public:
 
     int parsePacket();
 
+    // Move everything waiting on the socket into the receive queue, returns queue length
+    int receive();
+    // Take the oldest queued datagram, returns false if queue is empty
+    bool nextDatagram(fnUDPDatagram &datagram);
+
+    const fnUDPStats &stats() { return rx_stats; }
+
     int read();
     int read(unsigned char* buffer, size_t len);
     int read(char* buffer, size_t len);
@@ -0,0 +1,140 @@
+#include "byte_translator.h"
+
+#include <string.h>
+
+// Bytes of a machine word all set to 0x01 / 0x80 (4 bytes on ESP32, 8 on most hosts)
+static const size_t ONES = (size_t)-1 / 0xFF;
+static const size_t HIGHS = ONES * 0x80;
+
+ByteTranslator::ByteTranslator()
+{
+    for (int b = 0; b < 256; b++)
+    {
+        _len[b] = 1;
+        _out[b][0] = (char)b;
+    }
+    _update();
+}
+
+void ByteTranslator::set(uint8_t from, const char *to, size_t len)
+{
+    if (len > BYTE_TRANSLATOR_MAX_OUT)
+        len = BYTE_TRANSLATOR_MAX_OUT;
+    if (len > 0)
+        memcpy(_out[from], to, len);
+    _len[from] = len;
+    _update();
+}
+
+void ByteTranslator::replace(uint8_t from, const char *to, size_t len)
+{
+    ByteTranslator next;
+    next.set(from, to, len);
+    compose(next);
+}
+
+void ByteTranslator::compose(const ByteTranslator &next)
+{
+    for (int b = 0; b < 256; b++)
+    {
+        char out[BYTE_TRANSLATOR_MAX_OUT];
+        size_t n = 0;
+        for (size_t i = 0; i < _len[b]; i++)
+        {
+            uint8_t c = (uint8_t)_out[b][i];
+            for (size_t j = 0; j < next._len[c] && n < BYTE_TRANSLATOR_MAX_OUT; j++)
+                out[n++] = next._out[c][j];
+        }
+        memcpy(_out[b], out, n);
+        _len[b] = n;
+    }
+    _update();
+}
+
+void ByteTranslator::_update()
+{
+    _changed_count = 0;
+    _one_to_one = true;
+    for (int b = 0; b < 256; b++)
+    {
+        _changed[b] = !(_len[b] == 1 && (uint8_t)_out[b][0] == b);
+        if (!_changed[b])
+            continue;
+        if (_changed_count < BYTE_TRANSLATOR_MAX_SCAN)
+            _scan[_changed_count] = b;
+        _changed_count++;
+        if (_len[b] != 1)
+            _one_to_one = false;
+    }
+}
+
+// Position of the first byte at or after i that needs changing, n if none
+size_t ByteTranslator::_skip(const uint8_t *p, size_t i, size_t n) const
+{
+    if (_changed_count <= BYTE_TRANSLATOR_MAX_SCAN)
+    {
+        // A byte of w equals c where (w ^ c*ONES) has a zero byte
+        while (i + sizeof(size_t) <= n)
+        {
+            size_t w;
+            memcpy(&w, p + i, sizeof(w));
+            size_t hit = 0;
+            for (int k = 0; k < _changed_count; k++)
+            {
+                size_t x = w ^ (_scan[k] * ONES);
+                hit |= (x - ONES) & ~x & HIGHS;
+            }
+            if (hit)
+                break;
+            i += sizeof(size_t);
+        }
+    }
+
+    while (i < n && !_changed[p[i]])
+        i++;
+    return i;
+}
+
+void ByteTranslator::apply(std::string &s, size_t start) const
+{
+    if (_changed_count == 0 || start >= s.size())
+        return;
+
+    const uint8_t *src = (const uint8_t *)s.data();
+    size_t n = s.size();
+    size_t i = _skip(src, start, n);
+    if (i == n)
+        return;
+
+    if (_one_to_one)
+    {
+        char *p = &s[0];
+        while (i < n)
+        {
+            p[i] = _out[(uint8_t)p[i]][0];
+            i = _skip((const uint8_t *)p, i + 1, n);
+        }
+        return;
+    }
+
+    // Length changes, copy unchanged runs in bulk and build the result next to the source
+    std::string out;
+    out.reserve(n + (n - i) / 8);
+    out.append(s, 0, i);
+    while (i < n)
+    {
+        uint8_t b = src[i];
+        out.append(_out[b], _len[b]);
+        size_t next = _skip(src, i + 1, n);
+        out.append((const char *)src + i + 1, next - i - 1);
+        i = next;
+    }
+    s.swap(out);
+}
+
+std::string ByteTranslator::translate(const std::string &s) const
+{
+    std::string out = s;
+    apply(out);
+    return out;
+}
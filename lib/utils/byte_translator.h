@@ -0,0 +1,64 @@
+#ifndef BYTE_TRANSLATOR_H
+#define BYTE_TRANSLATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/*
+ Byte by byte text translation driven by a 256 entry table.
+
+ Each input byte maps to 0..BYTE_TRANSLATOR_MAX_OUT output bytes: itself, another
+ byte, nothing (dropped) or a short sequence (e.g. EOL -> CR LF, PETSCII -> UTF-8).
+ apply() translates a string in a single pass. Runs of bytes that stay as they are
+ are skipped a machine word at a time when only a few byte values need changing,
+ which is the usual case for line ending translation.
+
+ Tables are built once (see replace() and compose()) and can then be shared,
+ apply() doesn't modify the translator.
+*/
+
+#define BYTE_TRANSLATOR_MAX_OUT 4
+
+// Word-at-a-time search is used up to this many byte values that need changing
+#define BYTE_TRANSLATOR_MAX_SCAN 6
+
+class ByteTranslator
+{
+public:
+    ByteTranslator(); // identity
+
+    // Map byte `from` to `len` bytes of `to` (len 0 drops it)
+    void set(uint8_t from, const char *to, size_t len);
+    void set(uint8_t from, uint8_t to) { char c = (char)to; set(from, &c, 1); }
+    void drop(uint8_t from) { set(from, nullptr, 0); }
+
+    /* Replace byte `from` with `to` in the output of every entry, same result as
+       running std::replace over text that was already translated by this table
+    */
+    void replace(uint8_t from, const char *to, size_t len);
+    void replace(uint8_t from, uint8_t to) { char c = (char)to; replace(from, &c, 1); }
+
+    // Feed the output of every entry through `next`, so one pass does both
+    void compose(const ByteTranslator &next);
+
+    bool is_identity() const { return _changed_count == 0; }
+
+    // Translate s in place from position start on
+    void apply(std::string &s, size_t start = 0) const;
+    std::string translate(const std::string &s) const;
+
+private:
+    void _update();
+    size_t _skip(const uint8_t *p, size_t i, size_t n) const;
+
+    uint8_t _len[256];
+    char _out[256][BYTE_TRANSLATOR_MAX_OUT];
+    bool _changed[256];
+
+    int _changed_count;             // byte values that aren't mapped to themselves
+    bool _one_to_one;               // every byte maps to exactly one byte, can translate in place
+    uint8_t _scan[BYTE_TRANSLATOR_MAX_SCAN]; // values to search for when _changed_count is small
+};
+
+#endif // BYTE_TRANSLATOR_H
@@ -10,6 +10,7 @@
 //#include "../../include/petscii.h"
 #include "../../include/debug.h"
 #include "U8Char.h"
+#include "byte_translator.h"
 
 
 #if defined(_WIN32)
@@ -239,18 +240,31 @@ namespace mstr {
     //                 [](unsigned char c) { return ascii2petscii(c); });
     // }
 
-    // convert PETSCII to UTF8, using methods from U8Char
-    std::string toUTF8(const std::string &petsciiInput)
+    // PETSCII to UTF8 table, built once from U8Char
+    const ByteTranslator &petsciiToUTF8Table()
     {
-        std::string utf8string;
-        for(char petscii : petsciiInput) {
-            if(petscii > 0)
+        static const ByteTranslator table = [] {
+            ByteTranslator t;
+            for (int b = 0; b < 256; b++)
             {
-                U8Char u8char(petscii);
-                utf8string+=u8char.toUtf8();
+                char petscii = (char)b;
+                if (petscii > 0)
+                {
+                    std::string utf8 = U8Char(petscii).toUtf8();
+                    t.set(b, utf8.data(), utf8.size());
+                }
+                else
+                    t.drop(b);
             }
-        }
-        return utf8string;
+            return t;
+        }();
+        return table;
+    }
+
+    // convert PETSCII to UTF8, using methods from U8Char
+    std::string toUTF8(const std::string &petsciiInput)
+    {
+        return petsciiToUTF8Table().translate(petsciiInput);
     }
 
     // convert UTF8 to PETSCII, using methods from U8Char
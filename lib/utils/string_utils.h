@@ -7,6 +7,8 @@
 
 #include <vector>
 
+class ByteTranslator;
+
 void copyString(const std::string& input, char *dst, size_t dst_size);
 
 inline constexpr auto hash_djb2a(const std::string_view sv) {
@@ -58,6 +60,7 @@ namespace mstr {
     // void toASCII(std::string &s);
     // void toPETSCII(std::string &s);
     std::string toUTF8(const std::string &petsciiInput);
+    const ByteTranslator &petsciiToUTF8Table();
     std::string toPETSCII2(const std::string &utfInputString);
     std::string toHex(const uint8_t *input, size_t size);
     std::string toHex(const std::string &input);
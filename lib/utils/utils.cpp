@@ -974,12 +974,22 @@ std::string prependSlash(const std::string& str) {
 }
 
 #ifndef ESP_PLATFORM
+static bool _debug_enabled = true;
+
+void util_debug_enable(bool enable)
+{
+    _debug_enabled = enable;
+}
+
 // helper function for Debug_print* macros on fujinet-pc
 void util_debug_printf(const char *fmt, ...)
 {
     static bool print_ts = true;
     va_list argp;
 
+    if (!_debug_enabled)
+        return;
+
     if (!print_ts)
     {
         if (fmt != nullptr)
@@ -114,6 +114,8 @@ std::string prependSlash(const std::string& str);
 #ifndef ESP_PLATFORM
 // helper function for Debug_print* macros on fujinet-pc
 void util_debug_printf(const char *fmt, ...);
+// turn Debug_print* output off and on at run time (fujinet_bench mutes it)
+void util_debug_enable(bool enable);
 #endif // !ESP_PLATFORM
 
 char* util_strndup(const char* s, size_t n);
@@ -52,6 +52,9 @@ void call_char(void *data, const XML_Char *s, int len)
 
 bool WebDAV::begin_parser()
 {
+    // Drop the parser of a listing which wasn't read to the end
+    end_parser();
+
     // Create XML parser
     parser = XML_ParserCreate(NULL);
     if (parser == nullptr)
@@ -93,10 +96,7 @@ bool WebDAV::parse(const char *buf, int len, int isFinal)
         return true;
     }
 
-    // Put PROPFIND data to debug console
-    Debug_printf("WebDAV::parse data (%d bytes):\r\n", len);
-    if (len > 0)
-        Debug_printf("%s\r\n", buf);
+    Debug_printf("WebDAV::parse data (%d bytes)\r\n", len);
 
     // Parse the damned buffer
     XML_Status xs = XML_Parse(parser, buf, len, isFinal);
@@ -110,10 +110,19 @@ bool WebDAV::parse(const char *buf, int len, int isFinal)
     return false;
 }
 
+bool WebDAV::next(DAVEntry &entry)
+{
+    if (entries.empty())
+        return true;
+
+    entry = std::move(entries.front());
+    entries.pop_front();
+    return false;
+}
+
 void WebDAV::clear()
 {
     entries.clear();
-    entries.shrink_to_fit();
     currentEntry.filename.clear();
     currentEntry.fileSize.clear();
     currentEntry.isDir = false;
@@ -129,9 +138,15 @@ void WebDAV::Start(const XML_Char *el, const XML_Char **attr)
         insideResponse = true;
     }
     else if (IS_ANYNS_ELEMENT("displayname", el, el_len))
+    {
         insideDisplayName = true;
+        currentEntry.filename.clear();
+    }
     else if (IS_ANYNS_ELEMENT("getcontentlength", el, el_len))
+    {
         insideGetContentLength = true;
+        currentEntry.fileSize.clear();
+    }
 }
 
 void WebDAV::End(const XML_Char *el)
@@ -158,7 +173,10 @@ void WebDAV::End(const XML_Char *el)
 
         // store directory entry
         if (store)
+        {
+            Debug_printf("  %s, %s%s\n", currentEntry.filename.c_str(), currentEntry.fileSize.c_str(), currentEntry.isDir ? " DIR" : "");
             entries.push_back(currentEntry);
+        }
 
         // reset currentEntry
         currentEntry.filename.clear();
@@ -175,17 +193,12 @@ void WebDAV::End(const XML_Char *el)
 
 void WebDAV::Char(const XML_Char *s, int len)
 {
+    // text can arrive in several pieces, e.g. split between two parse() calls
     if (insideResponse == true)
     {
         if (insideDisplayName == true)
-        {
-            currentEntry.filename = std::string(s, len);
-            Debug_printf("  filename = %s\n", currentEntry.filename.c_str());
-        }
+            currentEntry.filename.append(s, len);
         else if (insideGetContentLength == true)
-        {
-            currentEntry.fileSize = std::string(s, len);
-            Debug_printf("  fileSize = %s\n", currentEntry.fileSize.c_str());
-        }
+            currentEntry.fileSize.append(s, len);
     }
 }
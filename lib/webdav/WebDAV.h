@@ -6,11 +6,19 @@
 #define WebDAV_H
 
 #include <expat.h>
+#include <deque>
 #include <string>
-#include <vector>
 
 // using namespace std;
 
+/**
+ * Size of the PROPFIND response pieces fed to the parser. Decoded entries wait
+ * in a queue until they are taken with next(), and the next piece is only
+ * parsed once the queue is empty, so at most one piece worth of entries is
+ * held in memory.
+ */
+#define WEBDAV_CHUNK_SIZE 512
+
 /**
  * @brief a class wrapping expat parser for directory entries
  */
@@ -54,9 +62,11 @@ public:
     bool parse(const char *buf, int len, int isFinal);
 
     /**
-     * @brief Called to scoot to beginning of directory entries
+     * @brief Take the oldest decoded directory entry
+     * @param entry receives the entry
+     * @return TRUE if no entry is waiting
      */
-    std::vector<WebDAV::DAVEntry>::iterator rewind() {return entries.begin();};
+    bool next(DAVEntry &entry);
 
     /**
      * @brief Called to remove all stored directory entries
@@ -83,12 +93,12 @@ public:
      */
     void Char(const XML_Char *s, int len);
 
+protected:
     /**
-     * @brief collection of DAV entries.
+     * @brief decoded DAV entries, not yet taken by next()
      */
-    std::vector<DAVEntry> entries;
+    std::deque<DAVEntry> entries;
 
-protected:
     /**
      * @brief the current entry
      */
@@ -112,7 +122,7 @@ protected:
     /**
      * Expat XML parser
      */
-    XML_Parser parser;
+    XML_Parser parser = nullptr;
 
     /*
      * Parsed entries counter
@@ -30,8 +30,14 @@
 
 #ifndef ESP_PLATFORM
 #include "fnTaskManager.h"
+#include "fujiImageIndex.h"
 #include "version.h"
 #include "build_version.h"
+
+// Worker threads for blocking task steps, 0 runs everything on the main loop
+#ifndef FN_TASK_WORKERS
+#define FN_TASK_WORKERS 2
+#endif
 #endif
 
 #ifdef BLUETOOTH_SUPPORT
@@ -91,6 +97,9 @@ void main_shutdown_handler()
     // Give devices an opportunity to clean up before rebooting
 
     SYSTEM_BUS.shutdown();
+
+    // Write out any config changes still waiting for the save delay
+    Config.flush();
 }
 
 // Initial setup
@@ -437,6 +446,11 @@ void main_setup(int argc, char *argv[])
   #endif // DEBUG
 #else
 // !ESP_PLATFORM
+    // Blocking parts of background tasks (e.g. web file downloads) run here
+    taskMgr.start_workers(FN_TASK_WORKERS);
+    // Crawls the hosts in the background, once the workers are up
+    imageIndex.setup();
+
     unsigned long endms = fnSystem.millis();
     Debug_printf("Setup complete @ %lu (%lums)\n", endms, endms - startms);
 #endif
@@ -501,6 +515,8 @@ void fn_service_loop(void *param)
 #endif
         SYSTEM_BUS.service();
 
+        Config.service();
+
 #ifdef ESP_PLATFORM
         taskYIELD(); // Allow other tasks to run
 #else
@@ -508,6 +524,7 @@ void fn_service_loop(void *param)
         fnHTTPD.service();
 
         taskMgr.service();
+        imageIndex.service();
 
         if (fnSystem.check_deferred_reboot())
         {